@@ -0,0 +1,970 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageBenchmarkCommandlet.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "RuntimeImageReader.h"
+#include "RuntimeImageUtils.h"
+#include "Helpers/GIFLoader.h"
+#include "Helpers/StreamingResampler.h"
+#include "Helpers/TGAHelpers.h"
+#include "Helpers/qoi.h"
+
+#include <atomic>
+#include <stdlib.h>
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageBenchmark, Log, All);
+
+namespace
+{
+    /**
+     * Counts allocations going through GMalloc while enabled, and the heap growth over the start of a case.
+     * Memory allocated by third party code with its own allocator is not seen
+     */
+    class FBenchmarkMalloc final : public FMalloc
+    {
+    public:
+        /**
+         * Wraps GMalloc on first use and stays installed for the rest of the process: memory allocated through it
+         * may be freed by any thread at any time later, so it can be neither destroyed nor swapped back out
+         */
+        static FBenchmarkMalloc& Get()
+        {
+            static FBenchmarkMalloc* Instance = []()
+            {
+                FBenchmarkMalloc* BenchmarkMalloc = new FBenchmarkMalloc(GMalloc);
+                GMalloc = BenchmarkMalloc;
+                return BenchmarkMalloc;
+            }();
+
+            return *Instance;
+        }
+
+        /** Disabled it only forwards to the wrapped allocator */
+        void SetEnabled(bool bInEnabled) { bEnabled = bInEnabled; }
+
+        void ResetCounters()
+        {
+            NumAllocations = 0;
+            StartBytes = LiveBytes.load();
+            PeakBytes = StartBytes;
+        }
+
+        int64 GetNumAllocations() const { return NumAllocations; }
+        int64 GetPeakBytes() const { return FMath::Max<int64>(PeakBytes - StartBytes, 0); }
+
+        virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            void* Result = InnerMalloc->Malloc(Count, Alignment);
+            OnAllocated(Result);
+            return Result;
+        }
+
+        virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            OnFreed(Original);
+            void* Result = InnerMalloc->Realloc(Original, Count, Alignment);
+            OnAllocated(Result);
+            return Result;
+        }
+
+        virtual void Free(void* Original) override
+        {
+            OnFreed(Original);
+            InnerMalloc->Free(Original);
+        }
+
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return InnerMalloc->QuantizeSize(Count, Alignment); }
+        virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return InnerMalloc->GetAllocationSize(Original, SizeOut); }
+        virtual void Trim(bool bTrimThreadCaches) override { InnerMalloc->Trim(bTrimThreadCaches); }
+        virtual void SetupTLSCachesOnCurrentThread() override { InnerMalloc->SetupTLSCachesOnCurrentThread(); }
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override { InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread(); }
+        virtual bool IsInternallyThreadSafe() const override { return InnerMalloc->IsInternallyThreadSafe(); }
+        virtual bool ValidateHeap() override { return InnerMalloc->ValidateHeap(); }
+        virtual void UpdateStats() override { InnerMalloc->UpdateStats(); }
+        virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { InnerMalloc->GetAllocatorStats(OutStats); }
+        virtual void DumpAllocatorStats(FOutputDevice& Ar) override { InnerMalloc->DumpAllocatorStats(Ar); }
+        virtual const TCHAR* GetDescriptiveName() override { return InnerMalloc->GetDescriptiveName(); }
+
+    private:
+        explicit FBenchmarkMalloc(FMalloc* InInnerMalloc)
+            : InnerMalloc(InInnerMalloc)
+        {}
+
+        void OnAllocated(void* Pointer)
+        {
+            SIZE_T Size = 0;
+            if (bEnabled && Pointer && InnerMalloc->GetAllocationSize(Pointer, Size))
+            {
+                ++NumAllocations;
+
+                const int64 Bytes = LiveBytes += (int64)Size;
+                int64 Peak = PeakBytes;
+                while (Bytes > Peak && !PeakBytes.compare_exchange_weak(Peak, Bytes))
+                {
+                }
+            }
+        }
+
+        void OnFreed(void* Pointer)
+        {
+            SIZE_T Size = 0;
+            if (bEnabled && Pointer && InnerMalloc->GetAllocationSize(Pointer, Size))
+            {
+                LiveBytes -= (int64)Size;
+            }
+        }
+
+    private:
+        FMalloc* InnerMalloc;
+
+        std::atomic<bool> bEnabled { false };
+        std::atomic<int64> NumAllocations { 0 };
+        std::atomic<int64> LiveBytes { 0 };
+        std::atomic<int64> PeakBytes { 0 };
+        int64 StartBytes = 0;
+    };
+
+    /** Source image of every synthetic case: gradients with noise in one half and flat bands in the other, so compressors see both */
+    TArray64<uint8> MakeSourcePixels(int32 SizeX, int32 SizeY)
+    {
+        TArray64<uint8> Pixels;
+        Pixels.SetNumUninitialized((int64)SizeX * SizeY * 4);
+
+        uint32 Noise = 0x9E3779B9;
+        for (int32 Y = 0; Y < SizeY; ++Y)
+        {
+            for (int32 X = 0; X < SizeX; ++X)
+            {
+                Noise = Noise * 1664525 + 1013904223;
+
+                uint8* Pixel = &Pixels[((int64)Y * SizeX + X) * 4];
+                const bool bFlat = Y < SizeY / 2;
+                Pixel[0] = (uint8)(X * 255 / FMath::Max(SizeX - 1, 1));
+                Pixel[1] = (uint8)(Y * 255 / FMath::Max(SizeY - 1, 1));
+                Pixel[2] = bFlat ? (uint8)((X / 32) * 32) : (uint8)(Noise >> 24);
+                Pixel[3] = bFlat ? 255 : (uint8)(128 + (Noise >> 25));
+
+                if (bFlat)
+                {
+                    Pixel[0] &= 0xE0;
+                    Pixel[1] &= 0xE0;
+                }
+            }
+        }
+
+        return Pixels;
+    }
+
+    void AppendLE16(TArray64<uint8>& Out, uint32 Value)
+    {
+        Out.Add((uint8)Value);
+        Out.Add((uint8)(Value >> 8));
+    }
+
+    void AppendLE32(TArray64<uint8>& Out, uint32 Value)
+    {
+        AppendLE16(Out, Value & 0xFFFF);
+        AppendLE16(Out, Value >> 16);
+    }
+
+    bool EncodeWithImageWrapper(EImageFormat ImageFormat, const void* RawData, int64 RawSize, int32 SizeX, int32 SizeY, ERGBFormat RGBFormat, int32 BitDepth, int32 Quality, TArray64<uint8>& OutEncoded)
+    {
+        IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+        TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(ImageFormat);
+        if (!ImageWrapper.IsValid() || !ImageWrapper->SetRaw(RawData, RawSize, SizeX, SizeY, RGBFormat, BitDepth))
+        {
+            return false;
+        }
+
+        OutEncoded = ImageWrapper->GetCompressed(Quality);
+        return OutEncoded.Num() > 0;
+    }
+
+    TArray64<uint8> ToRGBA16(const TArray64<uint8>& Pixels)
+    {
+        TArray64<uint8> Result;
+        Result.SetNumUninitialized(Pixels.Num() * 2);
+
+        uint16* Dest = (uint16*)Result.GetData();
+        for (int64 Index = 0; Index < Pixels.Num(); Index += 4)
+        {
+            // BGRA8 to RGBA16, the low byte repeats the high one so all 16 bits vary
+            *Dest++ = Pixels[Index + 2] * 257;
+            *Dest++ = Pixels[Index + 1] * 257;
+            *Dest++ = Pixels[Index + 0] * 257;
+            *Dest++ = Pixels[Index + 3] * 257;
+        }
+
+        return Result;
+    }
+
+    TArray64<uint8> ToRGBA16F(const TArray64<uint8>& Pixels)
+    {
+        TArray64<uint8> Result;
+        Result.SetNumUninitialized(Pixels.Num() * 2);
+
+        FFloat16* Dest = (FFloat16*)Result.GetData();
+        for (int64 Index = 0; Index < Pixels.Num(); Index += 4)
+        {
+            *Dest++ = FFloat16(Pixels[Index + 2] / 64.0f);
+            *Dest++ = FFloat16(Pixels[Index + 1] / 64.0f);
+            *Dest++ = FFloat16(Pixels[Index + 0] / 64.0f);
+            *Dest++ = FFloat16(Pixels[Index + 3] / 255.0f);
+        }
+
+        return Result;
+    }
+
+    /** 24 bit bottom-up BMP, the variant every reader supports */
+    TArray64<uint8> EncodeBMP(const TArray64<uint8>& Pixels, int32 SizeX, int32 SizeY)
+    {
+        const uint32 RowSize = Align(SizeX * 3, 4);
+        const uint32 ImageSize = RowSize * SizeY;
+
+        TArray64<uint8> Out;
+        Out.Reserve(54 + ImageSize);
+
+        Out.Add('B');
+        Out.Add('M');
+        AppendLE32(Out, 54 + ImageSize);
+        AppendLE32(Out, 0);
+        AppendLE32(Out, 54);
+
+        AppendLE32(Out, 40);
+        AppendLE32(Out, SizeX);
+        AppendLE32(Out, SizeY);
+        AppendLE16(Out, 1);
+        AppendLE16(Out, 24);
+        AppendLE32(Out, 0);
+        AppendLE32(Out, ImageSize);
+        AppendLE32(Out, 2835);
+        AppendLE32(Out, 2835);
+        AppendLE32(Out, 0);
+        AppendLE32(Out, 0);
+
+        for (int32 Y = SizeY - 1; Y >= 0; --Y)
+        {
+            const uint8* Row = &Pixels[(int64)Y * SizeX * 4];
+            for (int32 X = 0; X < SizeX; ++X)
+            {
+                Out.Append(Row + X * 4, 3);
+            }
+            Out.AddZeroed(RowSize - SizeX * 3);
+        }
+
+        return Out;
+    }
+
+    /** 32 bit top-down TGA, raw (type 2) or run length encoded (type 10) */
+    TArray64<uint8> EncodeTGA(const TArray64<uint8>& Pixels, int32 SizeX, int32 SizeY, bool bRLE)
+    {
+        TArray64<uint8> Out;
+        Out.Reserve(18 + Pixels.Num());
+
+        Out.Add(0);
+        Out.Add(0);
+        Out.Add(bRLE ? 10 : 2);
+        Out.AddZeroed(5);
+        AppendLE16(Out, 0);
+        AppendLE16(Out, 0);
+        AppendLE16(Out, SizeX);
+        AppendLE16(Out, SizeY);
+        Out.Add(32);
+        Out.Add(0x28);
+
+        if (!bRLE)
+        {
+            Out.Append(Pixels);
+            return Out;
+        }
+
+        const uint32* Source = (const uint32*)Pixels.GetData();
+        for (int32 Y = 0; Y < SizeY; ++Y)
+        {
+            const uint32* Row = Source + (int64)Y * SizeX;
+
+            int32 X = 0;
+            while (X < SizeX)
+            {
+                int32 RunLength = 1;
+                while (X + RunLength < SizeX && RunLength < 128 && Row[X + RunLength] == Row[X])
+                {
+                    ++RunLength;
+                }
+
+                if (RunLength > 1)
+                {
+                    Out.Add((uint8)(0x80 | (RunLength - 1)));
+                    Out.Append((const uint8*)(Row + X), 4);
+                    X += RunLength;
+                    continue;
+                }
+
+                // raw packet up to the next run
+                int32 RawLength = 1;
+                while (X + RawLength < SizeX && RawLength < 128 && (X + RawLength + 1 >= SizeX || Row[X + RawLength] != Row[X + RawLength + 1]))
+                {
+                    ++RawLength;
+                }
+
+                Out.Add((uint8)(RawLength - 1));
+                Out.Append((const uint8*)(Row + X), (int64)RawLength * 4);
+                X += RawLength;
+            }
+        }
+
+        return Out;
+    }
+
+    /** Radiance HDR with flat (not run length encoded) scanlines */
+    TArray64<uint8> EncodeHDR(const TArray64<uint8>& Pixels, int32 SizeX, int32 SizeY)
+    {
+        const FTCHARToUTF8 Header(*FString::Printf(TEXT("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n"), SizeY, SizeX));
+
+        TArray64<uint8> Out;
+        Out.Append((const uint8*)Header.Get(), Header.Length());
+        Out.Reserve(Out.Num() + Pixels.Num());
+
+        for (int64 Index = 0; Index < Pixels.Num(); Index += 4)
+        {
+            // mantissas stay at 128 and above, so a scanline never looks like the start of an RLE one
+            Out.Add(128 + (Pixels[Index + 2] >> 1));
+            Out.Add(128 + (Pixels[Index + 1] >> 1));
+            Out.Add(128 + (Pixels[Index + 0] >> 1));
+            Out.Add(129);
+        }
+
+        return Out;
+    }
+
+    TArray64<uint8> EncodeQOI(const TArray64<uint8>& Pixels, int32 SizeX, int32 SizeY)
+    {
+        TArray64<uint8> RGBA = Pixels;
+        for (int64 Index = 0; Index < RGBA.Num(); Index += 4)
+        {
+            Swap(RGBA[Index], RGBA[Index + 2]);
+        }
+
+        qoi_desc Description;
+        Description.width = SizeX;
+        Description.height = SizeY;
+        Description.channels = 4;
+        Description.colorspace = QOI_SRGB;
+
+        int EncodedLength = 0;
+        void* Encoded = qoi_encode(RGBA.GetData(), &Description, &EncodedLength);
+
+        TArray64<uint8> Out;
+        if (Encoded)
+        {
+            Out.Append((const uint8*)Encoded, EncodedLength);
+            free(Encoded);
+        }
+
+        return Out;
+    }
+
+    /** Baseline little-endian TIFF, a single uncompressed RGBA strip */
+    TArray64<uint8> EncodeTIFF(const TArray64<uint8>& Pixels, int32 SizeX, int32 SizeY)
+    {
+        constexpr uint32 NumEntries = 11;
+        constexpr uint32 BitsPerSampleOffset = 8 + 2 + NumEntries * 12 + 4;
+        constexpr uint32 PixelsOffset = BitsPerSampleOffset + 8;
+        constexpr uint32 ShortType = 3;
+        constexpr uint32 LongType = 4;
+
+        TArray64<uint8> Out;
+        Out.Reserve(PixelsOffset + Pixels.Num());
+
+        Out.Add('I');
+        Out.Add('I');
+        AppendLE16(Out, 42);
+        AppendLE32(Out, 8);
+
+        auto AppendEntry = [&Out](uint32 Tag, uint32 Type, uint32 Count, uint32 Value)
+        {
+            AppendLE16(Out, Tag);
+            AppendLE16(Out, Type);
+            AppendLE32(Out, Count);
+            // short values are left-justified in the value field
+            Type == ShortType && Count == 1 ? (AppendLE16(Out, Value), AppendLE16(Out, 0)) : AppendLE32(Out, Value);
+        };
+
+        AppendLE16(Out, NumEntries);
+        AppendEntry(256, LongType, 1, SizeX);                               // ImageWidth
+        AppendEntry(257, LongType, 1, SizeY);                               // ImageLength
+        AppendEntry(258, ShortType, 4, BitsPerSampleOffset);                // BitsPerSample
+        AppendEntry(259, ShortType, 1, 1);                                  // Compression: none
+        AppendEntry(262, ShortType, 1, 2);                                  // PhotometricInterpretation: RGB
+        AppendEntry(273, LongType, 1, PixelsOffset);                        // StripOffsets
+        AppendEntry(277, ShortType, 1, 4);                                  // SamplesPerPixel
+        AppendEntry(278, LongType, 1, SizeY);                               // RowsPerStrip
+        AppendEntry(279, LongType, 1, (uint32)Pixels.Num());                // StripByteCounts
+        AppendEntry(284, ShortType, 1, 1);                                  // PlanarConfiguration: chunky
+        AppendEntry(338, ShortType, 1, 2);                                  // ExtraSamples: unassociated alpha
+        AppendLE32(Out, 0);
+
+        for (int32 Sample = 0; Sample < 4; ++Sample)
+        {
+            AppendLE16(Out, 8);
+        }
+
+        const int64 PixelsStart = Out.Num();
+        Out.Append(Pixels);
+        for (int64 Index = PixelsStart; Index < Out.Num(); Index += 4)
+        {
+            Swap(Out[Index], Out[Index + 2]);
+        }
+
+        return Out;
+    }
+
+    /** Encodes the synthetic source image, false for formats without an encoder here */
+    bool EncodeSource(const FString& Format, const TArray64<uint8>& Pixels, int32 SizeX, int32 SizeY, TArray64<uint8>& OutEncoded)
+    {
+        if (Format == TEXT("PNG8"))
+        {
+            return EncodeWithImageWrapper(EImageFormat::PNG, Pixels.GetData(), Pixels.Num(), SizeX, SizeY, ERGBFormat::BGRA, 8, 0, OutEncoded);
+        }
+        if (Format == TEXT("PNG16"))
+        {
+            const TArray64<uint8> RGBA16 = ToRGBA16(Pixels);
+            return EncodeWithImageWrapper(EImageFormat::PNG, RGBA16.GetData(), RGBA16.Num(), SizeX, SizeY, ERGBFormat::RGBA, 16, 0, OutEncoded);
+        }
+        if (Format == TEXT("JPEG"))
+        {
+            return EncodeWithImageWrapper(EImageFormat::JPEG, Pixels.GetData(), Pixels.Num(), SizeX, SizeY, ERGBFormat::BGRA, 8, 85, OutEncoded);
+        }
+        if (Format == TEXT("EXR"))
+        {
+            const TArray64<uint8> RGBA16F = ToRGBA16F(Pixels);
+            return EncodeWithImageWrapper(EImageFormat::EXR, RGBA16F.GetData(), RGBA16F.Num(), SizeX, SizeY, ERGBFormat::RGBA, 16, 0, OutEncoded);
+        }
+
+        if (Format == TEXT("BMP"))
+        {
+            OutEncoded = EncodeBMP(Pixels, SizeX, SizeY);
+        }
+        else if (Format == TEXT("TGA"))
+        {
+            OutEncoded = EncodeTGA(Pixels, SizeX, SizeY, false);
+        }
+        else if (Format == TEXT("TGA_RLE"))
+        {
+            OutEncoded = EncodeTGA(Pixels, SizeX, SizeY, true);
+        }
+        else if (Format == TEXT("HDR"))
+        {
+            OutEncoded = EncodeHDR(Pixels, SizeX, SizeY);
+        }
+        else if (Format == TEXT("QOI"))
+        {
+            OutEncoded = EncodeQOI(Pixels, SizeX, SizeY);
+        }
+        else if (Format == TEXT("TIFF"))
+        {
+            OutEncoded = EncodeTIFF(Pixels, SizeX, SizeY);
+        }
+
+        return OutEncoded.Num() > 0;
+    }
+
+    /** A constant image has to come out at full weight in every output row and column, whatever the source size and scale */
+    bool VerifyStreamingResampler(FString& OutError)
+    {
+        TArray<FIntPoint> SourceSizes;
+        for (int32 Size = 1; Size <= 2048; ++Size)
+        {
+            SourceSizes.Add(FIntPoint(Size, 3));
+            SourceSizes.Add(FIntPoint(3, Size));
+        }
+
+        // heights that used to get an empty output row
+        SourceSizes.Add(FIntPoint(1, 40001));
+        SourceSizes.Add(FIntPoint(1, 1086));
+        SourceSizes.Add(FIntPoint(1, 1179));
+
+        for (const FIntPoint& SourceSize : SourceSizes)
+        {
+            for (const int32 Percent : { 25, 50, 75 })
+            {
+                // same output size as FPNGScanlineDecoder::DecodeDownscaled
+                const int32 DestSizeX = FMath::Max(1, (int32)FMath::Floor(SourceSize.X * Percent * 0.01f));
+                const int32 DestSizeY = FMath::Max(1, (int32)FMath::Floor(SourceSize.Y * Percent * 0.01f));
+
+                FImage DestImage;
+                DestImage.Init(DestSizeX, DestSizeY, ERawImageFormat::G8);
+
+                TArray<uint8> SourceRow;
+                SourceRow.Init(255, SourceSize.X);
+
+                FStreamingAreaResampler Resampler(SourceSize.X, SourceSize.Y, 1, DestImage);
+                while (!Resampler.IsComplete())
+                {
+                    Resampler.AddRow(SourceRow.GetData());
+                }
+
+                for (int64 Index = 0; Index < DestImage.RawData.Num(); ++Index)
+                {
+                    if (DestImage.RawData[Index] != 255)
+                    {
+                        OutError = FString::Printf(
+                            TEXT("%d x %d at %d%%: output pixel (%lld, %lld) is %d instead of 255"),
+                            SourceSize.X, SourceSize.Y, Percent, Index % DestSizeX, Index / DestSizeX, DestImage.RawData[Index]
+                        );
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    TArray<uint8> MakeTGA(uint16 Width, uint16 Height, uint8 ImageTypeCode, uint8 BitsPerPixel, uint8 ImageDescriptor, const TArray<uint8>& PixelData)
+    {
+        FTGAHelpers::FTGAFileHeader Header = {};
+        Header.ImageTypeCode = ImageTypeCode;
+        Header.Width = Width;
+        Header.Height = Height;
+        Header.BitsPerPixel = BitsPerPixel;
+        Header.ImageDescriptor = ImageDescriptor;
+
+        TArray<uint8> TGA;
+        TGA.Append((const uint8*)&Header, sizeof(Header));
+        TGA.Append(PixelData);
+        return TGA;
+    }
+
+    /**
+     * TGA headers can claim 65535 x 65535 (17 GB as BGRA). Files that can't hold such pixels have to be rejected
+     * before anything is allocated, truncated RLE data must not be read past, and valid small files still decode
+     */
+    bool VerifyTGADecoder(FString& OutError)
+    {
+        struct FOversizedHeader
+        {
+            uint8 ImageTypeCode;
+            uint8 BitsPerPixel;
+        };
+
+        for (const FOversizedHeader& Oversized : { FOversizedHeader{ 2, 32 }, FOversizedHeader{ 2, 24 }, FOversizedHeader{ 10, 32 }, FOversizedHeader{ 3, 8 } })
+        {
+            TArray<uint8> PixelData;
+            PixelData.Init(0, 64);
+            const TArray<uint8> TGA = MakeTGA(MAX_uint16, MAX_uint16, Oversized.ImageTypeCode, Oversized.BitsPerPixel, 0, PixelData);
+
+            FRuntimeImageData Image;
+            FString Error;
+            if (FTGAHelpers::DecompressTGA((const FTGAHelpers::FTGAFileHeader*)TGA.GetData(), TGA.Num(), Image, Error) || Error.IsEmpty() || Image.RawData.Num() > 0)
+            {
+                OutError = FString::Printf(TEXT("65535 x 65535 TGA (type %d, %d bpp) with %d bytes of pixels was not rejected"), Oversized.ImageTypeCode, Oversized.BitsPerPixel, PixelData.Num());
+                return false;
+            }
+        }
+
+        // raw run of 4 pixels with only 2 present
+        {
+            TArray<uint8> PixelData = { 0x03 };
+            PixelData.AddZeroed(8);
+            const TArray<uint8> TGA = MakeTGA(2, 2, 10, 32, 0, PixelData);
+
+            FRuntimeImageData Image;
+            FString Error;
+            if (FRuntimeImageUtils::ImportBufferAsImage(TGA.GetData(), TGA.Num(), Image, Error))
+            {
+                OutError = TEXT("Truncated RLE TGA was decoded");
+                return false;
+            }
+        }
+
+        // top-left origin, rows come out in file order
+        {
+            const TArray<uint8> PixelData = { 1, 2, 3, 255, 4, 5, 6, 255, 7, 8, 9, 255, 10, 11, 12, 255 };
+            const TArray<uint8> TGA = MakeTGA(2, 2, 2, 32, 0x20, PixelData);
+
+            FRuntimeImageData Image;
+            FString Error;
+            if (!FRuntimeImageUtils::ImportBufferAsImage(TGA.GetData(), TGA.Num(), Image, Error))
+            {
+                OutError = FString::Printf(TEXT("2 x 2 TGA failed to decode: %s"), *Error);
+                return false;
+            }
+
+            if (Image.SizeX != 2 || Image.SizeY != 2 || Image.RawData.Num() != PixelData.Num() || FMemory::Memcmp(Image.RawData.GetData(), PixelData.GetData(), PixelData.Num()) != 0)
+            {
+                OutError = TEXT("2 x 2 TGA decoded to the wrong pixels");
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    struct FBenchmarkCase
+    {
+        FString Name;
+        FString Format;
+        int32 SizeX = 0;
+        int32 SizeY = 0;
+        int64 InputBytes = 0;
+
+        /** Untimed preparation before every iteration */
+        TFunction<void()> Setup;
+
+        /** The measured work */
+        TFunction<bool(FString& OutError)> Run;
+    };
+
+    TSharedRef<FJsonObject> RunCase(const FBenchmarkCase& Case, int32 NumIterations, FBenchmarkMalloc& BenchmarkMalloc, bool& bOutSuccess)
+    {
+        TArray<double> Milliseconds;
+        int64 NumAllocations = 0;
+        int64 PeakBytes = 0;
+        FString Error;
+
+        bOutSuccess = true;
+        for (int32 Iteration = 0; Iteration < NumIterations && bOutSuccess; ++Iteration)
+        {
+            if (Case.Setup)
+            {
+                Case.Setup();
+            }
+
+            BenchmarkMalloc.ResetCounters();
+            const double StartTime = FPlatformTime::Seconds();
+
+            bOutSuccess = Case.Run(Error);
+
+            Milliseconds.Add((FPlatformTime::Seconds() - StartTime) * 1000.0);
+            NumAllocations += BenchmarkMalloc.GetNumAllocations();
+            PeakBytes = FMath::Max(PeakBytes, BenchmarkMalloc.GetPeakBytes());
+        }
+
+        Milliseconds.Sort();
+        const double MedianMs = Milliseconds.Num() > 0 ? Milliseconds[Milliseconds.Num() / 2] : 0.0;
+        const double Megapixels = (double)Case.SizeX * Case.SizeY / 1000000.0;
+
+        TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+        Result->SetStringField(TEXT("case"), Case.Name);
+        Result->SetStringField(TEXT("format"), Case.Format);
+        Result->SetNumberField(TEXT("width"), Case.SizeX);
+        Result->SetNumberField(TEXT("height"), Case.SizeY);
+        Result->SetNumberField(TEXT("inputBytes"), Case.InputBytes);
+        Result->SetNumberField(TEXT("iterations"), Milliseconds.Num());
+        Result->SetNumberField(TEXT("medianMs"), MedianMs);
+        Result->SetNumberField(TEXT("minMs"), Milliseconds.Num() > 0 ? Milliseconds[0] : 0.0);
+        Result->SetNumberField(TEXT("msPerMegapixel"), Megapixels > 0.0 ? MedianMs / Megapixels : 0.0);
+        Result->SetNumberField(TEXT("peakHeapBytes"), PeakBytes);
+        Result->SetNumberField(TEXT("allocationsPerIteration"), Milliseconds.Num() > 0 ? NumAllocations / Milliseconds.Num() : 0);
+        Result->SetBoolField(TEXT("success"), bOutSuccess);
+        if (!bOutSuccess)
+        {
+            Result->SetStringField(TEXT("error"), Error);
+        }
+
+        UE_LOG(
+            LogRuntimeImageBenchmark, Display, TEXT("%-8s %-8s %5d x %-5d %9.2f ms %8.2f ms/MP %8.1f MB peak %7lld allocs %s"),
+            *Case.Name, *Case.Format, Case.SizeX, Case.SizeY, MedianMs, Megapixels > 0.0 ? MedianMs / Megapixels : 0.0,
+            PeakBytes / (1024.0 * 1024.0), Milliseconds.Num() > 0 ? NumAllocations / Milliseconds.Num() : 0, bOutSuccess ? TEXT("") : *Error
+        );
+
+        return Result;
+    }
+}
+
+URuntimeImageBenchmarkCommandlet::URuntimeImageBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 URuntimeImageBenchmarkCommandlet::Main(const FString& Params)
+{
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamValues;
+    ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+    const FString OutputFilename = ParamValues.Contains(TEXT("Output"))
+        ? FPaths::ConvertRelativePathToFull(ParamValues[TEXT("Output")])
+        : FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("RuntimeImageLoader"), TEXT("Benchmarks"), FDateTime::Now().ToString() + TEXT(".json"));
+    const int32 NumIterations = ParamValues.Contains(TEXT("Iterations")) ? FMath::Max(1, FCString::Atoi(*ParamValues[TEXT("Iterations")])) : 5;
+
+    TArray<int32> Sizes;
+    {
+        TArray<FString> SizeTokens;
+        ParamValues.FindRef(TEXT("Sizes")).ParseIntoArray(SizeTokens, TEXT(","));
+        for (const FString& SizeToken : SizeTokens)
+        {
+            // up to 32768 so a single image can exceed 2 GB decoded, e.g. -Sizes=24576 -Formats=PNG8
+            Sizes.Add(FMath::Clamp(FCString::Atoi(*SizeToken), 4, 32768));
+        }
+        if (Sizes.Num() == 0)
+        {
+            Sizes = { 256, 1024, 4096 };
+        }
+    }
+
+    const TArray<FString> AllFormats = { TEXT("PNG8"), TEXT("PNG16"), TEXT("JPEG"), TEXT("BMP"), TEXT("TGA"), TEXT("TGA_RLE"), TEXT("EXR"), TEXT("TIFF"), TEXT("QOI"), TEXT("HDR") };
+    TArray<FString> Formats;
+    ParamValues.FindRef(TEXT("Formats")).ParseIntoArray(Formats, TEXT(","));
+    if (Formats.Num() == 0)
+    {
+        Formats = AllFormats;
+    }
+
+    TArray<FBenchmarkCase> Cases;
+
+    // everything a case touches outside its own closure, kept alive until all cases ran
+    TArray<TSharedRef<TArray64<uint8>>> EncodedSources;
+    TArray<TSharedRef<FRuntimeImageData>> WorkImages;
+
+    for (const int32 Size : Sizes)
+    {
+        const TArray64<uint8> Pixels = MakeSourcePixels(Size, Size);
+
+        for (const FString& Format : Formats)
+        {
+            if (!AllFormats.Contains(Format))
+            {
+                UE_LOG(LogRuntimeImageBenchmark, Warning, TEXT("Unknown format %s, expected one of %s"), *Format, *FString::Join(AllFormats, TEXT(",")));
+                continue;
+            }
+
+            // HDR sources are equirectangular panoramas, which is what the cubemap case needs
+            const int32 SizeX = Size;
+            const int32 SizeY = Format == TEXT("HDR") ? FMath::Max(Size / 2, 1) : Size;
+
+            TSharedRef<TArray64<uint8>> Encoded = MakeShared<TArray64<uint8>>();
+            if (!EncodeSource(Format, Format == TEXT("HDR") ? MakeSourcePixels(SizeX, SizeY) : Pixels, SizeX, SizeY, *Encoded))
+            {
+                UE_LOG(LogRuntimeImageBenchmark, Warning, TEXT("Failed to encode a %d x %d %s source, skipped"), SizeX, SizeY, *Format);
+                continue;
+            }
+            EncodedSources.Add(Encoded);
+
+            FBenchmarkCase& DecodeCase = Cases.AddDefaulted_GetRef();
+            DecodeCase.Name = TEXT("decode");
+            DecodeCase.Format = Format;
+            DecodeCase.SizeX = SizeX;
+            DecodeCase.SizeY = SizeY;
+            DecodeCase.InputBytes = Encoded->Num();
+            DecodeCase.Run = [Encoded, SizeX, SizeY](FString& OutError)
+            {
+                FRuntimeImageData ImageData;
+                if (!FRuntimeImageUtils::ImportBufferAsImage(Encoded->GetData(), Encoded->Num(), ImageData, OutError))
+                {
+                    return false;
+                }
+
+                // catches sizes truncated to 32 bits on the way, decoded images above 2 GB included
+                const int64 ExpectedBytes = (int64)SizeX * SizeY * ImageData.GetBytesPerPixel();
+                if (ImageData.SizeX != SizeX || ImageData.SizeY != SizeY || ImageData.RawData.Num() != ExpectedBytes)
+                {
+                    OutError = FString::Printf(TEXT("Decoded %d x %d with %lld bytes, expected %d x %d with %lld bytes"), ImageData.SizeX, ImageData.SizeY, ImageData.RawData.Num(), SizeX, SizeY, ExpectedBytes);
+                    return false;
+                }
+
+                return true;
+            };
+
+            // the transform cases start from a decoded image, restored before every iteration
+            TSharedRef<FRuntimeImageData> DecodedImage = MakeShared<FRuntimeImageData>();
+            FString Error;
+            if (!FRuntimeImageUtils::ImportBufferAsImage(Encoded->GetData(), Encoded->Num(), *DecodedImage, Error))
+            {
+                continue;
+            }
+
+            TSharedRef<FRuntimeImageData> WorkImage = MakeShared<FRuntimeImageData>();
+            WorkImages.Add(WorkImage);
+
+            FBenchmarkCase TransformCase;
+            TransformCase.Format = Format;
+            TransformCase.SizeX = SizeX;
+            TransformCase.SizeY = SizeY;
+            TransformCase.InputBytes = DecodedImage->RawData.Num();
+            TransformCase.Setup = [DecodedImage, WorkImage]() { *WorkImage = *DecodedImage; };
+
+            if (Format == TEXT("PNG8"))
+            {
+                FBenchmarkCase& ResizeCase = Cases.Add_GetRef(TransformCase);
+                ResizeCase.Name = TEXT("resize");
+                ResizeCase.Run = [WorkImage](FString& OutError)
+                {
+                    FTransformImageParams TransformParams;
+                    TransformParams.PercentSizeX = 50;
+                    TransformParams.PercentSizeY = 50;
+                    URuntimeImageReader::ApplySizeFormatTransformations(*WorkImage, TransformParams);
+                    return true;
+                };
+            }
+            else if (Format == TEXT("PNG16"))
+            {
+                // the conversion done for pixel-only requests
+                FBenchmarkCase& PixelsCase = Cases.Add_GetRef(TransformCase);
+                PixelsCase.Name = TEXT("pixels");
+                PixelsCase.Run = [WorkImage](FString& OutError)
+                {
+                    const TArray<FColor> Pixels = WorkImage->AsBGRA8();
+                    return Pixels.Num() > 0;
+                };
+            }
+            else if (Format == TEXT("HDR"))
+            {
+                FBenchmarkCase& CubemapCase = Cases.Add_GetRef(TransformCase);
+                CubemapCase.Name = TEXT("cubemap");
+                CubemapCase.Run = [WorkImage](FString& OutError)
+                {
+                    URuntimeImageReader::ApplySizeFormatTransformations(*WorkImage, FTransformImageParams());
+                    return WorkImage->RawData.Num() > 0;
+                };
+            }
+        }
+    }
+
+    // a correctness check rather than a benchmark, the streaming downscale behind PercentSize PNG loads
+    {
+        FBenchmarkCase& ResamplerCase = Cases.AddDefaulted_GetRef();
+        ResamplerCase.Name = TEXT("resampler-sweep");
+        ResamplerCase.Format = TEXT("G8");
+        ResamplerCase.Run = [](FString& OutError) { return VerifyStreamingResampler(OutError); };
+    }
+
+    {
+        FBenchmarkCase& TGACase = Cases.AddDefaulted_GetRef();
+        TGACase.Name = TEXT("tga-headers");
+        TGACase.Format = TEXT("TGA");
+        TGACase.Run = [](FString& OutError) { return VerifyTGADecoder(OutError); };
+    }
+
+    // formats without an encoder here (GIF, WebP) and any other real world files, benchmarked at their own size
+    if (ParamValues.Contains(TEXT("Corpus")))
+    {
+        TArray<FString> CorpusFilenames;
+        IFileManager::Get().FindFilesRecursive(CorpusFilenames, *FPaths::ConvertRelativePathToFull(ParamValues[TEXT("Corpus")]), TEXT("*.*"), true, false);
+
+        for (const FString& Filename : CorpusFilenames)
+        {
+            const FString Extension = FPaths::GetExtension(Filename).ToLower();
+            const bool bAnimated = Extension == TEXT("gif") || Extension == TEXT("webp");
+            if (!bAnimated && !FRuntimeImageUtils::IsSupportedImageFile(Filename))
+            {
+                continue;
+            }
+
+            TSharedRef<TArray64<uint8>> Encoded = MakeShared<TArray64<uint8>>();
+            if (!FFileHelper::LoadFileToArray(*Encoded, *Filename))
+            {
+                continue;
+            }
+            EncodedSources.Add(Encoded);
+
+            FBenchmarkCase& CorpusCase = Cases.AddDefaulted_GetRef();
+            CorpusCase.Name = TEXT("corpus");
+            CorpusCase.Format = Extension.ToUpper();
+            CorpusCase.InputBytes = Encoded->Num();
+
+            if (bAnimated)
+            {
+                // the whole animation is decoded, the loader reports the canvas size
+                TArray<uint8> Bytes(Encoded->GetData(), (int32)Encoded->Num());
+                TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> Loader = FGIFLoaderFactory::CreateLoader(Filename, Bytes);
+                if (Loader.IsValid() && Loader->Decode(MoveTemp(Bytes)))
+                {
+                    CorpusCase.SizeX = Loader->GetWidth();
+                    CorpusCase.SizeY = Loader->GetHeight();
+                }
+
+                CorpusCase.Run = [Filename, Encoded](FString& OutError)
+                {
+                    TArray<uint8> GifBytes(Encoded->GetData(), (int32)Encoded->Num());
+                    TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> GifLoader = FGIFLoaderFactory::CreateLoader(Filename, GifBytes);
+                    if (!GifLoader.IsValid() || !GifLoader->Decode(MoveTemp(GifBytes)))
+                    {
+                        OutError = GifLoader.IsValid() ? GifLoader->GetDecodeError() : TEXT("Unsupported animated image");
+                        return false;
+                    }
+                    return true;
+                };
+            }
+            else
+            {
+                FRuntimeImageData ImageData;
+                FString Error;
+                if (FRuntimeImageUtils::ImportBufferAsImage(Encoded->GetData(), Encoded->Num(), ImageData, Error))
+                {
+                    CorpusCase.SizeX = ImageData.SizeX;
+                    CorpusCase.SizeY = ImageData.SizeY;
+                }
+
+                CorpusCase.Run = [Encoded](FString& OutError)
+                {
+                    FRuntimeImageData CorpusImage;
+                    return FRuntimeImageUtils::ImportBufferAsImage(Encoded->GetData(), Encoded->Num(), CorpusImage, OutError);
+                };
+            }
+        }
+    }
+
+    UE_LOG(LogRuntimeImageBenchmark, Display, TEXT("Running %d benchmark cases, %d iterations each"), Cases.Num(), NumIterations);
+
+    TArray<TSharedPtr<FJsonValue>> Results;
+    int32 NumFailed = 0;
+    {
+        // allocations are counted only while cases run
+        FBenchmarkMalloc& BenchmarkMalloc = FBenchmarkMalloc::Get();
+        BenchmarkMalloc.SetEnabled(true);
+
+        for (const FBenchmarkCase& Case : Cases)
+        {
+            bool bSuccess = false;
+            Results.Add(MakeShared<FJsonValueObject>(RunCase(Case, NumIterations, BenchmarkMalloc, bSuccess)));
+            NumFailed += bSuccess ? 0 : 1;
+        }
+
+        BenchmarkMalloc.SetEnabled(false);
+    }
+
+    TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+    {
+        TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("RuntimeImageLoader"));
+
+        Report->SetNumberField(TEXT("schemaVersion"), 1);
+        Report->SetStringField(TEXT("pluginVersion"), Plugin.IsValid() ? Plugin->GetDescriptor().VersionName : FString());
+        Report->SetStringField(TEXT("engineVersion"), FEngineVersion::Current().ToString());
+        Report->SetStringField(TEXT("platform"), FPlatformProperties::IniPlatformName());
+        Report->SetStringField(TEXT("cpu"), FPlatformMisc::GetCPUBrand().TrimStartAndEnd());
+        Report->SetNumberField(TEXT("cores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+        Report->SetStringField(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+        Report->SetArrayField(TEXT("results"), Results);
+    }
+
+    FString ReportText;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportText);
+    if (!FJsonSerializer::Serialize(Report, Writer) || !FFileHelper::SaveStringToFile(ReportText, *OutputFilename))
+    {
+        UE_LOG(LogRuntimeImageBenchmark, Error, TEXT("Failed to write benchmark results to %s"), *OutputFilename);
+        return 1;
+    }
+
+    UE_LOG(LogRuntimeImageBenchmark, Display, TEXT("%d of %d cases succeeded, results written to %s"), Cases.Num() - NumFailed, Cases.Num(), *OutputFilename);
+    return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,27 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RuntimeImageBenchmarkCommandlet.generated.h"
+
+/**
+ * Measures decode and transform throughput with the runtime code paths, works headless (-nullrhi), e.g. on Linux build agents.
+ * Source images for every format are generated in memory over a size sweep, GIF and WebP (no encoders available) come from -Corpus.
+ * Results are written as JSON so they can be compared across versions. Decode cases also verify the decoded size,
+ * -Sizes=24576 -Formats=PNG8 checks the 64-bit paths with an image above 2 GB. The resampler-sweep case checks the streaming downscale,
+ * tga-headers checks that TGA headers claiming more pixels than the file holds are rejected.
+ *
+ * -run=RuntimeImageBenchmark [-Output=<file.json>] [-Sizes=256,1024,4096] [-Iterations=<n>] [-Formats=PNG8,JPEG,...] [-Corpus=<dir>]
+ */
+UCLASS()
+class URuntimeImageBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    URuntimeImageBenchmarkCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,228 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageConvertCommandlet.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "RuntimeImageReader.h"
+#include "RuntimeImageUtils.h"
+#include "Helpers/ImageBundle.h"
+#include "Helpers/PNGScanlineDecoder.h"
+#include "Helpers/TextureCacheFile.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageConvert, Log, All);
+
+namespace
+{
+    struct FConvertSettings
+    {
+        FTransformImageParams TransformParams;
+        bool bGenerateMips = false;
+        bool bCompress = false;
+    };
+
+    bool ConvertImage(const FString& SourceFilename, const FConvertSettings& Settings, int64& OutBytesRead, FTextureCacheData& OutCacheData, FString& OutError)
+    {
+        TArray64<uint8> FileData;
+        if (!FFileHelper::LoadFileToArray(FileData, *SourceFilename))
+        {
+            OutError = TEXT("Failed to read file");
+            return false;
+        }
+        OutBytesRead = FileData.Num();
+
+        FTransformImageParams TransformParams = Settings.TransformParams;
+
+        // same streaming PNG downscale as runtime loads, the full resolution image never exists
+        FRuntimeImageData ImageData;
+        bool bDecodedDownscaled = false;
+        if (TransformParams.IsPercentSizeValid())
+        {
+            bDecodedDownscaled = FPNGScanlineDecoder::DecodeDownscaled(FileData.GetData(), FileData.Num(), TransformParams.PercentSizeX, TransformParams.PercentSizeY, ImageData, OutError);
+            if (!OutError.IsEmpty())
+            {
+                return false;
+            }
+
+            if (bDecodedDownscaled)
+            {
+                TransformParams.PercentSizeX = 100;
+                TransformParams.PercentSizeY = 100;
+            }
+        }
+
+        if (!bDecodedDownscaled && !FRuntimeImageUtils::ImportBufferAsImage(FileData.GetData(), FileData.Num(), ImageData, OutError))
+        {
+            return false;
+        }
+        FileData.Empty();
+
+        // same stages as URuntimeImageReader::ProcessRequest for 2D textures
+        if (ImageData.TextureSourceFormat == TSF_BGRE8)
+        {
+            OutError = TEXT("HDR images are loaded as cubemaps and can't be cached");
+            return false;
+        }
+
+        ImageData.PixelFormat = URuntimeImageReader::DeterminePixelFormat(ImageData.Format, TransformParams);
+        if (ImageData.PixelFormat == PF_Unknown)
+        {
+            OutError = FString::Printf(TEXT("Raw image format is not supported: %d"), (int32)ImageData.Format);
+            return false;
+        }
+
+        URuntimeImageReader::ApplySizeFormatTransformations(ImageData, TransformParams);
+        if (TransformParams.bAutoPixelFormat)
+        {
+            URuntimeImageReader::SelectCheapestPixelFormat(ImageData, TransformParams);
+        }
+
+        return FTextureCacheFile::Build(MoveTemp(ImageData), Settings.bGenerateMips, Settings.bCompress, OutCacheData, OutError);
+    }
+}
+
+URuntimeImageConvertCommandlet::URuntimeImageConvertCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 URuntimeImageConvertCommandlet::Main(const FString& Params)
+{
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamValues;
+    ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+    const FString InputDirectory = FPaths::ConvertRelativePathToFull(ParamValues.FindRef(TEXT("Input")));
+    const FString OutputDirectory = FPaths::ConvertRelativePathToFull(ParamValues.FindRef(TEXT("Output")));
+    const FString BundleFilename = ParamValues.Contains(TEXT("Bundle")) ? FPaths::ConvertRelativePathToFull(ParamValues[TEXT("Bundle")]) : FString();
+    if (!ParamValues.Contains(TEXT("Input")) || (!ParamValues.Contains(TEXT("Output")) && BundleFilename.IsEmpty()) || !IFileManager::Get().DirectoryExists(*InputDirectory))
+    {
+        UE_LOG(LogRuntimeImageConvert, Error, TEXT("Usage: -run=RuntimeImageConvert -Input=<dir> (-Output=<dir> | -Bundle=<file>) [-Recursive] [-PercentSize=<1..100>] [-KeepSourceFormat] [-AutoPixelFormat] [-Mips] [-Compress]"));
+        return 1;
+    }
+
+    // one bundle instead of a cache file per image
+    FImageBundleWriter BundleWriter;
+    FCriticalSection BundleWriterLock;
+    if (!BundleFilename.IsEmpty())
+    {
+        FString Error;
+        if (!BundleWriter.Open(BundleFilename, Error))
+        {
+            UE_LOG(LogRuntimeImageConvert, Error, TEXT("%s"), *Error);
+            return 1;
+        }
+    }
+
+    FConvertSettings Settings;
+    {
+        const int32 PercentSize = ParamValues.Contains(TEXT("PercentSize")) ? FCString::Atoi(*ParamValues[TEXT("PercentSize")]) : 100;
+        Settings.TransformParams.PercentSizeX = PercentSize;
+        Settings.TransformParams.PercentSizeY = PercentSize;
+        // 8 bit sRGB BGRA like runtime loads unless asked to keep the decoded format,
+        // picking the cheapest format starts from the decoded one so it implies keeping it
+        Settings.TransformParams.bAutoPixelFormat = Switches.Contains(TEXT("AutoPixelFormat"));
+        Settings.TransformParams.bForUI = !Switches.Contains(TEXT("KeepSourceFormat")) && !Settings.TransformParams.bAutoPixelFormat;
+        Settings.bGenerateMips = Switches.Contains(TEXT("Mips"));
+        Settings.bCompress = Switches.Contains(TEXT("Compress"));
+    }
+
+    TArray<FString> SourceFilenames;
+    auto AddImageFile = [&SourceFilenames](const TCHAR* FilenameOrDirectory, bool bIsDirectory)
+    {
+        if (!bIsDirectory && FRuntimeImageUtils::IsSupportedImageFile(FilenameOrDirectory))
+        {
+            SourceFilenames.Add(FilenameOrDirectory);
+        }
+        return true;
+    };
+
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    if (Switches.Contains(TEXT("Recursive")))
+    {
+        PlatformFile.IterateDirectoryRecursively(*InputDirectory, AddImageFile);
+    }
+    else
+    {
+        PlatformFile.IterateDirectory(*InputDirectory, AddImageFile);
+    }
+
+    UE_LOG(LogRuntimeImageConvert, Display, TEXT("Converting %d images from %s to %s"), SourceFilenames.Num(), *InputDirectory, BundleWriter.IsOpen() ? *BundleFilename : *OutputDirectory);
+
+    FThreadSafeCounter NumFailed;
+    FThreadSafeCounter64 BytesRead;
+    FThreadSafeCounter64 BytesWritten;
+
+    const double StartTime = FPlatformTime::Seconds();
+
+    ParallelFor(SourceFilenames.Num(), [&](int32 FileIndex)
+    {
+        const FString& SourceFilename = SourceFilenames[FileIndex];
+
+        FString RelativeFilename = SourceFilename;
+        FPaths::MakePathRelativeTo(RelativeFilename, *(InputDirectory / TEXT("")));
+
+        int64 FileBytesRead = 0;
+        int64 FileBytesWritten = 0;
+        FString Error;
+
+        FTextureCacheData CacheData;
+        bool bConverted = ConvertImage(SourceFilename, Settings, FileBytesRead, CacheData, Error);
+        if (bConverted && BundleWriter.IsOpen())
+        {
+            FScopeLock Lock(&BundleWriterLock);
+            bConverted = BundleWriter.AddImage(FPaths::ChangeExtension(RelativeFilename, TEXT("")), CacheData, Error);
+        }
+        else if (bConverted)
+        {
+            bConverted = FTextureCacheFile::Save(FPaths::ChangeExtension(OutputDirectory / RelativeFilename, FTextureCacheFile::Extension), CacheData, Error);
+        }
+
+        if (bConverted)
+        {
+            for (const TArray64<uint8>& Mip : CacheData.Mips)
+            {
+                FileBytesWritten += Mip.Num();
+            }
+        }
+        else
+        {
+            UE_LOG(LogRuntimeImageConvert, Error, TEXT("Failed to convert %s: %s"), *SourceFilename, *Error);
+            NumFailed.Increment();
+        }
+
+        BytesRead.Add(FileBytesRead);
+        BytesWritten.Add(FileBytesWritten);
+    });
+
+    if (BundleWriter.IsOpen())
+    {
+        FString Error;
+        if (!BundleWriter.Close(Error))
+        {
+            UE_LOG(LogRuntimeImageConvert, Error, TEXT("%s"), *Error);
+            return 1;
+        }
+    }
+
+    const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, 0.001);
+    const int32 NumConverted = SourceFilenames.Num() - NumFailed.GetValue();
+    const double MegabytesRead = BytesRead.GetValue() / (1024.0 * 1024.0);
+    const double MegabytesWritten = BytesWritten.GetValue() / (1024.0 * 1024.0);
+
+    UE_LOG(
+        LogRuntimeImageConvert, Display, TEXT("Converted %d of %d images in %.2f s: %.1f images/s, %.1f MB/s read (%.1f MB), %.1f MB/s written (%.1f MB)"),
+        NumConverted, SourceFilenames.Num(), Seconds, NumConverted / Seconds, MegabytesRead / Seconds, MegabytesRead, MegabytesWritten / Seconds, MegabytesWritten
+    );
+
+    return NumFailed.GetValue() > 0 ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RuntimeImageConvertCommandlet.generated.h"
+
+/**
+ * Converts a directory of images to texture cache files (.rtex) with the runtime decode and transform code, works headless (-nullrhi).
+ * Cache files are loaded with URuntimeImageBundle::LoadTextureCacheFile, -Bundle writes a single URuntimeImageBundle instead.
+ * -AutoPixelFormat implies -KeepSourceFormat.
+ *
+ * -run=RuntimeImageConvert -Input=<dir> -Output=<dir> [-Recursive] [-PercentSize=<1..100>] [-KeepSourceFormat] [-AutoPixelFormat] [-Mips] [-Compress]
+ */
+UCLASS()
+class URuntimeImageConvertCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    URuntimeImageConvertCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,444 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "APNGLoader.h"
+#include "RuntimeImageLoaderLog.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "IImageWrapperModule.h"
+#include "IImageWrapper.h"
+#include "Misc/Crc.h"
+#include "RHI.h"
+
+DEFINE_LOG_CATEGORY(LibApngHelper);
+
+namespace APNGLoader
+{
+	static const uint8 PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	/** Chunk header (length + type) and CRC */
+	static constexpr uint32 ChunkOverhead = 12;
+
+	/** APNG dispose and blend operations, see fcTL */
+	static constexpr uint8 DisposeOpNone = 0;
+	static constexpr uint8 DisposeOpBackground = 1;
+	static constexpr uint8 DisposeOpPrevious = 2;
+	static constexpr uint8 BlendOpSource = 0;
+	static constexpr uint8 BlendOpOver = 1;
+
+	static uint32 ReadUInt32(const uint8* Data)
+	{
+		return ((uint32)Data[0] << 24) | ((uint32)Data[1] << 16) | ((uint32)Data[2] << 8) | (uint32)Data[3];
+	}
+
+	static uint16 ReadUInt16(const uint8* Data)
+	{
+		return (uint16)(((uint32)Data[0] << 8) | (uint32)Data[1]);
+	}
+
+	static void WriteUInt32(TArray<uint8>& Out, uint32 Value)
+	{
+		Out.Add((uint8)(Value >> 24));
+		Out.Add((uint8)(Value >> 16));
+		Out.Add((uint8)(Value >> 8));
+		Out.Add((uint8)Value);
+	}
+
+	static bool IsChunk(const uint8* ChunkType, const char* Name)
+	{
+		return FMemory::Memcmp(ChunkType, Name, 4) == 0;
+	}
+
+	/** Appends a chunk with a valid CRC, the PNG decoder rejects critical chunks that fail the check */
+	static void WriteChunk(TArray<uint8>& Out, const char* ChunkType, const uint8* ChunkData, uint32 ChunkLength)
+	{
+		WriteUInt32(Out, ChunkLength);
+
+		const int32 TypeOffset = Out.Num();
+		Out.Append((const uint8*)ChunkType, 4);
+		Out.Append(ChunkData, ChunkLength);
+
+		// FCrc::MemCrc32 is the zlib CRC-32 that PNG uses
+		WriteUInt32(Out, FCrc::MemCrc32(Out.GetData() + TypeOffset, ChunkLength + 4));
+	}
+
+	/**
+	 * Iterates chunks of a PNG stream. Returns false once IEND is reached or the stream is truncated.
+	 */
+	static bool NextChunk(const TArray<uint8>& PngBytes, int64& InOutOffset, const uint8*& OutType, const uint8*& OutData, uint32& OutLength)
+	{
+		if (InOutOffset + ChunkOverhead > PngBytes.Num())
+		{
+			return false;
+		}
+
+		const uint8* Chunk = PngBytes.GetData() + InOutOffset;
+		OutLength = ReadUInt32(Chunk);
+		if (InOutOffset + ChunkOverhead + OutLength > PngBytes.Num())
+		{
+			return false;
+		}
+
+		OutType = Chunk + 4;
+		OutData = Chunk + 8;
+		InOutOffset += ChunkOverhead + OutLength;
+
+		return !IsChunk(OutType, "IEND");
+	}
+}
+
+
+const int32 FAPNGLoader::GetWidth() const
+{
+	return Width;
+}
+
+const int32 FAPNGLoader::GetHeight() const
+{
+	return Height;
+}
+
+const int32 FAPNGLoader::GetTotalFrames() const
+{
+	return TotalFrameCount;
+}
+
+FString FAPNGLoader::GetDecodeError() const
+{
+	return FString::Printf(TEXT("APNGLoader: %s"), *LastError);
+}
+
+void FAPNGLoader::ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor)
+{
+	if (FrameIndex > GetTotalFrames() - 1)
+	{
+		FrameIndex = 0;
+	}
+
+	if (FrameStore.IsValid() && FrameIndex >= 0 && FrameIndex < FrameStore->GetTotalFrames())
+	{
+		FrameStore->ReadFrame(FrameIndex, Visitor);
+		return;
+	}
+
+	Visitor(&FColor::Black);
+}
+
+const float FAPNGLoader::GetNextFrameDelay(int32 FrameIndex)
+{
+	return Timestamps.IsValidIndex(FrameIndex) ? Timestamps[FrameIndex] : 0.f;
+}
+
+FIntRect FAPNGLoader::GetFrameDirtyRect(int32 FrameIndex) const
+{
+	return DirtyRects.IsValidIndex(FrameIndex) ? DirtyRects[FrameIndex] : FIntRect(0, 0, Width, Height);
+}
+
+bool FAPNGLoader::HasAnimationControlChunk(const TArray<uint8>& PngBytes)
+{
+	if (PngBytes.Num() < sizeof(APNGLoader::PngSignature) || FMemory::Memcmp(PngBytes.GetData(), APNGLoader::PngSignature, sizeof(APNGLoader::PngSignature)) != 0)
+	{
+		return false;
+	}
+
+	int64 Offset = sizeof(APNGLoader::PngSignature);
+	const uint8* ChunkType;
+	const uint8* ChunkData;
+	uint32 ChunkLength;
+
+	// acTL is only valid before the first IDAT
+	while (APNGLoader::NextChunk(PngBytes, Offset, ChunkType, ChunkData, ChunkLength))
+	{
+		if (APNGLoader::IsChunk(ChunkType, "acTL"))
+		{
+			return true;
+		}
+		if (APNGLoader::IsChunk(ChunkType, "IDAT"))
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+bool FAPNGLoader::DecodeGIF(TArray<uint8>&& GifBytes)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+
+	const TArray<uint8> Data(MoveTemp(GifBytes));
+
+	if (!HasAnimationControlChunk(Data))
+	{
+		SetError(TEXT("Data is not an animated PNG"));
+		return false;
+	}
+
+	int64 Offset = sizeof(APNGLoader::PngSignature);
+	const uint8* ChunkType;
+	const uint8* ChunkData;
+	uint32 ChunkLength;
+
+	bool bSeenImageData = false;
+	bool bHasPendingFrame = false;
+	FFrameControl PendingControl;
+	TArray<uint8> PendingFrameData;
+
+	while (!IsCancelled() && APNGLoader::NextChunk(Data, Offset, ChunkType, ChunkData, ChunkLength))
+	{
+		if (APNGLoader::IsChunk(ChunkType, "IHDR"))
+		{
+			if (ChunkLength != 13)
+			{
+				SetError(TEXT("Invalid IHDR chunk"));
+				return false;
+			}
+
+			HeaderChunkData = TArray<uint8>(ChunkData, ChunkLength);
+			Width = (int32)APNGLoader::ReadUInt32(ChunkData);
+			Height = (int32)APNGLoader::ReadUInt32(ChunkData + 4);
+
+			const int32 MaxDimension = (int32)GetMax2DTextureDimension();
+			if (Width <= 0 || Height <= 0 || Width > MaxDimension || Height > MaxDimension)
+			{
+				SetError(FString::Printf(TEXT("Unsupported canvas size %d x %d"), Width, Height));
+				return false;
+			}
+		}
+		else if (APNGLoader::IsChunk(ChunkType, "acTL"))
+		{
+			if (ChunkLength != 8 || HeaderChunkData.Num() == 0)
+			{
+				SetError(TEXT("Invalid acTL chunk"));
+				return false;
+			}
+
+			TotalFrameCount = (int32)APNGLoader::ReadUInt32(ChunkData);
+			if (TotalFrameCount <= 0)
+			{
+				SetError(TEXT("Animation has no frames"));
+				return false;
+			}
+
+			FrameStore = FGIFFrameStoreFactory::CreateFrameStore(bCompressFrames, Width, Height, TotalFrameCount);
+			if (!FrameStore.IsValid())
+			{
+				SetError(TEXT("Not enough memory to store decoded frames"));
+				return false;
+			}
+
+			// frames may be read while decoding, so per-frame data is never reallocated
+			Timestamps.SetNumZeroed(TotalFrameCount);
+			DirtyRects.SetNumZeroed(TotalFrameCount);
+
+			Canvas.SetNumZeroed(Width * Height);
+		}
+		else if (APNGLoader::IsChunk(ChunkType, "fcTL"))
+		{
+			if (bHasPendingFrame && !DecodeFrame(PendingControl, PendingFrameData))
+			{
+				break;
+			}
+
+			bHasPendingFrame = ParseFrameControl(ChunkData, ChunkLength, PendingControl);
+			if (!bHasPendingFrame)
+			{
+				break;
+			}
+			PendingFrameData.Reset();
+		}
+		else if (APNGLoader::IsChunk(ChunkType, "IDAT"))
+		{
+			bSeenImageData = true;
+
+			// the default image is only part of the animation if its fcTL comes first
+			if (bHasPendingFrame)
+			{
+				PendingFrameData.Append(ChunkData, ChunkLength);
+			}
+		}
+		else if (APNGLoader::IsChunk(ChunkType, "fdAT"))
+		{
+			// fdAT is IDAT prefixed with a sequence number
+			if (bHasPendingFrame && ChunkLength > 4)
+			{
+				PendingFrameData.Append(ChunkData + 4, ChunkLength - 4);
+			}
+		}
+		else if (!bSeenImageData)
+		{
+			// PLTE, tRNS, gAMA etc. apply to every frame
+			APNGLoader::WriteChunk(SharedChunks, (const char*)ChunkType, ChunkData, ChunkLength);
+		}
+
+		if (NumFramesComposited >= TotalFrameCount && TotalFrameCount > 0)
+		{
+			break;
+		}
+	}
+
+	if (bHasPendingFrame && NumFramesComposited < TotalFrameCount && !IsCancelled())
+	{
+		DecodeFrame(PendingControl, PendingFrameData);
+	}
+
+	// frames are decoded once, the scratch state is only needed while compositing
+	Canvas.Empty();
+	SavedRegion.Empty();
+
+	if (NumFramesComposited == 0)
+	{
+		if (LastError.IsEmpty())
+		{
+			SetError(TEXT("No frames decoded. Please check input data is valid!"));
+		}
+		return false;
+	}
+
+	if (NumFramesComposited < TotalFrameCount)
+	{
+		// play the frames that decoded, see UAnimatedTexture2D::RenderFrameToTexture
+		UE_LOG(LibApngHelper, Warning, TEXT("Decoded %d of %d APNG frames"), NumFramesComposited, TotalFrameCount);
+	}
+
+	return true;
+}
+
+bool FAPNGLoader::ParseFrameControl(const uint8* ChunkData, uint32 ChunkLength, FFrameControl& OutControl)
+{
+	if (ChunkLength != 26 || !FrameStore.IsValid())
+	{
+		SetError(TEXT("Invalid fcTL chunk"));
+		return false;
+	}
+
+	OutControl.Width = (int32)APNGLoader::ReadUInt32(ChunkData + 4);
+	OutControl.Height = (int32)APNGLoader::ReadUInt32(ChunkData + 8);
+	OutControl.OffsetX = (int32)APNGLoader::ReadUInt32(ChunkData + 12);
+	OutControl.OffsetY = (int32)APNGLoader::ReadUInt32(ChunkData + 16);
+	OutControl.DelayNum = APNGLoader::ReadUInt16(ChunkData + 20);
+	OutControl.DelayDen = APNGLoader::ReadUInt16(ChunkData + 22);
+	OutControl.DisposeOp = ChunkData[24];
+	OutControl.BlendOp = ChunkData[25];
+
+	if (OutControl.Width <= 0 || OutControl.Height <= 0 || OutControl.OffsetX < 0 || OutControl.OffsetY < 0
+		|| OutControl.Width > Width - OutControl.OffsetX || OutControl.Height > Height - OutControl.OffsetY)
+	{
+		SetError(FString::Printf(TEXT("Frame %d region is outside of the canvas"), NumFramesComposited));
+		return false;
+	}
+
+	return true;
+}
+
+bool FAPNGLoader::DecodeFrame(const FFrameControl& Control, const TArray<uint8>& FrameData)
+{
+	const int32 FrameIndex = NumFramesComposited;
+
+	// Wrap the frame data into a standalone PNG with the frame size in its header
+	TArray<uint8> FramePng;
+	FramePng.Reserve(sizeof(APNGLoader::PngSignature) + HeaderChunkData.Num() + SharedChunks.Num() + FrameData.Num() + 3 * APNGLoader::ChunkOverhead);
+	FramePng.Append(APNGLoader::PngSignature, sizeof(APNGLoader::PngSignature));
+
+	TArray<uint8> FrameHeader;
+	APNGLoader::WriteUInt32(FrameHeader, Control.Width);
+	APNGLoader::WriteUInt32(FrameHeader, Control.Height);
+	FrameHeader.Append(HeaderChunkData.GetData() + 8, HeaderChunkData.Num() - 8);
+
+	APNGLoader::WriteChunk(FramePng, "IHDR", FrameHeader.GetData(), FrameHeader.Num());
+	FramePng.Append(SharedChunks);
+	APNGLoader::WriteChunk(FramePng, "IDAT", FrameData.GetData(), FrameData.Num());
+	APNGLoader::WriteChunk(FramePng, "IEND", nullptr, 0);
+
+	IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+	TSharedPtr<IImageWrapper> PngImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+
+	TArray<uint8> RawFrame;
+	if (!PngImageWrapper.IsValid() || !PngImageWrapper->SetCompressed(FramePng.GetData(), FramePng.Num())
+		|| !PngImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawFrame)
+		|| RawFrame.Num() != (int64)Control.Width * Control.Height * sizeof(FColor))
+	{
+		SetError(FString::Printf(TEXT("Failed to decode frame %d"), FrameIndex));
+		return false;
+	}
+
+	const FIntRect FrameRect(Control.OffsetX, Control.OffsetY, Control.OffsetX + Control.Width, Control.OffsetY + Control.Height);
+
+	// the first frame has nothing to restore to
+	uint8 DisposeOp = Control.DisposeOp;
+	if (FrameIndex == 0 && DisposeOp == APNGLoader::DisposeOpPrevious)
+	{
+		DisposeOp = APNGLoader::DisposeOpBackground;
+	}
+
+	if (DisposeOp == APNGLoader::DisposeOpPrevious)
+	{
+		SavedRegion.SetNumUninitialized(Control.Width * Control.Height);
+		for (int32 Y = 0; Y < Control.Height; ++Y)
+		{
+			FMemory::Memcpy(&SavedRegion[Y * Control.Width], &Canvas[(FrameRect.Min.Y + Y) * Width + FrameRect.Min.X], Control.Width * sizeof(FColor));
+		}
+	}
+
+	const FColor* FramePixels = (const FColor*)RawFrame.GetData();
+	for (int32 Y = 0; Y < Control.Height; ++Y)
+	{
+		const FColor* Src = FramePixels + Y * Control.Width;
+		FColor* Dst = &Canvas[(FrameRect.Min.Y + Y) * Width + FrameRect.Min.X];
+
+		if (Control.BlendOp == APNGLoader::BlendOpSource)
+		{
+			FMemory::Memcpy(Dst, Src, Control.Width * sizeof(FColor));
+		}
+		else
+		{
+			GIFFrameStore::BlendRowOver(Src, Dst, Control.Width);
+		}
+	}
+
+	FrameStore->AddFrame(FrameIndex, Canvas.GetData());
+
+	// a zero denominator means 1/100 s units
+	Timestamps[FrameIndex] = (float)Control.DelayNum / (Control.DelayDen == 0 ? 100.f : (float)Control.DelayDen);
+
+	// the frame region plus whatever the previous frame disposed of
+	FIntRect DirtyRect = FrameRect;
+	if (FrameIndex == 0)
+	{
+		DirtyRect = FIntRect(0, 0, Width, Height);
+	}
+	else if (!DisposedRect.IsEmpty())
+	{
+		DirtyRect.Union(DisposedRect);
+	}
+	DirtyRects[FrameIndex] = DirtyRect;
+
+	NumFramesComposited = FrameIndex + 1;
+	MarkFrameDecoded(FrameIndex);
+
+	// Dispose the frame region before the next frame is composited
+	DisposedRect = FIntRect();
+	if (DisposeOp == APNGLoader::DisposeOpBackground)
+	{
+		for (int32 Y = FrameRect.Min.Y; Y < FrameRect.Max.Y; ++Y)
+		{
+			FMemory::Memzero(&Canvas[Y * Width + FrameRect.Min.X], Control.Width * sizeof(FColor));
+		}
+		DisposedRect = FrameRect;
+	}
+	else if (DisposeOp == APNGLoader::DisposeOpPrevious)
+	{
+		for (int32 Y = 0; Y < Control.Height; ++Y)
+		{
+			FMemory::Memcpy(&Canvas[(FrameRect.Min.Y + Y) * Width + FrameRect.Min.X], &SavedRegion[Y * Control.Width], Control.Width * sizeof(FColor));
+		}
+		DisposedRect = FrameRect;
+	}
+
+	return true;
+}
+
+void FAPNGLoader::SetError(const FString& Error)
+{
+	LastError = Error;
+
+	UE_LOG(LibApngHelper, Warning, TEXT("Decode error: %s"), *GetDecodeError());
+}
@@ -0,0 +1,73 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GIFLoader.h"
+#include "GIFFrameStore.h"
+
+/**
+ * Animated PNG loader. Frames are decoded one at a time as their fcTL/fdAT chunks are parsed:
+ * each frame's image data is wrapped into a standalone PNG, decoded with ImageWrapper
+ * and composited onto the canvas following the fcTL blend and dispose operations.
+ */
+class FAPNGLoader : public IGIFLoader
+{
+public:
+	FAPNGLoader() {};
+	virtual ~FAPNGLoader() {}
+
+public: /** Gif Data Method */
+	const int32 GetWidth() const override;
+	const int32 GetHeight() const override;
+	const int32 GetTotalFrames() const override;
+	FString GetDecodeError() const override;
+
+public: /** Get Next Frame Texture Data*/
+	void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) override;
+	const float GetNextFrameDelay(int32 FrameIndex) override;
+	FIntRect GetFrameDirtyRect(int32 FrameIndex) const override;
+	bool DecodeGIF(TArray<uint8>&& GifBytes) override;
+
+	/** True if the data is a PNG with an acTL chunk before the image data */
+	static bool HasAnimationControlChunk(const TArray<uint8>& PngBytes);
+
+private:
+	/** fcTL chunk contents */
+	struct FFrameControl
+	{
+		int32 Width = 0;
+		int32 Height = 0;
+		int32 OffsetX = 0;
+		int32 OffsetY = 0;
+		uint16 DelayNum = 0;
+		uint16 DelayDen = 0;
+		uint8 DisposeOp = 0;
+		uint8 BlendOp = 0;
+	};
+
+	bool ParseFrameControl(const uint8* ChunkData, uint32 ChunkLength, FFrameControl& OutControl);
+	bool DecodeFrame(const FFrameControl& Control, const TArray<uint8>& FrameData);
+	void SetError(const FString& Error);
+
+private:
+	TUniquePtr<IGIFFrameStore> FrameStore;
+	TArray<float> Timestamps;
+	TArray<FIntRect> DirtyRects;
+
+	/** IHDR data and the ancillary chunks (PLTE, tRNS, gAMA...) shared by every frame */
+	TArray<uint8> HeaderChunkData;
+	TArray<uint8> SharedChunks;
+
+	/** Composited animation state */
+	TArray<FColor> Canvas;
+	TArray<FColor> SavedRegion;
+	FIntRect DisposedRect;
+	int32 NumFramesComposited = 0;
+
+	int32 Width = -1;
+	int32 Height = -1;
+	int32 TotalFrameCount = -1;
+
+	FString LastError;
+};
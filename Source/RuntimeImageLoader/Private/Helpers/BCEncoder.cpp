@@ -0,0 +1,204 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "BCEncoder.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+    constexpr int32 BlockSize = 4;
+    constexpr int32 NumBlockPixels = BlockSize * BlockSize;
+
+    /** Block pixels in BGRA order */
+    using FBlock = uint8[NumBlockPixels][4];
+
+    void GatherBlock(const uint8* Pixels, int32 SizeX, int32 SizeY, int32 BlockX, int32 BlockY, FBlock& OutBlock)
+    {
+        for (int32 Y = 0; Y < BlockSize; ++Y)
+        {
+            const int32 SourceY = FMath::Min(BlockY * BlockSize + Y, SizeY - 1);
+            for (int32 X = 0; X < BlockSize; ++X)
+            {
+                const int32 SourceX = FMath::Min(BlockX * BlockSize + X, SizeX - 1);
+                FMemory::Memcpy(OutBlock[Y * BlockSize + X], Pixels + ((int64)SourceY * SizeX + SourceX) * 4, 4);
+            }
+        }
+    }
+
+    uint16 To565(int32 B, int32 G, int32 R)
+    {
+        return (uint16)(((R >> 3) << 11) | ((G >> 2) << 5) | (B >> 3));
+    }
+
+    void From565(uint16 Color, int32 OutBGR[3])
+    {
+        const int32 R = (Color >> 11) & 31;
+        const int32 G = (Color >> 5) & 63;
+        const int32 B = Color & 31;
+
+        OutBGR[0] = (B << 3) | (B >> 2);
+        OutBGR[1] = (G << 2) | (G >> 4);
+        OutBGR[2] = (R << 3) | (R >> 2);
+    }
+
+    void WriteLE16(uint8* Dest, uint16 Value)
+    {
+        Dest[0] = (uint8)Value;
+        Dest[1] = (uint8)(Value >> 8);
+    }
+
+    void EncodeColorBlock(const FBlock& Block, uint8* OutBlock)
+    {
+        int32 Min[3] = { 255, 255, 255 };
+        int32 Max[3] = { 0, 0, 0 };
+        for (int32 Pixel = 0; Pixel < NumBlockPixels; ++Pixel)
+        {
+            for (int32 Channel = 0; Channel < 3; ++Channel)
+            {
+                Min[Channel] = FMath::Min<int32>(Min[Channel], Block[Pixel][Channel]);
+                Max[Channel] = FMath::Max<int32>(Max[Channel], Block[Pixel][Channel]);
+            }
+        }
+
+        // pull the endpoints in by 1/16 of the range, the interpolated colors then cover the block better
+        for (int32 Channel = 0; Channel < 3; ++Channel)
+        {
+            const int32 Inset = (Max[Channel] - Min[Channel]) >> 4;
+            Min[Channel] += Inset;
+            Max[Channel] -= Inset;
+        }
+
+        uint16 Color0 = To565(Max[0], Max[1], Max[2]);
+        uint16 Color1 = To565(Min[0], Min[1], Min[2]);
+
+        uint32 Indices = 0;
+        if (Color0 != Color1)
+        {
+            // Color0 > Color1 selects the four color mode
+            if (Color0 < Color1)
+            {
+                Swap(Color0, Color1);
+            }
+
+            int32 Palette[4][3];
+            From565(Color0, Palette[0]);
+            From565(Color1, Palette[1]);
+            for (int32 Channel = 0; Channel < 3; ++Channel)
+            {
+                Palette[2][Channel] = (2 * Palette[0][Channel] + Palette[1][Channel]) / 3;
+                Palette[3][Channel] = (Palette[0][Channel] + 2 * Palette[1][Channel]) / 3;
+            }
+
+            for (int32 Pixel = 0; Pixel < NumBlockPixels; ++Pixel)
+            {
+                uint32 BestIndex = 0;
+                int32 BestDistance = MAX_int32;
+                for (uint32 Index = 0; Index < 4; ++Index)
+                {
+                    int32 Distance = 0;
+                    for (int32 Channel = 0; Channel < 3; ++Channel)
+                    {
+                        const int32 Delta = Block[Pixel][Channel] - Palette[Index][Channel];
+                        Distance += Delta * Delta;
+                    }
+
+                    if (Distance < BestDistance)
+                    {
+                        BestDistance = Distance;
+                        BestIndex = Index;
+                    }
+                }
+
+                Indices |= BestIndex << (Pixel * 2);
+            }
+        }
+
+        WriteLE16(OutBlock, Color0);
+        WriteLE16(OutBlock + 2, Color1);
+        WriteLE16(OutBlock + 4, (uint16)Indices);
+        WriteLE16(OutBlock + 6, (uint16)(Indices >> 16));
+    }
+
+    void EncodeAlphaBlock(const FBlock& Block, uint8* OutBlock)
+    {
+        int32 Min = 255;
+        int32 Max = 0;
+        for (int32 Pixel = 0; Pixel < NumBlockPixels; ++Pixel)
+        {
+            Min = FMath::Min<int32>(Min, Block[Pixel][3]);
+            Max = FMath::Max<int32>(Max, Block[Pixel][3]);
+        }
+
+        uint64 Indices = 0;
+        if (Max != Min)
+        {
+            // Alpha0 > Alpha1 selects eight interpolated values, index 0 and 1 are the endpoints
+            int32 Palette[8] = { Max, Min };
+            for (int32 Step = 1; Step < 7; ++Step)
+            {
+                Palette[Step + 1] = ((7 - Step) * Max + Step * Min) / 7;
+            }
+
+            for (int32 Pixel = 0; Pixel < NumBlockPixels; ++Pixel)
+            {
+                uint64 BestIndex = 0;
+                int32 BestDistance = MAX_int32;
+                for (int32 Index = 0; Index < 8; ++Index)
+                {
+                    const int32 Distance = FMath::Abs(Block[Pixel][3] - Palette[Index]);
+                    if (Distance < BestDistance)
+                    {
+                        BestDistance = Distance;
+                        BestIndex = Index;
+                    }
+                }
+
+                Indices |= BestIndex << (Pixel * 3);
+            }
+        }
+
+        OutBlock[0] = (uint8)Max;
+        OutBlock[1] = (uint8)Min;
+        for (int32 Byte = 0; Byte < 6; ++Byte)
+        {
+            OutBlock[2 + Byte] = (uint8)(Indices >> (Byte * 8));
+        }
+    }
+}
+
+namespace FBCEncoder
+{
+    int64 GetCompressedSize(int32 SizeX, int32 SizeY, bool bWithAlpha)
+    {
+        const int64 NumBlocks = (int64)FMath::DivideAndRoundUp(SizeX, BlockSize) * FMath::DivideAndRoundUp(SizeY, BlockSize);
+        return NumBlocks * (bWithAlpha ? 16 : 8);
+    }
+
+    void Compress(const uint8* Pixels, int32 SizeX, int32 SizeY, bool bWithAlpha, uint8* OutBlocks)
+    {
+        const int32 NumBlocksX = FMath::DivideAndRoundUp(SizeX, BlockSize);
+        const int32 NumBlocksY = FMath::DivideAndRoundUp(SizeY, BlockSize);
+        const int32 BlockBytes = bWithAlpha ? 16 : 8;
+
+        ParallelFor(NumBlocksY, [&](int32 BlockY)
+        {
+            uint8* Dest = OutBlocks + (int64)BlockY * NumBlocksX * BlockBytes;
+
+            FBlock Block;
+            for (int32 BlockX = 0; BlockX < NumBlocksX; ++BlockX, Dest += BlockBytes)
+            {
+                GatherBlock(Pixels, SizeX, SizeY, BlockX, BlockY, Block);
+
+                // BC3 is an alpha block followed by a BC1 color block
+                if (bWithAlpha)
+                {
+                    EncodeAlphaBlock(Block, Dest);
+                    EncodeColorBlock(Block, Dest + 8);
+                }
+                else
+                {
+                    EncodeColorBlock(Block, Dest);
+                }
+            }
+        });
+    }
+}
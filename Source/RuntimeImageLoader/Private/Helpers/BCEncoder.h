@@ -0,0 +1,17 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace FBCEncoder
+{
+    /** Bytes of BC1 (8 per 4x4 block) or BC3 (16 per block) data for an image of the given size */
+    int64 GetCompressedSize(int32 SizeX, int32 SizeY, bool bWithAlpha);
+
+    /**
+     * Compresses a BGRA8 image to BC1 (opaque) or BC3 (with alpha), blocks on the right and bottom edges repeat the last column/row.
+     * Endpoints are the inset bounding box of each block: fast and predictable, though not as accurate as an offline cluster fit
+     */
+    void Compress(const uint8* Pixels, int32 SizeX, int32 SizeY, bool bWithAlpha, uint8* OutBlocks);
+}
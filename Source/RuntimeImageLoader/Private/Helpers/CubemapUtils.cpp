@@ -3,6 +3,7 @@
 #include "CubemapUtils.h"
 #include "ImageCore.h"
 #include "Runtime/Launch/Resources/Version.h"
+#include "RuntimeImageLoaderMemory.h"
 
 // transform world space vector to a space relative to the face
 static FVector TransformSideToWorldSpace(uint32 CubemapFace, FVector InDirection)
@@ -189,6 +190,8 @@ struct FImageViewLongLat
 
 void GenerateBaseCubeMipFromLongitudeLatitude2D(FImage* OutMip, const FImage& SrcImage, const uint32 MaxCubemapTextureResolution, uint8 SourceEncodingOverride)
 {
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Cubemap);
+
     FImage LongLatImage;
 
 #if ENGINE_MAJOR_VERSION < 5
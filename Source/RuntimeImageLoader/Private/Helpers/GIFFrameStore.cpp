@@ -0,0 +1,383 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "GIFFrameStore.h"
+#include "Async/Async.h"
+#include "Misc/Compression.h"
+#include "Misc/ScopeLock.h"
+#include "RuntimeImageLoaderMemory.h"
+
+namespace GIFFrameStore
+{
+	/** LUT expansion of palette indices to BGRA, unrolled so that independent lookups can be issued together */
+	static void ExpandIndexedPixels(const uint8* Indices, const FColor* Palette, FColor* OutPixels, int64 NumPixels)
+	{
+		int64 PixelIndex = 0;
+
+		for (; PixelIndex + 8 <= NumPixels; PixelIndex += 8)
+		{
+			OutPixels[PixelIndex + 0] = Palette[Indices[PixelIndex + 0]];
+			OutPixels[PixelIndex + 1] = Palette[Indices[PixelIndex + 1]];
+			OutPixels[PixelIndex + 2] = Palette[Indices[PixelIndex + 2]];
+			OutPixels[PixelIndex + 3] = Palette[Indices[PixelIndex + 3]];
+			OutPixels[PixelIndex + 4] = Palette[Indices[PixelIndex + 4]];
+			OutPixels[PixelIndex + 5] = Palette[Indices[PixelIndex + 5]];
+			OutPixels[PixelIndex + 6] = Palette[Indices[PixelIndex + 6]];
+			OutPixels[PixelIndex + 7] = Palette[Indices[PixelIndex + 7]];
+		}
+
+		for (; PixelIndex < NumPixels; ++PixelIndex)
+		{
+			OutPixels[PixelIndex] = Palette[Indices[PixelIndex]];
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void FRawGIFFrameStore::Init(int32 InWidth, int32 InHeight, int32 InTotalFrames)
+{
+	Width = InWidth;
+	Height = InHeight;
+	TotalFrames = InTotalFrames;
+
+	const int64 TotalPixels = TotalFrames * GetFramePixelCount();
+	FrameData.Empty(TotalPixels);
+	FrameData.AddUninitialized(TotalPixels);
+}
+
+bool FRawGIFFrameStore::AddFrame(int32 FrameIndex, const FColor* FramePixels)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+	check(FrameIndex >= 0 && FrameIndex < TotalFrames);
+
+	const int64 FramePixelCount = GetFramePixelCount();
+	FMemory::Memcpy(FrameData.GetData() + FrameIndex * FramePixelCount, FramePixels, FramePixelCount * sizeof(FColor));
+
+	return true;
+}
+
+void FRawGIFFrameStore::ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor)
+{
+	check(FrameIndex >= 0 && FrameIndex < TotalFrames);
+
+	// frames are never written again once added, no scratch state to guard
+	Visitor(FrameData.GetData() + FrameIndex * GetFramePixelCount());
+}
+
+SIZE_T FRawGIFFrameStore::GetAllocatedSize() const
+{
+	return FrameData.GetAllocatedSize();
+}
+
+int64 FRawGIFFrameStore::GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const
+{
+	return (int64)InTotalFrames * InWidth * InHeight * sizeof(FColor);
+}
+
+// ------------------------------------------------------
+
+void FIndexedGIFFrameStore::Init(int32 InWidth, int32 InHeight, int32 InTotalFrames)
+{
+	Width = InWidth;
+	Height = InHeight;
+	TotalFrames = InTotalFrames;
+
+	const int64 TotalPixels = TotalFrames * GetFramePixelCount();
+	FrameIndices.Empty(TotalPixels);
+	FrameIndices.AddZeroed(TotalPixels);
+
+	// frames that fail to decode keep a transparent black palette
+	FramePalettes.Empty(TotalFrames * MaxPaletteSize);
+	FramePalettes.AddZeroed(TotalFrames * MaxPaletteSize);
+
+	ExpandedFrame.Empty(GetFramePixelCount());
+	ExpandedFrame.AddUninitialized(GetFramePixelCount());
+	ExpandedFrameIndex = INDEX_NONE;
+}
+
+bool FIndexedGIFFrameStore::AddFrame(int32 FrameIndex, const FColor* FramePixels)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+	check(FrameIndex >= 0 && FrameIndex < TotalFrames);
+
+	const int64 FramePixelCount = GetFramePixelCount();
+	uint8* Indices = FrameIndices.GetData() + FrameIndex * FramePixelCount;
+	FColor* Palette = FramePalettes.GetData() + FrameIndex * MaxPaletteSize;
+
+	// Open addressing table: colour -> palette slot. Composited frames may exceed 256 colours
+	// (local palettes, transparency over previous frames), in that case the frame is rejected.
+	constexpr uint32 HashSize = 1024;
+	uint32 HashColours[HashSize];
+	int16 HashSlots[HashSize];
+	FMemory::Memset(HashSlots, 0xFF, sizeof(HashSlots));
+
+	int32 NumColours = 0;
+	uint32 LastColour = 0;
+	uint8 LastSlot = 0;
+	bool bHasLastColour = false;
+
+	for (int64 PixelIndex = 0; PixelIndex < FramePixelCount; ++PixelIndex)
+	{
+		const uint32 Colour = FramePixels[PixelIndex].DWColor();
+
+		// GIF frames are mostly runs of the same colour
+		if (bHasLastColour && Colour == LastColour)
+		{
+			Indices[PixelIndex] = LastSlot;
+			continue;
+		}
+
+		uint32 HashIndex = (Colour * 2654435761u) >> 22;
+		while (HashSlots[HashIndex] >= 0 && HashColours[HashIndex] != Colour)
+		{
+			HashIndex = (HashIndex + 1) & (HashSize - 1);
+		}
+
+		if (HashSlots[HashIndex] < 0)
+		{
+			if (NumColours == MaxPaletteSize)
+			{
+				return false;
+			}
+
+			HashColours[HashIndex] = Colour;
+			HashSlots[HashIndex] = NumColours;
+			Palette[NumColours] = FramePixels[PixelIndex];
+			++NumColours;
+		}
+
+		LastColour = Colour;
+		LastSlot = (uint8)HashSlots[HashIndex];
+		bHasLastColour = true;
+
+		Indices[PixelIndex] = LastSlot;
+	}
+
+	return true;
+}
+
+void FIndexedGIFFrameStore::ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor)
+{
+	FScopeLock ExpandLock(&ExpandMutex);
+	Visitor(ExpandFrame(FrameIndex));
+}
+
+const FColor* FIndexedGIFFrameStore::ExpandFrame(int32 FrameIndex)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+	check(FrameIndex >= 0 && FrameIndex < TotalFrames);
+
+	if (ExpandedFrameIndex != FrameIndex)
+	{
+		const int64 FramePixelCount = GetFramePixelCount();
+
+		GIFFrameStore::ExpandIndexedPixels(
+			FrameIndices.GetData() + FrameIndex * FramePixelCount,
+			FramePalettes.GetData() + FrameIndex * MaxPaletteSize,
+			ExpandedFrame.GetData(),
+			FramePixelCount
+		);
+
+		ExpandedFrameIndex = FrameIndex;
+	}
+
+	return ExpandedFrame.GetData();
+}
+
+SIZE_T FIndexedGIFFrameStore::GetAllocatedSize() const
+{
+	return FrameIndices.GetAllocatedSize() + FramePalettes.GetAllocatedSize() + ExpandedFrame.GetAllocatedSize();
+}
+
+int64 FIndexedGIFFrameStore::GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const
+{
+	const int64 FramePixelCount = (int64)InWidth * InHeight;
+	return InTotalFrames * (FramePixelCount + MaxPaletteSize * sizeof(FColor)) + FramePixelCount * sizeof(FColor);
+}
+
+// ------------------------------------------------------
+
+FCompressedGIFFrameStore::~FCompressedGIFFrameStore()
+{
+	WaitForPrefetch();
+}
+
+void FCompressedGIFFrameStore::Init(int32 InWidth, int32 InHeight, int32 InTotalFrames)
+{
+	WaitForPrefetch();
+
+	Width = InWidth;
+	Height = InHeight;
+	TotalFrames = InTotalFrames;
+
+	CompressedFrames.Empty(TotalFrames);
+	CompressedFrames.SetNum(TotalFrames);
+
+	const int64 FrameBytes = GetFrameBytes();
+	if (CanCompressFrame(FrameBytes))
+	{
+		CompressionBuffer.SetNumUninitialized(FCompression::CompressMemoryBound(NAME_LZ4, (int32)FrameBytes));
+	}
+	else
+	{
+		CompressionBuffer.Empty();
+	}
+
+	for (FDecompressedFrame& DecompressedFrame : DecompressedFrames)
+	{
+		DecompressedFrame.Pixels.SetNumUninitialized(GetFramePixelCount());
+		DecompressedFrame.FrameIndex = INDEX_NONE;
+	}
+	LastFrameIndex = INDEX_NONE;
+	NumAddedFrames.Reset();
+}
+
+bool FCompressedGIFFrameStore::AddFrame(int32 FrameIndex, const FColor* FramePixels)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+	check(FrameIndex >= 0 && FrameIndex < TotalFrames);
+
+	const int64 FrameBytes = GetFrameBytes();
+	int32 CompressedSize = CompressionBuffer.Num();
+
+	TArray64<uint8>& CompressedFrame = CompressedFrames[FrameIndex];
+
+	if (CanCompressFrame(FrameBytes) && FCompression::CompressMemory(NAME_LZ4, CompressionBuffer.GetData(), CompressedSize, FramePixels, (int32)FrameBytes) && CompressedSize < FrameBytes)
+	{
+		CompressedFrame.SetNumUninitialized(CompressedSize);
+		FMemory::Memcpy(CompressedFrame.GetData(), CompressionBuffer.GetData(), CompressedSize);
+	}
+	else
+	{
+		// incompressible frame is kept as is, see DecompressFrame
+		CompressedFrame.SetNumUninitialized(FrameBytes);
+		FMemory::Memcpy(CompressedFrame.GetData(), FramePixels, FrameBytes);
+	}
+
+	// frames are added in order and may be read as soon as they are added
+	NumAddedFrames.Set(FrameIndex + 1);
+
+	return true;
+}
+
+void FCompressedGIFFrameStore::ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor)
+{
+	FScopeLock ReadLock(&ReadMutex);
+	Visitor(GetFrame(FrameIndex));
+}
+
+const FColor* FCompressedGIFFrameStore::GetFrame(int32 FrameIndex)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+	check(FrameIndex >= 0 && FrameIndex < TotalFrames);
+
+	WaitForPrefetch();
+
+	int32 Slot = DecompressedFrames[0].FrameIndex == FrameIndex ? 0 : (DecompressedFrames[1].FrameIndex == FrameIndex ? 1 : INDEX_NONE);
+	if (Slot == INDEX_NONE)
+	{
+		// seek or misprediction: decompress in place, the previously returned frame is no longer in use
+		Slot = DecompressedFrames[0].FrameIndex == LastFrameIndex ? 0 : 1;
+		DecompressFrame(FrameIndex, DecompressedFrames[Slot]);
+	}
+
+	// predict playback direction from the last two requests
+	const int32 Step = (LastFrameIndex != INDEX_NONE && FrameIndex == LastFrameIndex - 1) ? -1 : 1;
+	const int32 NextFrameIndex = (FrameIndex + Step + TotalFrames) % TotalFrames;
+	LastFrameIndex = FrameIndex;
+
+	FDecompressedFrame& PrefetchFrame = DecompressedFrames[1 - Slot];
+	if (NextFrameIndex != FrameIndex && NextFrameIndex < NumAddedFrames.GetValue() && PrefetchFrame.FrameIndex != NextFrameIndex)
+	{
+		PrefetchFrame.FrameIndex = INDEX_NONE;
+
+		PrefetchTask = Async(
+			EAsyncExecution::ThreadPool,
+			[this, NextFrameIndex, &PrefetchFrame]()
+			{
+				DecompressFrame(NextFrameIndex, PrefetchFrame);
+			}
+		);
+	}
+
+	return DecompressedFrames[Slot].Pixels.GetData();
+}
+
+SIZE_T FCompressedGIFFrameStore::GetAllocatedSize() const
+{
+	SIZE_T AllocatedSize = CompressedFrames.GetAllocatedSize() + CompressionBuffer.GetAllocatedSize();
+
+	for (const TArray64<uint8>& CompressedFrame : CompressedFrames)
+	{
+		AllocatedSize += CompressedFrame.GetAllocatedSize();
+	}
+
+	for (const FDecompressedFrame& DecompressedFrame : DecompressedFrames)
+	{
+		AllocatedSize += DecompressedFrame.Pixels.GetAllocatedSize();
+	}
+
+	return AllocatedSize;
+}
+
+int64 FCompressedGIFFrameStore::GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const
+{
+	// compressed frames are allocated while decoding, up front only the double buffer and the compression scratch
+	const int64 FrameBytes = (int64)InWidth * InHeight * sizeof(FColor);
+	return 3 * FrameBytes;
+}
+
+void FCompressedGIFFrameStore::DecompressFrame(int32 FrameIndex, FDecompressedFrame& OutFrame) const
+{
+	const int64 FrameBytes = GetFrameBytes();
+	const TArray64<uint8>& CompressedFrame = CompressedFrames[FrameIndex];
+
+	if (CompressedFrame.Num() == FrameBytes)
+	{
+		FMemory::Memcpy(OutFrame.Pixels.GetData(), CompressedFrame.GetData(), FrameBytes);
+	}
+	else if (CompressedFrame.Num() == 0 || !CanCompressFrame(FrameBytes) || !FCompression::UncompressMemory(NAME_LZ4, OutFrame.Pixels.GetData(), (int32)FrameBytes, CompressedFrame.GetData(), (int32)CompressedFrame.Num()))
+	{
+		// frame was never decoded
+		FMemory::Memzero(OutFrame.Pixels.GetData(), FrameBytes);
+	}
+
+	OutFrame.FrameIndex = FrameIndex;
+}
+
+void FCompressedGIFFrameStore::WaitForPrefetch()
+{
+	if (PrefetchTask.IsValid())
+	{
+		PrefetchTask.Wait();
+		PrefetchTask.Reset();
+	}
+}
+
+TUniquePtr<IGIFFrameStore> FGIFFrameStoreFactory::CreateFrameStore(bool bCompressFrames, int32 InWidth, int32 InHeight, int32 InTotalFrames)
+{
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+
+	TUniquePtr<IGIFFrameStore> FrameStore;
+	if (bCompressFrames)
+	{
+		FrameStore = MakeUnique<FCompressedGIFFrameStore>();
+	}
+	else
+	{
+		FrameStore = MakeUnique<FRawGIFFrameStore>();
+	}
+
+	if (!FrameStore->HasEnoughMemory(InWidth, InHeight, InTotalFrames))
+	{
+		// full colour frames don't fit, try to keep them compressed instead
+		FrameStore = MakeUnique<FCompressedGIFFrameStore>();
+		if (!FrameStore->HasEnoughMemory(InWidth, InHeight, InTotalFrames))
+		{
+			return nullptr;
+		}
+	}
+
+	FrameStore->Init(InWidth, InHeight, InTotalFrames);
+	return FrameStore;
+}
@@ -0,0 +1,177 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeCounter.h"
+
+/** Storage for decoded animation frames. Frames are written once by a GIF loader and read back one at a time for upload */
+class IGIFFrameStore
+{
+public:
+	virtual ~IGIFFrameStore() = default;
+
+	virtual void Init(int32 InWidth, int32 InHeight, int32 InTotalFrames) = 0;
+
+	/**
+	 * Stores a full canvas frame in BGRA order. Returns false if the frame can't be represented by this store.
+	 * Each frame is written once; frames already stored may be read from another thread meanwhile.
+	 */
+	virtual bool AddFrame(int32 FrameIndex, const FColor* FramePixels) = 0;
+
+	/**
+	 * Calls Visitor with the frame pixels, which are only valid during the call.
+	 * Textures sharing a decoder read frames from the game and render threads at once, so this is thread safe
+	 */
+	virtual void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) = 0;
+
+	virtual SIZE_T GetAllocatedSize() const = 0;
+
+	/** Memory allocated by Init for the given animation */
+	virtual int64 GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const = 0;
+
+	/** Checks the up front allocation against available physical memory before calling Init */
+	bool HasEnoughMemory(int32 InWidth, int32 InHeight, int32 InTotalFrames) const
+	{
+		return GetRequiredSize(InWidth, InHeight, InTotalFrames) <= (int64)FPlatformMemory::GetStats().AvailablePhysical;
+	}
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+	int32 GetTotalFrames() const { return TotalFrames; }
+	int64 GetFramePixelCount() const { return (int64)Width * Height; }
+	int64 GetFrameBytes() const { return GetFramePixelCount() * sizeof(FColor); }
+
+protected:
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 TotalFrames = 0;
+};
+
+/** Keeps every frame as 32-bit BGRA */
+class FRawGIFFrameStore : public IGIFFrameStore
+{
+public:
+	void Init(int32 InWidth, int32 InHeight, int32 InTotalFrames) override;
+	bool AddFrame(int32 FrameIndex, const FColor* FramePixels) override;
+	void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) override;
+	SIZE_T GetAllocatedSize() const override;
+	int64 GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const override;
+
+private:
+	TArray64<FColor> FrameData;
+};
+
+/**
+ * Keeps every frame as 8-bit palette indices plus a per-frame palette of up to 256 colours.
+ * Only the frame being uploaded is expanded back to BGRA.
+ */
+class FIndexedGIFFrameStore : public IGIFFrameStore
+{
+public:
+	static constexpr int32 MaxPaletteSize = 256;
+
+public:
+	void Init(int32 InWidth, int32 InHeight, int32 InTotalFrames) override;
+	bool AddFrame(int32 FrameIndex, const FColor* FramePixels) override;
+	void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) override;
+	SIZE_T GetAllocatedSize() const override;
+	int64 GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const override;
+
+private:
+	/** ExpandMutex is held by the caller */
+	const FColor* ExpandFrame(int32 FrameIndex);
+
+private:
+	TArray64<uint8> FrameIndices;
+	TArray<FColor> FramePalettes;
+
+	/** Guards the expanded frame, which is shared by every reader */
+	FCriticalSection ExpandMutex;
+	TArray64<FColor> ExpandedFrame;
+	int32 ExpandedFrameIndex = INDEX_NONE;
+};
+
+/**
+ * Keeps every frame LZ4 compressed for cheap random access (scrubbing, reverse playback).
+ * Frames are decompressed into a double buffer: the requested frame is returned from one half
+ * while the frame expected next is decompressed ahead into the other half on a worker thread.
+ */
+class FCompressedGIFFrameStore : public IGIFFrameStore
+{
+public:
+	virtual ~FCompressedGIFFrameStore();
+
+	void Init(int32 InWidth, int32 InHeight, int32 InTotalFrames) override;
+	bool AddFrame(int32 FrameIndex, const FColor* FramePixels) override;
+	void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) override;
+	SIZE_T GetAllocatedSize() const override;
+	int64 GetRequiredSize(int32 InWidth, int32 InHeight, int32 InTotalFrames) const override;
+
+private:
+	struct FDecompressedFrame
+	{
+		TArray64<FColor> Pixels;
+		int32 FrameIndex = INDEX_NONE;
+	};
+
+	/** ReadMutex is held by the caller */
+	const FColor* GetFrame(int32 FrameIndex);
+
+	void DecompressFrame(int32 FrameIndex, FDecompressedFrame& OutFrame) const;
+	void WaitForPrefetch();
+
+	/** LZ4 takes 32-bit sizes including the compression bound, larger frames are kept as is */
+	static bool CanCompressFrame(int64 FrameBytes) { return FrameBytes <= MAX_int32 / 2; }
+
+private:
+	TArray<TArray64<uint8>> CompressedFrames;
+	TArray<uint8> CompressionBuffer;
+
+	/** Guards the double buffer and the prefetch state, which are shared by every reader */
+	FCriticalSection ReadMutex;
+	FDecompressedFrame DecompressedFrames[2];
+	int32 LastFrameIndex = INDEX_NONE;
+	FThreadSafeCounter NumAddedFrames;
+	TFuture<void> PrefetchTask;
+};
+
+namespace GIFFrameStore
+{
+	/** Composites a row of non-premultiplied pixels over the canvas ("over" operator of APNG and animated WebP) */
+	inline void BlendRowOver(const FColor* Src, FColor* Dst, int32 NumPixels)
+	{
+		for (int32 X = 0; X < NumPixels; ++X)
+		{
+			const FColor& S = Src[X];
+			FColor& D = Dst[X];
+
+			if (S.A == 255 || D.A == 0)
+			{
+				D = S;
+			}
+			else if (S.A != 0)
+			{
+				const uint32 DstWeight = D.A * (255 - S.A);
+				const uint32 OutAlpha255 = S.A * 255 + DstWeight;
+
+				D.R = (uint8)((S.R * S.A * 255 + D.R * DstWeight) / OutAlpha255);
+				D.G = (uint8)((S.G * S.A * 255 + D.G * DstWeight) / OutAlpha255);
+				D.B = (uint8)((S.B * S.A * 255 + D.B * DstWeight) / OutAlpha255);
+				D.A = (uint8)(OutAlpha255 / 255);
+			}
+		}
+	}
+}
+
+class FGIFFrameStoreFactory
+{
+public:
+	/**
+	 * Creates a store for full colour frames, compressed if requested or if raw frames don't fit in memory.
+	 * Returns nullptr when even compressed frames can't be allocated.
+	 */
+	static TUniquePtr<IGIFFrameStore> CreateFrameStore(bool bCompressFrames, int32 InWidth, int32 InHeight, int32 InTotalFrames);
+};
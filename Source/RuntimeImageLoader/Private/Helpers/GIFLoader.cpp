@@ -3,24 +3,31 @@
 #include "GIFLoader.h"
 #include "NSGIFLoader.h"
 #include "WEBPGIFLoader.h"
+#include "APNGLoader.h"
 
 
-TUniquePtr<IGIFLoader> FGIFLoaderFactory::CreateLoader(const FString& GifURI, const TArray<uint8>& GifData)
+TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> FGIFLoaderFactory::CreateLoader(const FString& GifURI, const TArray<uint8>& GifData)
 {
     if (GifURI.EndsWith(".gif"))
     {
-        return MakeUnique<FNSGIFLoader>();
+        return MakeShared<FNSGIFLoader, ESPMode::ThreadSafe>();
     }
     else if (GifURI.EndsWith(".webp"))
     {
-        return MakeUnique<FWEBPGIFLoader>();
+        return MakeShared<FWEBPGIFLoader, ESPMode::ThreadSafe>();
+    }
+
+    // animated PNGs are regular PNGs with an acTL chunk, so they are told apart by content rather than extension
+    if (FAPNGLoader::HasAnimationControlChunk(GifData))
+    {
+        return MakeShared<FAPNGLoader, ESPMode::ThreadSafe>();
     }
 
     if (FWEBPGIFLoader::HasValidWebpHeader(GifData))
     {
-        return MakeUnique<FWEBPGIFLoader>();
+        return MakeShared<FWEBPGIFLoader, ESPMode::ThreadSafe>();
     }
 
     // construct .gif loader as it is more popular than .webp
-    return MakeUnique<FNSGIFLoader>();
+    return MakeShared<FNSGIFLoader, ESPMode::ThreadSafe>();
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "RuntimeImageScheduler.h"
 
 class IGIFLoader
 {
@@ -14,12 +17,75 @@ public:
 	virtual const int32 GetWidth() const = 0;
 	virtual const int32 GetHeight() const = 0;
 	virtual const int32 GetTotalFrames() const = 0;
-	virtual const FColor* GetNextFrame(int32 FrameIndex) = 0;
+	/** Calls Visitor with the frame canvas, valid only during the call. Textures sharing the decoder read from several threads at once */
+	virtual void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) = 0;
 	virtual const float GetNextFrameDelay(int32 FrameIndex) = 0;
+
+	/**
+	 * Canvas area that differs from the previous frame, so sequential playback only uploads that part.
+	 * Loaders that don't track frame regions report the whole canvas
+	 */
+	virtual FIntRect GetFrameDirtyRect(int32 FrameIndex) const { return FIntRect(0, 0, GetWidth(), GetHeight()); }
+
+	/** Keep decoded frames LZ4 compressed in memory. Must be set before DecodeGIF */
+	void SetCompressFrames(bool bInCompressFrames) { bCompressFrames = bInCompressFrames; }
+
+	/**
+	 * Keep only the canvas and a few recent frames, decoding each frame when it is requested. Must be set before DecodeGIF.
+	 * Loaders that can't decode frames on demand ignore it and store every frame
+	 */
+	void SetStreamFrames(bool bInStreamFrames) { bStreamFrames = bInStreamFrames; }
+
+	/** Decoding stops before the next frame once the task is cancelled. Must be set before DecodeGIF */
+	void SetTaskHandle(const FRuntimeImageTaskHandle& InTaskHandle) { TaskHandle = InTaskHandle; }
+	bool IsCancelled() const { return TaskHandle.IsCancelled(); }
+
+	/** Called on the decoding thread as soon as the first frame can be read. Must be set before DecodeGIF */
+	void SetOnFirstFrameDecoded(TUniqueFunction<void()>&& InOnFirstFrameDecoded) { OnFirstFrameDecoded = MoveTemp(InOnFirstFrameDecoded); }
+
+public:
+	/** Runs DecodeGIF and publishes completion. Can be called on a worker while frames are already being played */
+	bool Decode(TArray<uint8>&& GifBytes)
+	{
+		const bool bResult = DecodeGIF(MoveTemp(GifBytes)) && !IsCancelled();
+
+		bDecodeFinished.AtomicSet(true);
+		OnFirstFrameDecoded.Reset();
+
+		return bResult;
+	}
+
+	/** Frames [0, GetNumDecodedFrames()) can be read while the rest of the animation is still decoding */
+	int32 GetNumDecodedFrames() const { return NumDecodedFrames.GetValue(); }
+	bool IsDecodeFinished() const { return bDecodeFinished; }
+
+protected:
+	/** Called by loaders once the frame is fully written to the frame store */
+	void MarkFrameDecoded(int32 FrameIndex)
+	{
+		NumDecodedFrames.Set(FrameIndex + 1);
+
+		if (OnFirstFrameDecoded)
+		{
+			TUniqueFunction<void()> FirstFrameCallback = MoveTemp(OnFirstFrameDecoded);
+			OnFirstFrameDecoded.Reset();
+			FirstFrameCallback();
+		}
+	}
+
+protected:
+	bool bCompressFrames = false;
+	bool bStreamFrames = false;
+
+private:
+	FThreadSafeCounter NumDecodedFrames;
+	FThreadSafeBool bDecodeFinished = false;
+	FRuntimeImageTaskHandle TaskHandle;
+	TUniqueFunction<void()> OnFirstFrameDecoded;
 };
 
 class FGIFLoaderFactory
 {
 public:
-	static TUniquePtr<IGIFLoader> CreateLoader(const FString& GifURI, const TArray<uint8>& GifData);
+	static TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> CreateLoader(const FString& GifURI, const TArray<uint8>& GifData);
 };
@@ -0,0 +1,110 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "GIFLoaderCache.h"
+#include "Hash/CityHash.h"
+#include "HAL/FileManager.h"
+#include "Texture2DAnimation/AnimatedTexture2D.h"
+
+FGIFLoaderCache& FGIFLoaderCache::Get()
+{
+	static FGIFLoaderCache Instance;
+	return Instance;
+}
+
+FString FGIFLoaderCache::MakeKey(const FString& GifURI, const TArray<uint8>& GifBytes, bool bCompressFrames, bool bStreamFrames)
+{
+	const TCHAR* FrameStorage = bStreamFrames ? TEXT("stream") : (bCompressFrames ? TEXT("lz4") : TEXT("default"));
+
+	const bool bIsRemote = GifURI.StartsWith(TEXT("http://")) || GifURI.StartsWith(TEXT("https://"));
+
+	if (GifURI.Len() > 0 && !bIsRemote)
+	{
+		const FFileStatData StatData = IFileManager::Get().GetStatData(*GifURI);
+		return FString::Printf(TEXT("%s:%lld:%lld|%s"), *GifURI, StatData.FileSize, StatData.ModificationTime.GetTicks(), FrameStorage);
+	}
+
+	if (GifBytes.Num() == 0)
+	{
+		return FString();
+	}
+
+	const uint64 ContentHash = CityHash64((const char*)GifBytes.GetData(), GifBytes.Num());
+	return FString::Printf(TEXT("bytes:%016llx:%d|%s"), ContentHash, GifBytes.Num(), FrameStorage);
+}
+
+FString FGIFLoaderCache::MakeTextureKey(const FString& DecoderKey, TEnumAsByte<enum TextureFilter> FilterMode)
+{
+	return FString::Printf(TEXT("%s|filter:%d"), *DecoderKey, (int32)FilterMode.GetValue());
+}
+
+TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> FGIFLoaderCache::FindDecoder(const FString& Key)
+{
+	FScopeLock DecodersLock(&DecodersMutex);
+
+	if (TWeakPtr<IGIFLoader, ESPMode::ThreadSafe>* Decoder = Decoders.Find(Key))
+	{
+		// a cancelled decode never completes, so it is not worth sharing
+		TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> SharedDecoder = Decoder->Pin();
+		if (SharedDecoder.IsValid() && !SharedDecoder->IsCancelled())
+		{
+			return SharedDecoder;
+		}
+	}
+
+	return nullptr;
+}
+
+TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> FGIFLoaderCache::AddDecoder(const FString& Key, TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> Decoder)
+{
+	FScopeLock DecodersLock(&DecodersMutex);
+
+	if (TWeakPtr<IGIFLoader, ESPMode::ThreadSafe>* ExistingDecoder = Decoders.Find(Key))
+	{
+		TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> SharedDecoder = ExistingDecoder->Pin();
+		if (SharedDecoder.IsValid() && !SharedDecoder->IsCancelled())
+		{
+			return SharedDecoder;
+		}
+	}
+
+	// drop entries whose animations were released
+	for (auto It = Decoders.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	Decoders.Add(Key, Decoder);
+
+	return Decoder;
+}
+
+UAnimatedTexture2D* FGIFLoaderCache::FindTexture(const FString& Key)
+{
+	check(IsInGameThread());
+
+	UAnimatedTexture2D* Texture = nullptr;
+	if (TWeakObjectPtr<UAnimatedTexture2D>* CachedTexture = Textures.Find(Key))
+	{
+		Texture = CachedTexture->Get();
+	}
+
+	return Texture;
+}
+
+void FGIFLoaderCache::AddTexture(const FString& Key, UAnimatedTexture2D* Texture)
+{
+	check(IsInGameThread());
+
+	for (auto It = Textures.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	Textures.Add(Key, Texture);
+}
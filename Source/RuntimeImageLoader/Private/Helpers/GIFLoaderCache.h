@@ -0,0 +1,44 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "Engine/Texture.h"
+#include "GIFLoader.h"
+
+class UAnimatedTexture2D;
+
+/**
+ * Process wide registry of decoded animations. The same GIF shown many times is decoded and stored once,
+ * entries are weak so the frames are released together with the last texture referencing them.
+ */
+class FGIFLoaderCache
+{
+public:
+	static FGIFLoaderCache& Get();
+
+	/**
+	 * Files are keyed by path, size and modification time so an edited GIF is decoded again.
+	 * Bytes and downloaded data are keyed by content hash. Returns an empty key for URLs whose content is not known yet
+	 */
+	static FString MakeKey(const FString& GifURI, const TArray<uint8>& GifBytes, bool bCompressFrames, bool bStreamFrames);
+
+	/** Textures additionally have to agree on sampler settings */
+	static FString MakeTextureKey(const FString& DecoderKey, TEnumAsByte<enum TextureFilter> FilterMode);
+
+	TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> FindDecoder(const FString& Key);
+
+	/** Registers decoded animation. If another request registered the same key meanwhile, that decoder is returned instead */
+	TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> AddDecoder(const FString& Key, TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> Decoder);
+
+	/** Textures shared between requests with identical playback state. Game thread only */
+	UAnimatedTexture2D* FindTexture(const FString& Key);
+	void AddTexture(const FString& Key, UAnimatedTexture2D* Texture);
+
+private:
+	FCriticalSection DecodersMutex;
+	TMap<FString, TWeakPtr<IGIFLoader, ESPMode::ThreadSafe>> Decoders;
+
+	TMap<FString, TWeakObjectPtr<UAnimatedTexture2D>> Textures;
+};
@@ -0,0 +1,282 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "ImageBundle.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/BufferReader.h"
+#include "RHI.h"
+
+// found by TArray serialization, so it can't live in the anonymous namespace
+static FArchive& operator<<(FArchive& Ar, FImageBundleEntry& Entry)
+{
+    int32 PixelFormat = Entry.PixelFormat;
+    Ar << Entry.Name << Entry.SizeX << Entry.SizeY << PixelFormat << Entry.bSRGB << Entry.Offset << Entry.MipSizes;
+    Entry.PixelFormat = (EPixelFormat)PixelFormat;
+
+    return Ar;
+}
+
+namespace
+{
+    constexpr uint32 BundleMagic = 0x4E424952; // 'RIBN'
+    constexpr int32 BundleVersion = 1;
+
+    /** Magic, version, number of images, reserved and the index offset, padded to the payload alignment */
+    constexpr int64 HeaderSize = 32;
+
+    struct FBundleHeader
+    {
+        uint32 Magic = BundleMagic;
+        int32 Version = BundleVersion;
+        int32 NumEntries = 0;
+        int32 Reserved = 0;
+        int64 IndexOffset = 0;
+
+        void Serialize(FArchive& Ar)
+        {
+            Ar << Magic << Version << NumEntries << Reserved << IndexOffset;
+
+            uint8 Padding[HeaderSize - 24] = {};
+            Ar.Serialize(Padding, sizeof(Padding));
+        }
+    };
+
+    bool IsEntryValid(const FImageBundleEntry& Entry, int64 PayloadEnd)
+    {
+        if (Entry.SizeX <= 0 || Entry.SizeY <= 0 || Entry.PixelFormat <= PF_Unknown || Entry.PixelFormat >= PF_MAX
+            || Entry.MipSizes.Num() == 0 || Entry.Offset < HeaderSize || Entry.Offset % FImageBundle::PayloadAlignment != 0)
+        {
+            return false;
+        }
+
+        int64 Offset = Entry.Offset;
+        for (int32 MipIndex = 0; MipIndex < Entry.MipSizes.Num(); ++MipIndex)
+        {
+            if (Entry.MipSizes[MipIndex] != FTextureCacheFile::GetMipSize(Entry.PixelFormat, Entry.SizeX, Entry.SizeY, MipIndex))
+            {
+                return false;
+            }
+            Offset += Entry.MipSizes[MipIndex];
+        }
+
+        return Offset <= PayloadEnd;
+    }
+}
+
+FImageBundleWriter::~FImageBundleWriter()
+{
+    // an unclosed bundle has no index, leave nothing behind that looks usable
+    if (Writer.IsValid())
+    {
+        Writer.Reset();
+        IFileManager::Get().Delete(*BundleFilename, false, false, true);
+    }
+}
+
+bool FImageBundleWriter::Open(const FString& Filename, FString& OutError)
+{
+    check(!Writer.IsValid());
+
+    Writer.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+    if (!Writer.IsValid())
+    {
+        OutError = FString::Printf(TEXT("Failed to create image bundle %s"), *Filename);
+        return false;
+    }
+
+    BundleFilename = Filename;
+    Entries.Reset();
+    Names.Reset();
+
+    // placeholder until Close knows where the index is
+    FBundleHeader Header;
+    Header.Serialize(*Writer);
+
+    return true;
+}
+
+bool FImageBundleWriter::AddImage(const FString& Name, const FTextureCacheData& Image, FString& OutError)
+{
+    check(Writer.IsValid());
+
+    if (Names.Contains(Name))
+    {
+        OutError = FString::Printf(TEXT("Image bundle already has an image named %s"), *Name);
+        return false;
+    }
+
+    FImageBundleEntry Entry;
+    Entry.Name = Name;
+    Entry.SizeX = Image.SizeX;
+    Entry.SizeY = Image.SizeY;
+    Entry.PixelFormat = Image.PixelFormat;
+    Entry.bSRGB = Image.bSRGB;
+    Entry.Offset = Align(Writer->Tell(), FImageBundle::PayloadAlignment);
+
+    for (const TArray64<uint8>& Mip : Image.Mips)
+    {
+        Entry.MipSizes.Add(Mip.Num());
+    }
+
+    if (!IsEntryValid(Entry, MAX_int64))
+    {
+        OutError = FString::Printf(TEXT("Image %s has mips that don't match %d x %d in pixel format %d"), *Name, Image.SizeX, Image.SizeY, (int32)Image.PixelFormat);
+        return false;
+    }
+
+    uint8 Padding[FImageBundle::PayloadAlignment] = {};
+    Writer->Serialize(Padding, Entry.Offset - Writer->Tell());
+
+    for (const TArray64<uint8>& Mip : Image.Mips)
+    {
+        Writer->Serialize((void*)Mip.GetData(), Mip.Num());
+    }
+
+    if (Writer->IsError())
+    {
+        OutError = FString::Printf(TEXT("Failed to write %s to image bundle %s"), *Name, *BundleFilename);
+        return false;
+    }
+
+    Names.Add(Name);
+    Entries.Add(MoveTemp(Entry));
+    return true;
+}
+
+bool FImageBundleWriter::Close(FString& OutError)
+{
+    check(Writer.IsValid());
+
+    FBundleHeader Header;
+    Header.NumEntries = Entries.Num();
+    Header.IndexOffset = Writer->Tell();
+
+    *Writer << Entries;
+
+    Writer->Seek(0);
+    Header.Serialize(*Writer);
+
+    const bool bSuccess = !Writer->IsError() && Writer->Close();
+    Writer.Reset();
+
+    if (!bSuccess)
+    {
+        OutError = FString::Printf(TEXT("Failed to write image bundle %s"), *BundleFilename);
+        IFileManager::Get().Delete(*BundleFilename, false, false, true);
+        return false;
+    }
+
+    return true;
+}
+
+FImageBundleReader::~FImageBundleReader()
+{
+    // the region has to go before the file it maps
+    MappedRegion.Reset();
+    MappedFile.Reset();
+}
+
+TSharedPtr<FImageBundleReader, ESPMode::ThreadSafe> FImageBundleReader::Open(const FString& Filename, FString& OutError)
+{
+    TSharedPtr<FImageBundleReader, ESPMode::ThreadSafe> Reader = MakeShared<FImageBundleReader, ESPMode::ThreadSafe>();
+    if (!Reader->Map(Filename, OutError) || !Reader->ParseIndex(OutError))
+    {
+        OutError = FString::Printf(TEXT("%s: %s"), *Filename, *OutError);
+        return nullptr;
+    }
+
+    return Reader;
+}
+
+void FImageBundleReader::GetMips(const FImageBundleEntry& Entry, TArray<TArrayView64<const uint8>>& OutMips) const
+{
+    OutMips.Reset(Entry.MipSizes.Num());
+
+    const uint8* MipData = BundleData + Entry.Offset;
+    for (int64 MipSize : Entry.MipSizes)
+    {
+        OutMips.Emplace(MipData, MipSize);
+        MipData += MipSize;
+    }
+}
+
+bool FImageBundleReader::Map(const FString& Filename, FString& OutError)
+{
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+    MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+    if (MappedFile.IsValid())
+    {
+        MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+    }
+
+    if (MappedRegion.IsValid())
+    {
+        BundleData = MappedRegion->GetMappedPtr();
+        BundleSize = MappedRegion->GetMappedSize();
+        return true;
+    }
+
+    MappedFile.Reset();
+    if (!FFileHelper::LoadFileToArray(FileData, *Filename))
+    {
+        OutError = TEXT("Failed to open image bundle");
+        return false;
+    }
+
+    BundleData = FileData.GetData();
+    BundleSize = FileData.Num();
+    return true;
+}
+
+bool FImageBundleReader::ParseIndex(FString& OutError)
+{
+    if (BundleSize < HeaderSize)
+    {
+        OutError = TEXT("Not an image bundle");
+        return false;
+    }
+
+    FBufferReader Reader((void*)BundleData, BundleSize, false);
+
+    FBundleHeader Header;
+    Header.Serialize(Reader);
+    if (Header.Magic != BundleMagic || Header.Version != BundleVersion)
+    {
+        OutError = FString::Printf(TEXT("Not an image bundle or unsupported version %d"), Header.Version);
+        return false;
+    }
+
+    if (Header.IndexOffset < HeaderSize || Header.IndexOffset > BundleSize)
+    {
+        OutError = TEXT("Corrupted image bundle header");
+        return false;
+    }
+
+    TArray<FImageBundleEntry> IndexEntries;
+    Reader.Seek(Header.IndexOffset);
+    Reader << IndexEntries;
+
+    if (Reader.IsError() || IndexEntries.Num() != Header.NumEntries)
+    {
+        OutError = TEXT("Corrupted image bundle index");
+        return false;
+    }
+
+    Entries.Reserve(IndexEntries.Num());
+    for (FImageBundleEntry& Entry : IndexEntries)
+    {
+        if (!IsEntryValid(Entry, Header.IndexOffset))
+        {
+            OutError = FString::Printf(TEXT("Corrupted image bundle entry %s"), *Entry.Name);
+            return false;
+        }
+
+        FString Name = Entry.Name;
+        Entries.Add(MoveTemp(Name), MoveTemp(Entry));
+    }
+
+    return true;
+}
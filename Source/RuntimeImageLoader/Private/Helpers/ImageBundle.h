@@ -0,0 +1,92 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "Templates/UniquePtr.h"
+#include "TextureCacheFile.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/** Image stored in a bundle, mips follow each other starting at Offset */
+struct FImageBundleEntry
+{
+    FString Name;
+    int32 SizeX = 0;
+    int32 SizeY = 0;
+    EPixelFormat PixelFormat = PF_Unknown;
+    bool bSRGB = true;
+    int64 Offset = 0;
+    TArray<int64> MipSizes;
+};
+
+/**
+ * Bundle layout: a fixed header, GPU ready mip payloads (each image aligned to PayloadAlignment)
+ * and the index of all images at the end. The header points at the index and is patched on Close,
+ * so images are streamed to disk as they are added instead of being held until the index is known.
+ */
+namespace FImageBundle
+{
+    /** Extension of bundle files, without the dot */
+    constexpr const TCHAR* Extension = TEXT("rbundle");
+
+    constexpr int64 PayloadAlignment = 16;
+}
+
+/** Writes a bundle, not thread safe */
+class FImageBundleWriter
+{
+public:
+    ~FImageBundleWriter();
+
+    bool Open(const FString& Filename, FString& OutError);
+
+    /** Appends the mips of a cache entry, names are unique within a bundle */
+    bool AddImage(const FString& Name, const FTextureCacheData& Image, FString& OutError);
+
+    /** Writes the index and patches the header. The bundle is unusable until closed */
+    bool Close(FString& OutError);
+
+    bool IsOpen() const { return Writer.IsValid(); }
+    int32 GetNumImages() const { return Entries.Num(); }
+
+private:
+    TUniquePtr<FArchive> Writer;
+    TArray<FImageBundleEntry> Entries;
+    TSet<FString> Names;
+    FString BundleFilename;
+};
+
+/**
+ * Memory maps a bundle once and hands out views of the mips, so a load is an upload straight from the mapped file.
+ * Falls back to reading the whole file where the platform can't map it
+ */
+class FImageBundleReader
+{
+public:
+    ~FImageBundleReader();
+
+    static TSharedPtr<FImageBundleReader, ESPMode::ThreadSafe> Open(const FString& Filename, FString& OutError);
+
+    const FImageBundleEntry* FindEntry(const FString& Name) const { return Entries.Find(Name); }
+    const TMap<FString, FImageBundleEntry>& GetEntries() const { return Entries; }
+
+    /** Views of the entry mips inside the bundle, valid as long as the reader */
+    void GetMips(const FImageBundleEntry& Entry, TArray<TArrayView64<const uint8>>& OutMips) const;
+
+private:
+    bool Map(const FString& Filename, FString& OutError);
+    bool ParseIndex(FString& OutError);
+
+private:
+    TUniquePtr<IMappedFileHandle> MappedFile;
+    TUniquePtr<IMappedFileRegion> MappedRegion;
+    TArray64<uint8> FileData;
+
+    const uint8* BundleData = nullptr;
+    int64 BundleSize = 0;
+
+    TMap<FString, FImageBundleEntry> Entries;
+};
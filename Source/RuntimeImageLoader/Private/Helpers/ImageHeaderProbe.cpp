@@ -0,0 +1,282 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "ImageHeaderProbe.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Templates/UniquePtr.h"
+
+namespace
+{
+    FORCEINLINE uint32 ReadBE16(const uint8* Data) { return (Data[0] << 8) | Data[1]; }
+    FORCEINLINE uint32 ReadBE32(const uint8* Data) { return ((uint32)Data[0] << 24) | ((uint32)Data[1] << 16) | ((uint32)Data[2] << 8) | (uint32)Data[3]; }
+    FORCEINLINE uint32 ReadLE16(const uint8* Data) { return Data[0] | (Data[1] << 8); }
+    FORCEINLINE uint32 ReadLE32(const uint8* Data) { return (uint32)Data[0] | ((uint32)Data[1] << 8) | ((uint32)Data[2] << 16) | ((uint32)Data[3] << 24); }
+
+    bool StartsWith(const uint8* Data, int64 Length, const char* Signature, int64 SignatureLength)
+    {
+        return Length >= SignatureLength && FMemory::Memcmp(Data, Signature, SignatureLength) == 0;
+    }
+
+    bool ProbeJPEG(const uint8* Data, int64 Length, int32& OutWidth, int32& OutHeight)
+    {
+        int64 Offset = 2;
+        while (Offset + 4 <= Length)
+        {
+            if (Data[Offset] != 0xFF)
+            {
+                return false;
+            }
+
+            const uint8 Marker = Data[Offset + 1];
+            if (Marker == 0xFF)
+            {
+                // fill byte
+                ++Offset;
+                continue;
+            }
+
+            // SOF0..SOF15 except DHT, JPG and DAC carry the frame size
+            if (Marker >= 0xC0 && Marker <= 0xCF && Marker != 0xC4 && Marker != 0xC8 && Marker != 0xCC)
+            {
+                if (Offset + 9 > Length)
+                {
+                    return false;
+                }
+
+                OutHeight = ReadBE16(Data + Offset + 5);
+                OutWidth = ReadBE16(Data + Offset + 7);
+                return true;
+            }
+
+            // markers without a payload
+            if ((Marker >= 0xD0 && Marker <= 0xD9) || Marker == 0x01)
+            {
+                Offset += 2;
+                continue;
+            }
+
+            Offset += 2 + ReadBE16(Data + Offset + 2);
+        }
+
+        return false;
+    }
+
+    bool ProbeBMP(const uint8* Data, int64 Length, int32& OutWidth, int32& OutHeight)
+    {
+        if (Length < 26)
+        {
+            return false;
+        }
+
+        // BITMAPCOREHEADER has 16 bit dimensions, later headers 32 bit with negative height for top-down images
+        if (ReadLE32(Data + 14) == 12)
+        {
+            OutWidth = ReadLE16(Data + 18);
+            OutHeight = ReadLE16(Data + 20);
+        }
+        else
+        {
+            OutWidth = (int32)ReadLE32(Data + 18);
+            OutHeight = FMath::Abs((int32)ReadLE32(Data + 22));
+        }
+
+        return true;
+    }
+
+    bool ProbeHDR(const uint8* Data, int64 Length, int32& OutWidth, int32& OutHeight)
+    {
+        // header lines end with an empty line, followed by the resolution line, e.g. "-Y 512 +X 1024"
+        const FString Header(FUTF8ToTCHAR((const ANSICHAR*)Data, (int32)FMath::Min<int64>(Length, 4096)).Get());
+
+        const int32 HeaderEnd = Header.Find(TEXT("\n\n"));
+        if (HeaderEnd == INDEX_NONE)
+        {
+            return false;
+        }
+
+        FString ResolutionLine;
+        Header.Mid(HeaderEnd + 2).Split(TEXT("\n"), &ResolutionLine, nullptr);
+
+        TArray<FString> Tokens;
+        ResolutionLine.ParseIntoArrayWS(Tokens);
+        if (Tokens.Num() != 4 || !Tokens[0].EndsWith(TEXT("Y")) || !Tokens[2].EndsWith(TEXT("X")))
+        {
+            return false;
+        }
+
+        OutHeight = FCString::Atoi(*Tokens[1]);
+        OutWidth = FCString::Atoi(*Tokens[3]);
+        return true;
+    }
+
+    bool ProbeTIFF(const uint8* Data, int64 Length, int32& OutWidth, int32& OutHeight)
+    {
+        const bool bLittleEndian = Data[0] == 'I';
+        auto Read16 = [bLittleEndian](const uint8* Value) { return bLittleEndian ? ReadLE16(Value) : ReadBE16(Value); };
+        auto Read32 = [bLittleEndian](const uint8* Value) { return bLittleEndian ? ReadLE32(Value) : ReadBE32(Value); };
+
+        constexpr uint32 ImageWidthTag = 256;
+        constexpr uint32 ImageLengthTag = 257;
+        constexpr uint32 ShortType = 3;
+        constexpr int64 EntrySize = 12;
+
+        const int64 DirectoryOffset = Read32(Data + 4);
+        if (DirectoryOffset + 2 > Length)
+        {
+            return false;
+        }
+
+        const int64 NumEntries = Read16(Data + DirectoryOffset);
+        for (int64 Entry = 0; Entry < NumEntries; ++Entry)
+        {
+            const uint8* EntryData = Data + DirectoryOffset + 2 + Entry * EntrySize;
+            if (EntryData + EntrySize > Data + Length)
+            {
+                break;
+            }
+
+            const uint32 Tag = Read16(EntryData);
+            const uint32 Value = Read16(EntryData + 2) == ShortType ? Read16(EntryData + 8) : Read32(EntryData + 8);
+
+            if (Tag == ImageWidthTag)
+            {
+                OutWidth = (int32)Value;
+            }
+            else if (Tag == ImageLengthTag)
+            {
+                OutHeight = (int32)Value;
+            }
+        }
+
+        return OutWidth > 0 && OutHeight > 0;
+    }
+
+    bool ProbeEXR(const uint8* Data, int64 Length, int32& OutWidth, int32& OutHeight)
+    {
+        // magic and version, then attributes as name\0 type\0 size value up to an empty name
+        int64 Offset = 8;
+        while (Offset < Length && Data[Offset] != 0)
+        {
+            const ANSICHAR* Name = (const ANSICHAR*)Data + Offset;
+            const int64 NameLength = FCStringAnsi::Strnlen(Name, Length - Offset);
+            Offset += NameLength + 1;
+
+            const int64 TypeLength = Offset < Length ? FCStringAnsi::Strnlen((const ANSICHAR*)Data + Offset, Length - Offset) : 0;
+            Offset += TypeLength + 1;
+
+            if (Offset + 4 > Length)
+            {
+                return false;
+            }
+
+            const int64 Size = ReadLE32(Data + Offset);
+            Offset += 4;
+
+            if (FCStringAnsi::Strncmp(Name, "dataWindow", NameLength + 1) == 0 && Size == 16 && Offset + Size <= Length)
+            {
+                // box2i: xMin, yMin, xMax, yMax
+                OutWidth = (int32)ReadLE32(Data + Offset + 8) - (int32)ReadLE32(Data + Offset) + 1;
+                OutHeight = (int32)ReadLE32(Data + Offset + 12) - (int32)ReadLE32(Data + Offset + 4) + 1;
+                return true;
+            }
+
+            Offset += Size;
+        }
+
+        return false;
+    }
+}
+
+namespace FImageHeaderProbe
+{
+    bool Probe(const uint8* Data, int64 Length, const FString& Extension, int32& OutWidth, int32& OutHeight, FString& OutFormat)
+    {
+        OutWidth = 0;
+        OutHeight = 0;
+        OutFormat.Reset();
+
+        bool bRecognized = false;
+        if (StartsWith(Data, Length, "\x89PNG\r\n\x1a\n", 8) && Length >= 24)
+        {
+            OutWidth = (int32)ReadBE32(Data + 16);
+            OutHeight = (int32)ReadBE32(Data + 20);
+            OutFormat = TEXT("PNG");
+            bRecognized = true;
+        }
+        else if (StartsWith(Data, Length, "\xFF\xD8", 2))
+        {
+            OutFormat = TEXT("JPEG");
+            bRecognized = ProbeJPEG(Data, Length, OutWidth, OutHeight);
+        }
+        else if (StartsWith(Data, Length, "BM", 2))
+        {
+            OutFormat = TEXT("BMP");
+            bRecognized = ProbeBMP(Data, Length, OutWidth, OutHeight);
+        }
+        else if ((StartsWith(Data, Length, "GIF87a", 6) || StartsWith(Data, Length, "GIF89a", 6)) && Length >= 10)
+        {
+            OutWidth = ReadLE16(Data + 6);
+            OutHeight = ReadLE16(Data + 8);
+            OutFormat = TEXT("GIF");
+            bRecognized = true;
+        }
+        else if (StartsWith(Data, Length, "qoif", 4) && Length >= 12)
+        {
+            OutWidth = (int32)ReadBE32(Data + 4);
+            OutHeight = (int32)ReadBE32(Data + 8);
+            OutFormat = TEXT("QOI");
+            bRecognized = true;
+        }
+        else if (StartsWith(Data, Length, "#?", 2))
+        {
+            OutFormat = TEXT("HDR");
+            bRecognized = ProbeHDR(Data, Length, OutWidth, OutHeight);
+        }
+        else if ((StartsWith(Data, Length, "II*\0", 4) || StartsWith(Data, Length, "MM\0*", 4)) && Length >= 8)
+        {
+            OutFormat = TEXT("TIFF");
+            bRecognized = ProbeTIFF(Data, Length, OutWidth, OutHeight);
+        }
+        else if (StartsWith(Data, Length, "\x76\x2f\x31\x01", 4))
+        {
+            OutFormat = TEXT("EXR");
+            bRecognized = ProbeEXR(Data, Length, OutWidth, OutHeight);
+        }
+        else if (Extension.Equals(TEXT("tga"), ESearchCase::IgnoreCase) && Length >= 18)
+        {
+            OutWidth = ReadLE16(Data + 12);
+            OutHeight = ReadLE16(Data + 14);
+            OutFormat = TEXT("TGA");
+            bRecognized = true;
+        }
+
+        if (!bRecognized || OutWidth <= 0 || OutHeight <= 0)
+        {
+            OutWidth = 0;
+            OutHeight = 0;
+            OutFormat.Reset();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ProbeFile(const FString& Filename, int32& OutWidth, int32& OutHeight, FString& OutFormat)
+    {
+        TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent));
+        if (!Reader.IsValid())
+        {
+            return false;
+        }
+
+        TArray<uint8> Header;
+        Header.SetNumUninitialized(FMath::Min(Reader->TotalSize(), HeaderSize));
+        Reader->Serialize(Header.GetData(), Header.Num());
+        if (Reader->IsError())
+        {
+            return false;
+        }
+
+        return Probe(Header.GetData(), Header.Num(), FPaths::GetExtension(Filename), OutWidth, OutHeight, OutFormat);
+    }
+}
@@ -0,0 +1,20 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace FImageHeaderProbe
+{
+    /** Leading bytes of a file handed to Probe, JPEGs with larger metadata blocks before the frame header are not recognized */
+    constexpr int64 HeaderSize = 64 * 1024;
+
+    /**
+     * Reads dimensions and the format name (PNG, JPEG, BMP, TGA, GIF, QOI, HDR, TIFF, EXR) from the start of an image file without decoding it.
+     * TGA has no signature and is only tried for the .tga extension. Returns false if the header isn't recognized
+     */
+    bool Probe(const uint8* Data, int64 Length, const FString& Extension, int32& OutWidth, int32& OutHeight, FString& OutFormat);
+
+    /** Reads the first HeaderSize bytes of the file and probes them */
+    bool ProbeFile(const FString& Filename, int32& OutWidth, int32& OutHeight, FString& OutFormat);
+}
@@ -0,0 +1,278 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "ImageStatistics.h"
+#include "Async/ParallelFor.h"
+#include "Math/Float16.h"
+
+namespace
+{
+    constexpr int32 RowsPerChunk = 64;
+    constexpr int32 NumBins = FRuntimeImageStatistics::NumHistogramBins;
+
+    // pixel readers return RGBA on the 0..1 scale (HDR may exceed it)
+
+    struct FReadBGRA8
+    {
+        static constexpr int32 BytesPerPixel = 4;
+        static constexpr bool bHasAlpha = true;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            return VectorSwizzle(VectorDivide(VectorLoadByte4(Pixel), VectorSetFloat1(255.f)), 2, 1, 0, 3);
+        }
+    };
+
+    struct FReadG8
+    {
+        static constexpr int32 BytesPerPixel = 1;
+        static constexpr bool bHasAlpha = false;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            const float Value = Pixel[0] / 255.f;
+            return MakeVectorRegister(Value, Value, Value, 1.f);
+        }
+    };
+
+    struct FReadG16
+    {
+        static constexpr int32 BytesPerPixel = 2;
+        static constexpr bool bHasAlpha = false;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            const float Value = *(const uint16*)Pixel / 65535.f;
+            return MakeVectorRegister(Value, Value, Value, 1.f);
+        }
+    };
+
+    struct FReadRGBA16
+    {
+        static constexpr int32 BytesPerPixel = 8;
+        static constexpr bool bHasAlpha = true;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            const uint16* Values = (const uint16*)Pixel;
+            return VectorDivide(MakeVectorRegister((float)Values[0], (float)Values[1], (float)Values[2], (float)Values[3]), VectorSetFloat1(65535.f));
+        }
+    };
+
+    struct FReadRGBA16F
+    {
+        static constexpr int32 BytesPerPixel = 8;
+        static constexpr bool bHasAlpha = true;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            const FFloat16* Values = (const FFloat16*)Pixel;
+            return MakeVectorRegister(Values[0].GetFloat(), Values[1].GetFloat(), Values[2].GetFloat(), Values[3].GetFloat());
+        }
+    };
+
+    struct FReadRGBA32F
+    {
+        static constexpr int32 BytesPerPixel = 16;
+        static constexpr bool bHasAlpha = true;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            return VectorLoad((const float*)Pixel);
+        }
+    };
+
+    struct FReadBGRE8
+    {
+        static constexpr int32 BytesPerPixel = 4;
+        static constexpr bool bHasAlpha = false;
+
+        static FORCEINLINE VectorRegister Read(const uint8* Pixel)
+        {
+            const FLinearColor Color = ((const FColor*)Pixel)->FromRGBE();
+            return MakeVectorRegister(Color.R, Color.G, Color.B, 1.f);
+        }
+    };
+
+    struct FChunkStatistics
+    {
+        double Sum[4] = {};
+        VectorRegister Min;
+        VectorRegister Max;
+        uint32 Histogram[4][NumBins] = {};
+    };
+
+    template<typename FReader>
+    void AccumulateChunk(const FImage& Image, int32 FirstRow, int32 LastRow, FChunkStatistics& Chunk)
+    {
+        const VectorRegister Zero = VectorZero();
+        const VectorRegister One = VectorOne();
+        const VectorRegister BinScale = VectorSetFloat1(NumBins - 1.f);
+        const VectorRegister BinRounding = VectorSetFloat1(0.5f);
+
+        const int64 RowPitch = (int64)Image.SizeX * FReader::BytesPerPixel;
+
+        VectorRegister Min = VectorSetFloat1(MAX_flt);
+        VectorRegister Max = VectorSetFloat1(-MAX_flt);
+
+        MS_ALIGN(16) float Values[4] GCC_ALIGN(16);
+
+        for (int32 Y = FirstRow; Y < LastRow; ++Y)
+        {
+            const uint8* Pixel = Image.RawData.GetData() + Y * RowPitch;
+
+            // summed per row in floats and per image in doubles, so large images don't lose precision
+            VectorRegister RowSum = Zero;
+
+            for (int32 X = 0; X < Image.SizeX; ++X, Pixel += FReader::BytesPerPixel)
+            {
+                const VectorRegister Value = FReader::Read(Pixel);
+
+                RowSum = VectorAdd(RowSum, Value);
+                Min = VectorMin(Min, Value);
+                Max = VectorMax(Max, Value);
+
+                VectorStoreAligned(VectorMultiplyAdd(VectorMin(VectorMax(Value, Zero), One), BinScale, BinRounding), Values);
+                for (int32 Channel = 0; Channel < 4; ++Channel)
+                {
+                    ++Chunk.Histogram[Channel][FMath::Clamp((int32)Values[Channel], 0, NumBins - 1)];
+                }
+            }
+
+            VectorStoreAligned(RowSum, Values);
+            for (int32 Channel = 0; Channel < 4; ++Channel)
+            {
+                Chunk.Sum[Channel] += Values[Channel];
+            }
+        }
+
+        Chunk.Min = Min;
+        Chunk.Max = Max;
+    }
+
+    template<typename FReader>
+    void ComputeWithReader(const FImage& Image, FRuntimeImageStatistics& OutStatistics)
+    {
+        const int32 NumChunks = FMath::DivideAndRoundUp(Image.SizeY, RowsPerChunk);
+
+        TArray<FChunkStatistics> Chunks;
+        Chunks.SetNum(NumChunks);
+
+        ParallelFor(NumChunks, [&](int32 ChunkIndex)
+        {
+            const int32 FirstRow = ChunkIndex * RowsPerChunk;
+            AccumulateChunk<FReader>(Image, FirstRow, FMath::Min(FirstRow + RowsPerChunk, Image.SizeY), Chunks[ChunkIndex]);
+        });
+
+        double Sum[4] = {};
+        VectorRegister Min = Chunks[0].Min;
+        VectorRegister Max = Chunks[0].Max;
+
+        TArray<int64>* Histograms[4] = { &OutStatistics.HistogramR, &OutStatistics.HistogramG, &OutStatistics.HistogramB, &OutStatistics.HistogramA };
+        for (TArray<int64>* Histogram : Histograms)
+        {
+            Histogram->Init(0, NumBins);
+        }
+
+        for (const FChunkStatistics& Chunk : Chunks)
+        {
+            Min = VectorMin(Min, Chunk.Min);
+            Max = VectorMax(Max, Chunk.Max);
+
+            for (int32 Channel = 0; Channel < 4; ++Channel)
+            {
+                Sum[Channel] += Chunk.Sum[Channel];
+
+                int64* Bins = Histograms[Channel]->GetData();
+                for (int32 Bin = 0; Bin < NumBins; ++Bin)
+                {
+                    Bins[Bin] += Chunk.Histogram[Channel][Bin];
+                }
+            }
+        }
+
+        const double NumPixels = (double)Image.SizeX * Image.SizeY;
+        OutStatistics.AverageColor = FLinearColor((float)(Sum[0] / NumPixels), (float)(Sum[1] / NumPixels), (float)(Sum[2] / NumPixels), (float)(Sum[3] / NumPixels));
+
+        VectorStore(Min, &OutStatistics.MinValue.R);
+        VectorStore(Max, &OutStatistics.MaxValue.R);
+
+        OutStatistics.bHasAlphaChannel = FReader::bHasAlpha;
+        OutStatistics.bFullyOpaque = OutStatistics.MinValue.A >= 1.f;
+        OutStatistics.bFullyTransparent = OutStatistics.MaxValue.A <= 0.f;
+        OutStatistics.bValid = true;
+    }
+}
+
+namespace FImageStatistics
+{
+    bool Compute(const FImage& Image, FRuntimeImageStatistics& OutStatistics)
+    {
+        OutStatistics = FRuntimeImageStatistics();
+
+        if (Image.SizeX <= 0 || Image.SizeY <= 0 || Image.RawData.Num() == 0)
+        {
+            return false;
+        }
+
+        switch (Image.Format)
+        {
+            case ERawImageFormat::G8:       ComputeWithReader<FReadG8>(Image, OutStatistics); break;
+            case ERawImageFormat::G16:      ComputeWithReader<FReadG16>(Image, OutStatistics); break;
+            case ERawImageFormat::BGRA8:    ComputeWithReader<FReadBGRA8>(Image, OutStatistics); break;
+            case ERawImageFormat::BGRE8:    ComputeWithReader<FReadBGRE8>(Image, OutStatistics); break;
+            case ERawImageFormat::RGBA16:   ComputeWithReader<FReadRGBA16>(Image, OutStatistics); break;
+            case ERawImageFormat::RGBA16F:  ComputeWithReader<FReadRGBA16F>(Image, OutStatistics); break;
+            case ERawImageFormat::RGBA32F:  ComputeWithReader<FReadRGBA32F>(Image, OutStatistics); break;
+            default:                        return false;
+        }
+
+        return true;
+    }
+
+    void AnalyzeChannelUsage(const FImage& Image, bool& bOutOpaque, bool& bOutGreyscale)
+    {
+        check(Image.Format == ERawImageFormat::BGRA8);
+
+        const int64 NumPixels = (int64)Image.SizeX * Image.SizeY;
+        const int64 PixelsPerChunk = (int64)Image.SizeX * RowsPerChunk;
+        const int32 NumChunks = FMath::DivideAndRoundUp(Image.SizeY, RowsPerChunk);
+
+        TArray<uint32> ChunkAlpha;
+        TArray<uint32> ChunkColorDifference;
+        ChunkAlpha.SetNumZeroed(NumChunks);
+        ChunkColorDifference.SetNumZeroed(NumChunks);
+
+        const uint32* Pixels = (const uint32*)Image.RawData.GetData();
+
+        // branchless bit reductions over packed pixels, the compiler vectorizes these loops
+        ParallelFor(NumChunks, [&](int32 ChunkIndex)
+        {
+            const int64 First = ChunkIndex * PixelsPerChunk;
+            const int64 Last = FMath::Min(First + PixelsPerChunk, NumPixels);
+
+            uint32 Alpha = 0xFFFFFFFF;
+            uint32 ColorDifference = 0;
+            for (int64 Index = First; Index < Last; ++Index)
+            {
+                const uint32 Pixel = Pixels[Index];
+                Alpha &= Pixel;
+                // B ^ G in the low byte, G ^ R in the next one
+                ColorDifference |= (Pixel ^ (Pixel >> 8)) & 0xFFFF;
+            }
+
+            ChunkAlpha[ChunkIndex] = Alpha;
+            ChunkColorDifference[ChunkIndex] = ColorDifference;
+        });
+
+        uint32 Alpha = 0xFFFFFFFF;
+        uint32 ColorDifference = 0;
+        for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+        {
+            Alpha &= ChunkAlpha[ChunkIndex];
+            ColorDifference |= ChunkColorDifference[ChunkIndex];
+        }
+
+        bOutOpaque = (Alpha >> 24) == 0xFF;
+        bOutGreyscale = ColorDifference == 0;
+    }
+}
@@ -0,0 +1,19 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ImageCore.h"
+#include "RuntimeImageStatistics.h"
+
+namespace FImageStatistics
+{
+    /**
+     * Gathers average, min/max, histograms and opacity in one parallel pass over the image.
+     * Returns false and leaves OutStatistics invalid for formats it can't read
+     */
+    bool Compute(const FImage& Image, FRuntimeImageStatistics& OutStatistics);
+
+    /** Checks which channels of a BGRA8 image carry information: alpha is 255 everywhere, R, G and B are equal everywhere */
+    void AnalyzeChannelUsage(const FImage& Image, bool& bOutOpaque, bool& bOutGreyscale);
+}
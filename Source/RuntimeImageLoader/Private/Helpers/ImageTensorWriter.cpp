@@ -0,0 +1,173 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "ImageTensorWriter.h"
+#include "Async/ParallelFor.h"
+#include "Math/Float16.h"
+
+namespace
+{
+    /** Consecutive source pixels an output pixel is filtered from, their weights sum to one */
+    struct FFilterTaps
+    {
+        int32 First = 0;
+        int32 Num = 0;
+        int32 WeightsOffset = 0;
+    };
+
+    struct FAxisFilter
+    {
+        TArray<FFilterTaps> Taps;
+        TArray<float> Weights;
+    };
+
+    /**
+     * Shrinking averages every source pixel an output pixel covers (box filter), so the result doesn't alias
+     * or depend on the source resolution. Enlarging interpolates the two nearest pixels
+     */
+    void BuildFilter(int32 SourceSize, int32 DestSize, FAxisFilter& OutFilter)
+    {
+        const double Scale = (double)SourceSize / DestSize;
+
+        OutFilter.Taps.SetNum(DestSize);
+        OutFilter.Weights.Reset();
+
+        for (int32 Index = 0; Index < DestSize; ++Index)
+        {
+            FFilterTaps& Tap = OutFilter.Taps[Index];
+            Tap.WeightsOffset = OutFilter.Weights.Num();
+
+            if (Scale <= 1.0)
+            {
+                const double SourcePosition = FMath::Clamp((Index + 0.5) * Scale - 0.5, 0.0, (double)(SourceSize - 1));
+
+                Tap.First = (int32)SourcePosition;
+                Tap.Num = FMath::Min(Tap.First + 1, SourceSize - 1) - Tap.First + 1;
+
+                const float Weight1 = Tap.Num > 1 ? (float)(SourcePosition - Tap.First) : 0.f;
+                OutFilter.Weights.Add(1.f - Weight1);
+                if (Tap.Num > 1)
+                {
+                    OutFilter.Weights.Add(Weight1);
+                }
+            }
+            else
+            {
+                const double Start = Index * Scale;
+                const double End = FMath::Min((Index + 1) * Scale, (double)SourceSize);
+
+                Tap.First = FMath::Min((int32)Start, SourceSize - 1);
+                Tap.Num = FMath::Max(FMath::CeilToInt(End) - Tap.First, 1);
+
+                for (int32 Source = Tap.First; Source < Tap.First + Tap.Num; ++Source)
+                {
+                    const double Coverage = FMath::Min(End, Source + 1.0) - FMath::Max(Start, (double)Source);
+                    OutFilter.Weights.Add((float)(FMath::Max(Coverage, 0.0) / Scale));
+                }
+            }
+        }
+    }
+
+    FORCEINLINE void StoreElement(float* Dest, float Value)
+    {
+        *Dest = Value;
+    }
+
+    FORCEINLINE void StoreElement(FFloat16* Dest, float Value)
+    {
+        *Dest = FFloat16(Value);
+    }
+
+    template<typename ElementType>
+    void WriteRows(const FImage& Image, const FImageTensorParams& Params, ElementType* Dest)
+    {
+        FAxisFilter FilterX;
+        FAxisFilter FilterY;
+        BuildFilter(Image.SizeX, Params.Width, FilterX);
+        BuildFilter(Image.SizeY, Params.Height, FilterY);
+
+        // (Value / 255 - Mean) / Std folded into a single multiply-add, lanes are in the source BGRA order
+        const VectorRegister Scale = MakeVectorRegister(1.f / (255.f * Params.Std.B), 1.f / (255.f * Params.Std.G), 1.f / (255.f * Params.Std.R), 0.f);
+        const VectorRegister Bias = MakeVectorRegister(-Params.Mean.B / Params.Std.B, -Params.Mean.G / Params.Std.G, -Params.Mean.R / Params.Std.R, 0.f);
+
+        // lane each output channel is read from
+        const int32 ChannelLanes[FImageTensorParams::NumChannels] = { Params.bBGR ? 0 : 2, 1, Params.bBGR ? 2 : 0 };
+
+        const int64 PlaneSize = (int64)Params.Width * Params.Height;
+        const int64 RowPitch = (int64)Image.SizeX * 4;
+        const uint8* Pixels = Image.RawData.GetData();
+
+        ParallelFor(Params.Height, [&](int32 Y)
+        {
+            const FFilterTaps& TapY = FilterY.Taps[Y];
+            const float* WeightsY = FilterY.Weights.GetData() + TapY.WeightsOffset;
+
+            MS_ALIGN(16) float Values[4] GCC_ALIGN(16);
+
+            for (int32 X = 0; X < Params.Width; ++X)
+            {
+                const FFilterTaps& TapX = FilterX.Taps[X];
+                const float* WeightsX = FilterX.Weights.GetData() + TapX.WeightsOffset;
+
+                VectorRegister Sum = VectorZero();
+                for (int32 RowTap = 0; RowTap < TapY.Num; ++RowTap)
+                {
+                    const uint8* Source = Pixels + (TapY.First + RowTap) * RowPitch + (int64)TapX.First * 4;
+
+                    VectorRegister RowSum = VectorZero();
+                    for (int32 ColumnTap = 0; ColumnTap < TapX.Num; ++ColumnTap)
+                    {
+                        RowSum = VectorMultiplyAdd(VectorLoadByte4(Source + ColumnTap * 4), VectorSetFloat1(WeightsX[ColumnTap]), RowSum);
+                    }
+
+                    Sum = VectorMultiplyAdd(RowSum, VectorSetFloat1(WeightsY[RowTap]), Sum);
+                }
+
+                VectorStoreAligned(VectorMultiplyAdd(Sum, Scale, Bias), Values);
+
+                const int64 PixelIndex = (int64)Y * Params.Width + X;
+                if (Params.Layout == ERuntimeTensorLayout::NCHW)
+                {
+                    for (int32 Channel = 0; Channel < FImageTensorParams::NumChannels; ++Channel)
+                    {
+                        StoreElement(Dest + Channel * PlaneSize + PixelIndex, Values[ChannelLanes[Channel]]);
+                    }
+                }
+                else
+                {
+                    ElementType* Pixel = Dest + PixelIndex * FImageTensorParams::NumChannels;
+                    for (int32 Channel = 0; Channel < FImageTensorParams::NumChannels; ++Channel)
+                    {
+                        StoreElement(Pixel + Channel, Values[ChannelLanes[Channel]]);
+                    }
+                }
+            }
+        });
+    }
+}
+
+namespace FImageTensorWriter
+{
+    void WriteImage(FRuntimeImageData& Image, const FImageTensorParams& Params, void* Dest)
+    {
+        check(Params.IsValid());
+
+        if (Image.Format != ERawImageFormat::BGRA8)
+        {
+            FImage ConvertedImage;
+            Image.CopyTo(ConvertedImage, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+
+            Image.RawData = MoveTemp(ConvertedImage.RawData);
+            Image.Format = ERawImageFormat::BGRA8;
+            Image.GammaSpace = EGammaSpace::sRGB;
+        }
+
+        if (Params.bHalfPrecision)
+        {
+            WriteRows(Image, Params, (FFloat16*)Dest);
+        }
+        else
+        {
+            WriteRows(Image, Params, (float*)Dest);
+        }
+    }
+}
@@ -0,0 +1,17 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RuntimeImageData.h"
+#include "RuntimeImageTensor.h"
+
+namespace FImageTensorWriter
+{
+    /**
+     * Resizes (area average when shrinking, bilinear with pixel centers aligned when enlarging), normalizes and lays out
+     * the image into one tensor slice in a single pass.
+     * Dest must hold Params.GetImageSizeBytes(). Images that aren't BGRA8 are converted first
+     */
+    void WriteImage(FRuntimeImageData& Image, const FImageTensorParams& Params, void* Dest);
+}
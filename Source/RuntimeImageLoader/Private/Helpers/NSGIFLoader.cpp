@@ -2,17 +2,21 @@
 
 #include "NSGIFLoader.h"
 #include "RuntimeImageLoaderLog.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RHI.h"
 
 DEFINE_LOG_CATEGORY(LibNsGifHelper);
 
 #if WITH_LIBNSGIF
 void* FNSGIFLoader::bitmap_create(int width, int height)
 {
-	if (width > 4096 || height > 4096) {
+	// frames are uploaded as a single texture, so the canvas can't exceed what the RHI supports
+	const int32 MaxDimension = (int32)GetMax2DTextureDimension();
+	if (width <= 0 || height <= 0 || width > MaxDimension || height > MaxDimension) {
 		return NULL;
 	}
 
-	return calloc(width * height, BYTES_PER_PIXEL);
+	return calloc((size_t)width * height, BYTES_PER_PIXEL);
 }
 
 unsigned char* FNSGIFLoader::bitmap_get_buffer(void* bitmap)
@@ -40,11 +44,13 @@ FString FNSGIFLoader::GetDecodeError() const
 
 bool FNSGIFLoader::DecodeGIF(TArray<uint8>&& GifBytes)
 {
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+
 	/* load file into memory */
 	TArray<uint8> Data(MoveTemp(GifBytes));
 	
 	/* create our gif animation */
-	LastError = nsgif_create(&bitmap_callbacks, NSGIF_BITMAP_FMT_R8G8B8A8, &Gif);
+	LastError = nsgif_create(&bitmap_callbacks, NSGIF_BITMAP_FMT_B8G8R8A8, &Gif);
 	if (LastError != NSGIF_OK)
 	{
 		Warning("nsgif_create");
@@ -57,41 +63,33 @@ bool FNSGIFLoader::DecodeGIF(TArray<uint8>&& GifBytes)
 		/* Not fatal; some GIFs are nasty. Can still try to decode
 		 * any frames that were decoded successfully. */
 		Warning("nsgif_data_scan");
+		nsgif_destroy(Gif);
 		return false;
 	}
 
 	nsgif_data_complete(Gif);
 
-	int32 LoopMax = nsgif_get_info(Gif)->loop_max;
-	if (LoopMax == 0) LoopMax = 1;
-
-	for (uint64 i = 0; i < LoopMax; i++)
-	{
-		DecodeInternal(Gif, i==0);
-		
-		/* We want to ignore any loop limit in the GIF. */
-		nsgif_reset(Gif);
-	}
-
-	/** Gif Info */
+	/** Gif Info, must be known before the first frame is published */
 	Info = nsgif_get_info(Gif);
 
-	if (Width == -1 && Height == -1 && TotalFrameCount == -1)
-	{
-		Width = Info->width;
-		Height = Info->height;
-		TotalFrameCount = Info->frame_count;
-	}
+	Width = Info->width;
+	Height = Info->height;
+	TotalFrameCount = Info->frame_count;
+
+	/* Frames are decoded once, looping is handled by the animated texture.
+	 * The loop limit of the GIF is ignored. */
+	DecodeInternal(Gif, true);
 
 	/* clean up */
 	nsgif_destroy(Gif);
 
-	if (TextureData.Num() == 0)
+	if (!FrameStore.IsValid() || FrameStore->GetTotalFrames() == 0)
 	{
 		UE_LOG(LibNsGifHelper, Warning, TEXT("Failed to decode GIF! Please check input data is valid. Otherwise contact developers for an advice"));
+		return false;
 	}
 
-	return TextureData.Num() > 0;
+	return true;
 }
 
 const int32 FNSGIFLoader::GetWidth() const
@@ -115,15 +113,42 @@ bool FNSGIFLoader::DecodeInternal(nsgif_t* gif, bool first)
 	const nsgif_info_t* info;
 	info = nsgif_get_info(gif);
 
-	// Calculate the total number of pixels (frame_count * width * height)
-	const int32 TotalPixels = info->frame_count * info->width * info->height;
-	TextureData.Empty(TotalPixels);
-	TextureData.AddUninitialized(TotalPixels);
+	// Frames are kept palette-indexed unless compression is requested, see StoreFrame
+	if (bCompressFrames)
+	{
+		FrameStore = MakeShared<FCompressedGIFFrameStore, ESPMode::ThreadSafe>();
+	}
+	else
+	{
+		FrameStore = MakeShared<FIndexedGIFFrameStore, ESPMode::ThreadSafe>();
+	}
+
+	if (!FrameStore->HasEnoughMemory(info->width, info->height, info->frame_count))
+	{
+		UE_LOG(LibNsGifHelper, Warning, TEXT("GIF %ux%u with %u frames needs %lld bytes of frame storage. Falling back to compressed frames"),
+			info->width, info->height, info->frame_count, FrameStore->GetRequiredSize(info->width, info->height, info->frame_count));
+
+		FrameStore = MakeShared<FCompressedGIFFrameStore, ESPMode::ThreadSafe>();
+		if (!FrameStore->HasEnoughMemory(info->width, info->height, info->frame_count))
+		{
+			FrameStore.Reset();
+			LastError = NSGIF_ERR_OOM;
+			Warning("FrameStore->Init");
+			return false;
+		}
+	}
+	FrameStore->Init(info->width, info->height, info->frame_count);
+
+	// frames may be read while decoding, so timestamps are never reallocated
+	Timestamps.SetNumZeroed(info->frame_count);
 
 	// Decode the frames
 	while (true) {
+		if (IsCancelled()) {
+			return false;
+		}
+
 		nsgif_bitmap_t* bitmap;
-		const uint8* image;
 		uint32_t frame_new;
 		uint32_t delay_cs;
 		nsgif_rect_t area;
@@ -134,7 +159,10 @@ bool FNSGIFLoader::DecodeInternal(nsgif_t* gif, bool first)
 			return false;
 		}
 
-		Timestamps.Add(delay_cs * 10.f / 1000.f);
+		if (frame_new < info->frame_count)
+		{
+			Timestamps[frame_new] = delay_cs * 10.f / 1000.f;
+		}
 
 		if (frame_new < frame_prev) {
 			// Must be an animation that loops. We only care about
@@ -150,25 +178,12 @@ bool FNSGIFLoader::DecodeInternal(nsgif_t* gif, bool first)
 		}
 		else 
 		{
-			image = (const uint8*)bitmap;
-
-			// TODO: Optimize this loop later? Use memcpy?
-
-			for (uint32_t i = 0; i < info->height * info->width; i++) {
-				uint32_t y = i / info->width;
-				uint32_t x = i % info->width;
-
-				size_t z = (y * info->width + x) * 4;
-				uint8 Red = image[z];
-				uint8 Green = image[z + 1];
-				uint8 Blue = image[z + 2];
-				uint8 Alpha = image[z + 3];
-
-				int32 PixelIndex = ((frame_new * info->height + y) * info->width + x);
-				TextureData[PixelIndex] = FColor(Red, Green, Blue, Alpha);
-			}
+			// bitmap is created in BGRA byte order which matches FColor layout
+			StoreFrame(frame_new, (const FColor*)bitmap);
 		}
 
+		MarkFrameDecoded(frame_new);
+
 		if (delay_cs == NSGIF_INFINITE) 
 		{
 			// This frame is the last.
@@ -179,24 +194,66 @@ bool FNSGIFLoader::DecodeInternal(nsgif_t* gif, bool first)
 	return true;
 }
 
-const FColor* FNSGIFLoader::GetNextFrame(int32 FrameIndex)
+void FNSGIFLoader::StoreFrame(int32 FrameIndex, const FColor* FramePixels)
+{
+	// Only this thread replaces the store. Stores allow adding a frame while earlier frames are read,
+	// so the lock just publishes a replaced store and is never held while frames are written or read
+	TSharedPtr<IGIFFrameStore, ESPMode::ThreadSafe> CurrentFrameStore;
+	{
+		FScopeLock FrameStoreLock(&FrameStoreMutex);
+		CurrentFrameStore = FrameStore;
+	}
+
+	if (CurrentFrameStore->AddFrame(FrameIndex, FramePixels))
+	{
+		return;
+	}
+
+	// Composited frame has more than 256 colours, keep full colour frames from now on
+
+	UE_LOG(LibNsGifHelper, Verbose, TEXT("GIF frame %d uses more than %d colours. Switching to full colour frame storage"), FrameIndex, FIndexedGIFFrameStore::MaxPaletteSize);
+
+	TSharedPtr<IGIFFrameStore, ESPMode::ThreadSafe> RawFrameStore = MakeShared<FRawGIFFrameStore, ESPMode::ThreadSafe>();
+	if (!RawFrameStore->HasEnoughMemory(CurrentFrameStore->GetWidth(), CurrentFrameStore->GetHeight(), CurrentFrameStore->GetTotalFrames()))
+	{
+		// full colour frames don't fit in memory, compressed frames keep the footprint close to the indexed one
+		RawFrameStore = MakeShared<FCompressedGIFFrameStore, ESPMode::ThreadSafe>();
+	}
+	RawFrameStore->Init(CurrentFrameStore->GetWidth(), CurrentFrameStore->GetHeight(), CurrentFrameStore->GetTotalFrames());
+
+	// readers keep using the current store while every frame is copied over
+	for (int32 PrevFrameIndex = 0; PrevFrameIndex < FrameIndex; ++PrevFrameIndex)
+	{
+		CurrentFrameStore->ReadFrame(PrevFrameIndex, [&RawFrameStore, PrevFrameIndex](const FColor* PrevFramePixels) { RawFrameStore->AddFrame(PrevFrameIndex, PrevFramePixels); });
+	}
+	RawFrameStore->AddFrame(FrameIndex, FramePixels);
+
+	FScopeLock FrameStoreLock(&FrameStoreMutex);
+	FrameStore = MoveTemp(RawFrameStore);
+}
+
+void FNSGIFLoader::ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor)
 {
 	if (FrameIndex > GetTotalFrames() - 1)
 	{
 		FrameIndex = 0;
 	}
 
-	// Calculate the starting index of the desired frame in the TextureData array
-	int32 StartIndex = FrameIndex * GetWidth() * GetHeight();
+	// the visitor uploads the frame, it runs outside the lock so the decoder is never blocked by the render thread
+	TSharedPtr<IGIFFrameStore, ESPMode::ThreadSafe> CurrentFrameStore;
+	{
+		FScopeLock FrameStoreLock(&FrameStoreMutex);
+		CurrentFrameStore = FrameStore;
+	}
 
-	if (StartIndex >= 0 && StartIndex < TextureData.Num())
+	if (CurrentFrameStore.IsValid() && FrameIndex >= 0 && FrameIndex < CurrentFrameStore->GetTotalFrames())
 	{
-		return &TextureData[StartIndex];
+		CurrentFrameStore->ReadFrame(FrameIndex, Visitor);
 	}
 	else
 	{
 		// Handling the case where the index is out of bounds
-		return &FColor::Black; // return a default FColor value, like FColor::Black
+		Visitor(&FColor::Black);
 	}
 }
 
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GIFLoader.h"
+#include "GIFFrameStore.h"
 
 THIRD_PARTY_INCLUDES_START
 extern "C" {
@@ -28,7 +29,7 @@ public: /** Gif Data Method */
     FString GetDecodeError() const override;
 
 public: /** Get Next Frame Texture Data*/
-    const FColor* GetNextFrame(int32 FrameIndex) override;
+    void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) override;
 	const float GetNextFrameDelay(int32 FrameIndex) override;
 	bool DecodeGIF(TArray<uint8>&& GifBytes) override;
 
@@ -38,13 +39,16 @@ protected: /** Bitmap Callbacks Methods */
 	static void bitmap_destroy(void* bitmap);
 	
 	bool DecodeInternal(nsgif_t* gif, bool first);
+	void StoreFrame(int32 FrameIndex, const FColor* FramePixels);
 
 	void Warning(const char* context);
 
 private: /** Gif Data*/
 	nsgif_t* Gif;
 	const nsgif_info_t* Info;
-	TArray<FColor> TextureData;
+	/** Readers hold a reference while visiting a frame, so a store replaced meanwhile stays alive until they are done */
+	TSharedPtr<IGIFFrameStore, ESPMode::ThreadSafe> FrameStore;
+	FCriticalSection FrameStoreMutex;
 	TArray<float> Timestamps;
 
 	int32 Width = -1;
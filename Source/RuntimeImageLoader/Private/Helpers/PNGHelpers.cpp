@@ -23,4 +23,44 @@ namespace FPNGHelpers
             }
         }
     }
+
+    bool HasAlpha(const uint8* Buffer, int64 Length)
+    {
+        constexpr int64 SignatureSize = 8;
+        constexpr int64 ChunkHeaderSize = 8;
+        constexpr int64 ChunkCRCSize = 4;
+        constexpr uint8 ColorTypeAlphaMask = 4;
+
+        auto ReadUInt32 = [](const uint8* Data) { return ((uint32)Data[0] << 24) | ((uint32)Data[1] << 16) | ((uint32)Data[2] << 8) | (uint32)Data[3]; };
+
+        int64 Offset = SignatureSize;
+        while (Offset + ChunkHeaderSize <= Length)
+        {
+            const int64 ChunkSize = ReadUInt32(Buffer + Offset);
+            const uint8* ChunkType = Buffer + Offset + 4;
+            const uint8* ChunkData = Buffer + Offset + ChunkHeaderSize;
+
+            if (FMemory::Memcmp(ChunkType, "IHDR", 4) == 0)
+            {
+                // width, height, bit depth, color type
+                if (ChunkSize < 10 || Offset + ChunkHeaderSize + 10 > Length || (ChunkData[9] & ColorTypeAlphaMask) != 0)
+                {
+                    return true;
+                }
+            }
+            else if (FMemory::Memcmp(ChunkType, "tRNS", 4) == 0)
+            {
+                return true;
+            }
+            else if (FMemory::Memcmp(ChunkType, "IDAT", 4) == 0)
+            {
+                // transparency is always declared before the image data
+                return false;
+            }
+
+            Offset += ChunkHeaderSize + ChunkSize + ChunkCRCSize;
+        }
+
+        return true;
+    }
 }
\ No newline at end of file
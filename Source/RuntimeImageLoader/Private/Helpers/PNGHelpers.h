@@ -140,4 +140,7 @@ namespace FPNGHelpers
     };
 
     void FillZeroAlphaPNGData(int32 SizeX, int32 SizeY, ETextureSourceFormat SourceFormat, uint8* SourceData);
+
+    /** Reads the PNG header chunks: true when the color type has alpha or a tRNS chunk adds transparency */
+    bool HasAlpha(const uint8* Buffer, int64 Length);
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "PNGScanlineDecoder.h"
+#include "StreamingResampler.h"
+#include "Misc/ScopeExit.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPNGScanlineDecoder, Log, All);
+
+#if WITH_LIBPNG
+
+THIRD_PARTY_INCLUDES_START
+#include "png.h"
+THIRD_PARTY_INCLUDES_END
+
+namespace
+{
+    struct FPNGReadContext
+    {
+        const uint8* Data = nullptr;
+        int64 Length = 0;
+        int64 Offset = 0;
+    };
+
+    struct FPNGHeader
+    {
+        png_uint_32 Width = 0;
+        png_uint_32 Height = 0;
+        int BitDepth = 0;
+        int ColorType = 0;
+        int InterlaceType = 0;
+        bool bHasTransparency = false;
+    };
+
+    void ReadData(png_structp Png, png_bytep OutBytes, png_size_t Count)
+    {
+        FPNGReadContext* Context = (FPNGReadContext*)png_get_io_ptr(Png);
+        if (Context->Offset + (int64)Count > Context->Length)
+        {
+            png_error(Png, "Read past the end of the PNG data");
+        }
+
+        FMemory::Memcpy(OutBytes, Context->Data + Context->Offset, Count);
+        Context->Offset += Count;
+    }
+
+    void OnError(png_structp Png, png_const_charp Message)
+    {
+        UE_LOG(LogPNGScanlineDecoder, Warning, TEXT("%s"), ANSI_TO_TCHAR(Message));
+        longjmp(png_jmpbuf(Png), 1);
+    }
+
+    void OnWarning(png_structp Png, png_const_charp Message)
+    {
+        UE_LOG(LogPNGScanlineDecoder, Verbose, TEXT("%s"), ANSI_TO_TCHAR(Message));
+    }
+
+    // libpng reports errors with longjmp, functions calling setjmp keep only trivially destructible locals
+
+    bool ReadHeader(png_structp Png, png_infop Info, FPNGHeader& OutHeader)
+    {
+        if (setjmp(png_jmpbuf(Png)))
+        {
+            return false;
+        }
+
+        png_read_info(Png, Info);
+        png_get_IHDR(Png, Info, &OutHeader.Width, &OutHeader.Height, &OutHeader.BitDepth, &OutHeader.ColorType, &OutHeader.InterlaceType, nullptr, nullptr);
+        OutHeader.bHasTransparency = png_get_valid(Png, Info, PNG_INFO_tRNS) != 0;
+
+        return true;
+    }
+
+    bool SetupTransforms(png_structp Png, png_infop Info, const FPNGHeader& Header, int32 NumChannels)
+    {
+        if (setjmp(png_jmpbuf(Png)))
+        {
+            return false;
+        }
+
+        if (NumChannels == 1)
+        {
+            if (Header.BitDepth < 8)
+            {
+                png_set_expand_gray_1_2_4_to_8(Png);
+            }
+        }
+        else
+        {
+            png_set_expand(Png);
+            if (Header.ColorType == PNG_COLOR_TYPE_GRAY || Header.ColorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+            {
+                png_set_gray_to_rgb(Png);
+            }
+            if (!(Header.ColorType & PNG_COLOR_MASK_ALPHA) && !Header.bHasTransparency)
+            {
+                png_set_filler(Png, 0xFF, PNG_FILLER_AFTER);
+            }
+            png_set_bgr(Png);
+        }
+
+        png_read_update_info(Png, Info);
+
+        return true;
+    }
+
+    bool ReadRows(png_structp Png, uint8* RowBuffer, png_uint_32 NumRows, FStreamingAreaResampler& Resampler)
+    {
+        if (setjmp(png_jmpbuf(Png)))
+        {
+            return false;
+        }
+
+        for (png_uint_32 Row = 0; Row < NumRows; ++Row)
+        {
+            png_read_row(Png, RowBuffer, nullptr);
+            Resampler.AddRow(RowBuffer);
+        }
+
+        return true;
+    }
+}
+
+namespace FPNGScanlineDecoder
+{
+    bool DecodeDownscaled(const uint8* Buffer, int64 Length, int32 PercentSizeX, int32 PercentSizeY, FRuntimeImageData& OutImage, FString& OutError)
+    {
+        if (Length < 8 || png_sig_cmp(Buffer, 0, 8) != 0)
+        {
+            return false;
+        }
+
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Decode);
+
+        png_structp Png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, OnError, OnWarning);
+        png_infop Info = Png ? png_create_info_struct(Png) : nullptr;
+        if (!Info)
+        {
+            png_destroy_read_struct(&Png, nullptr, nullptr);
+            return false;
+        }
+
+        ON_SCOPE_EXIT
+        {
+            png_destroy_read_struct(&Png, &Info, nullptr);
+        };
+
+        FPNGReadContext ReadContext;
+        ReadContext.Data = Buffer;
+        ReadContext.Length = Length;
+        png_set_read_fn(Png, &ReadContext, ReadData);
+
+        FPNGHeader Header;
+        if (!ReadHeader(Png, Info, Header))
+        {
+            OutError = TEXT("Failed to read PNG header");
+            return false;
+        }
+
+        // interlaced rows arrive in passes and 16 bit is kept as RGBA16 by the regular decode
+        if (Header.InterlaceType != PNG_INTERLACE_NONE || Header.BitDepth > 8)
+        {
+            return false;
+        }
+
+        // from here on the image is decoded, until now it was only the header
+        FScopedDecodeStat DecodeStat(EImageDecodeStatFormat::PNG);
+
+        const bool bGrayscale = Header.ColorType == PNG_COLOR_TYPE_GRAY && !Header.bHasTransparency;
+        const int32 NumChannels = bGrayscale ? 1 : 4;
+
+        const int32 DestSizeX = FMath::Max(1, (int32)FMath::Floor(Header.Width * PercentSizeX * 0.01f));
+        const int32 DestSizeY = FMath::Max(1, (int32)FMath::Floor(Header.Height * PercentSizeY * 0.01f));
+
+        if (!SetupTransforms(Png, Info, Header, NumChannels) || png_get_rowbytes(Png, Info) != (png_size_t)Header.Width * NumChannels)
+        {
+            OutError = TEXT("Failed to set up PNG row decoding");
+            return false;
+        }
+
+        OutImage.Init2D(DestSizeX, DestSizeY, bGrayscale ? TSF_G8 : TSF_BGRA8);
+        OutImage.SRGB = true;
+        OutImage.GammaSpace = EGammaSpace::sRGB;
+
+        TArray<uint8> RowBuffer;
+        RowBuffer.SetNumUninitialized(Header.Width * NumChannels);
+
+        FStreamingAreaResampler Resampler(Header.Width, Header.Height, NumChannels, OutImage);
+        if (!ReadRows(Png, RowBuffer.GetData(), Header.Height, Resampler))
+        {
+            OutError = TEXT("Failed to decode PNG rows");
+            return false;
+        }
+
+        check(Resampler.IsComplete());
+        FRuntimeImageLoaderCounters::AddBytesDecoded(OutImage.RawData.Num());
+
+        UE_LOG(LogPNGScanlineDecoder, Verbose, TEXT("Streamed %u x %u PNG into %d x %d"), Header.Width, Header.Height, DestSizeX, DestSizeY);
+
+        return true;
+    }
+}
+
+#else
+
+namespace FPNGScanlineDecoder
+{
+    bool DecodeDownscaled(const uint8* Buffer, int64 Length, int32 PercentSizeX, int32 PercentSizeY, FRuntimeImageData& OutImage, FString& OutError)
+    {
+        return false;
+    }
+}
+
+#endif // WITH_LIBPNG
@@ -0,0 +1,18 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RuntimeImageData.h"
+
+namespace FPNGScanlineDecoder
+{
+    /**
+     * Decodes a PNG row by row straight into a FStreamingAreaResampler, the full resolution image is never in memory.
+     * Output is G8 for grayscale and BGRA8 for everything else, sized like URuntimeImageReader::ApplySizeFormatTransformations would.
+     *
+     * Returns false with an empty OutError when the data can't be streamed (not a PNG, interlaced, 16 bit),
+     * the caller should then decode it as usual.
+     */
+    bool DecodeDownscaled(const uint8* Buffer, int64 Length, int32 PercentSizeX, int32 PercentSizeY, FRuntimeImageData& OutImage, FString& OutError);
+}
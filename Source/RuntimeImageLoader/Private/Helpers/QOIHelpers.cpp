@@ -6,6 +6,9 @@
 
 #include "qoi.h"
 
+// RawData and the conversion loop use 32-bit sizes, which qoi_decode keeps valid by rejecting larger images
+static_assert((uint64)QOI_PIXELS_MAX * 4 <= (uint64)MAX_int32, "QOI decoded size must fit in int32");
+
 bool FQOILoader::IsValidImage(const uint8* Buffer, uint32 Length) const
 {
     if (Buffer == nullptr || 
@@ -0,0 +1,507 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RequestCapture.h"
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Hash/CityHash.h"
+#include "HttpPath.h"
+#include "HttpServerModule.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+#include "IHttpRouter.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "RuntimeImageLoader.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageCapture, Log, All);
+
+namespace
+{
+    TSharedRef<FJsonObject> ParamsToJson(const FTransformImageParams& Params)
+    {
+        TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+        Json->SetBoolField(TEXT("forUI"), Params.bForUI);
+        Json->SetNumberField(TEXT("filter"), Params.FilterMode.GetValue());
+        Json->SetNumberField(TEXT("percentX"), Params.PercentSizeX);
+        Json->SetNumberField(TEXT("percentY"), Params.PercentSizeY);
+        Json->SetBoolField(TEXT("autoPixelFormat"), Params.bAutoPixelFormat);
+        Json->SetBoolField(TEXT("statistics"), Params.bComputeStatistics);
+        Json->SetBoolField(TEXT("onlyPixels"), Params.bOnlyPixels);
+        Json->SetBoolField(TEXT("nativeImageData"), Params.bNativeImageData);
+        return Json;
+    }
+
+    FTransformImageParams ParamsFromJson(const FJsonObject& Json)
+    {
+        FTransformImageParams Params;
+        Json.TryGetBoolField(TEXT("forUI"), Params.bForUI);
+        Json.TryGetNumberField(TEXT("percentX"), Params.PercentSizeX);
+        Json.TryGetNumberField(TEXT("percentY"), Params.PercentSizeY);
+        Json.TryGetBoolField(TEXT("autoPixelFormat"), Params.bAutoPixelFormat);
+        Json.TryGetBoolField(TEXT("statistics"), Params.bComputeStatistics);
+        Json.TryGetBoolField(TEXT("onlyPixels"), Params.bOnlyPixels);
+        Json.TryGetBoolField(TEXT("nativeImageData"), Params.bNativeImageData);
+
+        int32 FilterMode = 0;
+        if (Json.TryGetNumberField(TEXT("filter"), FilterMode) && FilterMode >= 0 && FilterMode < TextureFilter::TF_MAX)
+        {
+            Params.FilterMode = (TextureFilter)FilterMode;
+        }
+
+        return Params;
+    }
+
+    bool IsHttpUri(const FString& Uri)
+    {
+        return Uri.StartsWith(TEXT("http://")) || Uri.StartsWith(TEXT("https://"));
+    }
+
+    /** Path and query of a URL, "/" when it has none */
+    FString GetUrlPath(const FString& Url)
+    {
+        const int32 HostStart = Url.Find(TEXT("://")) + 3;
+        const int32 PathStart = Url.Find(TEXT("/"), ESearchCase::CaseSensitive, ESearchDir::FromStart, HostStart);
+        return PathStart != INDEX_NONE ? Url.Mid(PathStart) : FString(TEXT("/"));
+    }
+
+    double GetPercentile(const TArray<double>& SortedValues, double Percentile)
+    {
+        if (SortedValues.Num() == 0)
+        {
+            return 0.0;
+        }
+
+        const int32 Index = FMath::Clamp(FMath::CeilToInt(Percentile * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1);
+        return SortedValues[Index];
+    }
+}
+
+FString FRequestCapture::GetBytesFilename(const FString& CaptureDirectory, const FString& BytesHash)
+{
+    return CaptureDirectory / BytesDirectory / BytesHash + TEXT(".bin");
+}
+
+bool FRequestCapture::Load(const FString& CaptureDirectory, TArray<FRecordedImageRequest>& OutRequests, FString& OutError)
+{
+    TArray<FString> Lines;
+    if (!FFileHelper::LoadFileToStringArray(Lines, *(CaptureDirectory / RequestsFilename)))
+    {
+        OutError = FString::Printf(TEXT("Failed to read %s"), *(CaptureDirectory / RequestsFilename));
+        return false;
+    }
+
+    OutRequests.Reset(Lines.Num());
+    for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+    {
+        if (Lines[LineIndex].TrimStartAndEnd().IsEmpty())
+        {
+            continue;
+        }
+
+        TSharedPtr<FJsonObject> Json;
+        if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Lines[LineIndex]), Json) || !Json.IsValid())
+        {
+            OutError = FString::Printf(TEXT("Malformed capture line %d"), LineIndex + 1);
+            return false;
+        }
+
+        FRecordedImageRequest& Request = OutRequests.AddDefaulted_GetRef();
+        Request.Time = Json->GetNumberField(TEXT("t"));
+        Request.Op = Json->GetStringField(TEXT("op")) == TEXT("cancelAll") ? ERecordedRequestOp::CancelAll : ERecordedRequestOp::Load;
+        Json->TryGetStringField(TEXT("uri"), Request.Uri);
+        Json->TryGetStringField(TEXT("hash"), Request.BytesHash);
+        Json->TryGetNumberField(TEXT("size"), Request.NumBytes);
+
+        const TSharedPtr<FJsonObject>* Params = nullptr;
+        if (Json->TryGetObjectField(TEXT("params"), Params))
+        {
+            Request.TransformParams = ParamsFromJson(**Params);
+        }
+    }
+
+    return true;
+}
+
+FRequestRecorder::~FRequestRecorder()
+{
+    Stop();
+}
+
+bool FRequestRecorder::Start(const FString& InCaptureDirectory, FString& OutError)
+{
+    check(IsInGameThread());
+    check(!Writer.IsValid());
+
+    IFileManager::Get().MakeDirectory(*(InCaptureDirectory / FRequestCapture::BytesDirectory), true);
+
+    // appending keeps one capture across sessions, times restart at zero with every recording
+    Writer.Reset(IFileManager::Get().CreateFileWriter(*(InCaptureDirectory / FRequestCapture::RequestsFilename), FILEWRITE_Append | FILEWRITE_AllowRead));
+    if (!Writer.IsValid())
+    {
+        OutError = FString::Printf(TEXT("Failed to create a capture in %s"), *InCaptureDirectory);
+        return false;
+    }
+
+    CaptureDirectory = InCaptureDirectory;
+    StartTime = FPlatformTime::Seconds();
+    NumRecorded = 0;
+    SavedHashes.Reset();
+
+    UE_LOG(LogRuntimeImageCapture, Log, TEXT("Recording image requests to %s"), *CaptureDirectory);
+    return true;
+}
+
+void FRequestRecorder::Stop()
+{
+    if (Writer.IsValid())
+    {
+        Writer->Close();
+        Writer.Reset();
+
+        UE_LOG(LogRuntimeImageCapture, Log, TEXT("Recorded %d image requests to %s"), NumRecorded, *CaptureDirectory);
+    }
+}
+
+void FRequestRecorder::RecordLoad(const FImageReadRequest& Request)
+{
+    check(IsInGameThread());
+
+    if (!Writer.IsValid())
+    {
+        return;
+    }
+
+    FRecordedImageRequest Recorded;
+    Recorded.Time = FPlatformTime::Seconds() - StartTime;
+    Recorded.Op = ERecordedRequestOp::Load;
+    Recorded.Uri = Request.InputImage.ImageFilename;
+    Recorded.TransformParams = Request.TransformParams;
+
+    const TArray<uint8>& ImageBytes = Request.InputImage.ImageBytes;
+    if (Recorded.Uri.IsEmpty() && ImageBytes.Num() > 0)
+    {
+        // recording runs on the game thread, a cheap hash plus the size is enough to tell captured contents apart
+        const uint64 Hash = CityHash64((const char*)ImageBytes.GetData(), ImageBytes.Num());
+
+        Recorded.BytesHash = FString::Printf(TEXT("%016llx-%d"), Hash, ImageBytes.Num());
+        Recorded.NumBytes = ImageBytes.Num();
+
+        // bursts of byte requests often repeat the same content, each is written once and off the game thread
+        if (!SavedHashes.Contains(Recorded.BytesHash))
+        {
+            SavedHashes.Add(Recorded.BytesHash);
+
+            AsyncTask(
+                ENamedThreads::AnyBackgroundThreadNormalTask,
+                [BytesFilename = FRequestCapture::GetBytesFilename(CaptureDirectory, Recorded.BytesHash), Bytes = ImageBytes]()
+                {
+                    if (!IFileManager::Get().FileExists(*BytesFilename))
+                    {
+                        FFileHelper::SaveArrayToFile(Bytes, *BytesFilename);
+                    }
+                }
+            );
+        }
+    }
+
+    WriteLine(Recorded);
+}
+
+void FRequestRecorder::RecordCancelAll()
+{
+    check(IsInGameThread());
+
+    if (Writer.IsValid())
+    {
+        FRecordedImageRequest Recorded;
+        Recorded.Time = FPlatformTime::Seconds() - StartTime;
+        Recorded.Op = ERecordedRequestOp::CancelAll;
+
+        WriteLine(Recorded);
+    }
+}
+
+void FRequestRecorder::WriteLine(const FRecordedImageRequest& Request)
+{
+    TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+    Json->SetNumberField(TEXT("t"), Request.Time);
+    Json->SetStringField(TEXT("op"), Request.Op == ERecordedRequestOp::CancelAll ? TEXT("cancelAll") : TEXT("load"));
+
+    if (Request.Op == ERecordedRequestOp::Load)
+    {
+        if (Request.BytesHash.IsEmpty())
+        {
+            Json->SetStringField(TEXT("uri"), Request.Uri);
+        }
+        else
+        {
+            Json->SetStringField(TEXT("hash"), Request.BytesHash);
+            Json->SetNumberField(TEXT("size"), Request.NumBytes);
+        }
+        Json->SetObjectField(TEXT("params"), ParamsToJson(Request.TransformParams));
+    }
+
+    FString Line;
+    FJsonSerializer::Serialize(Json, TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Line));
+    Line += TEXT("\n");
+
+    FTCHARToUTF8 Utf8Line(*Line);
+    Writer->Serialize((void*)Utf8Line.Get(), Utf8Line.Length());
+
+    // a crash or a killed process still leaves everything up to the last request
+    Writer->Flush();
+    ++NumRecorded;
+}
+
+FRequestReplay::~FRequestReplay()
+{
+    StopHttpStandIn();
+}
+
+bool FRequestReplay::Start(const FString& InCaptureDirectory, const FString& HttpRoot, uint32 HttpPort, float InSpeed, FString& OutError)
+{
+    check(IsInGameThread());
+
+    if (!FRequestCapture::Load(InCaptureDirectory, Recorded, OutError))
+    {
+        return false;
+    }
+
+    // byte contents are loaded up front, reading them must not count towards latency
+    bool bHasHttpRequests = false;
+    for (const FRecordedImageRequest& Request : Recorded)
+    {
+        bHasHttpRequests |= IsHttpUri(Request.Uri);
+
+        if (!Request.BytesHash.IsEmpty() && !BytesByHash.Contains(Request.BytesHash))
+        {
+            TArray<uint8>& Bytes = BytesByHash.Add(Request.BytesHash);
+            if (!FFileHelper::LoadFileToArray(Bytes, *FRequestCapture::GetBytesFilename(InCaptureDirectory, Request.BytesHash)))
+            {
+                OutError = FString::Printf(TEXT("Capture is missing the content of byte request %s"), *Request.BytesHash);
+                return false;
+            }
+        }
+    }
+
+    if (bHasHttpRequests && !StartHttpStandIn(HttpRoot.IsEmpty() ? InCaptureDirectory / FRequestCapture::HttpDirectory : HttpRoot, HttpPort, OutError))
+    {
+        return false;
+    }
+
+    CaptureDirectory = InCaptureDirectory;
+    Speed = InSpeed > 0.0f ? InSpeed : 1.0f;
+    StartTime = FPlatformTime::Seconds();
+
+    UE_LOG(LogRuntimeImageCapture, Log, TEXT("Replaying %d image requests from %s at %.2fx"), Recorded.Num(), *CaptureDirectory, Speed);
+    return true;
+}
+
+void FRequestReplay::Tick(URuntimeImageLoader& Loader)
+{
+    const double Now = FPlatformTime::Seconds();
+
+    while (NextRecordedIndex < Recorded.Num() && Recorded[NextRecordedIndex].Time / Speed <= Now - StartTime)
+    {
+        const FRecordedImageRequest& Request = Recorded[NextRecordedIndex++];
+
+        if (Request.Op == ERecordedRequestOp::CancelAll)
+        {
+            // cancelled requests never call back
+            for (FIssuedRequest& IssuedRequest : Issued)
+            {
+                IssuedRequest.bCancelled |= IssuedRequest.bPending;
+                IssuedRequest.bPending = false;
+            }
+            NumPending = 0;
+
+            Loader.CancelAll();
+            continue;
+        }
+
+        FIssuedRequest& IssuedRequest = Issued.AddDefaulted_GetRef();
+        IssuedRequest.IssueTime = Now;
+        IssuedRequest.bPending = true;
+        ++NumPending;
+
+        FInputImageDescription InputImage;
+        if (!Request.BytesHash.IsEmpty())
+        {
+            IssuedRequest.Source = ESource::Bytes;
+            InputImage.ImageBytes = BytesByHash.FindChecked(Request.BytesHash);
+        }
+        else if (IsHttpUri(Request.Uri))
+        {
+            IssuedRequest.Source = ESource::Http;
+            InputImage.ImageFilename = HttpBaseUrl + GetUrlPath(Request.Uri);
+        }
+        else
+        {
+            IssuedRequest.Source = ESource::File;
+            InputImage.ImageFilename = Request.Uri;
+        }
+
+        FOnRequestCompleted OnCompleted;
+        OnCompleted.BindSP(this, &FRequestReplay::OnRequestCompleted, Issued.Num() - 1);
+
+        Loader.LoadImage(InputImage, Request.TransformParams, MoveTemp(OnCompleted));
+    }
+
+    if (IsFinished() && !bReported)
+    {
+        Report();
+        StopHttpStandIn();
+    }
+}
+
+bool FRequestReplay::IsFinished() const
+{
+    return NextRecordedIndex >= Recorded.Num() && NumPending == 0;
+}
+
+bool FRequestReplay::StartHttpStandIn(const FString& HttpRoot, uint32 HttpPort, FString& OutError)
+{
+    HttpRouter = FHttpServerModule::Get().GetHttpRouter(HttpPort);
+    if (!HttpRouter.IsValid())
+    {
+        OutError = FString::Printf(TEXT("Failed to listen on port %u for the HTTP stand-in"), HttpPort);
+        return false;
+    }
+
+    const FString RootDirectory = FPaths::ConvertRelativePathToFull(HttpRoot);
+    auto ServeFile = [RootDirectory](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+    {
+        FString Filename = RootDirectory / Request.RelativePath.GetPath();
+        FPaths::CollapseRelativeDirectories(Filename);
+
+        TArray<uint8> FileData;
+        if (!FPaths::IsUnderDirectory(Filename, RootDirectory) || !FFileHelper::LoadFileToArray(FileData, *Filename, FILEREAD_Silent))
+        {
+            OnComplete(FHttpServerResponse::Error(EHttpServerResponseCodes::NotFound));
+            return true;
+        }
+
+        OnComplete(FHttpServerResponse::Create(MoveTemp(FileData), TEXT("application/octet-stream")));
+        return true;
+    };
+
+#if (ENGINE_MAJOR_VERSION >= 5) && (ENGINE_MINOR_VERSION > 3)
+    HttpRouteHandle = HttpRouter->BindRoute(FHttpPath(TEXT("/")), EHttpServerRequestVerbs::VERB_GET, FHttpRequestHandler::CreateLambda(MoveTemp(ServeFile)));
+#else
+    HttpRouteHandle = HttpRouter->BindRoute(FHttpPath(TEXT("/")), EHttpServerRequestVerbs::VERB_GET, MoveTemp(ServeFile));
+#endif
+
+    if (!HttpRouteHandle.IsValid())
+    {
+        OutError = FString::Printf(TEXT("Port %u is already routed by someone else"), HttpPort);
+        return false;
+    }
+
+    FHttpServerModule::Get().StartAllListeners();
+
+    HttpBaseUrl = FString::Printf(TEXT("http://127.0.0.1:%u"), HttpPort);
+
+    UE_LOG(LogRuntimeImageCapture, Log, TEXT("Serving %s at %s for replayed URLs"), *RootDirectory, *HttpBaseUrl);
+    return true;
+}
+
+void FRequestReplay::StopHttpStandIn()
+{
+    if (HttpRouter.IsValid() && HttpRouteHandle.IsValid())
+    {
+        HttpRouter->UnbindRoute(HttpRouteHandle);
+    }
+
+    HttpRouteHandle.Reset();
+    HttpRouter.Reset();
+}
+
+void FRequestReplay::OnRequestCompleted(const FImageReadResult& ReadResult, int32 IssuedIndex)
+{
+    FIssuedRequest& IssuedRequest = Issued[IssuedIndex];
+    if (!IssuedRequest.bPending)
+    {
+        return;
+    }
+
+    IssuedRequest.LatencyMs = (FPlatformTime::Seconds() - IssuedRequest.IssueTime) * 1000.0;
+    IssuedRequest.bSucceeded = ReadResult.OutError.IsEmpty();
+    IssuedRequest.bPending = false;
+    --NumPending;
+}
+
+void FRequestReplay::Report()
+{
+    bReported = true;
+
+    static const TCHAR* SourceNames[] = { TEXT("file"), TEXT("http"), TEXT("bytes"), TEXT("all") };
+
+    TArray<TSharedPtr<FJsonValue>> Results;
+    for (int32 SourceIndex = 0; SourceIndex <= (int32)ESource::Num; ++SourceIndex)
+    {
+        TArray<double> Latencies;
+        int32 NumRequests = 0;
+        int32 NumFailed = 0;
+        int32 NumCancelled = 0;
+
+        for (const FIssuedRequest& IssuedRequest : Issued)
+        {
+            if (SourceIndex != (int32)ESource::Num && IssuedRequest.Source != (ESource)SourceIndex)
+            {
+                continue;
+            }
+
+            ++NumRequests;
+            NumCancelled += IssuedRequest.bCancelled ? 1 : 0;
+            NumFailed += !IssuedRequest.bCancelled && !IssuedRequest.bSucceeded ? 1 : 0;
+
+            if (IssuedRequest.LatencyMs >= 0.0)
+            {
+                Latencies.Add(IssuedRequest.LatencyMs);
+            }
+        }
+
+        if (NumRequests == 0)
+        {
+            continue;
+        }
+
+        Latencies.Sort();
+
+        TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+        Result->SetStringField(TEXT("source"), SourceNames[SourceIndex]);
+        Result->SetNumberField(TEXT("requests"), NumRequests);
+        Result->SetNumberField(TEXT("failed"), NumFailed);
+        Result->SetNumberField(TEXT("cancelled"), NumCancelled);
+        Result->SetNumberField(TEXT("p50Ms"), GetPercentile(Latencies, 0.5));
+        Result->SetNumberField(TEXT("p90Ms"), GetPercentile(Latencies, 0.9));
+        Result->SetNumberField(TEXT("p99Ms"), GetPercentile(Latencies, 0.99));
+        Result->SetNumberField(TEXT("maxMs"), Latencies.Num() > 0 ? Latencies.Last() : 0.0);
+        Results.Add(MakeShared<FJsonValueObject>(Result));
+
+        UE_LOG(
+            LogRuntimeImageCapture, Display, TEXT("Replay %-5s %5d requests, %4d failed, %4d cancelled: p50 %8.2f ms, p90 %8.2f ms, p99 %8.2f ms, max %8.2f ms"),
+            SourceNames[SourceIndex], NumRequests, NumFailed, NumCancelled,
+            GetPercentile(Latencies, 0.5), GetPercentile(Latencies, 0.9), GetPercentile(Latencies, 0.99), Latencies.Num() > 0 ? Latencies.Last() : 0.0
+        );
+    }
+
+    TSharedRef<FJsonObject> ReportJson = MakeShared<FJsonObject>();
+    ReportJson->SetStringField(TEXT("capture"), CaptureDirectory);
+    ReportJson->SetNumberField(TEXT("speed"), Speed);
+    ReportJson->SetNumberField(TEXT("durationSeconds"), FPlatformTime::Seconds() - StartTime);
+    ReportJson->SetArrayField(TEXT("results"), Results);
+
+    const FString ReportFilename = CaptureDirectory / FString::Printf(TEXT("replay-%s.json"), *FDateTime::Now().ToString());
+
+    FString ReportText;
+    if (FJsonSerializer::Serialize(ReportJson, TJsonWriterFactory<>::Create(&ReportText)) && FFileHelper::SaveStringToFile(ReportText, *ReportFilename))
+    {
+        UE_LOG(LogRuntimeImageCapture, Display, TEXT("Replay report written to %s"), *ReportFilename);
+    }
+}
@@ -0,0 +1,134 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HttpRouteHandle.h"
+#include "RuntimeImageReader.h"
+
+class IHttpRouter;
+class URuntimeImageLoader;
+
+enum class ERecordedRequestOp : uint8
+{
+    Load,
+    CancelAll
+};
+
+/** One line of a capture. Byte requests keep the hash of their content, the bytes themselves are stored next to the log */
+struct FRecordedImageRequest
+{
+    /** Seconds since the recording started */
+    double Time = 0.0;
+    ERecordedRequestOp Op = ERecordedRequestOp::Load;
+
+    /** File path or URL, empty for byte requests */
+    FString Uri;
+    FString BytesHash;
+    int64 NumBytes = 0;
+
+    FTransformImageParams TransformParams;
+};
+
+/**
+ * Capture layout: requests.jsonl with one JSON object per request or cancellation in the order they happened,
+ * bytes/<sha1>.bin with the content of byte requests and, by convention, http/ with the files served for URLs during replay
+ */
+namespace FRequestCapture
+{
+    constexpr const TCHAR* RequestsFilename = TEXT("requests.jsonl");
+    constexpr const TCHAR* BytesDirectory = TEXT("bytes");
+    constexpr const TCHAR* HttpDirectory = TEXT("http");
+
+    FString GetBytesFilename(const FString& CaptureDirectory, const FString& BytesHash);
+
+    bool Load(const FString& CaptureDirectory, TArray<FRecordedImageRequest>& OutRequests, FString& OutError);
+}
+
+/** Appends requests queued on URuntimeImageLoader to a capture, game thread only */
+class FRequestRecorder
+{
+public:
+    ~FRequestRecorder();
+
+    bool Start(const FString& InCaptureDirectory, FString& OutError);
+    void Stop();
+
+    void RecordLoad(const FImageReadRequest& Request);
+    void RecordCancelAll();
+
+    const FString& GetCaptureDirectory() const { return CaptureDirectory; }
+    int32 GetNumRecorded() const { return NumRecorded; }
+
+private:
+    void WriteLine(const FRecordedImageRequest& Request);
+
+private:
+    TUniquePtr<FArchive> Writer;
+    FString CaptureDirectory;
+    double StartTime = 0.0;
+    int32 NumRecorded = 0;
+
+    /** Byte contents already handed to a background write */
+    TSet<FString> SavedHashes;
+};
+
+/**
+ * Drives URuntimeImageLoader with a capture at the recorded timing (scaled by Speed) and reports latency percentiles,
+ * measured from queuing to the completion callback. URLs are redirected to a local HTTP listener serving HttpRoot,
+ * the path of a URL maps to a file under HttpRoot. Files are loaded from their recorded paths
+ */
+class FRequestReplay : public TSharedFromThis<FRequestReplay>
+{
+public:
+    ~FRequestReplay();
+
+    bool Start(const FString& InCaptureDirectory, const FString& HttpRoot, uint32 HttpPort, float InSpeed, FString& OutError);
+
+    /** Issues due requests, called by the loader before it takes the next one from its queue */
+    void Tick(URuntimeImageLoader& Loader);
+
+    bool IsFinished() const;
+
+private:
+    enum class ESource : uint8
+    {
+        File,
+        Http,
+        Bytes,
+        Num
+    };
+
+    struct FIssuedRequest
+    {
+        ESource Source = ESource::File;
+        double IssueTime = 0.0;
+        double LatencyMs = -1.0;
+        bool bPending = false;
+        bool bSucceeded = false;
+        bool bCancelled = false;
+    };
+
+    bool StartHttpStandIn(const FString& HttpRoot, uint32 HttpPort, FString& OutError);
+    void StopHttpStandIn();
+
+    void OnRequestCompleted(const FImageReadResult& ReadResult, int32 IssuedIndex);
+    void Report();
+
+private:
+    FString CaptureDirectory;
+    TArray<FRecordedImageRequest> Recorded;
+    TMap<FString, TArray<uint8>> BytesByHash;
+
+    TArray<FIssuedRequest> Issued;
+    int32 NextRecordedIndex = 0;
+    int32 NumPending = 0;
+
+    double StartTime = 0.0;
+    float Speed = 1.0f;
+    bool bReported = false;
+
+    FString HttpBaseUrl;
+    TSharedPtr<IHttpRouter> HttpRouter;
+    FHttpRouteHandle HttpRouteHandle;
+};
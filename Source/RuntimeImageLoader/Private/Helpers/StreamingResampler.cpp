@@ -0,0 +1,151 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "StreamingResampler.h"
+
+FStreamingAreaResampler::FStreamingAreaResampler(int32 InSourceSizeX, int32 InSourceSizeY, int32 InNumChannels, FImage& OutImage)
+    : DestImage(OutImage)
+    , SourceSizeX(InSourceSizeX)
+    , SourceSizeY(InSourceSizeY)
+    , NumChannels(InNumChannels)
+{
+    check(NumChannels == 1 || NumChannels == 4);
+    check(DestImage.SizeX > 0 && DestImage.SizeX <= SourceSizeX && DestImage.SizeY > 0 && DestImage.SizeY <= SourceSizeY);
+
+    ScaleX = (double)SourceSizeX / DestImage.SizeX;
+    ScaleY = (double)SourceSizeY / DestImage.SizeY;
+
+    // boundaries are compared in integers scaled by the output size, so they are exact
+    ColumnSpans.SetNum(SourceSizeX);
+    for (int32 X = 0; X < SourceSizeX; ++X)
+    {
+        FColumnSpan& Span = ColumnSpans[X];
+        Span.DestX = (int32)FMath::Min((int64)X * DestImage.SizeX / SourceSizeX, (int64)DestImage.SizeX - 1);
+
+        const int64 DestColumnEndScaled = (int64)(Span.DestX + 1) * SourceSizeX;
+        const int64 ColumnStartScaled = (int64)X * DestImage.SizeX;
+        Span.Weight0 = (Span.DestX + 1 < DestImage.SizeX) ? (float)FMath::Min(1., (double)(DestColumnEndScaled - ColumnStartScaled) / DestImage.SizeX) : 1.f;
+    }
+
+    for (TArray<float>& Accumulator : Accumulators)
+    {
+        Accumulator.SetNumZeroed(DestImage.SizeX * NumChannels);
+    }
+}
+
+void FStreamingAreaResampler::AddRow(const uint8* SourceRow)
+{
+    check(!IsComplete());
+
+    const int32 SourceRow0 = NextSourceRow++;
+    const bool bLastSourceRow = NextSourceRow == SourceSizeY;
+
+    // source row [SourceRow0, SourceRow0 + 1) and output row [DestRow * ScaleY, (DestRow + 1) * ScaleY), both times the output height
+    const int64 RowStartScaled = (int64)SourceRow0 * DestImage.SizeY;
+    const int64 RowEndScaled = RowStartScaled + DestImage.SizeY;
+
+    // flushed rows are never revisited, a row is flushed exactly once
+    for (int32 DestRow = NextDestRowToFlush; DestRow < DestImage.SizeY; ++DestRow)
+    {
+        const int64 DestRowStartScaled = (int64)DestRow * SourceSizeY;
+        const int64 DestRowEndScaled = DestRowStartScaled + SourceSizeY;
+
+        if (DestRowStartScaled >= RowEndScaled)
+        {
+            break;
+        }
+
+        TArray<float>& Accumulator = Accumulators[DestRow & 1];
+
+        const int64 OverlapScaled = FMath::Min(RowEndScaled, DestRowEndScaled) - FMath::Max(RowStartScaled, DestRowStartScaled);
+        if (OverlapScaled > 0)
+        {
+            AccumulateRow(SourceRow, (float)((double)OverlapScaled / DestImage.SizeY), Accumulator);
+        }
+
+        // the output row is complete once the source passed its end, the last source row completes everything
+        if (DestRowEndScaled > RowEndScaled && !bLastSourceRow)
+        {
+            break;
+        }
+
+        FlushRow(DestRow, Accumulator);
+        NextDestRowToFlush = DestRow + 1;
+    }
+}
+
+void FStreamingAreaResampler::AccumulateRow(const uint8* SourceRow, float WeightY, TArray<float>& Accumulator) const
+{
+    float* Accum = Accumulator.GetData();
+
+    if (NumChannels == 4)
+    {
+        for (int32 X = 0; X < SourceSizeX; ++X)
+        {
+            const uint8* Pixel = SourceRow + X * 4;
+            const float Alpha = Pixel[3] * WeightY;
+            if (Alpha == 0.f)
+            {
+                continue;
+            }
+
+            const FColumnSpan& Span = ColumnSpans[X];
+            const float Weights[2] = { Alpha * Span.Weight0, Alpha * (1.f - Span.Weight0) };
+
+            for (int32 Side = 0; Side < 2 && Weights[Side] > 0.f; ++Side)
+            {
+                float* Dest = Accum + (Span.DestX + Side) * 4;
+                Dest[0] += Pixel[0] * Weights[Side];
+                Dest[1] += Pixel[1] * Weights[Side];
+                Dest[2] += Pixel[2] * Weights[Side];
+                Dest[3] += Weights[Side];
+            }
+        }
+    }
+    else
+    {
+        for (int32 X = 0; X < SourceSizeX; ++X)
+        {
+            const FColumnSpan& Span = ColumnSpans[X];
+            const float Value = SourceRow[X] * WeightY;
+
+            Accum[Span.DestX] += Value * Span.Weight0;
+            if (Span.Weight0 < 1.f)
+            {
+                Accum[Span.DestX + 1] += Value * (1.f - Span.Weight0);
+            }
+        }
+    }
+}
+
+void FStreamingAreaResampler::FlushRow(int32 DestRow, TArray<float>& Accumulator)
+{
+    const float InvArea = (float)(1. / (ScaleX * ScaleY));
+
+    uint8* Dest = DestImage.RawData.GetData() + (int64)DestRow * DestImage.SizeX * NumChannels;
+    float* Accum = Accumulator.GetData();
+
+    if (NumChannels == 4)
+    {
+        for (int32 X = 0; X < DestImage.SizeX; ++X)
+        {
+            const float* Sum = Accum + X * 4;
+            uint8* Pixel = Dest + X * 4;
+
+            // Sum[3] is the total alpha weight: colours were summed premultiplied by it
+            const float InvAlphaWeight = Sum[3] > 0.f ? 1.f / Sum[3] : 0.f;
+            Pixel[0] = (uint8)FMath::Clamp(FMath::RoundToInt(Sum[0] * InvAlphaWeight), 0, 255);
+            Pixel[1] = (uint8)FMath::Clamp(FMath::RoundToInt(Sum[1] * InvAlphaWeight), 0, 255);
+            Pixel[2] = (uint8)FMath::Clamp(FMath::RoundToInt(Sum[2] * InvAlphaWeight), 0, 255);
+            Pixel[3] = (uint8)FMath::Clamp(FMath::RoundToInt(Sum[3] * InvArea), 0, 255);
+        }
+    }
+    else
+    {
+        for (int32 X = 0; X < DestImage.SizeX; ++X)
+        {
+            Dest[X] = (uint8)FMath::Clamp(FMath::RoundToInt(Accum[X] * InvArea), 0, 255);
+        }
+    }
+
+    FMemory::Memzero(Accum, Accumulator.Num() * sizeof(float));
+}
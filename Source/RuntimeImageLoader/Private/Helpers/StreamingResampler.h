@@ -0,0 +1,54 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ImageCore.h"
+
+/**
+ * Area (box) downscaler fed one source row at a time by a scanline decoder.
+ * A source row straddles at most two output rows, so only two accumulator rows are kept:
+ * memory is the output image plus a couple of rows whatever the source size.
+ *
+ * Input is 8 bit, either 1 channel (G8) or 4 channels (BGRA8). 4 channel pixels are averaged
+ * weighted by alpha, so the colour of fully transparent pixels doesn't bleed into the edges.
+ */
+class FStreamingAreaResampler
+{
+public:
+    /** OutImage has to be initialized to the output size, in G8 for 1 channel or BGRA8 for 4 channels */
+    FStreamingAreaResampler(int32 InSourceSizeX, int32 InSourceSizeY, int32 InNumChannels, FImage& OutImage);
+
+    void AddRow(const uint8* SourceRow);
+
+    bool IsComplete() const { return NextSourceRow >= SourceSizeY; }
+
+private:
+    void AccumulateRow(const uint8* SourceRow, float WeightY, TArray<float>& Accumulator) const;
+    void FlushRow(int32 DestRow, TArray<float>& Accumulator);
+
+private:
+    /** Source column X adds Weight0 of itself to DestX and the rest to DestX + 1 */
+    struct FColumnSpan
+    {
+        int32 DestX = 0;
+        float Weight0 = 1.f;
+    };
+
+    TArray<FColumnSpan> ColumnSpans;
+
+    /** Indexed by output row parity */
+    TArray<float> Accumulators[2];
+
+    FImage& DestImage;
+
+    int32 SourceSizeX;
+    int32 SourceSizeY;
+    int32 NumChannels;
+
+    double ScaleX;
+    double ScaleY;
+
+    int32 NextSourceRow = 0;
+    int32 NextDestRowToFlush = 0;
+};
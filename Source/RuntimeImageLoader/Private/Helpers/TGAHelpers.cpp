@@ -5,7 +5,14 @@
 
 namespace FTGAHelpers
 {
-    void DecompressTGA_RLE_32bpp(const FTGAFileHeader* TGA, uint32* TextureData)
+    /** Offset of the pixels from the start of the file */
+    static int64 GetImageDataOffset(const FTGAFileHeader* TGA)
+    {
+        return sizeof(FTGAFileHeader) + TGA->IdFieldLength + (int64)(TGA->ColorMapEntrySize + 4) / 8 * TGA->ColorMapLength;
+    }
+
+    /** RLE decoders stop at DataEnd instead of reading past a truncated file */
+    bool DecompressTGA_RLE_32bpp(const FTGAFileHeader* TGA, const uint8* DataEnd, uint32* TextureData)
     {
         uint8* IdData = (uint8*)TGA + sizeof(FTGAFileHeader);
         uint8* ColorMap = IdData + TGA->IdFieldLength;
@@ -24,6 +31,10 @@ namespace FTGAHelpers
                 }
                 else if (RAWRun == 0) // new raw pixel or RLE-run.
                 {
+                    if (ImageData >= DataEnd)
+                    {
+                        return false;
+                    }
                     uint8 RLEChunk = *(ImageData++);
                     if (RLEChunk & 0x80)
                     {
@@ -38,18 +49,24 @@ namespace FTGAHelpers
                 // Retrieve new pixel data - raw run or single pixel for RLE stretch.
                 if (RAWRun > 0)
                 {
+                    if (DataEnd - ImageData < 4)
+                    {
+                        return false;
+                    }
                     Pixel = *(uint32*)ImageData; // RGBA 32-bit dword.
                     ImageData += 4;
                     RAWRun--;
                     RLERun--;
                 }
                 // Store.
-                *((TextureData + Y * TGA->Width) + X) = Pixel;
+                *((TextureData + (int64)Y * TGA->Width) + X) = Pixel;
             }
         }
+
+        return true;
     }
 
-    void DecompressTGA_RLE_24bpp(const FTGAFileHeader* TGA, uint32* TextureData)
+    bool DecompressTGA_RLE_24bpp(const FTGAFileHeader* TGA, const uint8* DataEnd, uint32* TextureData)
     {
         uint8* IdData = (uint8*)TGA + sizeof(FTGAFileHeader);
         uint8* ColorMap = IdData + TGA->IdFieldLength;
@@ -66,6 +83,10 @@ namespace FTGAHelpers
                     RLERun--;  // reuse current Pixel data.
                 else if (RAWRun == 0) // new raw pixel or RLE-run.
                 {
+                    if (ImageData >= DataEnd)
+                    {
+                        return false;
+                    }
                     uint8 RLEChunk = *(ImageData++);
                     if (RLEChunk & 0x80)
                     {
@@ -80,6 +101,10 @@ namespace FTGAHelpers
                 // Retrieve new pixel data - raw run or single pixel for RLE stretch.
                 if (RAWRun > 0)
                 {
+                    if (DataEnd - ImageData < 3)
+                    {
+                        return false;
+                    }
                     Pixel[0] = *(ImageData++);
                     Pixel[1] = *(ImageData++);
                     Pixel[2] = *(ImageData++);
@@ -88,12 +113,14 @@ namespace FTGAHelpers
                     RLERun--;
                 }
                 // Store.
-                *((TextureData + Y * TGA->Width) + X) = *(uint32*)&Pixel;
+                *((TextureData + (int64)Y * TGA->Width) + X) = *(uint32*)&Pixel;
             }
         }
+
+        return true;
     }
 
-    void DecompressTGA_RLE_16bpp(const FTGAFileHeader* TGA, uint32* TextureData)
+    bool DecompressTGA_RLE_16bpp(const FTGAFileHeader* TGA, const uint8* DataEnd, uint32* TextureData)
     {
         uint8* IdData = (uint8*)TGA + sizeof(FTGAFileHeader);
         uint8* ColorMap = IdData + TGA->IdFieldLength;
@@ -111,6 +138,10 @@ namespace FTGAHelpers
                     RLERun--;  // reuse current Pixel data.
                 else if (RAWRun == 0) // new raw pixel or RLE-run.
                 {
+                    if ((const uint8*)ImageData >= DataEnd)
+                    {
+                        return false;
+                    }
                     uint8 RLEChunk = *((uint8*)ImageData);
                     ImageData = (uint16*)(((uint8*)ImageData) + 1);
                     if (RLEChunk & 0x80)
@@ -126,6 +157,10 @@ namespace FTGAHelpers
                 // Retrieve new pixel data - raw run or single pixel for RLE stretch.
                 if (RAWRun > 0)
                 {
+                    if (DataEnd - (const uint8*)ImageData < 2)
+                    {
+                        return false;
+                    }
                     FilePixel = *(ImageData++);
                     RAWRun--;
                     RLERun--;
@@ -136,9 +171,11 @@ namespace FTGAHelpers
                 TexturePixel |= (FilePixel & 0x7C00) << 9;
                 TexturePixel |= (FilePixel & 0x8000) << 16;
                 // Store.
-                *((TextureData + Y * TGA->Width) + X) = TexturePixel;
+                *((TextureData + (int64)Y * TGA->Width) + X) = TexturePixel;
             }
         }
+
+        return true;
     }
 
     void DecompressTGA_32bpp(const FTGAFileHeader* TGA, uint32* TextureData)
@@ -150,7 +187,7 @@ namespace FTGAHelpers
 
         for (int32 Y = 0; Y < TGA->Height; Y++)
         {
-            FMemory::Memcpy(TextureData + Y * TGA->Width, ImageData + (TGA->Height - Y - 1) * TGA->Width, TGA->Width * 4);
+            FMemory::Memcpy(TextureData + (int64)Y * TGA->Width, ImageData + (int64)(TGA->Height - Y - 1) * TGA->Width, TGA->Width * 4);
         }
     }
 
@@ -173,7 +210,7 @@ namespace FTGAHelpers
                 TexturePixel |= (FilePixel & 0x7C00) << 9;
                 TexturePixel |= (FilePixel & 0x8000) << 16;
                 // Store.
-                *((TextureData + Y * TGA->Width) + X) = TexturePixel;
+                *((TextureData + (int64)Y * TGA->Width) + X) = TexturePixel;
             }
         }
     }
@@ -187,13 +224,14 @@ namespace FTGAHelpers
 
         for (int32 Y = 0; Y < TGA->Height; Y++)
         {
+            const uint8* ImageRow = ImageData + (int64)(TGA->Height - Y - 1) * TGA->Width * 3;
             for (int32 X = 0; X < TGA->Width; X++)
             {
-                Pixel[0] = *((ImageData + (TGA->Height - Y - 1)*TGA->Width * 3) + X * 3 + 0);
-                Pixel[1] = *((ImageData + (TGA->Height - Y - 1)*TGA->Width * 3) + X * 3 + 1);
-                Pixel[2] = *((ImageData + (TGA->Height - Y - 1)*TGA->Width * 3) + X * 3 + 2);
+                Pixel[0] = ImageRow[X * 3 + 0];
+                Pixel[1] = ImageRow[X * 3 + 1];
+                Pixel[2] = ImageRow[X * 3 + 2];
                 Pixel[3] = 255;
-                *((TextureData + Y * TGA->Width) + X) = *(uint32*)&Pixel;
+                *((TextureData + (int64)Y * TGA->Width) + X) = *(uint32*)&Pixel;
             }
         }
     }
@@ -207,36 +245,45 @@ namespace FTGAHelpers
         int32 RevY = 0;
         for (int32 Y = TGA->Height - 1; Y >= 0; --Y)
         {
-            const uint8* ImageCol = ImageData + (Y * TGA->Width);
-            uint8* TextureCol = TextureData + (RevY++ * TGA->Width);
+            const uint8* ImageCol = ImageData + ((int64)Y * TGA->Width);
+            uint8* TextureCol = TextureData + ((int64)RevY++ * TGA->Width);
             FMemory::Memcpy(TextureCol, ImageCol, TGA->Width);
         }
     }
 
 
-    bool DecompressTGA_helper(const FTGAFileHeader* TGA, uint32*& TextureData, const int32 TextureDataSize, FString& OutError)
+    bool DecompressTGA_helper(const FTGAFileHeader* TGA, int64 Length, uint32*& TextureData, const int64 TextureDataSize, FString& OutError)
     {
+        const uint8* DataEnd = (const uint8*)TGA + Length;
+
         if (TGA->ImageTypeCode == 10) // 10 = RLE compressed 
         {
             // RLE compression: CHUNKS: 1 -byte header, high bit 0 = raw, 1 = compressed
             // bits 0-6 are a 7-bit count; count+1 = number of raw pixels following, or rle pixels to be expanded. 
+            bool bTruncated = false;
             if (TGA->BitsPerPixel == 32)
             {
-                DecompressTGA_RLE_32bpp(TGA, TextureData);
+                bTruncated = !DecompressTGA_RLE_32bpp(TGA, DataEnd, TextureData);
             }
             else if (TGA->BitsPerPixel == 24)
             {
-                DecompressTGA_RLE_24bpp(TGA, TextureData);
+                bTruncated = !DecompressTGA_RLE_24bpp(TGA, DataEnd, TextureData);
             }
             else if (TGA->BitsPerPixel == 16)
             {
-                DecompressTGA_RLE_16bpp(TGA, TextureData);
+                bTruncated = !DecompressTGA_RLE_16bpp(TGA, DataEnd, TextureData);
             }
             else
             {
                 OutError = FString::Printf(TEXT("TGA uses an unsupported rle-compressed bit-depth: %u"), TGA->BitsPerPixel);
                 return false;
             }
+
+            if (bTruncated)
+            {
+                OutError = TEXT("TGA compressed pixel data is truncated");
+                return false;
+            }
         }
         else if (TGA->ImageTypeCode == 2) // 2 = Uncompressed RGB
         {
@@ -279,21 +326,21 @@ namespace FTGAHelpers
         bool FlipY = (TGA->ImageDescriptor & 0x20) ? 1 : 0;
         if (FlipY || FlipX)
         {
-            TArray<uint8> FlippedData;
+            TArray64<uint8> FlippedData;
             FlippedData.AddUninitialized(TextureDataSize);
 
-            int32 NumBlocksX = TGA->Width;
-            int32 NumBlocksY = TGA->Height;
-            int32 BlockBytes = TGA->BitsPerPixel == 8 ? 1 : 4;
+            int64 NumBlocksX = TGA->Width;
+            int64 NumBlocksY = TGA->Height;
+            int64 BlockBytes = TGA->BitsPerPixel == 8 ? 1 : 4;
 
             uint8* MipData = (uint8*)TextureData;
 
-            for (int32 Y = 0; Y < NumBlocksY; Y++)
+            for (int64 Y = 0; Y < NumBlocksY; Y++)
             {
-                for (int32 X = 0; X < NumBlocksX; X++)
+                for (int64 X = 0; X < NumBlocksX; X++)
                 {
-                    int32 DestX = FlipX ? (NumBlocksX - X - 1) : X;
-                    int32 DestY = FlipY ? (NumBlocksY - Y - 1) : Y;
+                    int64 DestX = FlipX ? (NumBlocksX - X - 1) : X;
+                    int64 DestY = FlipY ? (NumBlocksY - Y - 1) : Y;
                     FMemory::Memcpy(
                         &FlippedData[(DestX + DestY * NumBlocksX) * BlockBytes],
                         &MipData[(X + Y * NumBlocksX) * BlockBytes],
@@ -307,8 +354,21 @@ namespace FTGAHelpers
         return true;
     }
 
-    bool DecompressTGA(const FTGAFileHeader* TGA, FRuntimeImageData& OutImage, FString& OutError)
+    bool DecompressTGA(const FTGAFileHeader* TGA, int64 Length, FRuntimeImageData& OutImage, FString& OutError)
     {
+        // the header alone can claim 65535 x 65535, reject files that can't hold the pixels before allocating them
+        const int64 NumPixels = (int64)TGA->Width * TGA->Height;
+        const int64 FilePixelBytes = FMath::Max(TGA->BitsPerPixel / 8, 1);
+        const int64 MinPixelDataSize = TGA->ImageTypeCode == 10
+            ? FMath::DivideAndRoundUp<int64>(NumPixels, 128) * (1 + FilePixelBytes)
+            : NumPixels * FilePixelBytes;
+
+        if (Length < GetImageDataOffset(TGA) + MinPixelDataSize)
+        {
+            OutError = FString::Printf(TEXT("TGA of %d x %d is truncated: %lld bytes"), TGA->Width, TGA->Height, Length);
+            return false;
+        }
+
         if (TGA->ColorMapType == 1 && TGA->ImageTypeCode == 1 && TGA->BitsPerPixel == 8)
         {
             // Notes: The Scaleform GFx exporter (dll) strips all font glyphs into a single 8-bit texture.
@@ -361,9 +421,9 @@ namespace FTGAHelpers
             );
         }
 
-        int32 TextureDataSize = OutImage.RawData.Num();
+        const int64 TextureDataSize = OutImage.RawData.Num();
         uint32* TextureData = (uint32*)OutImage.RawData.GetData();
 
-        return DecompressTGA_helper(TGA, TextureData, TextureDataSize, OutError);
+        return DecompressTGA_helper(TGA, Length, TextureData, TextureDataSize, OutError);
     }
 }
\ No newline at end of file
@@ -38,7 +38,8 @@ namespace FTGAHelpers
 
     #pragma pack(pop)
 
-    bool DecompressTGA_helper(const FTGAFileHeader* TGA, uint32*& TextureData, const int32 TextureDataSize, FString& OutError);
-    bool DecompressTGA(const FTGAFileHeader* TGA, FRuntimeImageData& OutImage, FString& OutError);
+    /** Length is the size of the whole file starting at TGA, pixel offsets are 64-bit so every 65535 x 65535 image is addressable */
+    bool DecompressTGA_helper(const FTGAFileHeader* TGA, int64 Length, uint32*& TextureData, const int64 TextureDataSize, FString& OutError);
+    bool DecompressTGA(const FTGAFileHeader* TGA, int64 Length, FRuntimeImageData& OutImage, FString& OutError);
 
 }
\ No newline at end of file
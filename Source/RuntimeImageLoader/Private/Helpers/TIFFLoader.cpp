@@ -172,6 +172,13 @@ bool FRuntimeTiffLoadHelper::Load(const uint8 * Buffer, uint32 Length)
 		return false;
 	}
 
+	// RawData and the conversions below use 32-bit sizes, the widest output is RGBA16 at 8 bytes per pixel
+	if ((int64)FreeImage_GetWidth(Bitmap) * FreeImage_GetHeight(Bitmap) * 8 > MAX_int32)
+	{
+		UE_LOG(LogRuntimeImageLoaderTIFFLoader, Error, TEXT("TIFF of %u x %u is too large to decode"), FreeImage_GetWidth(Bitmap), FreeImage_GetHeight(Bitmap));
+		return false;
+	}
+
 	Width = FreeImage_GetWidth(Bitmap);
 	Height = FreeImage_GetHeight(Bitmap);
 
@@ -0,0 +1,164 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "TextureCacheFile.h"
+#include "HAL/FileManager.h"
+#include "Templates/UniquePtr.h"
+#include "BCEncoder.h"
+#include "ImageStatistics.h"
+#include "RHI.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTextureCacheFile, Log, All);
+
+namespace
+{
+    constexpr uint32 CacheMagic = 0x58455452; // 'RTEX'
+    constexpr int32 CacheVersion = 1;
+}
+
+namespace FTextureCacheFile
+{
+    bool Build(FRuntimeImageData&& Image, bool bGenerateMips, bool bCompress, FTextureCacheData& OutData, FString& OutError)
+    {
+        if (Image.PixelFormat == PF_Unknown || Image.RawData.Num() == 0)
+        {
+            OutError = FString::Printf(TEXT("Image has no pixel format to cache, raw format: %d"), (int32)Image.Format);
+            return false;
+        }
+
+        OutData = FTextureCacheData();
+        OutData.SizeX = Image.SizeX;
+        OutData.SizeY = Image.SizeY;
+        OutData.PixelFormat = Image.PixelFormat;
+        OutData.bSRGB = Image.SRGB;
+
+        // block compressed top mips have to be a whole number of blocks
+        bool bWithAlpha = false;
+        if (bCompress)
+        {
+            if (Image.Format != ERawImageFormat::BGRA8)
+            {
+                UE_LOG(LogTextureCacheFile, Warning, TEXT("Only BGRA8 images are compressed, raw format %d is stored uncompressed"), (int32)Image.Format);
+                bCompress = false;
+            }
+            else if (Image.SizeX % 4 != 0 || Image.SizeY % 4 != 0)
+            {
+                UE_LOG(LogTextureCacheFile, Warning, TEXT("%d x %d is not a multiple of 4, stored uncompressed"), Image.SizeX, Image.SizeY);
+                bCompress = false;
+            }
+            else
+            {
+                bool bOpaque = false;
+                bool bGreyscale = false;
+                FImageStatistics::AnalyzeChannelUsage(Image, bOpaque, bGreyscale);
+
+                bWithAlpha = !bOpaque;
+                OutData.PixelFormat = bWithAlpha ? PF_DXT5 : PF_DXT1;
+            }
+        }
+
+        FImage Mip = MoveTemp(Image);
+        while (true)
+        {
+            if (bCompress)
+            {
+                TArray64<uint8>& CompressedMip = OutData.Mips.AddDefaulted_GetRef();
+                CompressedMip.SetNumUninitialized(FBCEncoder::GetCompressedSize(Mip.SizeX, Mip.SizeY, bWithAlpha));
+                FBCEncoder::Compress(Mip.RawData.GetData(), Mip.SizeX, Mip.SizeY, bWithAlpha, CompressedMip.GetData());
+            }
+            else
+            {
+                OutData.Mips.Add(Mip.RawData);
+            }
+
+            if (!bGenerateMips || (Mip.SizeX == 1 && Mip.SizeY == 1))
+            {
+                break;
+            }
+
+            FImage NextMip;
+            Mip.ResizeTo(NextMip, FMath::Max(1, Mip.SizeX / 2), FMath::Max(1, Mip.SizeY / 2), Mip.Format, Mip.GammaSpace);
+            Mip = MoveTemp(NextMip);
+        }
+
+        return true;
+    }
+
+    int64 GetMipSize(EPixelFormat PixelFormat, int32 SizeX, int32 SizeY, int32 MipIndex)
+    {
+        const FPixelFormatInfo& FormatInfo = GPixelFormats[PixelFormat];
+        const int32 MipSizeX = FMath::Max(1, SizeX >> MipIndex);
+        const int32 MipSizeY = FMath::Max(1, SizeY >> MipIndex);
+
+        return (int64)FMath::DivideAndRoundUp(MipSizeX, FormatInfo.BlockSizeX) * FMath::DivideAndRoundUp(MipSizeY, FormatInfo.BlockSizeY) * FormatInfo.BlockBytes;
+    }
+
+    bool AreMipsValid(const FTextureCacheData& Data)
+    {
+        // more mips than the full chain would shift the size past 1x1
+        const int32 MaxMips = FMath::FloorLog2(FMath::Max(Data.SizeX, Data.SizeY)) + 1;
+        if (Data.Mips.Num() == 0 || Data.Mips.Num() > MaxMips)
+        {
+            return false;
+        }
+
+        for (int32 MipIndex = 0; MipIndex < Data.Mips.Num(); ++MipIndex)
+        {
+            if (Data.Mips[MipIndex].Num() != GetMipSize(Data.PixelFormat, Data.SizeX, Data.SizeY, MipIndex))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Serialize(FArchive& Ar, FTextureCacheData& Data)
+    {
+        uint32 Magic = CacheMagic;
+        int32 Version = CacheVersion;
+        Ar << Magic << Version;
+
+        if (Magic != CacheMagic || Version != CacheVersion)
+        {
+            return false;
+        }
+
+        int32 PixelFormat = Data.PixelFormat;
+        Ar << Data.SizeX << Data.SizeY << PixelFormat << Data.bSRGB << Data.Mips;
+        Data.PixelFormat = (EPixelFormat)PixelFormat;
+
+        return !Ar.IsError() && Data.SizeX > 0 && Data.SizeY > 0 && Data.Mips.Num() > 0 && PixelFormat > PF_Unknown && PixelFormat < PF_MAX;
+    }
+
+    bool Save(const FString& Filename, FTextureCacheData& Data, FString& OutError)
+    {
+        TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Filename));
+        if (!Writer.IsValid() || !Serialize(*Writer, Data) || !Writer->Close())
+        {
+            OutError = FString::Printf(TEXT("Failed to write texture cache %s"), *Filename);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Load(const FString& Filename, FTextureCacheData& OutData, FString& OutError)
+    {
+        TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename));
+        if (!Reader.IsValid() || !Serialize(*Reader, OutData))
+        {
+            OutError = FString::Printf(TEXT("Failed to read texture cache %s"), *Filename);
+            return false;
+        }
+
+        // a truncated or hand edited file would make the texture factory read past the mip data
+        if (!AreMipsValid(OutData))
+        {
+            OutError = FString::Printf(TEXT("Texture cache %s has mips that don't match %d x %d %s"), *Filename, OutData.SizeX, OutData.SizeY, GPixelFormats[OutData.PixelFormat].Name);
+            OutData = FTextureCacheData();
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,40 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "RuntimeImageData.h"
+
+/** GPU ready texture, every mip is stored in its final pixel format so loading is a read and an upload */
+struct FTextureCacheData
+{
+    int32 SizeX = 0;
+    int32 SizeY = 0;
+    EPixelFormat PixelFormat = PF_Unknown;
+    bool bSRGB = true;
+    TArray<TArray64<uint8>> Mips;
+};
+
+namespace FTextureCacheFile
+{
+    /** Extension of cache files, without the dot */
+    constexpr const TCHAR* Extension = TEXT("rtex");
+
+    /**
+     * Turns an image that went through the runtime transform stages into cache data: optional mip chain
+     * and BC1/BC3 compression of BGRA8 images (BC1 when fully opaque). Other formats are stored uncompressed
+     */
+    bool Build(FRuntimeImageData&& Image, bool bGenerateMips, bool bCompress, FTextureCacheData& OutData, FString& OutError);
+
+    /** Size in bytes of a mip of a SizeX x SizeY texture, block compressed formats round up to whole blocks */
+    int64 GetMipSize(EPixelFormat PixelFormat, int32 SizeX, int32 SizeY, int32 MipIndex);
+
+    /** Whether every mip holds exactly the bytes its size and pixel format need, so the upload can't read past them */
+    bool AreMipsValid(const FTextureCacheData& Data);
+
+    bool Serialize(FArchive& Ar, FTextureCacheData& Data);
+
+    bool Save(const FString& Filename, FTextureCacheData& Data, FString& OutError);
+    bool Load(const FString& Filename, FTextureCacheData& OutData, FString& OutError);
+}
@@ -0,0 +1,294 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "TilePyramid.h"
+#include "RuntimeImageUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "Async/ParallelFor.h"
+#include "IImageWrapperModule.h"
+#include "IImageWrapper.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTilePyramid, Log, All);
+
+namespace
+{
+    bool ParseAttribute(const FString& Xml, const TCHAR* Name, FString& OutValue)
+    {
+        const FString Pattern = FString::Printf(TEXT("%s=\""), Name);
+
+        const int32 ValueStart = Xml.Find(Pattern, ESearchCase::CaseSensitive);
+        if (ValueStart == INDEX_NONE)
+        {
+            return false;
+        }
+
+        const int32 ValueEnd = Xml.Find(TEXT("\""), ESearchCase::CaseSensitive, ESearchDir::FromStart, ValueStart + Pattern.Len());
+        if (ValueEnd == INDEX_NONE)
+        {
+            return false;
+        }
+
+        OutValue = Xml.Mid(ValueStart + Pattern.Len(), ValueEnd - ValueStart - Pattern.Len());
+        return true;
+    }
+
+    /** Tiles are handed to the texture factory as BGRA8 whatever the source format was */
+    void ConvertToBGRA8(FRuntimeImageData& ImageData)
+    {
+        if (ImageData.Format != ERawImageFormat::BGRA8)
+        {
+            FImage ConvertedImage;
+            ImageData.CopyTo(ConvertedImage, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+
+            ImageData.RawData = MoveTemp(ConvertedImage.RawData);
+            ImageData.Format = ERawImageFormat::BGRA8;
+            ImageData.GammaSpace = EGammaSpace::sRGB;
+            ImageData.SRGB = true;
+        }
+
+        ImageData.TextureSourceFormat = TSF_BGRA8;
+        ImageData.PixelFormat = PF_B8G8R8A8;
+    }
+
+    /** 2x2 box filter, odd sizes round up and average only the pixels that exist */
+    void DownsampleHalf(const FImage& Source, FImage& OutImage)
+    {
+        const int32 DestSizeX = FMath::Max(1, FMath::DivideAndRoundUp(Source.SizeX, 2));
+        const int32 DestSizeY = FMath::Max(1, FMath::DivideAndRoundUp(Source.SizeY, 2));
+
+        OutImage.Init(DestSizeX, DestSizeY, ERawImageFormat::BGRA8, Source.GammaSpace);
+
+        const FColor* SourcePixels = (const FColor*)Source.RawData.GetData();
+        FColor* DestPixels = (FColor*)OutImage.RawData.GetData();
+
+        ParallelFor(DestSizeY, [&](int32 Y)
+        {
+            const int32 SourceY0 = Y * 2;
+            const int32 SourceY1 = FMath::Min(SourceY0 + 1, Source.SizeY - 1);
+
+            for (int32 X = 0; X < DestSizeX; ++X)
+            {
+                const int32 SourceX0 = X * 2;
+                const int32 SourceX1 = FMath::Min(SourceX0 + 1, Source.SizeX - 1);
+
+                const FColor& A = SourcePixels[(int64)SourceY0 * Source.SizeX + SourceX0];
+                const FColor& B = SourcePixels[(int64)SourceY0 * Source.SizeX + SourceX1];
+                const FColor& C = SourcePixels[(int64)SourceY1 * Source.SizeX + SourceX0];
+                const FColor& D = SourcePixels[(int64)SourceY1 * Source.SizeX + SourceX1];
+
+                FColor& Dest = DestPixels[(int64)Y * DestSizeX + X];
+                Dest.R = (uint8)((A.R + B.R + C.R + D.R + 2) >> 2);
+                Dest.G = (uint8)((A.G + B.G + C.G + D.G + 2) >> 2);
+                Dest.B = (uint8)((A.B + B.B + C.B + D.B + 2) >> 2);
+                Dest.A = (uint8)((A.A + B.A + C.A + D.A + 2) >> 2);
+            }
+        });
+    }
+
+    bool SaveTile(IImageWrapperModule& ImageWrapperModule, const FImage& LevelImage, const FIntRect& TileRect, const FString& TilePath)
+    {
+        const int32 TileSizeX = TileRect.Width();
+        const int32 TileSizeY = TileRect.Height();
+
+        TArray64<uint8> TilePixels;
+        TilePixels.AddUninitialized((int64)TileSizeX * TileSizeY * sizeof(FColor));
+
+        const FColor* LevelPixels = (const FColor*)LevelImage.RawData.GetData();
+        for (int32 Row = 0; Row < TileSizeY; ++Row)
+        {
+            FMemory::Memcpy(
+                TilePixels.GetData() + (int64)Row * TileSizeX * sizeof(FColor),
+                LevelPixels + (int64)(TileRect.Min.Y + Row) * LevelImage.SizeX + TileRect.Min.X,
+                TileSizeX * sizeof(FColor)
+            );
+        }
+
+        TSharedPtr<IImageWrapper> PngImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+        if (!PngImageWrapper.IsValid() || !PngImageWrapper->SetRaw(TilePixels.GetData(), TilePixels.Num(), TileSizeX, TileSizeY, ERGBFormat::BGRA, 8))
+        {
+            return false;
+        }
+
+        const TArray64<uint8> CompressedTile = PngImageWrapper->GetCompressed();
+        return FFileHelper::SaveArrayToFile(CompressedTile, *TilePath);
+    }
+}
+
+int32 FTilePyramidDescriptor::GetMaxLevel() const
+{
+    return FMath::CeilLogTwo((uint32)FMath::Max(Width, Height));
+}
+
+FIntPoint FTilePyramidDescriptor::GetLevelSize(int32 Level) const
+{
+    const int32 Shift = GetMaxLevel() - Level;
+    return FIntPoint(
+        FMath::Max(1, (int32)FMath::DivideAndRoundUp((int64)Width, (int64)1 << Shift)),
+        FMath::Max(1, (int32)FMath::DivideAndRoundUp((int64)Height, (int64)1 << Shift))
+    );
+}
+
+FIntPoint FTilePyramidDescriptor::GetNumTiles(int32 Level) const
+{
+    const FIntPoint LevelSize = GetLevelSize(Level);
+    return FIntPoint(FMath::DivideAndRoundUp(LevelSize.X, TileSize), FMath::DivideAndRoundUp(LevelSize.Y, TileSize));
+}
+
+FIntRect FTilePyramidDescriptor::GetTileRect(int32 Level, const FIntPoint& Tile) const
+{
+    const FIntPoint LevelSize = GetLevelSize(Level);
+    return FIntRect(
+        Tile.X * TileSize, Tile.Y * TileSize,
+        FMath::Min((Tile.X + 1) * TileSize, LevelSize.X), FMath::Min((Tile.Y + 1) * TileSize, LevelSize.Y)
+    );
+}
+
+FIntRect FTilePyramidDescriptor::GetStoredTileRect(int32 Level, const FIntPoint& Tile) const
+{
+    const FIntPoint LevelSize = GetLevelSize(Level);
+    const FIntRect TileRect = GetTileRect(Level, Tile);
+    return FIntRect(
+        FMath::Max(TileRect.Min.X - Overlap, 0), FMath::Max(TileRect.Min.Y - Overlap, 0),
+        FMath::Min(TileRect.Max.X + Overlap, LevelSize.X), FMath::Min(TileRect.Max.Y + Overlap, LevelSize.Y)
+    );
+}
+
+FString FTilePyramidDescriptor::GetTilePath(int32 Level, const FIntPoint& Tile) const
+{
+    return FPaths::Combine(TilesDirectory, FString::FromInt(Level), FString::Printf(TEXT("%d_%d.%s"), Tile.X, Tile.Y, *Format));
+}
+
+namespace FTilePyramid
+{
+    bool LoadDescriptor(const FString& DziFilename, FTilePyramidDescriptor& OutDescriptor, FString& OutError)
+    {
+        FString Xml;
+        if (!FFileHelper::LoadFileToString(Xml, *DziFilename))
+        {
+            OutError = FString::Printf(TEXT("Failed to read tile pyramid descriptor: %s"), *DziFilename);
+            return false;
+        }
+
+        FString TileSize, Overlap, Width, Height;
+        if (!ParseAttribute(Xml, TEXT("TileSize"), TileSize) || !ParseAttribute(Xml, TEXT("Width"), Width) || !ParseAttribute(Xml, TEXT("Height"), Height))
+        {
+            OutError = FString::Printf(TEXT("Tile pyramid descriptor is missing TileSize or Size: %s"), *DziFilename);
+            return false;
+        }
+
+        OutDescriptor.TileSize = FCString::Atoi(*TileSize);
+        OutDescriptor.Width = FCString::Atoi(*Width);
+        OutDescriptor.Height = FCString::Atoi(*Height);
+        OutDescriptor.Overlap = ParseAttribute(Xml, TEXT("Overlap"), Overlap) ? FCString::Atoi(*Overlap) : 0;
+
+        if (!ParseAttribute(Xml, TEXT("Format"), OutDescriptor.Format))
+        {
+            OutDescriptor.Format = TEXT("jpg");
+        }
+
+        OutDescriptor.TilesDirectory = FPaths::Combine(FPaths::GetPath(DziFilename), FPaths::GetBaseFilename(DziFilename) + TEXT("_files"));
+
+        if (!OutDescriptor.IsValid())
+        {
+            OutError = FString::Printf(TEXT("Tile pyramid descriptor is not valid: %s"), *DziFilename);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SaveDescriptor(const FString& DziFilename, const FTilePyramidDescriptor& Descriptor)
+    {
+        const FString Xml = FString::Printf(
+            TEXT("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n")
+            TEXT("<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"%s\" Overlap=\"%d\" TileSize=\"%d\">\n")
+            TEXT("    <Size Width=\"%d\" Height=\"%d\"/>\n")
+            TEXT("</Image>\n"),
+            *Descriptor.Format, Descriptor.Overlap, Descriptor.TileSize, Descriptor.Width, Descriptor.Height
+        );
+
+        return FFileHelper::SaveStringToFile(Xml, *DziFilename);
+    }
+
+    bool BuildPyramid(FRuntimeImageData&& SourceImage, const FString& DziFilename, int32 TileSize, const FRuntimeImageTaskHandle& TaskHandle, FTilePyramidDescriptor& OutDescriptor, FString& OutError)
+    {
+        ConvertToBGRA8(SourceImage);
+
+        OutDescriptor = FTilePyramidDescriptor();
+        OutDescriptor.Width = SourceImage.SizeX;
+        OutDescriptor.Height = SourceImage.SizeY;
+        OutDescriptor.TileSize = FMath::Max(TileSize - 2 * OutDescriptor.Overlap, 16);
+        OutDescriptor.Format = TEXT("png");
+        OutDescriptor.TilesDirectory = FPaths::Combine(FPaths::GetPath(DziFilename), FPaths::GetBaseFilename(DziFilename) + TEXT("_files"));
+
+        IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+
+        FImage LevelImage = MoveTemp(SourceImage);
+        for (int32 Level = OutDescriptor.GetMaxLevel(); Level >= 0; --Level)
+        {
+            check(LevelImage.SizeX == OutDescriptor.GetLevelSize(Level).X && LevelImage.SizeY == OutDescriptor.GetLevelSize(Level).Y);
+
+            IFileManager::Get().MakeDirectory(*FPaths::Combine(OutDescriptor.TilesDirectory, FString::FromInt(Level)), true);
+
+            const FIntPoint NumTiles = OutDescriptor.GetNumTiles(Level);
+            for (int32 Row = 0; Row < NumTiles.Y; ++Row)
+            {
+                if (TaskHandle.IsCancelled())
+                {
+                    OutError = TEXT("Tile pyramid build was cancelled");
+                    return false;
+                }
+
+                for (int32 Column = 0; Column < NumTiles.X; ++Column)
+                {
+                    const FIntPoint Tile(Column, Row);
+                    if (!SaveTile(ImageWrapperModule, LevelImage, OutDescriptor.GetStoredTileRect(Level, Tile), OutDescriptor.GetTilePath(Level, Tile)))
+                    {
+                        OutError = FString::Printf(TEXT("Failed to write tile %s"), *OutDescriptor.GetTilePath(Level, Tile));
+                        return false;
+                    }
+                }
+            }
+
+            if (Level > 0)
+            {
+                FImage NextLevelImage;
+                DownsampleHalf(LevelImage, NextLevelImage);
+                LevelImage = MoveTemp(NextLevelImage);
+            }
+        }
+
+        if (!SaveDescriptor(DziFilename, OutDescriptor))
+        {
+            OutError = FString::Printf(TEXT("Failed to write tile pyramid descriptor: %s"), *DziFilename);
+            return false;
+        }
+
+        UE_LOG(LogTilePyramid, Log, TEXT("Built tile pyramid %s: %d x %d, %d levels"), *DziFilename, OutDescriptor.Width, OutDescriptor.Height, OutDescriptor.GetMaxLevel() + 1);
+
+        return true;
+    }
+
+    bool DecodeTile(const FTilePyramidDescriptor& Descriptor, int32 Level, const FIntPoint& Tile, FRuntimeImageData& OutTile, FString& OutError)
+    {
+        const FString TilePath = Descriptor.GetTilePath(Level, Tile);
+
+        TArray64<uint8> TileBytes;
+        if (!FFileHelper::LoadFileToArray(TileBytes, *TilePath))
+        {
+            OutError = FString::Printf(TEXT("Failed to read tile: %s"), *TilePath);
+            return false;
+        }
+
+        if (!FRuntimeImageUtils::ImportBufferAsImage(TileBytes.GetData(), TileBytes.Num(), OutTile, OutError))
+        {
+            return false;
+        }
+
+        ConvertToBGRA8(OutTile);
+
+        return true;
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RuntimeImageData.h"
+#include "RuntimeImageScheduler.h"
+
+/**
+ * Deep Zoom (DZI) style tile pyramid. The highest level is the full resolution image,
+ * every level below is half the size of the one above, down to a single pixel at level 0.
+ * Tiles are stored as <TilesDirectory>/<Level>/<Column>_<Row>.<Format>
+ */
+struct FTilePyramidDescriptor
+{
+    int32 Width = 0;
+    int32 Height = 0;
+    int32 TileSize = 254;
+
+    /** Pixels each tile shares with its neighbours, so bilinear filtering doesn't show seams */
+    int32 Overlap = 1;
+
+    FString Format = TEXT("png");
+    FString TilesDirectory;
+
+    bool IsValid() const { return Width > 0 && Height > 0 && TileSize > 0 && Overlap >= 0; }
+
+    int32 GetMaxLevel() const;
+    FIntPoint GetLevelSize(int32 Level) const;
+    FIntPoint GetNumTiles(int32 Level) const;
+
+    /** Part of the level covered by the tile, without the overlap */
+    FIntRect GetTileRect(int32 Level, const FIntPoint& Tile) const;
+
+    /** Part of the level stored in the tile file, including the overlap */
+    FIntRect GetStoredTileRect(int32 Level, const FIntPoint& Tile) const;
+
+    FString GetTilePath(int32 Level, const FIntPoint& Tile) const;
+};
+
+namespace FTilePyramid
+{
+    /** Parses a .dzi descriptor, tiles are expected in the <name>_files directory next to it */
+    bool LoadDescriptor(const FString& DziFilename, FTilePyramidDescriptor& OutDescriptor, FString& OutError);
+    bool SaveDescriptor(const FString& DziFilename, const FTilePyramidDescriptor& Descriptor);
+
+    /**
+     * Cuts a decoded image into PNG tiles, one level at a time, so peak memory stays close to the source image.
+     * The descriptor is written last: a pyramid left incomplete by a cancelled task is never picked up
+     */
+    bool BuildPyramid(FRuntimeImageData&& SourceImage, const FString& DziFilename, int32 TileSize, const FRuntimeImageTaskHandle& TaskHandle, FTilePyramidDescriptor& OutDescriptor, FString& OutError);
+
+    /** Decodes a single tile file to BGRA8 */
+    bool DecodeTile(const FTilePyramidDescriptor& Descriptor, int32 Level, const FIntPoint& Tile, FRuntimeImageData& OutTile, FString& OutError);
+}
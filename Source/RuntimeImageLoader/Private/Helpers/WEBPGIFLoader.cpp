@@ -2,6 +2,8 @@
 
 #include "WEBPGIFLoader.h"
 #include "RuntimeImageLoaderLog.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RHI.h"
 
 DEFINE_LOG_CATEGORY(LibWebpGifHelper);
 
@@ -30,35 +32,49 @@ FString FWEBPGIFLoader::GetDecodeError() const
 }
 
 
-const FColor* FWEBPGIFLoader::GetNextFrame(int32 FrameIndex)
+void FWEBPGIFLoader::ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor)
 {
     if (FrameIndex > GetTotalFrames() - 1)
     {
         FrameIndex = 0;
     }
 
-    // Calculate the starting index of the desired frame in the TextureData array
-    int32 StartIndex = FrameIndex * GetWidth() * GetHeight();
-
-    if (StartIndex >= 0 && StartIndex < TextureData.Num())
+    if (bStreaming)
     {
-        return &TextureData[StartIndex];
+        // the ring slot may be recomposed by another reader once the lock is released
+        FScopeLock StreamLock(&StreamMutex);
+
+        if (const FColor* StreamedFrame = GetStreamedFrame(FrameIndex))
+        {
+            Visitor(StreamedFrame);
+            return;
+        }
     }
-    else
+    else if (FrameStore.IsValid() && FrameIndex >= 0 && FrameIndex < FrameStore->GetTotalFrames())
     {
-        // Handling the case where the index is out of bounds
-        return &FColor::Black; // return a default FColor value, like FColor::Black
+        FrameStore->ReadFrame(FrameIndex, Visitor);
+        return;
     }
+
+    // Handling the case where the index is out of bounds
+    Visitor(&FColor::Black);
 }
 
 const float FWEBPGIFLoader::GetNextFrameDelay(int32 FrameIndex)
 {
-    return Timestamps[FrameIndex];
+    return Timestamps.IsValidIndex(FrameIndex) ? Timestamps[FrameIndex] : 0.f;
+}
+
+FIntRect FWEBPGIFLoader::GetFrameDirtyRect(int32 FrameIndex) const
+{
+    return DirtyRects.IsValidIndex(FrameIndex) ? DirtyRects[FrameIndex] : FIntRect(0, 0, Width, Height);
 }
 
 
 bool FWEBPGIFLoader::DecodeGIF(TArray<uint8>&& GifBytes)
 {
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+
     if (WebPGetInfo(GifBytes.GetData(), GifBytes.Num(), &Width, &Height) == 0)
     {
         SetError("Failed to validate .webp header. Please check input data is valid!");
@@ -76,89 +92,270 @@ bool FWEBPGIFLoader::DecodeGIF(TArray<uint8>&& GifBytes)
 
     if (DecoderConfig.input.has_animation)
     {
-        WebPAnimDecoderOptions DecodingOptions;
-        if (WebPAnimDecoderOptionsInit(&DecodingOptions) == 0)
+        // frames reference the compressed data directly, so it is kept for as long as frames are decoded
+        WebPBytes = MoveTemp(GifBytes);
+
+        if (!DemuxFrames(WebPBytes))
         {
-            SetError("Failed to initialize decoding options. Version mismatch. Please libwebp is valid!");
             return false;
         }
-        DecodingOptions.color_mode = MODE_RGBA;
 
-        WebPData GifData;
+        if (Width > (int32)GetMax2DTextureDimension() || Height > (int32)GetMax2DTextureDimension())
         {
-            GifData.bytes = GifBytes.GetData();
-            GifData.size = GifBytes.Num();
+            SetError("WebP canvas exceeds the maximum texture dimension supported by the RHI");
+            return false;
         }
 
-        // Tune 'dec_options' as needed.
-        WebPAnimDecoder* Decoder = WebPAnimDecoderNew(&GifData, &DecodingOptions);
-        if (Decoder == nullptr)
+        Canvas.SetNumZeroed(Width * Height);
+
+        if (bStreamFrames)
         {
-            SetError("Failed to create WebPAnimDecoder. Please check input data is valid!");
-            return false;
+            {
+                FScopeLock StreamLock(&StreamMutex);
+                if (GetStreamedFrame(0) == nullptr)
+                {
+                    return false;
+                }
+            }
+
+            // every frame can be produced on demand from here on
+            bStreaming = true;
+            MarkFrameDecoded(TotalFrameCount - 1);
+
+            return true;
         }
 
-        WebPAnimInfo AnimationInfo;
-        if (WebPAnimDecoderGetInfo(Decoder, &AnimationInfo) == 0)
+        if (!CreateFrameStore())
         {
-            SetError("Failed to retrieve .webp animation info. Please check input data is valid!");
             return false;
         }
 
-        TotalFrameCount = AnimationInfo.frame_count;
-
-        const int32 TotalPixels = TotalFrameCount * Width * Height;
-        TextureData.Empty(TotalPixels);
-        TextureData.AddUninitialized(TotalPixels);
-
-        //AnimationInfo.loop_count
-        for (uint32_t i = 0; i < 1; ++i) 
+        for (int32 FrameIndex = 0; FrameIndex < TotalFrameCount && !IsCancelled(); ++FrameIndex)
         {
-            int32 FrameInd = 0;
-            const int32 FrameBytes = Width * Height * BYTES_PER_PIXEL;
-
-            while (WebPAnimDecoderHasMoreFrames(Decoder)) 
+            if (!CompositeFrame(FrameIndex))
             {
-                uint8_t* DecodedData;
-                int timestamp;
-                if (WebPAnimDecoderGetNext(Decoder, &DecodedData, &timestamp) == 0)
-                {
-                    SetError("Failed to decode .webp frame. Please check input data is valid!");
-                    return false;
-                }
-                Timestamps.Add(timestamp / 1000.f);
-               
-                FPlatformMemory::Memcpy((uint8_t*)TextureData.GetData() + FrameInd * FrameBytes, DecodedData, FrameBytes);
-                ++FrameInd;
+                break;
             }
-            WebPAnimDecoderReset(Decoder);
+
+            FrameStore->AddFrame(FrameIndex, Canvas.GetData());
+            MarkFrameDecoded(FrameIndex);
         }
 
-        // const WebPDemuxer* demuxer = WebPAnimDecoderGetDemuxer(Decoder);
-        // ... (Do something using 'demuxer'; e.g. get EXIF/XMP/ICC data).
-        WebPAnimDecoderDelete(Decoder);
+        WebPBytes.Empty();
+        Frames.Empty();
+        Canvas.Empty();
+        DecodedFrame.Empty();
 
-        return true;
+        return GetNumDecodedFrames() > 0;
     }
-    Timestamps.Add(100.f);
+    Timestamps.SetNumZeroed(1);
+    Timestamps[0] = 100.f;
     TotalFrameCount = 1;
 
-    TextureData.SetNumZeroed(GetWidth() * GetHeight());
-
-    uint8_t* DecodedData = WebPDecodeRGBA(GifBytes.GetData(), GifBytes.Num(), &Width, &Height);
+    uint8_t* DecodedData = WebPDecodeBGRA(GifBytes.GetData(), GifBytes.Num(), &Width, &Height);
     if (DecodedData == nullptr)
     {
         SetError("Failed to decode .webp file. Please check input data is valid!");
         return false;
     }
 
-    FPlatformMemory::Memcpy((uint8_t*)TextureData.GetData(), DecodedData, Width * Height * BYTES_PER_PIXEL);
+    if (!CreateFrameStore())
+    {
+        WebPFree(DecodedData);
+        return false;
+    }
+    FrameStore->AddFrame(0, (const FColor*)DecodedData);
+    MarkFrameDecoded(0);
 
     WebPFree(DecodedData);
 
     return true;
 }
 
+bool FWEBPGIFLoader::DemuxFrames(const TArray<uint8>& GifBytes)
+{
+    WebPData GifData;
+    {
+        GifData.bytes = GifBytes.GetData();
+        GifData.size = GifBytes.Num();
+    }
+
+    WebPDemuxer* Demuxer = WebPDemux(&GifData);
+    if (Demuxer == nullptr)
+    {
+        SetError("Failed to demux .webp animation. Please check input data is valid!");
+        return false;
+    }
+
+    Width = (int32)WebPDemuxGetI(Demuxer, WEBP_FF_CANVAS_WIDTH);
+    Height = (int32)WebPDemuxGetI(Demuxer, WEBP_FF_CANVAS_HEIGHT);
+    TotalFrameCount = (int32)WebPDemuxGetI(Demuxer, WEBP_FF_FRAME_COUNT);
+
+    const FIntRect CanvasRect(0, 0, Width, Height);
+
+    // frames may be read while decoding, so per-frame data is never reallocated
+    Frames.Reserve(TotalFrameCount);
+    Timestamps.SetNumZeroed(TotalFrameCount);
+    DirtyRects.SetNumZeroed(TotalFrameCount);
+
+    WebPIterator Iterator;
+    if (WebPDemuxGetFrame(Demuxer, 1, &Iterator))
+    {
+        do
+        {
+            const int32 FrameIndex = Frames.Num();
+            if (FrameIndex >= TotalFrameCount)
+            {
+                break;
+            }
+
+            FWebPFrame& Frame = Frames.AddDefaulted_GetRef();
+            Frame.Rect = FIntRect(Iterator.x_offset, Iterator.y_offset, Iterator.x_offset + Iterator.width, Iterator.y_offset + Iterator.height);
+            Frame.Bytes = Iterator.fragment.bytes;
+            Frame.Size = Iterator.fragment.size;
+            Frame.bBlend = Iterator.blend_method == WEBP_MUX_BLEND;
+            Frame.bDisposeToBackground = Iterator.dispose_method == WEBP_MUX_DISPOSE_BACKGROUND;
+
+            if (!CanvasRect.Contains(Frame.Rect.Min) || Frame.Rect.Max.X > Width || Frame.Rect.Max.Y > Height)
+            {
+                SetError("WebP frame is outside of the canvas. Please check input data is valid!");
+                WebPDemuxReleaseIterator(&Iterator);
+                WebPDemuxDelete(Demuxer);
+                return false;
+            }
+
+            // WebPAnimDecoderGetNext reports a running timestamp, the demuxer reports the duration of each frame
+            Timestamps[FrameIndex] = Iterator.duration / 1000.f;
+
+            // same rules as libwebp's anim decoder: the frame replaces the whole canvas, or the canvas was fully cleared before it
+            const FWebPFrame* PrevFrame = FrameIndex > 0 ? &Frames[FrameIndex - 1] : nullptr;
+            Frame.bKeyFrame = PrevFrame == nullptr
+                || (Frame.Rect == CanvasRect && (!Iterator.has_alpha || !Frame.bBlend))
+                || (PrevFrame->bDisposeToBackground && (PrevFrame->Rect == CanvasRect || PrevFrame->bKeyFrame));
+
+            // the frame region plus whatever the previous frame disposed of
+            FIntRect DirtyRect = Frame.Rect;
+            if (PrevFrame == nullptr)
+            {
+                DirtyRect = CanvasRect;
+            }
+            else if (PrevFrame->bDisposeToBackground)
+            {
+                DirtyRect.Union(PrevFrame->Rect);
+            }
+            DirtyRects[FrameIndex] = DirtyRect;
+        }
+        while (WebPDemuxNextFrame(&Iterator));
+
+        WebPDemuxReleaseIterator(&Iterator);
+    }
+
+    WebPDemuxDelete(Demuxer);
+
+    if (Frames.Num() == 0)
+    {
+        SetError("WebP animation has no frames. Please check input data is valid!");
+        return false;
+    }
+    TotalFrameCount = Frames.Num();
+
+    return true;
+}
+
+bool FWEBPGIFLoader::CompositeFrame(int32 FrameIndex)
+{
+    const FWebPFrame& Frame = Frames[FrameIndex];
+
+    if (Frame.bKeyFrame)
+    {
+        FMemory::Memzero(Canvas.GetData(), Canvas.Num() * sizeof(FColor));
+    }
+    else if (Frames[FrameIndex - 1].bDisposeToBackground)
+    {
+        // disposal fills with transparent black rather than the background colour, same as libwebp's anim decoder
+        const FIntRect& DisposedRect = Frames[FrameIndex - 1].Rect;
+        for (int32 Y = DisposedRect.Min.Y; Y < DisposedRect.Max.Y; ++Y)
+        {
+            FMemory::Memzero(&Canvas[Y * Width + DisposedRect.Min.X], DisposedRect.Width() * sizeof(FColor));
+        }
+    }
+
+    const int32 FrameWidth = Frame.Rect.Width();
+    const int32 FrameHeight = Frame.Rect.Height();
+
+    // only the frame's sub-rectangle is decoded, in BGRA to match FColor
+    DecodedFrame.SetNumUninitialized(FrameWidth * FrameHeight);
+    if (WebPDecodeBGRAInto(Frame.Bytes, Frame.Size, (uint8*)DecodedFrame.GetData(), DecodedFrame.Num() * sizeof(FColor), FrameWidth * sizeof(FColor)) == nullptr)
+    {
+        SetError("Failed to decode .webp frame. Please check input data is valid!");
+        CanvasFrame = INDEX_NONE;
+        return false;
+    }
+
+    for (int32 Y = 0; Y < FrameHeight; ++Y)
+    {
+        const FColor* Src = DecodedFrame.GetData() + Y * FrameWidth;
+        FColor* Dst = &Canvas[(Frame.Rect.Min.Y + Y) * Width + Frame.Rect.Min.X];
+
+        if (Frame.bBlend)
+        {
+            GIFFrameStore::BlendRowOver(Src, Dst, FrameWidth);
+        }
+        else
+        {
+            FMemory::Memcpy(Dst, Src, FrameWidth * sizeof(FColor));
+        }
+    }
+
+    CanvasFrame = FrameIndex;
+    return true;
+}
+
+const FColor* FWEBPGIFLoader::GetStreamedFrame(int32 FrameIndex)
+{
+    // StreamMutex is held by the caller
+    if (!Frames.IsValidIndex(FrameIndex))
+    {
+        return nullptr;
+    }
+
+    for (const FRingFrame& RingFrame : Ring)
+    {
+        if (RingFrame.FrameIndex == FrameIndex)
+        {
+            return RingFrame.Pixels.GetData();
+        }
+    }
+
+    // continue from the canvas when playing forward, otherwise restart from the closest key frame
+    int32 StartFrame = FrameIndex;
+    while (!Frames[StartFrame].bKeyFrame)
+    {
+        --StartFrame;
+    }
+
+    if (CanvasFrame != INDEX_NONE && CanvasFrame < FrameIndex && CanvasFrame >= StartFrame)
+    {
+        StartFrame = CanvasFrame + 1;
+    }
+
+    for (int32 NextFrame = StartFrame; NextFrame <= FrameIndex; ++NextFrame)
+    {
+        if (!CompositeFrame(NextFrame))
+        {
+            return nullptr;
+        }
+    }
+
+    FRingFrame& RingFrame = Ring[NextRingSlot];
+    NextRingSlot = (NextRingSlot + 1) % RingSize;
+
+    RingFrame.Pixels = Canvas;
+    RingFrame.FrameIndex = FrameIndex;
+
+    return RingFrame.Pixels.GetData();
+}
+
 
 bool FWEBPGIFLoader::HasValidWebpHeader(const TArray<uint8>& GifBytes)
 {
@@ -167,6 +364,24 @@ bool FWEBPGIFLoader::HasValidWebpHeader(const TArray<uint8>& GifBytes)
     return WebPGetInfo(GifBytes.GetData(), GifBytes.Num(), &WidthTemp, &HeightTemp) == 1 ? true : false;
 }
 
+bool FWEBPGIFLoader::CreateFrameStore()
+{
+    if (Width > (int32)GetMax2DTextureDimension() || Height > (int32)GetMax2DTextureDimension())
+    {
+        SetError("WebP canvas exceeds the maximum texture dimension supported by the RHI");
+        return false;
+    }
+
+    FrameStore = FGIFFrameStoreFactory::CreateFrameStore(bCompressFrames, Width, Height, TotalFrameCount);
+    if (!FrameStore.IsValid())
+    {
+        SetError("Not enough memory to store decoded .webp frames");
+        return false;
+    }
+
+    return true;
+}
+
 void FWEBPGIFLoader::SetError(const char* error)
 {
     LastError = ANSI_TO_TCHAR(error);
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GIFLoader.h"
+#include "GIFFrameStore.h"
 
 THIRD_PARTY_INCLUDES_START
 #include "webp/decode.h"
@@ -14,6 +15,11 @@ THIRD_PARTY_INCLUDES_END
 #define BYTES_PER_PIXEL 4
 
 
+/**
+ * Animated frames are demuxed up front (rects, durations, disposal) and each frame's sub-rectangle
+ * is decoded and composited onto the canvas. Frames are either all stored in a frame store,
+ * or with SetStreamFrames decoded on demand keeping only the canvas and a small ring of recent frames.
+ */
 class FWEBPGIFLoader : public IGIFLoader
 {
 #if WITH_LIBWEBP
@@ -28,18 +34,62 @@ public: /** Gif Data Method */
     FString GetDecodeError() const override;
 
 public: /** Get Next Frame Texture Data*/
-    const FColor* GetNextFrame(int32 FrameIndex) override;
+    void ReadFrame(int32 FrameIndex, TFunctionRef<void(const FColor* FramePixels)> Visitor) override;
 	const float GetNextFrameDelay(int32 FrameIndex);
+	FIntRect GetFrameDirtyRect(int32 FrameIndex) const override;
 	bool DecodeGIF(TArray<uint8>&& GifBytes) override;
 
 	static bool HasValidWebpHeader(const TArray<uint8>& GifBytes);
 
+private:
+	/** ANMF frame as reported by the demuxer, Bytes point into WebPBytes */
+	struct FWebPFrame
+	{
+		FIntRect Rect;
+		const uint8* Bytes = nullptr;
+		size_t Size = 0;
+		bool bBlend = false;
+		bool bDisposeToBackground = false;
+
+		/** Frame doesn't depend on the canvas state, decoding can restart here */
+		bool bKeyFrame = false;
+	};
+
+	/** Recently composited frames kept when streaming, so looping textures sharing the decoder don't recompose */
+	static constexpr int32 RingSize = 3;
+
+	struct FRingFrame
+	{
+		TArray<FColor> Pixels;
+		int32 FrameIndex = INDEX_NONE;
+	};
+
 private:
 	void SetError(const char* error);
+	bool CreateFrameStore();
+
+	bool DemuxFrames(const TArray<uint8>& GifBytes);
+	bool CompositeFrame(int32 FrameIndex);
+	const FColor* GetStreamedFrame(int32 FrameIndex);
 
 private:
-	TArray<FColor> TextureData;
+	TUniquePtr<IGIFFrameStore> FrameStore;
 	TArray<float> Timestamps;
+	TArray<FIntRect> DirtyRects;
+
+	/** Demuxed animation, WebPBytes are only kept around while streaming */
+	TArray<uint8> WebPBytes;
+	TArray<FWebPFrame> Frames;
+
+	/** Composition state, CanvasFrame is the last frame composited onto the canvas */
+	TArray<FColor> Canvas;
+	TArray<FColor> DecodedFrame;
+	int32 CanvasFrame = INDEX_NONE;
+
+	FRingFrame Ring[RingSize];
+	int32 NextRingSlot = 0;
+	FCriticalSection StreamMutex;
+	bool bStreaming = false;
 
 	int32 Width = -1;
 	int32 Height = -1;
@@ -48,4 +98,4 @@ private:
 	FString LastError;
 
 #endif //WITH_LIBWEBP
-};
\ No newline at end of file
+};
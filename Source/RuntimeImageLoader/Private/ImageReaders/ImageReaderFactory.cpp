@@ -4,10 +4,15 @@
 
 TSharedPtr<IImageReader, ESPMode::ThreadSafe> FImageReaderFactory::CreateReader(const FString& ImageURI)
 {
-    if (ImageURI.StartsWith("http://") || ImageURI.StartsWith("https://"))
+    if (IsRemoteURI(ImageURI))
     {
         return MakeShared<FImageReaderHttp, ESPMode::ThreadSafe>();
     }
 
     return MakeShared<FImageReaderLocal, ESPMode::ThreadSafe>();
 }
+
+bool FImageReaderFactory::IsRemoteURI(const FString& ImageURI)
+{
+    return ImageURI.StartsWith("http://") || ImageURI.StartsWith("https://");
+}
@@ -8,4 +8,5 @@ class FImageReaderFactory
 {
 public:
     static TSharedPtr<IImageReader, ESPMode::ThreadSafe> CreateReader(const FString& ImageURI);
+    static bool IsRemoteURI(const FString& ImageURI);
 };
\ No newline at end of file
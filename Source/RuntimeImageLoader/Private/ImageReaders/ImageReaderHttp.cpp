@@ -6,13 +6,14 @@
 #include "Interfaces/IHttpResponse.h"
 #include "HttpManager.h"
 #include "HttpModule.h"
+#include "RuntimeImageLoaderMemory.h"
 
 FImageReaderHttp::~FImageReaderHttp()
 {
     DownloadFuture = nullptr;
 }
 
-TArray<uint8> FImageReaderHttp::ReadImage(const FString& ImageURI)
+TArray64<uint8> FImageReaderHttp::ReadImage(const FString& ImageURI)
 {
     check (!DownloadFuture.IsValid());
 
@@ -37,9 +38,9 @@ TArray<uint8> FImageReaderHttp::ReadImage(const FString& ImageURI)
     bool bResult = DownloadFuture->GetResult();
     if (bResult)
     {
-        return OutImageData;
+        return MoveTemp(OutImageData);
     }
-    return TArray<uint8>();
+    return TArray64<uint8>();
 }
 
 FString FImageReaderHttp::GetLastError() const
@@ -72,6 +73,7 @@ void FImageReaderHttp::HandleImageRequest(FHttpRequestPtr HttpRequest, FHttpResp
     
     if (bSuccess)
     {
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Compressed);
         OutImageData.Append(HttpResponse->GetContent().GetData(), HttpResponse->GetContentLength());
     }
     else
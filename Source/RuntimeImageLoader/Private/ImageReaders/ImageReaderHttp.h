@@ -12,7 +12,7 @@ class FImageReaderHttp : public IImageReader
 public:
     virtual ~FImageReaderHttp();
 
-    virtual TArray<uint8> ReadImage(const FString& ImageURI) override;
+    virtual TArray64<uint8> ReadImage(const FString& ImageURI) override;
     virtual FString GetLastError() const override;
     virtual void Flush() override;
     virtual void Cancel() override;
@@ -26,6 +26,6 @@ private:
 
     TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> CurrentHttpRequest;
 
-    TArray<uint8> OutImageData;
+    TArray64<uint8> OutImageData;
     FString OutError;
 };
\ No newline at end of file
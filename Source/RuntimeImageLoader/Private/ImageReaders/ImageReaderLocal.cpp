@@ -4,40 +4,76 @@
 #include "HAL/FileManager.h"
 #include "Misc/FileHelper.h"
 #include "Stats/Stats.h"
+#include "HAL/PlatformMemory.h"
+#include "RuntimeImageLoaderMemory.h"
 
-TArray<uint8> FImageReaderLocal::ReadImage(const FString& ImageURI)
+bool FImageReaderLocal::CanReadFile(const FString& ImageURI, int64 MaxFileSizeBytes)
 {
-    QUICK_SCOPE_CYCLE_COUNTER(STAT_RuntimeImageUtils_ImportFileAsTexture);
-
-    // TODO:
-    const int64 MAX_FILESIZE_BYTES = 999999999;
-
     IFileManager& FileManager = IFileManager::Get();
     if (!FileManager.FileExists(*ImageURI))
     {
         OutError = FString::Printf(TEXT("Image does not exist: %s"), *ImageURI);
-        return TArray<uint8>();
+        return false;
     }
 
     const int64 ImageFileSizeBytes = FileManager.FileSize(*ImageURI);
     check(ImageFileSizeBytes != INDEX_NONE);
 
-    // check filesize
-    if (ImageFileSizeBytes > MAX_FILESIZE_BYTES)
+    if (ImageFileSizeBytes > MaxFileSizeBytes)
     {
-        OutError = FString::Printf(TEXT("Image filesize > %d MBs): %s"), MAX_FILESIZE_BYTES, *ImageURI);
-        return TArray<uint8>();
+        OutError = FString::Printf(TEXT("Image filesize %lld MBs exceeds %lld MBs: %s"), ImageFileSizeBytes >> 20, MaxFileSizeBytes >> 20, *ImageURI);
+        return false;
+    }
+
+    // gigapixel files are fine as long as they fit in memory, the decoded image needs even more than that
+    const uint64 AvailableMemoryBytes = FPlatformMemory::GetStats().AvailablePhysical;
+    if ((uint64)ImageFileSizeBytes > AvailableMemoryBytes)
+    {
+        OutError = FString::Printf(TEXT("Image filesize %lld MBs exceeds available memory %llu MBs: %s"), ImageFileSizeBytes >> 20, AvailableMemoryBytes >> 20, *ImageURI);
+        return false;
+    }
+
+    return true;
+}
+
+TArray64<uint8> FImageReaderLocal::ReadImage(const FString& ImageURI)
+{
+    QUICK_SCOPE_CYCLE_COUNTER(STAT_RuntimeImageUtils_ImportFileAsTexture);
+
+    if (!CanReadFile(ImageURI, MAX_int64))
+    {
+        return TArray64<uint8>();
     }
 
     QUICK_SCOPE_CYCLE_COUNTER(STAT_FImageReaderLocal_LoadFileToArray);
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Compressed);
     if (!FFileHelper::LoadFileToArray(OutImageData, *ImageURI))
     {
         OutError = FString::Printf(TEXT("Image loading I/O error: %s"), *ImageURI);
-        return TArray<uint8>();
+        return TArray64<uint8>();
     }
     OutImageData.Add(0);
 
-    return OutImageData;
+    return MoveTemp(OutImageData);
+}
+
+bool FImageReaderLocal::ReadImage32(const FString& ImageURI, TArray<uint8>& OutImageData32)
+{
+    QUICK_SCOPE_CYCLE_COUNTER(STAT_FImageReaderLocal_ReadImage32);
+
+    if (!CanReadFile(ImageURI, MAX_int32))
+    {
+        return false;
+    }
+
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Compressed);
+    if (!FFileHelper::LoadFileToArray(OutImageData32, *ImageURI))
+    {
+        OutError = FString::Printf(TEXT("Image loading I/O error: %s"), *ImageURI);
+        return false;
+    }
+
+    return true;
 }
 
 FString FImageReaderLocal::GetLastError() const
@@ -10,12 +10,16 @@ class FImageReaderLocal : public IImageReader
 public:
     virtual ~FImageReaderLocal() {}
 
-    virtual TArray<uint8> ReadImage(const FString& ImageURI) override;
+    virtual TArray64<uint8> ReadImage(const FString& ImageURI) override;
+    virtual bool ReadImage32(const FString& ImageURI, TArray<uint8>& OutImageData32) override;
     virtual FString GetLastError() const override;
     virtual void Flush() override;
     virtual void Cancel() override;
 
 private:
-    TArray<uint8> OutImageData;
+    bool CanReadFile(const FString& ImageURI, int64 MaxFileSizeBytes);
+
+private:
+    TArray64<uint8> OutImageData;
     FString OutError;
 };
\ No newline at end of file
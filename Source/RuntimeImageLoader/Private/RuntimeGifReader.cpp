@@ -5,17 +5,21 @@
 #include "Texture2DAnimation/AnimatedTexture2D.h"
 #include "ImageReaders/ImageReaderFactory.h"
 #include "ImageReaders/IImageReader.h"
+#include "Helpers/GIFLoaderCache.h"
 #include "RuntimeImageLoaderLog.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
 
 DEFINE_LOG_CATEGORY(RuntimeGifReader);
 
 
-URuntimeGifReader* URuntimeGifReader::LoadGIF(const FString& GIFFilename, TEnumAsByte<enum TextureFilter> InFilterMode, bool bSynchronous)
+URuntimeGifReader* URuntimeGifReader::LoadGIF(const FString& GIFFilename, TEnumAsByte<enum TextureFilter> InFilterMode, bool bSynchronous, ERuntimeImagePriority Priority)
 {
 	FGifReadRequest Request;
 	{
 		Request.InputGif.ImageFilename = GIFFilename;
 		Request.FilterMode = InFilterMode;
+		Request.Priority = Priority;
 	}
 
 	URuntimeGifReader* GifReader = NewObject<URuntimeGifReader>();
@@ -24,12 +28,13 @@ URuntimeGifReader* URuntimeGifReader::LoadGIF(const FString& GIFFilename, TEnumA
 	return GifReader;
 }
 
-URuntimeGifReader* URuntimeGifReader::LoadGIFFromBytes(TArray<uint8>& GifBytes, TEnumAsByte<enum TextureFilter> InFilterMode, bool bSynchronous)
+URuntimeGifReader* URuntimeGifReader::LoadGIFFromBytes(TArray<uint8>& GifBytes, TEnumAsByte<enum TextureFilter> InFilterMode, bool bSynchronous, ERuntimeImagePriority Priority)
 {
 	FGifReadRequest Request;
 	{
 		Request.InputGif.ImageBytes = MoveTemp(GifBytes);
 		Request.FilterMode = InFilterMode;
+		Request.Priority = Priority;
 	}
 
 	URuntimeGifReader* GifReader = NewObject<URuntimeGifReader>();
@@ -38,6 +43,11 @@ URuntimeGifReader* URuntimeGifReader::LoadGIFFromBytes(TArray<uint8>& GifBytes,
 	return GifReader;
 }
 
+void URuntimeGifReader::Cancel()
+{
+	TaskHandle.Cancel();
+}
+
 // ------------------------------------------------------
 
 void URuntimeGifReader::SubmitRequest(FGifReadRequest&& InRequest, bool bSynchronous)
@@ -45,30 +55,124 @@ void URuntimeGifReader::SubmitRequest(FGifReadRequest&& InRequest, bool bSynchro
 	Request = MoveTemp(InRequest);
 
 	bool bIsCallerGameThread = IsInGameThread();
-	if (bIsCallerGameThread && bSynchronous)
+
+	if (Request.bShareTexture && bIsCallerGameThread)
+	{
+		// URLs are keyed by content, so their textures can't be looked up before download
+		CacheKey = FGIFLoaderCache::MakeKey(Request.InputGif.ImageFilename, Request.InputGif.ImageBytes, Request.bCompressFrames, Request.bStreamFrames);
+
+		UAnimatedTexture2D* SharedTexture = nullptr;
+		if (!CacheKey.IsEmpty())
+		{
+			SharedTexture = FGIFLoaderCache::Get().FindTexture(FGIFLoaderCache::MakeTextureKey(CacheKey, Request.FilterMode));
+			bCacheLookedUp = true;
+			bCacheHit = IsValid(SharedTexture);
+		}
+
+		if (IsValid(SharedTexture))
+		{
+			ReadResult.OutTexture = SharedTexture;
+			OnPostProcessRequest();
+
+			return;
+		}
+	}
+
+	// synchronous callers expect a fully decoded animation and don't wait in the scheduler queue
+	if (bSynchronous)
 	{
-		ProcessRequest();
+		Request.bProgressiveDecode = false;
+
+		ProcessRequest(FRuntimeImageTaskHandle());
 		OnPostProcessRequest();
 
 		return;
 	}
-	
-	CurrentTask = Async(
-		EAsyncExecution::ThreadPool,
-		[this, bIsCallerGameThread]()
+
+	// the reader has to outlive the scheduled task
+	AddToRoot();
+
+	TaskHandle = FRuntimeImageScheduler::Get().Schedule(
+		[this](const FRuntimeImageTaskHandle& InTaskHandle)
 		{
-			ProcessRequest();
-			OnPostProcessRequest();
-		}
+			ProcessRequest(InTaskHandle);
+
+			// progressive decode may have returned the texture already
+			if (!bResultPublished)
+			{
+				OnPostProcessRequest();
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [this]() { RemoveFromRoot(); });
+		},
+		Request.Priority
 	);
+}
 
-	if (bSynchronous)
+void URuntimeGifReader::ProcessRequest(const FRuntimeImageTaskHandle& InTaskHandle)
+{
+	if (InTaskHandle.IsCancelled())
+	{
+		ReadResult.OutError = TEXT("GIF request was cancelled");
+		return;
+	}
+
+	const FString& GifFilename = Request.InputGif.ImageFilename;
+
+	// decoded frames of the same GIF may still be alive, in that case skip reading and decoding
+	if (Request.bShareDecodedData && GifFilename.Len() > 0)
+	{
+		if (CacheKey.IsEmpty())
+		{
+			CacheKey = FGIFLoaderCache::MakeKey(GifFilename, Request.InputGif.ImageBytes, Request.bCompressFrames, Request.bStreamFrames);
+		}
+		if (!CacheKey.IsEmpty())
+		{
+			FindSharedDecoder();
+		}
+	}
+
+	if (!Decoder.IsValid() && !ReadAndDecode(InTaskHandle))
+	{
+		Decoder = nullptr;
+		return;
+	}
+
+	// progressive decode creates the texture from the first decoded frame
+	if (!bResultPublished)
+	{
+		CreateAnimatedTexture(Decoder);
+	}
+
+	Decoder = nullptr;
+}
+
+bool URuntimeGifReader::CreateAnimatedTexture(const TSharedPtr<IGIFLoader, ESPMode::ThreadSafe>& InDecoder)
+{
+	FAnimatedTexture2DCreateInfo CreateInfo;
+	CreateInfo.Filter = Request.FilterMode;
+
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
+	ReadResult.OutTexture = UAnimatedTexture2D::Create(InDecoder->GetWidth(), InDecoder->GetHeight(), CreateInfo);
+	if (!IsValid(ReadResult.OutTexture))
 	{
-		CurrentTask.Wait();
+		ReadResult.OutError = FString::Printf(TEXT("Error: Failed to Create Animated Texture Gif."));
+		UE_LOG(RuntimeGifReader, Error, TEXT("Error: Failed to Create Animated Texture Gif. Please check logs for any decoding related errors"));
+		return false;
 	}
+
+	ReadResult.OutTexture->SetDecoder(InDecoder);
+
+	ReadResult.OutTexture->SRGB = true;
+	ReadResult.OutTexture->UpdateResource();
+
+	FRuntimeTextureRegistry::Register(ReadResult.OutTexture, Request.InputGif.ImageFilename, InDecoder->GetWidth(), InDecoder->GetHeight(), CreateInfo.Format, 1);
+
+	return true;
 }
 
-void URuntimeGifReader::ProcessRequest()
+bool URuntimeGifReader::ReadAndDecode(const FRuntimeImageTaskHandle& InTaskHandle)
 {
 	TArray<uint8> ImageBuffer;
 
@@ -81,11 +185,13 @@ void URuntimeGifReader::ProcessRequest()
 	{
 		ImageReader = FImageReaderFactory::CreateReader(GifFilename);
 		{
-			ImageBuffer = ImageReader->ReadImage(GifFilename);
-			if (ImageBuffer.Num() == 0)
+			RUNTIMEIMAGELOADER_LLM_SCOPE(Compressed);
+
+			// animation decoders index the file with 32-bit offsets, files over 2 GB are rejected by the reader
+			if (!ImageReader->ReadImage32(GifFilename, ImageBuffer) || ImageBuffer.Num() == 0)
 			{
 				ReadResult.OutError = FString::Printf(TEXT("Failed to read GIF: %s. Error: %s"), *GifFilename, *ImageReader->GetLastError());
-				return;
+				return false;
 			}
 		}
 
@@ -98,40 +204,110 @@ void URuntimeGifReader::ProcessRequest()
 
 	check (ImageBuffer.Num() > 0);
 
+	if (InTaskHandle.IsCancelled())
+	{
+		ReadResult.OutError = TEXT("GIF request was cancelled");
+		return false;
+	}
+
+	if (Request.bShareDecodedData)
+	{
+		if (CacheKey.IsEmpty())
+		{
+			CacheKey = FGIFLoaderCache::MakeKey(GifFilename, ImageBuffer, Request.bCompressFrames, Request.bStreamFrames);
+		}
+
+		FindSharedDecoder();
+		if (Decoder.IsValid())
+		{
+			return true;
+		}
+	}
+
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Animation);
+
 	Decoder = FGIFLoaderFactory::CreateLoader(GifFilename, ImageBuffer);
 	check(Decoder.IsValid());
 
-	bool bResult = Decoder->DecodeGIF(MoveTemp(ImageBuffer));
-	if (!bResult)
+	Decoder->SetCompressFrames(Request.bCompressFrames);
+	Decoder->SetStreamFrames(Request.bStreamFrames);
+	Decoder->SetTaskHandle(InTaskHandle);
+
+	if (Request.bProgressiveDecode)
 	{
-		ReadResult.OutError = FString::Printf(TEXT("Error: Failed to decode GIF: %s"), *Decoder->GetDecodeError());
-		return;
+		// the texture is returned from the first frame while this task keeps decoding the rest
+		Decoder->SetOnFirstFrameDecoded(
+			[this]()
+			{
+				TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> SharedDecoder = Decoder;
+				if (Request.bShareDecodedData)
+				{
+					SharedDecoder = FGIFLoaderCache::Get().AddDecoder(CacheKey, Decoder);
+				}
+
+				CreateAnimatedTexture(SharedDecoder);
+				OnPostProcessRequest();
+			}
+		);
 	}
 
-	FAnimatedTexture2DCreateInfo CreateInfo;
-	CreateInfo.Filter = Request.FilterMode;
+	const bool bResult = Decoder->Decode(MoveTemp(ImageBuffer));
 
-	ReadResult.OutTexture = UAnimatedTexture2D::Create(Decoder->GetWidth(), Decoder->GetHeight(), CreateInfo);
-	if (!IsValid(ReadResult.OutTexture))
+	if (bResultPublished)
 	{
-		ReadResult.OutError = FString::Printf(TEXT("Error: Failed to Create Animated Texture Gif."));
-		UE_LOG(RuntimeGifReader, Error, TEXT("Error: Failed to Create Animated Texture Gif. Please check logs for any decoding related errors"));
-		return;
+		// remaining frames were decoded (or cancelled) after the texture was returned
+		return true;
 	}
 
-	ReadResult.OutTexture->SetDecoder(MoveTemp(Decoder));
+	if (!bResult)
+	{
+		if (InTaskHandle.IsCancelled())
+		{
+			ReadResult.OutError = TEXT("GIF request was cancelled");
+		}
+		else
+		{
+			ReadResult.OutError = FString::Printf(TEXT("Error: Failed to decode GIF: %s"), *Decoder->GetDecodeError());
+		}
+		return false;
+	}
 
-	ReadResult.OutTexture->SRGB = true;
-	ReadResult.OutTexture->UpdateResource();
+	if (Request.bShareDecodedData)
+	{
+		Decoder = FGIFLoaderCache::Get().AddDecoder(CacheKey, Decoder);
+	}
+
+	return true;
+}
+
+void URuntimeGifReader::FindSharedDecoder()
+{
+	Decoder = FGIFLoaderCache::Get().FindDecoder(CacheKey);
+
+	bCacheLookedUp = true;
+	bCacheHit |= Decoder.IsValid();
 }
 
 void URuntimeGifReader::OnPostProcessRequest()
 {
+	bResultPublished = true;
+
+	// a request may look up the texture and decoder caches several times but counts as a single hit or miss
+	if (bCacheLookedUp)
+	{
+		FRuntimeImageLoaderCounters::AddCacheLookup(bCacheHit);
+	}
+
 	AsyncTask(
 		ENamedThreads::GameThread, [this]()
 		{
 			if (ReadResult.OutError.IsEmpty())
 			{
+				if (Request.bShareTexture && !CacheKey.IsEmpty())
+				{
+					FGIFLoaderCache::Get().AddTexture(FGIFLoaderCache::MakeTextureKey(CacheKey, Request.FilterMode), ReadResult.OutTexture);
+				}
+
 				OnSuccess.Broadcast(ReadResult.OutTexture);
 			}
 			else
@@ -0,0 +1,134 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageBundle.h"
+#include "Misc/Paths.h"
+#include "TextureFactory/RuntimeRHITexture2DFactory.h"
+#include "Helpers/ImageBundle.h"
+#include "Helpers/TextureCacheFile.h"
+#include "RuntimeImageUtils.h"
+#include "RuntimeImageLoaderMemory.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageBundle, Log, All);
+
+URuntimeImageBundle* URuntimeImageBundle::OpenImageBundle(const FString& Filename, FString& OutError)
+{
+    TSharedPtr<FImageBundleReader, ESPMode::ThreadSafe> Reader = FImageBundleReader::Open(Filename, OutError);
+    if (!Reader.IsValid())
+    {
+        UE_LOG(LogRuntimeImageBundle, Warning, TEXT("Failed to open image bundle %s"), *OutError);
+        return nullptr;
+    }
+
+    URuntimeImageBundle* ImageBundle = NewObject<URuntimeImageBundle>();
+    ImageBundle->Reader = Reader;
+
+    UE_LOG(LogRuntimeImageBundle, Log, TEXT("Opened image bundle %s with %d images"), *Filename, Reader->GetEntries().Num());
+    return ImageBundle;
+}
+
+TArray<FString> URuntimeImageBundle::GetImageNames() const
+{
+    TArray<FString> Names;
+    if (Reader.IsValid())
+    {
+        Reader->GetEntries().GetKeys(Names);
+    }
+
+    return Names;
+}
+
+bool URuntimeImageBundle::Contains(const FString& Name) const
+{
+    return Reader.IsValid() && Reader->FindEntry(Name) != nullptr;
+}
+
+UTexture2D* URuntimeImageBundle::LoadTexture(const FString& Name, FString& OutError)
+{
+    check(IsInGameThread());
+
+    const FImageBundleEntry* Entry = Reader.IsValid() ? Reader->FindEntry(Name) : nullptr;
+    if (!Entry)
+    {
+        OutError = FString::Printf(TEXT("Image %s is not in the bundle"), *Name);
+        return nullptr;
+    }
+
+    // only the description, mips come from the mapped bundle
+    FRuntimeImageData ImageData;
+    ImageData.SizeX = Entry->SizeX;
+    ImageData.SizeY = Entry->SizeY;
+    ImageData.NumSlices = 1;
+    ImageData.SRGB = Entry->bSRGB;
+    ImageData.PixelFormat = Entry->PixelFormat;
+    ImageData.NumMips = Entry->MipSizes.Num();
+    Reader->GetMips(*Entry, ImageData.ExternalMips);
+
+    return CreateTexture(Name, ImageData, OutError);
+}
+
+UTexture2D* URuntimeImageBundle::LoadTextureCacheFile(const FString& Filename, FString& OutError)
+{
+    check(IsInGameThread());
+
+    FTextureCacheData CacheData;
+    if (!FTextureCacheFile::Load(Filename, CacheData, OutError))
+    {
+        UE_LOG(LogRuntimeImageBundle, Warning, TEXT("%s"), *OutError);
+        return nullptr;
+    }
+
+    // the texture factories upload mips that follow each other like in a bundle
+    int64 MipsSize = 0;
+    for (const TArray64<uint8>& Mip : CacheData.Mips)
+    {
+        MipsSize += Mip.Num();
+    }
+
+    TArray64<uint8> MipsData;
+    MipsData.Reserve(MipsSize);
+
+    FRuntimeImageData ImageData;
+    ImageData.SizeX = CacheData.SizeX;
+    ImageData.SizeY = CacheData.SizeY;
+    ImageData.NumSlices = 1;
+    ImageData.SRGB = CacheData.bSRGB;
+    ImageData.PixelFormat = CacheData.PixelFormat;
+    ImageData.NumMips = CacheData.Mips.Num();
+    for (TArray64<uint8>& Mip : CacheData.Mips)
+    {
+        ImageData.ExternalMips.Add(TArrayView64<const uint8>(MipsData.GetData() + MipsData.Num(), Mip.Num()));
+        MipsData.Append(Mip);
+        Mip.Empty();
+    }
+
+    return CreateTexture(FPaths::GetBaseFilename(Filename), ImageData, OutError);
+}
+
+UTexture2D* URuntimeImageBundle::CreateTexture(const FString& Name, FRuntimeImageData& ImageData, FString& OutError)
+{
+    if (!FRuntimeImageUtils::IsTextureResolutionValid(ImageData.SizeX, ImageData.SizeY))
+    {
+        OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d"), ImageData.SizeX, ImageData.SizeY);
+        return nullptr;
+    }
+
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
+    UTexture2D* Texture = FRuntimeImageUtils::CreateTexture(FPaths::GetCleanFilename(Name), ImageData);
+    Texture->RemoveFromRoot();
+
+    FRuntimeRHITexture2DFactory RHITexture2DFactory(Texture, ImageData);
+    if (!RHITexture2DFactory.Create())
+    {
+        OutError = FString::Printf(TEXT("Failed to create RHI texture 2D for %s, pixel format: %d"), *Name, (int32)ImageData.PixelFormat);
+        return nullptr;
+    }
+
+    FRuntimeTextureRegistry::Register(Texture, Name, ImageData.SizeX, ImageData.SizeY, ImageData.PixelFormat, ImageData.NumMips);
+    return Texture;
+}
+
+void URuntimeImageBundle::Close()
+{
+    Reader.Reset();
+}
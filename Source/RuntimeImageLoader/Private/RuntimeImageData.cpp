@@ -47,7 +47,7 @@ void FRuntimeImageData::Init2D(int32 InSizeX, int32 InSizeY, ETextureSourceForma
     TextureSourceFormat = InFormat;
     Format = ToRawImageFormat(InFormat);
 
-    const int32 RawDataSize = SizeX * SizeY * GetBytesPerPixel();
+    const int64 RawDataSize = (int64)SizeX * SizeY * GetBytesPerPixel();
 
     RawData.AddUninitialized(RawDataSize);
 
@@ -0,0 +1,294 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageDirectoryScan.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Helpers/ImageHeaderProbe.h"
+#include "RuntimeImageUtils.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageDirectoryScan, Log, All);
+
+// found by TArray serialization, so it can't live in the anonymous namespace
+static FArchive& operator<<(FArchive& Ar, FRuntimeImageFileInfo& FileInfo)
+{
+    return Ar << FileInfo.Filename << FileInfo.FileSize << FileInfo.Timestamp << FileInfo.Width << FileInfo.Height << FileInfo.Format;
+}
+
+namespace
+{
+    constexpr int32 IndexVersion = 1;
+
+    FString GetIndexFilename(const FString& Directory, bool bIsRecursive)
+    {
+        const FString CacheKey = FString::Printf(TEXT("%s|%d"), *FPaths::ConvertRelativePathToFull(Directory), bIsRecursive);
+        return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("RuntimeImageLoader"), TEXT("DirectoryIndex"), FMD5::HashAnsiString(*CacheKey) + TEXT(".bin"));
+    }
+
+    /** Probed files of the previous scan by filename */
+    void LoadIndex(const FString& IndexFilename, TMap<FString, FRuntimeImageFileInfo>& OutIndex)
+    {
+        TArray<uint8> IndexData;
+        if (!FFileHelper::LoadFileToArray(IndexData, *IndexFilename, FILEREAD_Silent))
+        {
+            return;
+        }
+
+        FMemoryReader Reader(IndexData);
+
+        int32 Version = 0;
+        TArray<FRuntimeImageFileInfo> Entries;
+        Reader << Version;
+        if (Version != IndexVersion)
+        {
+            return;
+        }
+
+        Reader << Entries;
+        if (Reader.IsError())
+        {
+            UE_LOG(LogRuntimeImageDirectoryScan, Warning, TEXT("Ignoring corrupted directory index %s"), *IndexFilename);
+            return;
+        }
+
+        OutIndex.Reserve(Entries.Num());
+        for (FRuntimeImageFileInfo& Entry : Entries)
+        {
+            FString Filename = Entry.Filename;
+            OutIndex.Add(MoveTemp(Filename), MoveTemp(Entry));
+        }
+    }
+
+    void SaveIndex(const FString& IndexFilename, TArray<FRuntimeImageFileInfo>& Entries)
+    {
+        TArray<uint8> IndexData;
+        FMemoryWriter Writer(IndexData);
+
+        int32 Version = IndexVersion;
+        Writer << Version;
+        Writer << Entries;
+
+        if (!FFileHelper::SaveArrayToFile(IndexData, *IndexFilename))
+        {
+            UE_LOG(LogRuntimeImageDirectoryScan, Warning, TEXT("Failed to save directory index %s"), *IndexFilename);
+        }
+    }
+
+    /** Lists one directory, stat data comes with the listing so files are never opened here */
+    void ListDirectory(const FString& Directory, bool bIsRecursive, const FRuntimeImageTaskHandle& TaskHandle, TArray<FRuntimeImageFileInfo>& OutFiles, TArray<FString>& OutDirectories)
+    {
+        IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+        PlatformFile.IterateDirectoryStat(*Directory, [&](const TCHAR* FilenameOrDirectory, const FFileStatData& StatData)
+        {
+            if (StatData.bIsDirectory)
+            {
+                if (bIsRecursive)
+                {
+                    OutDirectories.Add(FilenameOrDirectory);
+                }
+            }
+            else if (FRuntimeImageUtils::IsSupportedImageFile(FilenameOrDirectory))
+            {
+                FRuntimeImageFileInfo& FileInfo = OutFiles.AddDefaulted_GetRef();
+                FileInfo.Filename = FilenameOrDirectory;
+                FileInfo.FileSize = StatData.FileSize;
+                FileInfo.Timestamp = StatData.ModificationTime;
+            }
+
+            return !TaskHandle.IsCancelled();
+        });
+    }
+
+    /** Takes dimensions of unchanged files from the index, probes the rest in parallel */
+    void ProbeHeaders(TArray<FRuntimeImageFileInfo>& Files, const TMap<FString, FRuntimeImageFileInfo>& PreviousIndex, const FRuntimeImageTaskHandle& TaskHandle)
+    {
+        TArray<int32> ChangedFiles;
+        for (int32 FileIndex = 0; FileIndex < Files.Num(); ++FileIndex)
+        {
+            FRuntimeImageFileInfo& FileInfo = Files[FileIndex];
+
+            const FRuntimeImageFileInfo* IndexedFile = PreviousIndex.Find(FileInfo.Filename);
+            if (IndexedFile && IndexedFile->FileSize == FileInfo.FileSize && IndexedFile->Timestamp == FileInfo.Timestamp && !IndexedFile->Format.IsEmpty())
+            {
+                FileInfo.Width = IndexedFile->Width;
+                FileInfo.Height = IndexedFile->Height;
+                FileInfo.Format = IndexedFile->Format;
+            }
+            else
+            {
+                ChangedFiles.Add(FileIndex);
+            }
+        }
+
+        ParallelFor(ChangedFiles.Num(), [&](int32 ChangedIndex)
+        {
+            if (TaskHandle.IsCancelled())
+            {
+                return;
+            }
+
+            FRuntimeImageFileInfo& FileInfo = Files[ChangedFiles[ChangedIndex]];
+            if (!FImageHeaderProbe::ProbeFile(FileInfo.Filename, FileInfo.Width, FileInfo.Height, FileInfo.Format))
+            {
+                UE_LOG(LogRuntimeImageDirectoryScan, Verbose, TEXT("Unrecognized image header: %s"), *FileInfo.Filename);
+            }
+        });
+    }
+}
+
+URuntimeImageDirectoryScan* URuntimeImageDirectoryScan::ScanDirectory(const FString& Directory, bool bIsRecursive, bool bProbeHeaders, ERuntimeImagePriority Priority)
+{
+    URuntimeImageDirectoryScan* DirectoryScan = NewObject<URuntimeImageDirectoryScan>();
+    DirectoryScan->Start(Directory, bIsRecursive, bProbeHeaders, Priority);
+
+    return DirectoryScan;
+}
+
+void URuntimeImageDirectoryScan::Cancel()
+{
+    ScanTaskHandle.Cancel();
+    ScanTaskHandle = FRuntimeImageTaskHandle();
+}
+
+void URuntimeImageDirectoryScan::BeginDestroy()
+{
+    ScanTaskHandle.Cancel();
+
+    Super::BeginDestroy();
+}
+
+void URuntimeImageDirectoryScan::Start(const FString& Directory, bool bIsRecursive, bool bProbeHeaders, ERuntimeImagePriority Priority)
+{
+    TWeakObjectPtr<URuntimeImageDirectoryScan> WeakThis(this);
+
+    ScanTaskHandle = FRuntimeImageScheduler::Get().Schedule(
+        [WeakThis, Directory, bIsRecursive, bProbeHeaders](const FRuntimeImageTaskHandle& InTaskHandle)
+        {
+            // the owner has already dropped the handle of a cancelled scan
+            if (InTaskHandle.IsCancelled())
+            {
+                return;
+            }
+
+            if (Directory.IsEmpty() || !IFileManager::Get().DirectoryExists(*Directory))
+            {
+                const FString Error = FString::Printf(TEXT("Directory not found: %s"), *Directory);
+                AsyncTask(ENamedThreads::GameThread, [WeakThis, Error]()
+                {
+                    if (URuntimeImageDirectoryScan* DirectoryScan = WeakThis.Get())
+                    {
+                        DirectoryScan->OnScanFinished(Error);
+                    }
+                });
+                return;
+            }
+
+            const FString IndexFilename = GetIndexFilename(Directory, bIsRecursive);
+
+            TMap<FString, FRuntimeImageFileInfo> PreviousIndex;
+            if (bProbeHeaders)
+            {
+                LoadIndex(IndexFilename, PreviousIndex);
+            }
+
+            TArray<FRuntimeImageFileInfo> NewIndex;
+            TArray<FString> PendingDirectories = { Directory };
+
+            // breadth first, directories of one level are listed in parallel
+            while (PendingDirectories.Num() > 0 && !InTaskHandle.IsCancelled())
+            {
+                TArray<TArray<FRuntimeImageFileInfo>> DirectoryFiles;
+                TArray<TArray<FString>> Subdirectories;
+                DirectoryFiles.SetNum(PendingDirectories.Num());
+                Subdirectories.SetNum(PendingDirectories.Num());
+
+                ParallelFor(PendingDirectories.Num(), [&](int32 DirectoryIndex)
+                {
+                    ListDirectory(PendingDirectories[DirectoryIndex], bIsRecursive, InTaskHandle, DirectoryFiles[DirectoryIndex], Subdirectories[DirectoryIndex]);
+                });
+
+                TArray<FRuntimeImageFileInfo> Batch;
+                PendingDirectories.Reset();
+                for (int32 DirectoryIndex = 0; DirectoryIndex < DirectoryFiles.Num(); ++DirectoryIndex)
+                {
+                    Batch.Append(MoveTemp(DirectoryFiles[DirectoryIndex]));
+                    PendingDirectories.Append(MoveTemp(Subdirectories[DirectoryIndex]));
+                }
+
+                if (bProbeHeaders)
+                {
+                    ProbeHeaders(Batch, PreviousIndex, InTaskHandle);
+                    NewIndex.Append(Batch);
+                }
+
+                if (Batch.Num() > 0 && !InTaskHandle.IsCancelled())
+                {
+                    AsyncTask(ENamedThreads::GameThread, [WeakThis, Batch = MoveTemp(Batch)]() mutable
+                    {
+                        if (URuntimeImageDirectoryScan* DirectoryScan = WeakThis.Get())
+                        {
+                            DirectoryScan->OnBatchFound(MoveTemp(Batch));
+                        }
+                    });
+                }
+            }
+
+            if (InTaskHandle.IsCancelled())
+            {
+                return;
+            }
+
+            // files gone since the last scan drop out of the index
+            if (bProbeHeaders)
+            {
+                SaveIndex(IndexFilename, NewIndex);
+            }
+
+            AsyncTask(ENamedThreads::GameThread, [WeakThis]()
+            {
+                if (URuntimeImageDirectoryScan* DirectoryScan = WeakThis.Get())
+                {
+                    DirectoryScan->OnScanFinished(FString());
+                }
+            });
+        },
+        Priority
+    );
+}
+
+void URuntimeImageDirectoryScan::OnBatchFound(TArray<FRuntimeImageFileInfo>&& Batch)
+{
+    if (!ScanTaskHandle.IsValid())
+    {
+        return;
+    }
+
+    Images.Append(Batch);
+    OnImagesFound.Broadcast(Batch);
+}
+
+void URuntimeImageDirectoryScan::OnScanFinished(const FString& Error)
+{
+    if (!ScanTaskHandle.IsValid())
+    {
+        return;
+    }
+
+    ScanTaskHandle = FRuntimeImageTaskHandle();
+
+    if (!Error.IsEmpty())
+    {
+        UE_LOG(LogRuntimeImageDirectoryScan, Warning, TEXT("Directory scan failed: %s"), *Error);
+        OnFail.Broadcast(Error);
+        return;
+    }
+
+    UE_LOG(LogRuntimeImageDirectoryScan, Log, TEXT("Directory scan found %d images"), Images.Num());
+    OnCompleted.Broadcast(Images.Num());
+}
@@ -10,9 +10,143 @@
 #include "Interfaces/IPluginManager.h"
 #include "RuntimeImageUtils.h"
 #include "InputImageDescription.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Helpers/ImageTensorWriter.h"
+#include "Helpers/RequestCapture.h"
+#include "ImageReaders/ImageReaderFactory.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/Paths.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
+#include "RuntimeImageLoaderTrace.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageLoader, Log, All);
 
+namespace
+{
+    URuntimeImageLoader* GetConsoleLoader(UWorld* World)
+    {
+        URuntimeImageLoader* Loader = IsValid(World) ? World->GetSubsystem<URuntimeImageLoader>() : nullptr;
+        if (!Loader)
+        {
+            UE_LOG(LogRuntimeImageLoader, Warning, TEXT("No game world with a RuntimeImageLoader"));
+        }
+        return Loader;
+    }
+
+    void LogStageLatency(FOutputDevice& Ar, const TCHAR* Stage, const FRuntimeImageStageLatency& Latency)
+    {
+        Ar.Logf(TEXT("  %-14s %10lld  %9.2f  %9.2f"), Stage, Latency.Count, Latency.AverageMs, Latency.P95Ms);
+    }
+
+    FAutoConsoleCommandWithWorldArgsAndOutputDevice StatsCommand(
+        TEXT("ril.Stats"),
+        TEXT("Prints queue depth, stage latencies, cache hit rate and resident memory of RuntimeImageLoader. ril.Stats reset clears the totals"),
+        FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+        {
+            if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+            {
+                FRuntimeImageLoaderCounters::Reset();
+                return;
+            }
+
+            if (URuntimeImageLoader* Loader = GetConsoleLoader(World))
+            {
+                const FRuntimeImageLoaderStats Stats = Loader->GetLoaderStats();
+
+                Ar.Logf(TEXT("Requests: %d queued, %d in flight, %lld completed, %lld failed"), Stats.QueuedRequests, Stats.InFlightRequests, Stats.CompletedRequests, Stats.FailedRequests);
+                Ar.Logf(TEXT("Scheduler tasks: %d queued, %d running"), Stats.QueuedTasks, Stats.RunningTasks);
+                Ar.Logf(TEXT("Cache: %lld hits, %lld misses, %.1f%% hit rate"), Stats.CacheHits, Stats.CacheMisses, Stats.CacheHitRate * 100.0f);
+                Ar.Logf(
+                    TEXT("Bytes: %.2f MB read, %.2f MB decoded, %.2f MB uploaded"),
+                    Stats.BytesRead / (1024.0 * 1024.0), Stats.BytesDecoded / (1024.0 * 1024.0), Stats.BytesUploaded / (1024.0 * 1024.0)
+                );
+                Ar.Logf(TEXT("Resident: %d textures, %.2f MB"), Stats.ResidentTextures, Stats.ResidentBytes / (1024.0 * 1024.0));
+
+                Ar.Logf(TEXT("  %-14s %10s  %9s  %9s"), TEXT("Stage"), TEXT("Count"), TEXT("Avg (ms)"), TEXT("P95 (ms)"));
+                LogStageLatency(Ar, TEXT("Read"), Stats.Read);
+                LogStageLatency(Ar, TEXT("Decode"), Stats.Decode);
+                LogStageLatency(Ar, TEXT("Transform"), Stats.Transform);
+                LogStageLatency(Ar, TEXT("CreateUObject"), Stats.CreateUObject);
+                LogStageLatency(Ar, TEXT("Upload"), Stats.Upload);
+                LogStageLatency(Ar, TEXT("Callback"), Stats.Callback);
+                LogStageLatency(Ar, TEXT("Total"), Stats.Total);
+            }
+        })
+    );
+
+    FAutoConsoleCommandWithWorldArgsAndOutputDevice DumpQueueCommand(
+        TEXT("ril.DumpQueue"),
+        TEXT("Lists the active and queued requests of RuntimeImageLoader"),
+        FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+        {
+            if (URuntimeImageLoader* Loader = GetConsoleLoader(World))
+            {
+                Loader->DumpQueue(Ar);
+            }
+        })
+    );
+
+    FAutoConsoleCommandWithWorldAndArgs RecordCommand(
+        TEXT("ril.Record"),
+        TEXT("Records queued image requests. ril.Record [CaptureDirectory], defaults to Saved/RuntimeImageLoader/Captures/<timestamp>"),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+        {
+            if (URuntimeImageLoader* Loader = GetConsoleLoader(World))
+            {
+                const FString CaptureDirectory = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("RuntimeImageLoader") / TEXT("Captures") / FDateTime::Now().ToString();
+
+                FString Error;
+                if (!Loader->StartRecording(FPaths::ConvertRelativePathToFull(CaptureDirectory), Error))
+                {
+                    UE_LOG(LogRuntimeImageLoader, Error, TEXT("%s"), *Error);
+                }
+            }
+        })
+    );
+
+    FAutoConsoleCommandWithWorldAndArgs StopRecordingCommand(
+        TEXT("ril.StopRecording"),
+        TEXT("Stops recording image requests"),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+        {
+            if (URuntimeImageLoader* Loader = GetConsoleLoader(World))
+            {
+                Loader->StopRecording();
+            }
+        })
+    );
+
+    FAutoConsoleCommandWithWorldAndArgs ReplayCommand(
+        TEXT("ril.Replay"),
+        TEXT("Replays recorded image requests and logs latency percentiles. ril.Replay <CaptureDirectory> [Speed=1] [HttpPort=8787] [HttpRoot=<CaptureDirectory>/http]"),
+        FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+        {
+            if (Args.Num() == 0)
+            {
+                UE_LOG(LogRuntimeImageLoader, Warning, TEXT("Usage: ril.Replay <CaptureDirectory> [Speed=1] [HttpPort=8787] [HttpRoot=<CaptureDirectory>/http]"));
+                return;
+            }
+
+            if (URuntimeImageLoader* Loader = GetConsoleLoader(World))
+            {
+                const float Speed = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 1.0f;
+                const uint32 HttpPort = Args.Num() > 2 ? (uint32)FCString::Atoi(*Args[2]) : 8787;
+                const FString HttpRoot = Args.Num() > 3 ? FPaths::ConvertRelativePathToFull(Args[3]) : FString();
+
+                FString Error;
+                if (!Loader->StartReplay(FPaths::ConvertRelativePathToFull(Args[0]), HttpRoot, HttpPort, Speed, Error))
+                {
+                    UE_LOG(LogRuntimeImageLoader, Error, TEXT("%s"), *Error);
+                }
+            }
+        })
+    );
+}
+
 void URuntimeImageLoader::Initialize(FSubsystemCollectionBase& Collection)
 {
     InitializeImageReader();
@@ -20,6 +154,9 @@ void URuntimeImageLoader::Initialize(FSubsystemCollectionBase& Collection)
 
 void URuntimeImageLoader::Deinitialize()
 {
+    StopRecording();
+    Replay.Reset();
+
     ImageReader->Deinitialize();
     ImageReader = nullptr;
 }
@@ -79,7 +216,7 @@ void URuntimeImageLoader::LoadImageAsync(const FString& ImageFilename, const FTr
         );
     }
 
-    Requests.Enqueue(Request);
+    EnqueueRequest(Request);
 }
 
 void URuntimeImageLoader::LoadImageFromBytesAsync(UPARAM(ref) TArray<uint8>& ImageBytes, const FTransformImageParams& TransformParams, UTexture2D*& OutTexture, bool& bSuccess, FString& OutError, FLatentActionInfo LatentInfo, UObject* WorldContextObject /*= nullptr*/)
@@ -132,7 +269,7 @@ void URuntimeImageLoader::LoadImageFromBytesAsync(UPARAM(ref) TArray<uint8>& Ima
         );
     }
 
-    Requests.Enqueue(Request);
+    EnqueueRequest(Request);
 }
 
 void URuntimeImageLoader::LoadHDRIAsCubemapAsync(const FString& ImageFilename, const FTransformImageParams& TransformParams, UTextureCube*& OutTextureCube, bool& bSuccess, FString& OutError, FLatentActionInfo LatentInfo, UObject* WorldContextObject /*= nullptr*/)
@@ -194,7 +331,7 @@ void URuntimeImageLoader::LoadHDRIAsCubemapAsync(const FString& ImageFilename, c
         );
     }
 
-    Requests.Enqueue(Request);
+    EnqueueRequest(Request);
 }
 
 void URuntimeImageLoader::LoadImageSync(const FString& ImageFilename, const FTransformImageParams& TransformParams, UTexture2D*& OutTexture, bool& bSuccess, FString& OutError)
@@ -288,7 +425,147 @@ void URuntimeImageLoader::LoadImagePixels(const FInputImageDescription& InputIma
         );
     }
 
-    Requests.Enqueue(Request);
+    EnqueueRequest(Request);
+}
+
+void URuntimeImageLoader::LoadImageData(const FInputImageDescription& InputImage, FOnImageDataLoaded&& OnLoaded)
+{
+    FLoadImageRequest Request;
+    {
+        Request.Params.InputImage = InputImage;
+        Request.Params.TransformParams.bNativeImageData = true;
+
+        Request.OnRequestCompleted.BindLambda(
+            [OnLoaded = MoveTemp(OnLoaded)](const FImageReadResult& ReadResult)
+            {
+                if (!ReadResult.OutError.IsEmpty())
+                {
+                    UE_LOG(LogRuntimeImageLoader, Error, TEXT("Failed to load image. Error: %s"), *ReadResult.OutError);
+                }
+
+                OnLoaded.ExecuteIfBound(ReadResult.OutImageData, ReadResult.OutError);
+            }
+        );
+    }
+
+    EnqueueRequest(Request);
+}
+
+TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> URuntimeImageLoader::LoadImageDataSync(const FInputImageDescription& InputImage, FString& OutError)
+{
+    FImageReadRequest ReadRequest;
+    {
+        ReadRequest.InputImage = InputImage;
+        ReadRequest.TransformParams.bNativeImageData = true;
+    }
+
+    ImageReader->BlockTillAllRequestsFinished();
+    ImageReader->AddRequest(ReadRequest);
+    ImageReader->BlockTillAllRequestsFinished();
+
+    FImageReadResult ReadResult;
+    ImageReader->GetResult(ReadResult);
+
+    OutError = ReadResult.OutError;
+    return ReadResult.OutImageData;
+}
+
+void URuntimeImageLoader::LoadImage(const FInputImageDescription& InputImage, const FTransformImageParams& TransformParams, FOnRequestCompleted&& OnCompleted)
+{
+    FLoadImageRequest Request;
+    {
+        Request.Params.InputImage = InputImage;
+        Request.Params.TransformParams = TransformParams;
+        Request.OnRequestCompleted = MoveTemp(OnCompleted);
+    }
+
+    EnqueueRequest(Request);
+}
+
+bool URuntimeImageLoader::LoadImagesToTensorSync(const TArray<FInputImageDescription>& Images, const FImageTensorParams& Params, void* OutTensor, int64 TensorSizeBytes, TArray<FString>& OutErrors)
+{
+    OutErrors.Reset();
+
+    if (!Params.IsValid())
+    {
+        OutErrors.Init(TEXT("Invalid tensor params"), Images.Num());
+        return false;
+    }
+
+    const int64 SliceSizeBytes = Params.GetImageSizeBytes();
+    if (!OutTensor || TensorSizeBytes < SliceSizeBytes * Images.Num())
+    {
+        OutErrors.Init(FString::Printf(TEXT("Tensor of %lld bytes can't hold %d images of %lld bytes"), TensorSizeBytes, Images.Num(), SliceSizeBytes), Images.Num());
+        return false;
+    }
+
+    OutErrors.SetNum(Images.Num());
+
+    // http reads wait for the game thread to tick the request, doing that from the game thread would never return
+    const bool bCanReadURLs = !IsInGameThread();
+
+    ParallelFor(Images.Num(), [&](int32 ImageIndex)
+    {
+        uint8* Slice = (uint8*)OutTensor + SliceSizeBytes * ImageIndex;
+
+        const FInputImageDescription& InputImage = Images[ImageIndex];
+        if (!bCanReadURLs && InputImage.ImageBytes.Num() == 0 && FImageReaderFactory::IsRemoteURI(InputImage.ImageFilename))
+        {
+            OutErrors[ImageIndex] = FString::Printf(TEXT("Can't download %s synchronously on the game thread, use LoadImagesToTensor or pass the image bytes"), *InputImage.ImageFilename);
+            FMemory::Memzero(Slice, SliceSizeBytes);
+            return;
+        }
+
+        FRuntimeImageData Image;
+        if (FRuntimeImageUtils::ImportImage(InputImage, Image, OutErrors[ImageIndex]))
+        {
+            FImageTensorWriter::WriteImage(Image, Params, Slice);
+        }
+        else
+        {
+            FMemory::Memzero(Slice, SliceSizeBytes);
+        }
+    });
+
+    bool bSuccess = true;
+    for (int32 ImageIndex = 0; ImageIndex < Images.Num(); ++ImageIndex)
+    {
+        if (!OutErrors[ImageIndex].IsEmpty())
+        {
+            UE_LOG(LogRuntimeImageLoader, Error, TEXT("Failed to load image %d into tensor. Error: %s"), ImageIndex, *OutErrors[ImageIndex]);
+            bSuccess = false;
+        }
+    }
+
+    return bSuccess;
+}
+
+FRuntimeImageTaskHandle URuntimeImageLoader::LoadImagesToTensor(const TArray<FInputImageDescription>& Images, const FImageTensorParams& Params, void* OutTensor, int64 TensorSizeBytes, FOnTensorLoaded&& OnLoaded, ERuntimeImagePriority Priority /*= ERuntimeImagePriority::Normal*/)
+{
+    return FRuntimeImageScheduler::Get().Schedule(
+        [Images, Params, OutTensor, TensorSizeBytes, OnLoaded = MoveTemp(OnLoaded)](const FRuntimeImageTaskHandle& InTaskHandle) mutable
+        {
+            TArray<FString> Errors;
+            bool bSuccess = false;
+
+            if (InTaskHandle.IsCancelled())
+            {
+                Errors.Init(TEXT("Tensor request was cancelled"), Images.Num());
+            }
+            else
+            {
+                bSuccess = LoadImagesToTensorSync(Images, Params, OutTensor, TensorSizeBytes, Errors);
+            }
+
+            AsyncTask(
+                ENamedThreads::GameThread, [OnLoaded = MoveTemp(OnLoaded), bSuccess, Errors = MoveTemp(Errors)]()
+                {
+                    OnLoaded.ExecuteIfBound(bSuccess, Errors);
+                }
+            );
+        },
+        Priority
+    );
 }
 
 void URuntimeImageLoader::CancelAll()
@@ -302,7 +579,13 @@ void URuntimeImageLoader::CancelAll()
     return;
 #endif
 
+    if (Recorder.IsValid())
+    {
+        Recorder->RecordCancelAll();
+    }
+
     Requests.Empty();
+    NumQueuedRequests = 0;
     ActiveRequest.Invalidate();
 
     ImageReader->Clear();
@@ -324,13 +607,9 @@ public:
         {
             const FString Filename(FilenameOrDirectory);
 
-            for (const FString& ImageFormat : FRuntimeImageUtils::SupportedImageFormats)
+            if (FRuntimeImageUtils::IsSupportedImageFile(Filename))
             {
-                if (Filename.EndsWith(ImageFormat))
-                {
-                    Files.Add(Filename);
-                    break;
-                }
+                Files.Add(Filename);
             }
         }
         return true;
@@ -367,33 +646,161 @@ FString URuntimeImageLoader::GetThisPluginResourcesDirectory()
     return IPluginManager::Get().FindPlugin(TEXT("RuntimeImageLoader"))->GetBaseDir() / TEXT("Resources");
 }
 
+FRuntimeImageLoaderStats URuntimeImageLoader::GetLoaderStats() const
+{
+    FRuntimeImageLoaderStats Stats;
+    FRuntimeImageLoaderCounters::GetSnapshot(Stats);
+
+    Stats.QueuedRequests = NumQueuedRequests;
+    Stats.InFlightRequests = ActiveRequest.IsRequestValid() ? 1 : 0;
+
+    Stats.ResidentTextures = FRuntimeTextureRegistry::GetNumTextures();
+    Stats.ResidentBytes = FRuntimeTextureRegistry::GetResidentBytes();
+
+    return Stats;
+}
+
+void URuntimeImageLoader::DumpQueue(FOutputDevice& Ar)
+{
+    check(IsInGameThread());
+
+    const double Now = FPlatformTime::Seconds();
+    auto LogRequest = [&Ar, Now](const TCHAR* State, const FLoadImageRequest& Request)
+    {
+        const FInputImageDescription& InputImage = Request.Params.InputImage;
+        const FString Source = InputImage.ImageFilename.Len() > 0 ? InputImage.ImageFilename : FString::Printf(TEXT("<%d bytes>"), InputImage.ImageBytes.Num());
+
+        Ar.Logf(TEXT("%-8s  %8.2f  %s"), State, Now - Request.QueuedTime, *Source);
+    };
+
+    Ar.Logf(TEXT("%-8s  %8s  %s"), TEXT("State"), TEXT("Age (s)"), TEXT("Source"));
+
+    if (ActiveRequest.IsRequestValid())
+    {
+        LogRequest(TEXT("Active"), ActiveRequest);
+    }
+
+    // TQueue can't be iterated, requests go through a temporary queue and back in the same order
+    TQueue<FLoadImageRequest> VisitedRequests;
+    FLoadImageRequest Request;
+    while (Requests.Dequeue(Request))
+    {
+        LogRequest(TEXT("Queued"), Request);
+        VisitedRequests.Enqueue(MoveTemp(Request));
+    }
+    while (VisitedRequests.Dequeue(Request))
+    {
+        Requests.Enqueue(MoveTemp(Request));
+    }
+
+    const FRuntimeImageScheduler& Scheduler = FRuntimeImageScheduler::Get();
+    Ar.Logf(
+        TEXT("%d active, %d queued requests. Scheduler: %d running, %d queued tasks"),
+        ActiveRequest.IsRequestValid() ? 1 : 0, NumQueuedRequests, Scheduler.GetNumRunningTasks(), Scheduler.GetNumQueuedTasks()
+    );
+}
+
+bool URuntimeImageLoader::StartRecording(const FString& CaptureDirectory, FString& OutError)
+{
+    if (Recorder.IsValid() || Replay.IsValid())
+    {
+        OutError = TEXT("Already recording or replaying image requests");
+        return false;
+    }
+
+    TSharedPtr<FRequestRecorder> NewRecorder = MakeShared<FRequestRecorder>();
+    if (!NewRecorder->Start(CaptureDirectory, OutError))
+    {
+        return false;
+    }
+
+    Recorder = NewRecorder;
+    return true;
+}
+
+void URuntimeImageLoader::StopRecording()
+{
+    if (Recorder.IsValid())
+    {
+        Recorder->Stop();
+        Recorder.Reset();
+    }
+}
+
+bool URuntimeImageLoader::StartReplay(const FString& CaptureDirectory, const FString& HttpRoot, uint32 HttpPort, float Speed, FString& OutError)
+{
+    if (Recorder.IsValid() || Replay.IsValid())
+    {
+        OutError = TEXT("Already recording or replaying image requests");
+        return false;
+    }
+
+    TSharedPtr<FRequestReplay> NewReplay = MakeShared<FRequestReplay>();
+    if (!NewReplay->Start(CaptureDirectory, HttpRoot, HttpPort, Speed, OutError))
+    {
+        return false;
+    }
+
+    Replay = NewReplay;
+    return true;
+}
+
 void URuntimeImageLoader::Tick(float DeltaTime)
 {
     ensure(IsValid(ImageReader));
+
+    if (Replay.IsValid())
+    {
+        Replay->Tick(*this);
+
+        if (Replay->IsFinished())
+        {
+            Replay.Reset();
+        }
+    }
     
     if (!ActiveRequest.IsRequestValid() && !Requests.IsEmpty())
     {
         Requests.Dequeue(ActiveRequest);
+        --NumQueuedRequests;
 
-        FImageReadRequest ReadRequest(ActiveRequest.Params);
-
-        ImageReader->AddRequest(ReadRequest);
-        ImageReader->Trigger();
+        ImageReader->ScheduleRequest(ActiveRequest.Params);
     }
 
-    if (ActiveRequest.IsRequestValid() && ImageReader->IsWorkCompleted())
+    FImageReadResult ReadResult;
+    if (ActiveRequest.IsRequestValid() && ImageReader->GetScheduledResult(ReadResult))
     {
-        FImageReadResult ReadResult;
-        ImageReader->GetResult(ReadResult);
-
         ensure(ActiveRequest.OnRequestCompleted.IsBound());
 
-        ActiveRequest.OnRequestCompleted.Execute(ReadResult);
+        FRuntimeImageLoaderCounters::AddRequestCompleted(ReadResult.OutError.IsEmpty(), FPlatformTime::Seconds() - ActiveRequest.QueuedTime);
+
+        {
+            RUNTIMEIMAGELOADER_TRACE_STAGE(ActiveRequest.Params.TraceRequestId, Callback);
+            RUNTIMEIMAGELOADER_STAGE_TIME(Callback);
+            ActiveRequest.OnRequestCompleted.Execute(ReadResult);
+        }
+        RUNTIMEIMAGELOADER_TRACE(RequestCompleted, ActiveRequest.Params.TraceRequestId, (int32)ReadResult.OutPixelFormat, ReadResult.OutError.IsEmpty());
 
         ActiveRequest.Invalidate();
     }
 }
 
+void URuntimeImageLoader::EnqueueRequest(FLoadImageRequest& Request)
+{
+    Request.Params.TraceRequestId = FRuntimeImageLoaderTrace::NewRequestId();
+    RUNTIMEIMAGELOADER_TRACE(RequestQueued, Request.Params.TraceRequestId, Request.Params.InputImage.ImageFilename, Request.Params.InputImage.ImageBytes.Num());
+
+    if (Recorder.IsValid())
+    {
+        Recorder->RecordLoad(Request.Params);
+    }
+
+    Request.QueuedTime = FPlatformTime::Seconds();
+
+    Requests.Enqueue(Request);
+    ++NumQueuedRequests;
+}
+
 TStatId URuntimeImageLoader::GetStatId() const
 {
     RETURN_QUICK_DECLARE_CYCLE_STAT(URuntimeImageLoader, STATGROUP_Tickables);
@@ -0,0 +1,210 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageLoaderMemory.h"
+#include "Async/Async.h"
+#include "Engine/Texture.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/ScopeLock.h"
+#include "RenderUtils.h"
+#include "UObject/UObjectGlobals.h"
+#include "UObject/WeakObjectPtr.h"
+
+#if ENGINE_MAJOR_VERSION >= 5
+
+LLM_DEFINE_TAG(RuntimeImageLoader);
+LLM_DEFINE_TAG(RuntimeImageLoader_Compressed, TEXT("Compressed"), TEXT("RuntimeImageLoader"));
+LLM_DEFINE_TAG(RuntimeImageLoader_Decode, TEXT("Decode"), TEXT("RuntimeImageLoader"));
+LLM_DEFINE_TAG(RuntimeImageLoader_Animation, TEXT("Animation"), TEXT("RuntimeImageLoader"));
+LLM_DEFINE_TAG(RuntimeImageLoader_Cubemap, TEXT("Cubemap"), TEXT("RuntimeImageLoader"));
+LLM_DEFINE_TAG(RuntimeImageLoader_Textures, TEXT("Textures"), TEXT("RuntimeImageLoader"));
+
+#elif LLM_STAT_TAGS_ENABLED
+
+DEFINE_STAT(STAT_RuntimeImageLoader_CompressedLLM);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeLLM);
+DEFINE_STAT(STAT_RuntimeImageLoader_AnimationLLM);
+DEFINE_STAT(STAT_RuntimeImageLoader_CubemapLLM);
+DEFINE_STAT(STAT_RuntimeImageLoader_TexturesLLM);
+
+#endif
+
+namespace
+{
+    struct FRegisteredTexture
+    {
+        TWeakObjectPtr<UTexture> Texture;
+        FString Source;
+        int32 SizeX = 0;
+        int32 SizeY = 0;
+        EPixelFormat PixelFormat = PF_Unknown;
+        int64 SizeBytes = 0;
+        double CreationTime = 0.0;
+    };
+
+    FCriticalSection RegisteredTexturesLock;
+    TArray<FRegisteredTexture> RegisteredTextures;
+
+    /** Registrations since stale entries were last dropped, keeps pruning linear over many loads. Guarded by RegisteredTexturesLock */
+    int32 NumRegisteredSincePrune = 0;
+
+    /** A prune was queued to the game thread by a registration from another thread. Guarded by RegisteredTexturesLock */
+    bool bPruneQueued = false;
+
+    /** Totals of the registered entries, read without the lock or a walk over the list */
+    FThreadSafeCounter NumResidentTextures;
+    FThreadSafeCounter64 NumResidentBytes;
+
+    FDelegateHandle PostGarbageCollectHandle;
+
+    /** Weak pointers are only resolved on the game thread, where they can't race garbage collection */
+    void PruneTextures()
+    {
+        check(IsInGameThread());
+
+        FScopeLock Lock(&RegisteredTexturesLock);
+        RegisteredTextures.RemoveAllSwap([](const FRegisteredTexture& Entry)
+        {
+            if (Entry.Texture.IsValid())
+            {
+                return false;
+            }
+
+            NumResidentTextures.Decrement();
+            NumResidentBytes.Subtract(Entry.SizeBytes);
+            return true;
+        });
+        NumRegisteredSincePrune = 0;
+        bPruneQueued = false;
+    }
+
+    FAutoConsoleCommandWithOutputDevice DumpTexturesCommand(
+        TEXT("ril.DumpTextures"),
+        TEXT("Lists live textures created by RuntimeImageLoader with their sizes and sources"),
+        FConsoleCommandWithOutputDeviceDelegate::CreateStatic(&FRuntimeTextureRegistry::Dump)
+    );
+}
+
+void FRuntimeTextureRegistry::Register(UTexture* Texture, const FString& Source, int32 SizeX, int32 SizeY, EPixelFormat PixelFormat, int32 NumMips, int32 NumFaces /*= 1*/)
+{
+    if (!Texture)
+    {
+        return;
+    }
+
+    FScopeLock Lock(&RegisteredTexturesLock);
+
+    FRegisteredTexture& Entry = RegisteredTextures.AddDefaulted_GetRef();
+    Entry.Texture = Texture;
+    Entry.Source = Source.IsEmpty() ? TEXT("<bytes>") : Source;
+    Entry.SizeX = SizeX;
+    Entry.SizeY = SizeY;
+    Entry.PixelFormat = PixelFormat;
+    Entry.SizeBytes = (int64)CalcTextureSize(SizeX, SizeY, PixelFormat, FMath::Max(NumMips, 1)) * NumFaces;
+    Entry.CreationTime = FPlatformTime::Seconds();
+
+    NumResidentTextures.Increment();
+    NumResidentBytes.Add(Entry.SizeBytes);
+
+    // textures registered from workers would otherwise grow the list until the game thread happens to register one
+    ++NumRegisteredSincePrune;
+    if (NumRegisteredSincePrune >= FMath::Max(RegisteredTextures.Num() / 2, 64))
+    {
+        if (IsInGameThread())
+        {
+            PruneTextures();
+        }
+        else if (!bPruneQueued)
+        {
+            bPruneQueued = true;
+            AsyncTask(ENamedThreads::GameThread, []() { PruneTextures(); });
+        }
+    }
+}
+
+void FRuntimeTextureRegistry::Unregister(UTexture* Texture)
+{
+    check(IsInGameThread());
+
+    if (!Texture)
+    {
+        return;
+    }
+
+    FScopeLock Lock(&RegisteredTexturesLock);
+    RegisteredTextures.RemoveAllSwap([Texture](const FRegisteredTexture& Entry)
+    {
+        if (Entry.Texture.Get() != Texture)
+        {
+            return false;
+        }
+
+        NumResidentTextures.Decrement();
+        NumResidentBytes.Subtract(Entry.SizeBytes);
+        return true;
+    });
+}
+
+void FRuntimeTextureRegistry::Startup()
+{
+    // without it the totals only drop when registrations pile up or the list is dumped
+    PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddStatic(&PruneTextures);
+}
+
+void FRuntimeTextureRegistry::Shutdown()
+{
+    FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+    PostGarbageCollectHandle.Reset();
+}
+
+void FRuntimeTextureRegistry::Dump(FOutputDevice& Ar)
+{
+    PruneTextures();
+
+    FScopeLock Lock(&RegisteredTexturesLock);
+
+    TArray<const FRegisteredTexture*> SortedTextures;
+    for (const FRegisteredTexture& Entry : RegisteredTextures)
+    {
+        SortedTextures.Add(&Entry);
+    }
+    SortedTextures.Sort([](const FRegisteredTexture& A, const FRegisteredTexture& B) { return A.SizeBytes > B.SizeBytes; });
+
+    const double Now = FPlatformTime::Seconds();
+    int64 TotalBytes = 0;
+    int32 NumTextures = 0;
+
+    Ar.Logf(TEXT("%10s  %11s  %-22s  %-22s  %8s  %s"), TEXT("KB"), TEXT("Size"), TEXT("Format"), TEXT("Class"), TEXT("Age (s)"), TEXT("Name / Source"));
+    for (const FRegisteredTexture* Entry : SortedTextures)
+    {
+        // textures going away are skipped rather than dereferenced
+        const UTexture* Texture = Entry->Texture.Get();
+        if (!Texture)
+        {
+            continue;
+        }
+
+        Ar.Logf(
+            TEXT("%10.1f  %5d x %-5d %-22s  %-22s  %8.1f  %s / %s"),
+            Entry->SizeBytes / 1024.0, Entry->SizeX, Entry->SizeY, GetPixelFormatString(Entry->PixelFormat), *Texture->GetClass()->GetName(),
+            Now - Entry->CreationTime, *Texture->GetName(), *Entry->Source
+        );
+
+        TotalBytes += Entry->SizeBytes;
+        ++NumTextures;
+    }
+
+    Ar.Logf(TEXT("%d runtime textures, %.2f MB"), NumTextures, TotalBytes / (1024.0 * 1024.0));
+}
+
+int32 FRuntimeTextureRegistry::GetNumTextures()
+{
+    return NumResidentTextures.GetValue();
+}
+
+int64 FRuntimeTextureRegistry::GetResidentBytes()
+{
+    return NumResidentBytes.GetValue();
+}
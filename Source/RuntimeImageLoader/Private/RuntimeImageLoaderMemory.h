@@ -0,0 +1,72 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "PixelFormat.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+class FOutputDevice;
+class UTexture;
+
+/**
+ * Low-Level Memory Tracker tags of everything the plugin allocates (-llm, "stat LLMFULL", LLM CSV captures):
+ * RuntimeImageLoader/Compressed   encoded files and downloads
+ * RuntimeImageLoader/Decode       decoded images and their resized or converted copies
+ * RuntimeImageLoader/Animation    GIF, WebP and APNG decoders and their frame stores
+ * RuntimeImageLoader/Cubemap      equirectangular to cube face conversion
+ * RuntimeImageLoader/Textures     runtime textures, UObjects and RHI resources
+ */
+#if ENGINE_MAJOR_VERSION >= 5
+
+LLM_DECLARE_TAG(RuntimeImageLoader);
+LLM_DECLARE_TAG(RuntimeImageLoader_Compressed);
+LLM_DECLARE_TAG(RuntimeImageLoader_Decode);
+LLM_DECLARE_TAG(RuntimeImageLoader_Animation);
+LLM_DECLARE_TAG(RuntimeImageLoader_Cubemap);
+LLM_DECLARE_TAG(RuntimeImageLoader_Textures);
+
+#define RUNTIMEIMAGELOADER_LLM_SCOPE(Tag) LLM_SCOPE_BYTAG(RuntimeImageLoader_##Tag)
+
+#elif LLM_STAT_TAGS_ENABLED
+
+// no tag hierarchy before UE5, the tags are flat stats named after the same paths
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("RuntimeImageLoader/Compressed"), STAT_RuntimeImageLoader_CompressedLLM, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("RuntimeImageLoader/Decode"), STAT_RuntimeImageLoader_DecodeLLM, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("RuntimeImageLoader/Animation"), STAT_RuntimeImageLoader_AnimationLLM, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("RuntimeImageLoader/Cubemap"), STAT_RuntimeImageLoader_CubemapLLM, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("RuntimeImageLoader/Textures"), STAT_RuntimeImageLoader_TexturesLLM, STATGROUP_LLMFULL, );
+
+#define RUNTIMEIMAGELOADER_LLM_SCOPE(Tag) LLM_SCOPED_TAG_WITH_STAT(STAT_RuntimeImageLoader_##Tag##LLM, ELLMTracker::Default)
+
+#else
+
+#define RUNTIMEIMAGELOADER_LLM_SCOPE(Tag)
+
+#endif
+
+/**
+ * Textures created by the plugin with where they came from, listed by "ril.DumpTextures".
+ * Textures are held weakly and drop out once garbage collected, stale entries are pruned on the game thread after every garbage collection
+ * and as registrations pile up. Registering and the totals are thread safe, the rest is game thread only
+ */
+namespace FRuntimeTextureRegistry
+{
+    /** Source is the file, URL or bundle entry the texture was loaded from, empty for bytes */
+    void Register(UTexture* Texture, const FString& Source, int32 SizeX, int32 SizeY, EPixelFormat PixelFormat, int32 NumMips, int32 NumFaces = 1);
+
+    /** Stops counting a texture whose resource was released ahead of garbage collection */
+    void Unregister(UTexture* Texture);
+
+    /** Prunes stale entries after each garbage collection, called by the module */
+    void Startup();
+    void Shutdown();
+
+    /** Live textures, the largest first */
+    void Dump(FOutputDevice& Ar);
+
+    /** Totals kept up to date by registering, unregistering and pruning after garbage collection */
+    int32 GetNumTextures();
+    int64 GetResidentBytes();
+}
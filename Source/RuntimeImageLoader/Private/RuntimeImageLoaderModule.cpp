@@ -1,15 +1,20 @@
 // Copyright 2023 Petr Leontev. All Rights Reserved.
 
 #include "RuntimeImageLoaderModule.h"
+#include "RuntimeImageScheduler.h"
+#include "RuntimeImageLoaderMemory.h"
 
 #define LOCTEXT_NAMESPACE "FRuntimeImageLoaderModule"
 
 void FRuntimeImageLoaderModule::StartupModule()
 {
+	FRuntimeTextureRegistry::Startup();
 }
 
 void FRuntimeImageLoaderModule::ShutdownModule()
 {
+	FRuntimeImageScheduler::Get().CancelAll();
+	FRuntimeTextureRegistry::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
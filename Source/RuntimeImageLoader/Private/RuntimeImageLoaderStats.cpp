@@ -0,0 +1,303 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageLoaderStats.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "RuntimeImageLoader.h"
+
+DEFINE_STAT(STAT_RuntimeImageLoader_ReadFile);
+DEFINE_STAT(STAT_RuntimeImageLoader_Decode);
+DEFINE_STAT(STAT_RuntimeImageLoader_Transform);
+DEFINE_STAT(STAT_RuntimeImageLoader_CreateUObject);
+DEFINE_STAT(STAT_RuntimeImageLoader_RHIUpload);
+
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodePNG);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeJPEG);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeEXR);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeHDR);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeTIFF);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeQOI);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeBMP);
+DEFINE_STAT(STAT_RuntimeImageLoader_DecodeOther);
+
+DEFINE_STAT(STAT_RuntimeImageLoader_QueuedTasks);
+DEFINE_STAT(STAT_RuntimeImageLoader_RunningTasks);
+DEFINE_STAT(STAT_RuntimeImageLoader_PendingReadRequests);
+
+DEFINE_STAT(STAT_RuntimeImageLoader_BytesRead);
+DEFINE_STAT(STAT_RuntimeImageLoader_BytesDecoded);
+DEFINE_STAT(STAT_RuntimeImageLoader_BytesUploaded);
+
+CSV_DEFINE_CATEGORY(RuntimeImageLoader, true);
+
+namespace
+{
+    bool StartsWith(const uint8* Buffer, int64 Length, const char* Signature, int64 SignatureLength)
+    {
+        return Length >= SignatureLength && FMemory::Memcmp(Buffer, Signature, SignatureLength) == 0;
+    }
+
+    TStatId GetDecodeStatId(EImageDecodeStatFormat Format)
+    {
+        switch (Format)
+        {
+        case EImageDecodeStatFormat::PNG: return GET_STATID(STAT_RuntimeImageLoader_DecodePNG);
+        case EImageDecodeStatFormat::JPEG: return GET_STATID(STAT_RuntimeImageLoader_DecodeJPEG);
+        case EImageDecodeStatFormat::EXR: return GET_STATID(STAT_RuntimeImageLoader_DecodeEXR);
+        case EImageDecodeStatFormat::HDR: return GET_STATID(STAT_RuntimeImageLoader_DecodeHDR);
+        case EImageDecodeStatFormat::TIFF: return GET_STATID(STAT_RuntimeImageLoader_DecodeTIFF);
+        case EImageDecodeStatFormat::QOI: return GET_STATID(STAT_RuntimeImageLoader_DecodeQOI);
+        case EImageDecodeStatFormat::BMP: return GET_STATID(STAT_RuntimeImageLoader_DecodeBMP);
+        default: return GET_STATID(STAT_RuntimeImageLoader_DecodeOther);
+        }
+    }
+
+#if CSV_PROFILER
+    /** CSV stat names have to outlive the capture, so they are literals */
+    const char* GetDecodeCsvStatName(EImageDecodeStatFormat Format)
+    {
+        switch (Format)
+        {
+        case EImageDecodeStatFormat::PNG: return "DecodePNG";
+        case EImageDecodeStatFormat::JPEG: return "DecodeJPEG";
+        case EImageDecodeStatFormat::EXR: return "DecodeEXR";
+        case EImageDecodeStatFormat::HDR: return "DecodeHDR";
+        case EImageDecodeStatFormat::TIFF: return "DecodeTIFF";
+        case EImageDecodeStatFormat::QOI: return "DecodeQOI";
+        case EImageDecodeStatFormat::BMP: return "DecodeBMP";
+        default: return "DecodeOther";
+        }
+    }
+
+    float ToMegabytes(int64 Bytes)
+    {
+        return (float)(Bytes / (1024.0 * 1024.0));
+    }
+#endif
+
+    /**
+     * Lock free latency histogram on a log scale, four buckets per doubling starting at a microsecond.
+     * Percentiles are reported as the upper bound of their bucket, so they overestimate by up to 19%
+     */
+    class FLatencyHistogram
+    {
+    public:
+        void Add(double Seconds)
+        {
+            const double Microseconds = FMath::Max(Seconds * 1000000.0, 0.0);
+            const int32 Bucket = FMath::Clamp(FMath::FloorToInt(4.0f * FMath::Log2((float)Microseconds + 1.0f)), 0, NumBuckets - 1);
+
+            Buckets[Bucket].Increment();
+            Count.Increment();
+            TotalMicroseconds.Add((int64)Microseconds);
+        }
+
+        void GetSummary(FRuntimeImageStageLatency& OutLatency) const
+        {
+            OutLatency.Count = Count.GetValue();
+            OutLatency.AverageMs = OutLatency.Count > 0 ? (float)(TotalMicroseconds.GetValue() / 1000.0 / OutLatency.Count) : 0.0f;
+            OutLatency.P95Ms = GetPercentileMs(0.95);
+        }
+
+        void Reset()
+        {
+            for (FThreadSafeCounter& Bucket : Buckets)
+            {
+                Bucket.Reset();
+            }
+            Count.Reset();
+            TotalMicroseconds.Reset();
+        }
+
+    private:
+        float GetPercentileMs(double Percentile) const
+        {
+            // buckets are read one by one while other threads add to them, the total is taken from the same reads
+            int32 BucketCounts[NumBuckets];
+            int64 NumSamples = 0;
+            for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+            {
+                BucketCounts[Bucket] = Buckets[Bucket].GetValue();
+                NumSamples += BucketCounts[Bucket];
+            }
+
+            const int64 Rank = FMath::Max<int64>(FMath::CeilToInt((float)(Percentile * NumSamples)), 1);
+            int64 NumBelow = 0;
+            for (int32 Bucket = 0; Bucket < NumBuckets && NumSamples > 0; ++Bucket)
+            {
+                NumBelow += BucketCounts[Bucket];
+                if (NumBelow >= Rank)
+                {
+                    return (FMath::Pow(2.0f, (Bucket + 1) / 4.0f) - 1.0f) / 1000.0f;
+                }
+            }
+
+            return 0.0f;
+        }
+
+    private:
+        /** The last bucket starts at ~71 minutes */
+        static constexpr int32 NumBuckets = 128;
+
+        FThreadSafeCounter Buckets[NumBuckets];
+        FThreadSafeCounter64 Count;
+        FThreadSafeCounter64 TotalMicroseconds;
+    };
+
+    constexpr int32 NumStages = (int32)ERuntimeImageTraceStage::Callback + 1;
+
+    FThreadSafeCounter NumQueuedTasksCounter;
+    FThreadSafeCounter NumRunningTasksCounter;
+
+    FThreadSafeCounter64 BytesReadCounter;
+    FThreadSafeCounter64 BytesDecodedCounter;
+    FThreadSafeCounter64 BytesUploadedCounter;
+
+    FThreadSafeCounter64 NumCompletedRequests;
+    FThreadSafeCounter64 NumFailedRequests;
+    FThreadSafeCounter64 NumCacheHits;
+    FThreadSafeCounter64 NumCacheMisses;
+
+    FLatencyHistogram StageLatencies[NumStages];
+    FLatencyHistogram RequestLatency;
+}
+
+namespace FRuntimeImageLoaderCounters
+{
+    EImageDecodeStatFormat GetDecodeFormat(const uint8* Buffer, int64 Length)
+    {
+        if (StartsWith(Buffer, Length, "\x89PNG", 4))
+        {
+            return EImageDecodeStatFormat::PNG;
+        }
+        if (StartsWith(Buffer, Length, "\xFF\xD8", 2))
+        {
+            return EImageDecodeStatFormat::JPEG;
+        }
+        if (StartsWith(Buffer, Length, "\x76\x2f\x31\x01", 4))
+        {
+            return EImageDecodeStatFormat::EXR;
+        }
+        if (StartsWith(Buffer, Length, "#?", 2))
+        {
+            return EImageDecodeStatFormat::HDR;
+        }
+        if (StartsWith(Buffer, Length, "II*\0", 4) || StartsWith(Buffer, Length, "MM\0*", 4))
+        {
+            return EImageDecodeStatFormat::TIFF;
+        }
+        if (StartsWith(Buffer, Length, "qoif", 4))
+        {
+            return EImageDecodeStatFormat::QOI;
+        }
+        if (StartsWith(Buffer, Length, "BM", 2))
+        {
+            return EImageDecodeStatFormat::BMP;
+        }
+
+        // TGA has no signature
+        return EImageDecodeStatFormat::Other;
+    }
+
+    void AddBytesRead(int64 Bytes)
+    {
+        BytesReadCounter.Add(Bytes);
+        INC_MEMORY_STAT_BY(STAT_RuntimeImageLoader_BytesRead, Bytes);
+        CSV_CUSTOM_STAT(RuntimeImageLoader, ReadMB, ToMegabytes(Bytes), ECsvCustomStatOp::Accumulate);
+    }
+
+    void AddBytesDecoded(int64 Bytes)
+    {
+        BytesDecodedCounter.Add(Bytes);
+        INC_MEMORY_STAT_BY(STAT_RuntimeImageLoader_BytesDecoded, Bytes);
+        CSV_CUSTOM_STAT(RuntimeImageLoader, DecodedMB, ToMegabytes(Bytes), ECsvCustomStatOp::Accumulate);
+    }
+
+    void AddBytesUploaded(int64 Bytes)
+    {
+        BytesUploadedCounter.Add(Bytes);
+        INC_MEMORY_STAT_BY(STAT_RuntimeImageLoader_BytesUploaded, Bytes);
+        CSV_CUSTOM_STAT(RuntimeImageLoader, UploadedMB, ToMegabytes(Bytes), ECsvCustomStatOp::Accumulate);
+    }
+
+    void SetQueueDepth(int32 NumQueuedTasks, int32 NumRunningTasks)
+    {
+        NumQueuedTasksCounter.Set(NumQueuedTasks);
+        NumRunningTasksCounter.Set(NumRunningTasks);
+
+        SET_DWORD_STAT(STAT_RuntimeImageLoader_QueuedTasks, NumQueuedTasks);
+        SET_DWORD_STAT(STAT_RuntimeImageLoader_RunningTasks, NumRunningTasks);
+        CSV_CUSTOM_STAT(RuntimeImageLoader, QueuedTasks, NumQueuedTasks, ECsvCustomStatOp::Set);
+        CSV_CUSTOM_STAT(RuntimeImageLoader, RunningTasks, NumRunningTasks, ECsvCustomStatOp::Set);
+    }
+
+    void AddCacheLookup(bool bHit)
+    {
+        (bHit ? NumCacheHits : NumCacheMisses).Increment();
+    }
+
+    void AddStageTime(ERuntimeImageTraceStage Stage, double Seconds)
+    {
+        StageLatencies[(int32)Stage].Add(Seconds);
+    }
+
+    void AddRequestCompleted(bool bSucceeded, double LatencySeconds)
+    {
+        (bSucceeded ? NumCompletedRequests : NumFailedRequests).Increment();
+        RequestLatency.Add(LatencySeconds);
+    }
+
+    void GetSnapshot(FRuntimeImageLoaderStats& OutStats)
+    {
+        OutStats.QueuedTasks = NumQueuedTasksCounter.GetValue();
+        OutStats.RunningTasks = NumRunningTasksCounter.GetValue();
+
+        OutStats.CompletedRequests = NumCompletedRequests.GetValue();
+        OutStats.FailedRequests = NumFailedRequests.GetValue();
+
+        OutStats.CacheHits = NumCacheHits.GetValue();
+        OutStats.CacheMisses = NumCacheMisses.GetValue();
+        const int64 NumCacheLookups = OutStats.CacheHits + OutStats.CacheMisses;
+        OutStats.CacheHitRate = NumCacheLookups > 0 ? (float)((double)OutStats.CacheHits / NumCacheLookups) : 0.0f;
+
+        OutStats.BytesRead = BytesReadCounter.GetValue();
+        OutStats.BytesDecoded = BytesDecodedCounter.GetValue();
+        OutStats.BytesUploaded = BytesUploadedCounter.GetValue();
+
+        StageLatencies[(int32)ERuntimeImageTraceStage::Read].GetSummary(OutStats.Read);
+        StageLatencies[(int32)ERuntimeImageTraceStage::Decode].GetSummary(OutStats.Decode);
+        StageLatencies[(int32)ERuntimeImageTraceStage::Transform].GetSummary(OutStats.Transform);
+        StageLatencies[(int32)ERuntimeImageTraceStage::CreateUObject].GetSummary(OutStats.CreateUObject);
+        StageLatencies[(int32)ERuntimeImageTraceStage::Upload].GetSummary(OutStats.Upload);
+        StageLatencies[(int32)ERuntimeImageTraceStage::Callback].GetSummary(OutStats.Callback);
+        RequestLatency.GetSummary(OutStats.Total);
+    }
+
+    void Reset()
+    {
+        BytesReadCounter.Reset();
+        BytesDecodedCounter.Reset();
+        BytesUploadedCounter.Reset();
+
+        NumCompletedRequests.Reset();
+        NumFailedRequests.Reset();
+        NumCacheHits.Reset();
+        NumCacheMisses.Reset();
+
+        for (FLatencyHistogram& StageLatency : StageLatencies)
+        {
+            StageLatency.Reset();
+        }
+        RequestLatency.Reset();
+    }
+}
+
+FScopedDecodeStat::FScopedDecodeStat(EImageDecodeStatFormat Format)
+    : DecodeCounter(GET_STATID(STAT_RuntimeImageLoader_Decode))
+    , FormatCounter(GetDecodeStatId(Format))
+#if CSV_PROFILER
+    , DecodeCsvStat("Decode", CSV_CATEGORY_INDEX(RuntimeImageLoader))
+    , FormatCsvStat(GetDecodeCsvStatName(Format), CSV_CATEGORY_INDEX(RuntimeImageLoader))
+#endif
+{
+}
@@ -0,0 +1,125 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "RuntimeImageLoaderTrace.h"
+
+struct FRuntimeImageLoaderStats;
+
+/**
+ * Stages of a load, one cycle counter each: "stat RuntimeImageLoader" in game, RuntimeImageLoader category in CSV captures.
+ * Byte counters are 64-bit memory stats holding totals since startup (images past 4 GB don't wrap), the per frame
+ * throughput of every stage is in the CSV captures
+ */
+DECLARE_STATS_GROUP(TEXT("RuntimeImageLoader"), STATGROUP_RuntimeImageLoader, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Read File"), STAT_RuntimeImageLoader_ReadFile, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode"), STAT_RuntimeImageLoader_Decode, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Transform"), STAT_RuntimeImageLoader_Transform, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Create UObject"), STAT_RuntimeImageLoader_CreateUObject, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("RHI Upload"), STAT_RuntimeImageLoader_RHIUpload, STATGROUP_RuntimeImageLoader, );
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode PNG"), STAT_RuntimeImageLoader_DecodePNG, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode JPEG"), STAT_RuntimeImageLoader_DecodeJPEG, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode EXR"), STAT_RuntimeImageLoader_DecodeEXR, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode HDR"), STAT_RuntimeImageLoader_DecodeHDR, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode TIFF"), STAT_RuntimeImageLoader_DecodeTIFF, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode QOI"), STAT_RuntimeImageLoader_DecodeQOI, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode BMP"), STAT_RuntimeImageLoader_DecodeBMP, STATGROUP_RuntimeImageLoader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode Other"), STAT_RuntimeImageLoader_DecodeOther, STATGROUP_RuntimeImageLoader, );
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Queued Tasks"), STAT_RuntimeImageLoader_QueuedTasks, STATGROUP_RuntimeImageLoader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Running Tasks"), STAT_RuntimeImageLoader_RunningTasks, STATGROUP_RuntimeImageLoader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pending Read Requests"), STAT_RuntimeImageLoader_PendingReadRequests, STATGROUP_RuntimeImageLoader, );
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Read"), STAT_RuntimeImageLoader_BytesRead, STATGROUP_RuntimeImageLoader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Decoded"), STAT_RuntimeImageLoader_BytesDecoded, STATGROUP_RuntimeImageLoader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Uploaded"), STAT_RuntimeImageLoader_BytesUploaded, STATGROUP_RuntimeImageLoader, );
+
+CSV_DECLARE_CATEGORY_EXTERN(RuntimeImageLoader);
+
+/** Cycle counter and CSV timing of a load stage */
+#define RUNTIMEIMAGELOADER_SCOPE_STAT(Stage) \
+    SCOPE_CYCLE_COUNTER(STAT_RuntimeImageLoader_##Stage); \
+    CSV_SCOPED_TIMING_STAT(RuntimeImageLoader, Stage)
+
+enum class EImageDecodeStatFormat : uint8
+{
+    PNG,
+    JPEG,
+    EXR,
+    HDR,
+    TIFF,
+    QOI,
+    BMP,
+    Other
+};
+
+/**
+ * Besides feeding the stats above, the counters keep process wide totals in atomics that are compiled into shipping builds too,
+ * read through URuntimeImageLoader::GetLoaderStats and "ril.Stats"
+ */
+namespace FRuntimeImageLoaderCounters
+{
+    /** Picks the decode counter from the signature of an encoded image */
+    EImageDecodeStatFormat GetDecodeFormat(const uint8* Buffer, int64 Length);
+
+    void AddBytesRead(int64 Bytes);
+    void AddBytesDecoded(int64 Bytes);
+    void AddBytesUploaded(int64 Bytes);
+
+    void SetQueueDepth(int32 NumQueuedTasks, int32 NumRunningTasks);
+
+    void AddCacheLookup(bool bHit);
+    void AddStageTime(ERuntimeImageTraceStage Stage, double Seconds);
+
+    /** LatencySeconds is measured from queuing the request to its completion callback */
+    void AddRequestCompleted(bool bSucceeded, double LatencySeconds);
+
+    /** Fills the process wide part of the snapshot, queue depth of a particular loader is up to the loader */
+    void GetSnapshot(FRuntimeImageLoaderStats& OutStats);
+
+    /** Clears totals and latencies, queue depth is left as is */
+    void Reset();
+
+    class FScopedStageTime
+    {
+    public:
+        explicit FScopedStageTime(ERuntimeImageTraceStage InStage)
+            : Stage(InStage), StartTime(FPlatformTime::Seconds())
+        {
+        }
+
+        ~FScopedStageTime()
+        {
+            AddStageTime(Stage, FPlatformTime::Seconds() - StartTime);
+        }
+
+    private:
+        ERuntimeImageTraceStage Stage;
+        double StartTime;
+    };
+}
+
+/** Latency of a load stage for GetLoaderStats, kept next to RUNTIMEIMAGELOADER_TRACE_STAGE which is compiled out of shipping builds */
+#define RUNTIMEIMAGELOADER_STAGE_TIME(Stage) \
+    FRuntimeImageLoaderCounters::FScopedStageTime PREPROCESSOR_JOIN(RuntimeImageStageTime_, __LINE__)(ERuntimeImageTraceStage::Stage)
+
+/** Counts the time to the overall decode stage and to the decoded format */
+class FScopedDecodeStat
+{
+public:
+    explicit FScopedDecodeStat(EImageDecodeStatFormat Format);
+
+private:
+    FScopeCycleCounter DecodeCounter;
+    FScopeCycleCounter FormatCounter;
+
+#if CSV_PROFILER
+    FScopedCsvStat DecodeCsvStat;
+    FScopedCsvStat FormatCsvStat;
+#endif
+};
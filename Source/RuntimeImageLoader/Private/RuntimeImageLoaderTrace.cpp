@@ -0,0 +1,107 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageLoaderTrace.h"
+
+#if RUNTIMEIMAGELOADER_TRACE_ENABLED
+
+#include "HAL/PlatformTime.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+#if ENGINE_MAJOR_VERSION >= 5
+namespace RuntimeImageTrace = UE::Trace;
+#else
+namespace RuntimeImageTrace = Trace;
+#endif
+
+UE_TRACE_CHANNEL_DEFINE(RuntimeImageLoaderChannel);
+
+UE_TRACE_EVENT_BEGIN(RuntimeImageLoader, RequestQueued)
+    UE_TRACE_EVENT_FIELD(uint64, Cycle)
+    UE_TRACE_EVENT_FIELD(uint64, RequestId)
+    UE_TRACE_EVENT_FIELD(int64, InputSize)
+    UE_TRACE_EVENT_FIELD(RuntimeImageTrace::WideString, Uri)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(RuntimeImageLoader, RequestDecoded)
+    UE_TRACE_EVENT_FIELD(uint64, Cycle)
+    UE_TRACE_EVENT_FIELD(uint64, RequestId)
+    UE_TRACE_EVENT_FIELD(int64, EncodedSize)
+    UE_TRACE_EVENT_FIELD(int32, SizeX)
+    UE_TRACE_EVENT_FIELD(int32, SizeY)
+    UE_TRACE_EVENT_FIELD(int32, RawFormat)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(RuntimeImageLoader, RequestCompleted)
+    UE_TRACE_EVENT_FIELD(uint64, Cycle)
+    UE_TRACE_EVENT_FIELD(uint64, RequestId)
+    UE_TRACE_EVENT_FIELD(int32, PixelFormat)
+    UE_TRACE_EVENT_FIELD(bool, bSuccess)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(RuntimeImageLoader, StageBegin)
+    UE_TRACE_EVENT_FIELD(uint64, Cycle)
+    UE_TRACE_EVENT_FIELD(uint64, RequestId)
+    UE_TRACE_EVENT_FIELD(uint8, Stage)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(RuntimeImageLoader, StageEnd)
+    UE_TRACE_EVENT_FIELD(uint64, Cycle)
+    UE_TRACE_EVENT_FIELD(uint64, RequestId)
+    UE_TRACE_EVENT_FIELD(uint8, Stage)
+UE_TRACE_EVENT_END()
+
+namespace FRuntimeImageLoaderTrace
+{
+    uint64 NewRequestId()
+    {
+        static volatile int64 LastRequestId = 0;
+        return (uint64)FPlatformAtomics::InterlockedIncrement(&LastRequestId);
+    }
+
+    void RequestQueued(uint64 RequestId, const FString& Uri, int64 InputSize)
+    {
+        UE_TRACE_LOG(RuntimeImageLoader, RequestQueued, RuntimeImageLoaderChannel)
+            << RequestQueued.Cycle(FPlatformTime::Cycles64())
+            << RequestQueued.RequestId(RequestId)
+            << RequestQueued.InputSize(InputSize)
+            << RequestQueued.Uri(*Uri, Uri.Len());
+    }
+
+    void RequestDecoded(uint64 RequestId, int64 EncodedSize, int32 SizeX, int32 SizeY, int32 RawFormat)
+    {
+        UE_TRACE_LOG(RuntimeImageLoader, RequestDecoded, RuntimeImageLoaderChannel)
+            << RequestDecoded.Cycle(FPlatformTime::Cycles64())
+            << RequestDecoded.RequestId(RequestId)
+            << RequestDecoded.EncodedSize(EncodedSize)
+            << RequestDecoded.SizeX(SizeX)
+            << RequestDecoded.SizeY(SizeY)
+            << RequestDecoded.RawFormat(RawFormat);
+    }
+
+    void RequestCompleted(uint64 RequestId, int32 PixelFormat, bool bSuccess)
+    {
+        UE_TRACE_LOG(RuntimeImageLoader, RequestCompleted, RuntimeImageLoaderChannel)
+            << RequestCompleted.Cycle(FPlatformTime::Cycles64())
+            << RequestCompleted.RequestId(RequestId)
+            << RequestCompleted.PixelFormat(PixelFormat)
+            << RequestCompleted.bSuccess(bSuccess);
+    }
+
+    void StageBegin(uint64 RequestId, ERuntimeImageTraceStage Stage)
+    {
+        UE_TRACE_LOG(RuntimeImageLoader, StageBegin, RuntimeImageLoaderChannel)
+            << StageBegin.Cycle(FPlatformTime::Cycles64())
+            << StageBegin.RequestId(RequestId)
+            << StageBegin.Stage((uint8)Stage);
+    }
+
+    void StageEnd(uint64 RequestId, ERuntimeImageTraceStage Stage)
+    {
+        UE_TRACE_LOG(RuntimeImageLoader, StageEnd, RuntimeImageLoaderChannel)
+            << StageEnd.Cycle(FPlatformTime::Cycles64())
+            << StageEnd.RequestId(RequestId)
+            << StageEnd.Stage((uint8)Stage);
+    }
+}
+
+#endif // RUNTIMEIMAGELOADER_TRACE_ENABLED
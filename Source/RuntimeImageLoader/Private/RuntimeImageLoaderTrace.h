@@ -0,0 +1,79 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+#define RUNTIMEIMAGELOADER_TRACE_ENABLED (UE_TRACE_ENABLED && !UE_BUILD_SHIPPING)
+
+/** Steps of a request, in the order they happen */
+enum class ERuntimeImageTraceStage : uint8
+{
+    Read,
+    Decode,
+    Transform,
+    CreateUObject,
+    Upload,
+    Callback
+};
+
+#if RUNTIMEIMAGELOADER_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_EXTERN(RuntimeImageLoaderChannel);
+
+/**
+ * Request lifecycle on the RuntimeImageLoader trace channel (-trace=cpu,RuntimeImageLoader):
+ * RequestQueued, a StageBegin/StageEnd pair per step, RequestDecoded with the image description and RequestCompleted.
+ * Steps are CPU timers on the same channel as well, so they show up on the thread tracks of Timing Insights
+ */
+namespace FRuntimeImageLoaderTrace
+{
+    /** Ids are unique per process, zero is never handed out */
+    uint64 NewRequestId();
+
+    void RequestQueued(uint64 RequestId, const FString& Uri, int64 InputSize);
+    void RequestDecoded(uint64 RequestId, int64 EncodedSize, int32 SizeX, int32 SizeY, int32 RawFormat);
+    void RequestCompleted(uint64 RequestId, int32 PixelFormat, bool bSuccess);
+
+    void StageBegin(uint64 RequestId, ERuntimeImageTraceStage Stage);
+    void StageEnd(uint64 RequestId, ERuntimeImageTraceStage Stage);
+
+    class FStageScope
+    {
+    public:
+        FStageScope(uint64 InRequestId, ERuntimeImageTraceStage InStage)
+            : RequestId(InRequestId), Stage(InStage)
+        {
+            StageBegin(RequestId, Stage);
+        }
+
+        ~FStageScope()
+        {
+            StageEnd(RequestId, Stage);
+        }
+
+    private:
+        uint64 RequestId;
+        ERuntimeImageTraceStage Stage;
+    };
+}
+
+#define RUNTIMEIMAGELOADER_TRACE_STAGE(RequestId, Stage) \
+    TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR("RuntimeImageLoader::" #Stage, RuntimeImageLoaderChannel); \
+    FRuntimeImageLoaderTrace::FStageScope PREPROCESSOR_JOIN(RuntimeImageTraceStage_, __LINE__)(RequestId, ERuntimeImageTraceStage::Stage)
+
+#define RUNTIMEIMAGELOADER_TRACE(Event, ...) FRuntimeImageLoaderTrace::Event(__VA_ARGS__)
+
+#else
+
+namespace FRuntimeImageLoaderTrace
+{
+    inline uint64 NewRequestId() { return 0; }
+}
+
+#define RUNTIMEIMAGELOADER_TRACE_STAGE(RequestId, Stage)
+#define RUNTIMEIMAGELOADER_TRACE(Event, ...)
+
+#endif
@@ -2,9 +2,7 @@
 
 #include "RuntimeImageReader.h"
 
-#include "GenericPlatform/GenericPlatformProcess.h"
-#include "HAL/RunnableThread.h"
-#include "HAL/Event.h"
+#include "Async/Async.h"
 #include "RenderUtils.h"
 #include "Engine/Texture.h"
 #include "Engine/Texture2D.h"
@@ -20,6 +18,11 @@
 #include "TextureFactory/RuntimeTextureFactory.h"
 #include "RuntimeImageUtils.h"
 #include "Helpers/CubemapUtils.h"
+#include "Helpers/PNGScanlineDecoder.h"
+#include "Helpers/ImageStatistics.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
+#include "RuntimeImageLoaderTrace.h"
 
 
 DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageReader, Log, All);
@@ -28,48 +31,134 @@ DEFINE_LOG_CATEGORY_STATIC(LogRuntimeImageReader, Log, All);
 void URuntimeImageReader::Initialize()
 {
     TextureFactory = NewObject<URuntimeTextureFactory>((UObject*)GetTransientPackage());
-
-    ThreadSemaphore = FPlatformProcess::GetSynchEventFromPool(false);
-    Thread = FRunnableThread::Create(this, TEXT("RuntimeImageReader"), 0, TPri_SlightlyBelowNormal);
-
-    UE_LOG(LogRuntimeImageReader, Log, TEXT("Image reader thread started!"))
 }
 
 void URuntimeImageReader::Deinitialize()
 {
     Clear();
-    Stop();
 
     TextureFactory = nullptr;
+}
+
+void URuntimeImageReader::ScheduleRequest(const FImageReadRequest& Request)
+{
+    check(IsInGameThread());
+    check(!ScheduledTask.IsValid());
+
+    TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task = MakeShared<FImageReadTask, ESPMode::ThreadSafe>();
+    Task->Request = Request;
+    Task->Result.ImageFilename = Request.InputImage.ImageFilename;
+
+    // created here so that Clear can cancel a read that is in progress
+    if (Request.InputImage.ImageFilename.Len() > 0)
+    {
+        Task->ImageReader = FImageReaderFactory::CreateReader(Request.InputImage.ImageFilename);
+    }
+
+    ScheduledTask = Task;
+    ScheduledResult = FImageReadResult();
+    bHasScheduledResult = false;
+
+    INC_DWORD_STAT(STAT_RuntimeImageLoader_PendingReadRequests);
 
-    UE_LOG(LogRuntimeImageReader, Log, TEXT("Image reader thread exited!"))
+    TWeakObjectPtr<URuntimeImageReader> WeakReader(this);
+    Task->TaskHandle = FRuntimeImageScheduler::Get().Schedule(
+        [WeakReader, Task](const FRuntimeImageTaskHandle& TaskHandle)
+        {
+            RunScheduledDecode(WeakReader, Task);
+        },
+        Request.Priority
+    );
 }
 
-bool URuntimeImageReader::Init()
+bool URuntimeImageReader::GetScheduledResult(FImageReadResult& OutResult)
 {
+    check(IsInGameThread());
+
+    if (!bHasScheduledResult)
+    {
+        return false;
+    }
+
+    OutResult = MoveTemp(ScheduledResult);
+    ScheduledResult = FImageReadResult();
+    bHasScheduledResult = false;
+
     return true;
 }
 
-uint32 URuntimeImageReader::Run()
+void URuntimeImageReader::RunScheduledDecode(TWeakObjectPtr<URuntimeImageReader> WeakReader, TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task)
 {
-    while (!bStopThread)
+    DEC_DWORD_STAT(STAT_RuntimeImageLoader_PendingReadRequests);
+
+    if (Task->bCancelled)
     {
-        ThreadSemaphore->Wait();
-        
-        BlockTillAllRequestsFinished();
+        Task->Result.OutError = TEXT("Image request was cancelled");
     }
+    else if (ReadAndDecode(*Task) && NeedsTexture(Task->Request))
+    {
+        AsyncTask(ENamedThreads::GameThread, [WeakReader, Task]()
+        {
+            URuntimeImageReader* Reader = WeakReader.Get();
+            if (!IsValid(Reader) || Task->bCancelled || !Reader->CreateTextureObject(*Task))
+            {
+                PublishScheduledResult(WeakReader, Task);
+                return;
+            }
+
+            // the upload waits for the render thread, so it goes back to a worker
+            Task->TaskHandle = FRuntimeImageScheduler::Get().Schedule(
+                [WeakReader, Task](const FRuntimeImageTaskHandle& TaskHandle)
+                {
+                    RunScheduledUpload(WeakReader, Task);
+                },
+                Task->Request.Priority
+            );
+        });
 
-    return 0;
+        return;
+    }
+
+    AsyncTask(ENamedThreads::GameThread, [WeakReader, Task]() { PublishScheduledResult(WeakReader, Task); });
 }
 
-void URuntimeImageReader::Exit()
+void URuntimeImageReader::RunScheduledUpload(TWeakObjectPtr<URuntimeImageReader> WeakReader, TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task)
 {
-    // 
+    if (Task->bCancelled)
+    {
+        Task->Result.OutError = TEXT("Image request was cancelled");
+    }
+    else
+    {
+        UploadTexture(*Task);
+    }
+
+    AsyncTask(ENamedThreads::GameThread, [WeakReader, Task]() { PublishScheduledResult(WeakReader, Task); });
+}
+
+void URuntimeImageReader::PublishScheduledResult(TWeakObjectPtr<URuntimeImageReader> WeakReader, TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task)
+{
+    check(IsInGameThread());
+
+    URuntimeImageReader* Reader = WeakReader.Get();
+    if (!IsValid(Reader) || Reader->ScheduledTask != Task)
+    {
+        // cleared meanwhile, nobody waits for the textures
+        UnrootTextures(Task->Result);
+        return;
+    }
+
+    Reader->ScheduledResult = MoveTemp(Task->Result);
+    UnrootTextures(Reader->ScheduledResult);
+
+    Reader->ScheduledTask.Reset();
+    Reader->bHasScheduledResult = true;
 }
 
 void URuntimeImageReader::AddRequest(const FImageReadRequest& Request)
 {
     Requests.Enqueue(Request);
+    INC_DWORD_STAT(STAT_RuntimeImageLoader_PendingReadRequests);
 
     bCompletedWork.AtomicSet(false);
 }
@@ -90,16 +179,32 @@ bool URuntimeImageReader::GetResult(FImageReadResult& OutResult)
 
 void URuntimeImageReader::Clear()
 {
-    Requests.Empty();
+    if (ScheduledTask.IsValid())
+    {
+        TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> CancelledTask = MoveTemp(ScheduledTask);
+        ScheduledTask.Reset();
 
+        CancelledTask->bCancelled.AtomicSet(true);
+        if (CancelledTask->ImageReader.IsValid())
+        {
+            CancelledTask->ImageReader->Cancel();
+        }
+        CancelledTask->TaskHandle.Cancel();
+    }
+
+    ScheduledResult = FImageReadResult();
+    bHasScheduledResult = false;
+
+    // the stat is shared by every reader, and a cancelled scheduled decode still runs and decrements it itself
+    FImageReadRequest DroppedRequest;
+    while (Requests.Dequeue(DroppedRequest))
     {
-        FScopeLock ResultsLock(&ResultsMutex);
-        Results.Empty();
+        DEC_DWORD_STAT(STAT_RuntimeImageLoader_PendingReadRequests);
     }
 
-    if (ImageReader.IsValid())
     {
-        ImageReader->Cancel();
+        FScopeLock ResultsLock(&ResultsMutex);
+        Results.Empty();
     }
 
     if (IsValid(TextureFactory))
@@ -110,51 +215,19 @@ void URuntimeImageReader::Clear()
     bCompletedWork = true;
 }
 
-void URuntimeImageReader::Stop()
-{
-    bStopThread = true;
-
-    Trigger();
-    Thread->WaitForCompletion();
-
-    if (ImageReader.IsValid())
-    {
-        ImageReader->Cancel();
-    }
-
-    FPlatformProcess::ReturnSynchEventToPool(ThreadSemaphore);
-}
-
 bool URuntimeImageReader::IsWorkCompleted() const
 {
     return bCompletedWork;
 }
 
-void URuntimeImageReader::Trigger()
-{
-    ThreadSemaphore->Trigger();
-}
-
 void URuntimeImageReader::BlockTillAllRequestsFinished()
 {
-    while (!bCompletedWork && !bStopThread)
+    while (!bCompletedWork)
     {
         FImageReadRequest Request;
-        while (Requests.Dequeue(Request) && !bStopThread)
+        while (Requests.Dequeue(Request))
         {
-            PendingReadResult.ImageFilename = Request.InputImage.ImageFilename;
-
-            if (PendingReadResult.ImageFilename.Len() > 0)
-            {
-                UE_LOG(LogRuntimeImageReader, Log, TEXT("Reading image from file: %s"), *PendingReadResult.ImageFilename);
-            }
-            else if (Request.InputImage.ImageBytes.Num() > 0)
-            {
-                UE_LOG(
-                    LogRuntimeImageReader, Log, TEXT("Reading image from byte array. First few bytes: %d %d %d"), 
-                    Request.InputImage.ImageBytes[0], Request.InputImage.ImageBytes[1], Request.InputImage.ImageBytes[2]
-                );
-            }
+            DEC_DWORD_STAT(STAT_RuntimeImageLoader_PendingReadRequests);
 
             if (!ProcessRequest(Request))
             {
@@ -162,7 +235,7 @@ void URuntimeImageReader::BlockTillAllRequestsFinished()
             }
 
             FScopeLock ResultsLock(&ResultsMutex);
-            Results.Add(PendingReadResult);
+            Results.Add(MoveTemp(PendingReadResult));
 
             PendingReadResult = FImageReadResult();
         }
@@ -173,28 +246,79 @@ void URuntimeImageReader::BlockTillAllRequestsFinished()
 
 bool URuntimeImageReader::ProcessRequest(FImageReadRequest& Request)
 {
-    TArray<uint8> ImageBuffer;
+    FImageReadTask Task;
+    Task.Result.ImageFilename = Request.InputImage.ImageFilename;
+    Task.Request = MoveTemp(Request);
+
+    const bool bResult = ReadAndDecode(Task) && (!NeedsTexture(Task.Request) || (CreateTextureObject(Task) && UploadTexture(Task)));
+
+    PendingReadResult = MoveTemp(Task.Result);
+    UnrootTextures(PendingReadResult);
+
+    return bResult;
+}
+
+bool URuntimeImageReader::NeedsTexture(const FImageReadRequest& Request)
+{
+    return !Request.TransformParams.bNativeImageData && !Request.TransformParams.bOnlyPixels;
+}
+
+void URuntimeImageReader::UnrootTextures(FImageReadResult& Result)
+{
+    if (IsValid(Result.OutTexture))
+    {
+        Result.OutTexture->RemoveFromRoot();
+    }
+
+    if (IsValid(Result.OutTextureCube))
+    {
+        Result.OutTextureCube->RemoveFromRoot();
+    }
+}
+
+bool URuntimeImageReader::ReadAndDecode(FImageReadTask& Task)
+{
+    FImageReadRequest& Request = Task.Request;
+    FImageReadResult& PendingReadResult = Task.Result;
+
+    TArray64<uint8> FileBuffer;
+    TArrayView64<const uint8> ImageBuffer;
 
     // read image data from using URI
     // if not then read from bytes
     if (Request.InputImage.ImageFilename.Len() > 0)
     {
-        ImageReader = FImageReaderFactory::CreateReader(Request.InputImage.ImageFilename);
+        UE_LOG(LogRuntimeImageReader, Log, TEXT("Reading image from file: %s"), *Request.InputImage.ImageFilename);
+
+        if (!Task.ImageReader.IsValid())
         {
-            ImageBuffer = ImageReader->ReadImage(Request.InputImage.ImageFilename);
+            Task.ImageReader = FImageReaderFactory::CreateReader(Request.InputImage.ImageFilename);
+        }
+        {
+            RUNTIMEIMAGELOADER_SCOPE_STAT(ReadFile);
+            RUNTIMEIMAGELOADER_TRACE_STAGE(Request.TraceRequestId, Read);
+            RUNTIMEIMAGELOADER_STAGE_TIME(Read);
+            RUNTIMEIMAGELOADER_LLM_SCOPE(Compressed);
+
+            FileBuffer = Task.ImageReader->ReadImage(Request.InputImage.ImageFilename);
+            FRuntimeImageLoaderCounters::AddBytesRead(FileBuffer.Num());
+            ImageBuffer = FileBuffer;
             if (ImageBuffer.Num() == 0)
             {
-                PendingReadResult.OutError = FString::Printf(TEXT("Failed to read %s image. Error: %s"), *Request.InputImage.ImageFilename, *ImageReader->GetLastError());
+                PendingReadResult.OutError = FString::Printf(TEXT("Failed to read %s image. Error: %s"), *Request.InputImage.ImageFilename, *Task.ImageReader->GetLastError());
                 return false;
             }
 
         }
-
-        ImageReader = nullptr;
     }
     else if (Request.InputImage.ImageBytes.Num() > 0)
     {
-        ImageBuffer = MoveTemp(Request.InputImage.ImageBytes);
+        UE_LOG(
+            LogRuntimeImageReader, Log, TEXT("Reading image from byte array. First few bytes: %d %d %d"), 
+            Request.InputImage.ImageBytes[0], Request.InputImage.ImageBytes[1], Request.InputImage.ImageBytes[2]
+        );
+
+        ImageBuffer = TArrayView64<const uint8>(Request.InputImage.ImageBytes.GetData(), Request.InputImage.ImageBytes.Num());
     }
     else 
     {
@@ -206,19 +330,70 @@ bool URuntimeImageReader::ProcessRequest(FImageReadRequest& Request)
     check(ImageBuffer.Num() > 0);
 
 
-    FRuntimeImageData ImageData;
-    if (!FRuntimeImageUtils::ImportBufferAsImage(ImageBuffer.GetData(), ImageBuffer.Num(), ImageData, PendingReadResult.OutError))
+    FRuntimeImageData& ImageData = Task.ImageData;
+    FTransformImageParams& TransformParams = Task.TransformParams;
+    TransformParams = Request.TransformParams;
+
     {
-        return false;
+        RUNTIMEIMAGELOADER_TRACE_STAGE(Request.TraceRequestId, Decode);
+        RUNTIMEIMAGELOADER_STAGE_TIME(Decode);
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Decode);
+
+        // PNGs wanted at a fraction of their size are resampled while decoding, the full resolution image never exists.
+        // Statistics describe the image before resizing, so they need the full decode
+        bool bDecodedDownscaled = false;
+        if (TransformParams.IsPercentSizeValid() && !TransformParams.bOnlyPixels && !TransformParams.bNativeImageData && !TransformParams.bComputeStatistics)
+        {
+            bDecodedDownscaled = FPNGScanlineDecoder::DecodeDownscaled(ImageBuffer.GetData(), ImageBuffer.Num(), TransformParams.PercentSizeX, TransformParams.PercentSizeY, ImageData, PendingReadResult.OutError);
+            if (!PendingReadResult.OutError.IsEmpty())
+            {
+                return false;
+            }
+
+            if (bDecodedDownscaled)
+            {
+                TransformParams.PercentSizeX = 100;
+                TransformParams.PercentSizeY = 100;
+            }
+        }
+
+        if (!bDecodedDownscaled && !FRuntimeImageUtils::ImportBufferAsImage(ImageBuffer.GetData(), ImageBuffer.Num(), ImageData, PendingReadResult.OutError))
+        {
+            return false;
+        }
     }
 
+    RUNTIMEIMAGELOADER_TRACE(RequestDecoded, Request.TraceRequestId, ImageBuffer.Num(), ImageData.SizeX, ImageData.SizeY, (int32)ImageData.Format);
+
     if (PendingReadResult.OutError.Len() > 0)
     {
         return false;
     }
 
+    if (Request.TransformParams.bComputeStatistics && !FImageStatistics::Compute(ImageData, PendingReadResult.OutStatistics))
+    {
+        UE_LOG(LogRuntimeImageReader, Warning, TEXT("Statistics are not supported for raw image format: %d"), (int32)ImageData.Format);
+    }
+
+    if (Request.TransformParams.bNativeImageData)
+    {
+        // handed over as decoded: no format conversion, no copy
+        PendingReadResult.OutImageData = MakeShared<FRuntimeImageData, ESPMode::ThreadSafe>(MoveTemp(ImageData));
+
+        return true;
+    }
+
     if (Request.TransformParams.bOnlyPixels)
     {
+        // FColor arrays are 32-bit indexed, gigapixel images have to go through native image data
+        if ((int64)ImageData.SizeX * ImageData.SizeY > MAX_int32)
+        {
+            PendingReadResult.OutError = FString::Printf(TEXT("Image is too large for pixel output: %d x %d. Load it as native image data instead"), ImageData.SizeX, ImageData.SizeY);
+            return false;
+        }
+
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Decode);
+
         if (ImageData.TextureSourceFormat == TSF_BGRE8)
         {
             PendingReadResult.OutImagePixels = ImageData.AsBGRE8();
@@ -235,7 +410,7 @@ bool URuntimeImageReader::ProcessRequest(FImageReadRequest& Request)
     check(ImageData.RawData.Num() > 0);
     check(ImageData.TextureSourceFormat != TSF_Invalid);
 
-    ImageData.PixelFormat = DeterminePixelFormat(ImageData.Format, Request.TransformParams);
+    ImageData.PixelFormat = DeterminePixelFormat(ImageData.Format, TransformParams);
     if (ImageData.PixelFormat == PF_Unknown)
     {
         PendingReadResult.OutError = FString::Printf(TEXT("Pixel format is not supported: %d"), (int32)ImageData.PixelFormat);
@@ -243,45 +418,120 @@ bool URuntimeImageReader::ProcessRequest(FImageReadRequest& Request)
     }
 
     // TODO: Below code should be unified and texture source format should be respected by transformation layers
-    // cubemaps texture source format
+    // cubemaps texture source format, the cube object is created from the untransformed image (see UploadTexture)
     if (ImageData.TextureSourceFormat == TSF_BGRE8)
     {
-        PendingReadResult.OutTextureCube = TextureFactory->CreateTextureCube({ Request.InputImage.ImageFilename, &ImageData });
+        if (!FRuntimeImageUtils::IsTextureResolutionValid(ImageData.SizeX, ImageData.SizeY))
+        {
+            PendingReadResult.OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d"), ImageData.SizeX, ImageData.SizeY);
+            return false;
+        }
+    }
+    else
+    {
+        {
+            RUNTIMEIMAGELOADER_TRACE_STAGE(Request.TraceRequestId, Transform);
+            RUNTIMEIMAGELOADER_STAGE_TIME(Transform);
+
+            // TODO: Split into multiple transformation layers?
+            ApplySizeFormatTransformations(ImageData, TransformParams);
+
+            if (TransformParams.bAutoPixelFormat)
+            {
+                SelectCheapestPixelFormat(ImageData, TransformParams);
+            }
+        }
+
+        if (!FRuntimeImageUtils::IsTextureResolutionValid(ImageData.SizeX, ImageData.SizeY))
+        {
+            PendingReadResult.OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d. Downscale it with PercentSize or load pixels instead"), ImageData.SizeX, ImageData.SizeY);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool URuntimeImageReader::CreateTextureObject(FImageReadTask& Task)
+{
+    RUNTIMEIMAGELOADER_TRACE_STAGE(Task.Request.TraceRequestId, CreateUObject);
+    RUNTIMEIMAGELOADER_STAGE_TIME(CreateUObject);
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
+    // created rooted, see UnrootTextures
+    if (Task.ImageData.TextureSourceFormat == TSF_BGRE8)
+    {
+        Task.Result.OutTextureCube = TextureFactory->CreateTextureCube({ Task.Request.InputImage.ImageFilename, &Task.ImageData });
+        if (!IsValid(Task.Result.OutTextureCube))
+        {
+            Task.Result.OutError = TEXT("Failed to create texture cube object");
+            return false;
+        }
+    }
+    else
+    {
+        Task.Result.OutTexture = TextureFactory->CreateTexture2D({ Task.Request.InputImage.ImageFilename, &Task.ImageData });
+        if (!IsValid(Task.Result.OutTexture))
+        {
+            Task.Result.OutError = TEXT("Failed to create texture 2D object");
+            return false;
+        }
+    }
+
+    return true;
+}
 
+bool URuntimeImageReader::UploadTexture(FImageReadTask& Task)
+{
+    const FImageReadRequest& Request = Task.Request;
+    FImageReadResult& PendingReadResult = Task.Result;
+    FRuntimeImageData& ImageData = Task.ImageData;
+
+    if (ImageData.TextureSourceFormat == TSF_BGRE8)
+    {
         // TODO: Split into multiple transformation layers?
         // FIXME: this transformation should be done after texture cube is created
         // as texture cube object creation depends on image data params -> bad design!
         // FIXME: this is not exactly compatible with transform params
-        ApplySizeFormatTransformations(ImageData, Request.TransformParams);
+        {
+            RUNTIMEIMAGELOADER_TRACE_STAGE(Request.TraceRequestId, Transform);
+            RUNTIMEIMAGELOADER_STAGE_TIME(Transform);
+            ApplySizeFormatTransformations(ImageData, Task.TransformParams);
+        }
 
+        RUNTIMEIMAGELOADER_TRACE_STAGE(Request.TraceRequestId, Upload);
+        RUNTIMEIMAGELOADER_STAGE_TIME(Upload);
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
         FRuntimeRHITextureCubeFactory RHITextureCubeFactory(PendingReadResult.OutTextureCube, ImageData);
         if (!RHITextureCubeFactory.Create())
         {
             PendingReadResult.OutError = FString::Printf(TEXT("Failed to create RHI texture cube, pixel format: %d"), (int32)ImageData.PixelFormat);
             return false;
         }
-        PendingReadResult.OutTextureCube->RemoveFromRoot();
+        PendingReadResult.OutPixelFormat = ImageData.PixelFormat;
+
+        FRuntimeTextureRegistry::Register(PendingReadResult.OutTextureCube, Request.InputImage.ImageFilename, ImageData.SizeX, ImageData.SizeY, ImageData.PixelFormat, 1, 6);
     }
     else
     {
-        // TODO: Split into multiple transformation layers?
-        ApplySizeFormatTransformations(ImageData, Request.TransformParams);
-
-        PendingReadResult.OutTexture = TextureFactory->CreateTexture2D({ Request.InputImage.ImageFilename, &ImageData });
-        PendingReadResult.OutTexture->RemoveFromRoot();
-
+        RUNTIMEIMAGELOADER_TRACE_STAGE(Request.TraceRequestId, Upload);
+        RUNTIMEIMAGELOADER_STAGE_TIME(Upload);
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
         FRuntimeRHITexture2DFactory RHITexture2DFactory(PendingReadResult.OutTexture, ImageData);
         if (!RHITexture2DFactory.Create())
         {
             PendingReadResult.OutError = FString::Printf(TEXT("Failed to create RHI texture 2D, pixel format: %d"), (int32)ImageData.PixelFormat);
             return false;
         }
+        PendingReadResult.OutPixelFormat = ImageData.PixelFormat;
+
+        FRuntimeTextureRegistry::Register(PendingReadResult.OutTexture, Request.InputImage.ImageFilename, ImageData.SizeX, ImageData.SizeY, ImageData.PixelFormat, ImageData.NumMips);
     }
 
     return true;
 }
 
-EPixelFormat URuntimeImageReader::DeterminePixelFormat(ERawImageFormat::Type ImageFormat, const FTransformImageParams& Params) const
+EPixelFormat URuntimeImageReader::DeterminePixelFormat(ERawImageFormat::Type ImageFormat, const FTransformImageParams& Params)
 {
     EPixelFormat PixelFormat;
     
@@ -301,8 +551,49 @@ EPixelFormat URuntimeImageReader::DeterminePixelFormat(ERawImageFormat::Type Ima
     return PixelFormat;
 }
 
+void URuntimeImageReader::SelectCheapestPixelFormat(FRuntimeImageData& ImageData, const FTransformImageParams& TransformParams)
+{
+    RUNTIMEIMAGELOADER_SCOPE_STAT(Transform);
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Decode);
+
+    // UI brushes sample all color channels, a single channel texture would show up red
+    if (TransformParams.bForUI || ImageData.Format != ERawImageFormat::BGRA8)
+    {
+        return;
+    }
+
+    bool bOpaque = false;
+    bool bGreyscale = false;
+    FImageStatistics::AnalyzeChannelUsage(ImageData, bOpaque, bGreyscale);
+
+    if (bOpaque && bGreyscale)
+    {
+        const int64 NumPixels = (int64)ImageData.SizeX * ImageData.SizeY;
+        const uint8* SourcePixels = ImageData.RawData.GetData();
+
+        // R == G == B, keeping any of them is lossless
+        TArray64<uint8> GreyscaleData;
+        GreyscaleData.SetNumUninitialized(NumPixels);
+        for (int64 Index = 0; Index < NumPixels; ++Index)
+        {
+            GreyscaleData[Index] = SourcePixels[Index * 4];
+        }
+
+        ImageData.RawData = MoveTemp(GreyscaleData);
+        ImageData.Format = ERawImageFormat::G8;
+        ImageData.TextureSourceFormat = TSF_G8;
+        ImageData.PixelFormat = PF_G8;
+        ImageData.CompressionSettings = TC_Grayscale;
+    }
+
+    UE_LOG(LogRuntimeImageReader, Verbose, TEXT("Auto pixel format: %s (opaque: %d, greyscale: %d)"), GetPixelFormatString(ImageData.PixelFormat), bOpaque, bGreyscale);
+}
+
 void URuntimeImageReader::ApplySizeFormatTransformations(FRuntimeImageData& ImageData, FTransformImageParams TransformParams)
 {
+    RUNTIMEIMAGELOADER_SCOPE_STAT(Transform);
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Decode);
+
     if (TransformParams.IsPercentSizeValid())
     {
         const int32 TransformedSizeX = FMath::Floor(ImageData.SizeX * TransformParams.PercentSizeX * 0.01f);
@@ -352,6 +643,8 @@ void URuntimeImageReader::ApplySizeFormatTransformations(FRuntimeImageData& Imag
     
     if (ImageData.TextureSourceFormat == TSF_BGRE8)
     {
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Cubemap);
+
         FImage CubemapMip;
         GenerateBaseCubeMipFromLongitudeLatitude2D(&CubemapMip, ImageData, 8192, 0);
 
@@ -0,0 +1,194 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeImageScheduler.h"
+#include "Async/Async.h"
+#include "HAL/PlatformMisc.h"
+#include "RuntimeImageLoaderStats.h"
+
+
+void FRuntimeImageTaskHandle::Cancel() const
+{
+    FRuntimeImageScheduler::Get().Cancel(*this);
+}
+
+// ------------------------------------------------------
+
+FRuntimeImageScheduler& FRuntimeImageScheduler::Get()
+{
+    static FRuntimeImageScheduler Instance;
+    return Instance;
+}
+
+FRuntimeImageScheduler::FRuntimeImageScheduler()
+{
+    // leave most of the worker threads to the engine
+    MaxConcurrentTasks = FMath::Clamp(FPlatformMisc::NumberOfWorkerThreadsToSpawn() / 4, 1, 4);
+}
+
+FRuntimeImageTaskHandle FRuntimeImageScheduler::Schedule(FTask&& Task, ERuntimeImagePriority Priority)
+{
+    FRuntimeImageTaskHandle Handle;
+    Handle.State = MakeShared<FRuntimeImageTaskHandle::FState, ESPMode::ThreadSafe>();
+    Handle.State->Priority = Priority;
+
+    {
+        FScopeLock QueueLock(&QueueMutex);
+
+        Handle.State->Id = NextTaskId++;
+        Queues[(int32)Priority].Add({ Handle, MoveTemp(Task) });
+
+        LaunchWorkers();
+        UpdateQueueStats();
+    }
+
+    return Handle;
+}
+
+bool FRuntimeImageScheduler::Cancel(const FRuntimeImageTaskHandle& Handle)
+{
+    if (!Handle.IsValid())
+    {
+        return false;
+    }
+
+    Handle.State->bCancelled.AtomicSet(true);
+
+    FQueuedTask CancelledTask;
+    {
+        FScopeLock QueueLock(&QueueMutex);
+
+        TArray<FQueuedTask>& Queue = Queues[(int32)Handle.GetPriority()];
+        const int32 TaskIndex = Queue.IndexOfByPredicate([&Handle](const FQueuedTask& QueuedTask) { return QueuedTask.Handle.State == Handle.State; });
+        if (TaskIndex == INDEX_NONE)
+        {
+            // already running, the task notices the flag on its own
+            return false;
+        }
+
+        CancelledTask = MoveTemp(Queue[TaskIndex]);
+        Queue.RemoveAt(TaskIndex);
+        UpdateQueueStats();
+    }
+
+    // let the task release what it holds and report the cancellation
+    CancelledTask.Task(CancelledTask.Handle);
+
+    return true;
+}
+
+void FRuntimeImageScheduler::CancelAll()
+{
+    TArray<FQueuedTask> CancelledTasks;
+    {
+        FScopeLock QueueLock(&QueueMutex);
+
+        for (int32 Priority = UE_ARRAY_COUNT(Queues) - 1; Priority >= 0; --Priority)
+        {
+            CancelledTasks.Append(MoveTemp(Queues[Priority]));
+            Queues[Priority].Reset();
+        }
+        UpdateQueueStats();
+    }
+
+    for (FQueuedTask& CancelledTask : CancelledTasks)
+    {
+        CancelledTask.Handle.State->bCancelled.AtomicSet(true);
+        CancelledTask.Task(CancelledTask.Handle);
+    }
+}
+
+void FRuntimeImageScheduler::SetMaxConcurrentTasks(int32 InMaxConcurrentTasks)
+{
+    FScopeLock QueueLock(&QueueMutex);
+
+    MaxConcurrentTasks = FMath::Max(1, InMaxConcurrentTasks);
+    LaunchWorkers();
+}
+
+int32 FRuntimeImageScheduler::GetMaxConcurrentTasks() const
+{
+    FScopeLock QueueLock(&QueueMutex);
+    return MaxConcurrentTasks;
+}
+
+int32 FRuntimeImageScheduler::GetNumQueuedTasks() const
+{
+    FScopeLock QueueLock(&QueueMutex);
+
+    int32 NumQueuedTasks = 0;
+    for (const TArray<FQueuedTask>& Queue : Queues)
+    {
+        NumQueuedTasks += Queue.Num();
+    }
+    return NumQueuedTasks;
+}
+
+int32 FRuntimeImageScheduler::GetNumRunningTasks() const
+{
+    FScopeLock QueueLock(&QueueMutex);
+    return NumRunningWorkers;
+}
+
+void FRuntimeImageScheduler::LaunchWorkers()
+{
+    // QueueMutex is held by the caller
+    int32 NumQueuedTasks = 0;
+    for (const TArray<FQueuedTask>& Queue : Queues)
+    {
+        NumQueuedTasks += Queue.Num();
+    }
+
+    while (NumRunningWorkers < MaxConcurrentTasks && NumRunningWorkers < NumQueuedTasks)
+    {
+        ++NumRunningWorkers;
+
+        Async(EAsyncExecution::ThreadPool, [this]() { RunWorker(); });
+    }
+}
+
+void FRuntimeImageScheduler::RunWorker()
+{
+    FQueuedTask QueuedTask;
+    while (DequeueTask(QueuedTask))
+    {
+        QueuedTask.Task(QueuedTask.Handle);
+        QueuedTask = FQueuedTask();
+    }
+}
+
+bool FRuntimeImageScheduler::DequeueTask(FQueuedTask& OutTask)
+{
+    FScopeLock QueueLock(&QueueMutex);
+
+    // a lowered limit takes effect as running tasks finish
+    if (NumRunningWorkers <= MaxConcurrentTasks)
+    {
+        for (int32 Priority = UE_ARRAY_COUNT(Queues) - 1; Priority >= 0; --Priority)
+        {
+            if (Queues[Priority].Num() > 0)
+            {
+                OutTask = MoveTemp(Queues[Priority][0]);
+                Queues[Priority].RemoveAt(0);
+                UpdateQueueStats();
+
+                return true;
+            }
+        }
+    }
+
+    --NumRunningWorkers;
+    UpdateQueueStats();
+    return false;
+}
+
+void FRuntimeImageScheduler::UpdateQueueStats() const
+{
+    // QueueMutex is held by the caller
+    int32 NumQueuedTasks = 0;
+    for (const TArray<FQueuedTask>& Queue : Queues)
+    {
+        NumQueuedTasks += Queue.Num();
+    }
+
+    FRuntimeImageLoaderCounters::SetQueueDepth(NumQueuedTasks, NumRunningWorkers);
+}
@@ -12,8 +12,10 @@
 #include "PixelFormat.h"
 #include "HAL/FileManager.h"
 #include "HAL/UnrealMemory.h"
+#include "HAL/PlatformMemory.h"
 #include "Serialization/BulkData.h"
 #include "Serialization/Archive.h"
+#include "Misc/ScopeExit.h"
 #include "IImageWrapperModule.h"
 #include "Modules/ModuleManager.h"
 #include "IImageWrapper.h"
@@ -28,15 +30,26 @@
 #endif
 
 #include "Helpers/TGAHelpers.h"
+#include "ImageReaders/ImageReaderFactory.h"
+#include "ImageReaders/IImageReader.h"
 #include "Helpers/PNGHelpers.h"
 #include "Helpers/TIFFLoader.h"
 #include "Helpers/QOIHelpers.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
 
 #define MAX_SUPPORTED_TEXTURE_SIZE int32(1 << (MAX_TEXTURE_MIP_COUNT - 1))
 
 namespace FRuntimeImageUtils
 {
-    bool IsImportResolutionValid(int32 Width, int32 Height, bool bAllowNonPowerOfTwo)
+    /** Size of a pixel once the image wrapper decoded it, colour images come out with 4 channels */
+    int32 GetDecodedBytesPerPixel(ERGBFormat Format, int32 BitDepth)
+    {
+        const int32 NumChannels = Format == ERGBFormat::Gray ? 1 : 4;
+        return NumChannels * FMath::Max(1, BitDepth / 8);
+    }
+
+    bool IsImportResolutionValid(int32 Width, int32 Height, bool bAllowNonPowerOfTwo, int32 BytesPerPixel)
     {
         // Calculate the maximum supported resolution utilizing the global max texture mip count
         // (Note, have to subtract 1 because 1x1 is a valid mip-size; this means a GMaxTextureMipCount of 4 means a max resolution of 8x8, not 2^4 = 16x16)
@@ -51,7 +64,15 @@ namespace FRuntimeImageUtils
             bValid = false;
         }
 
-        if (Width > MAX_SUPPORTED_TEXTURE_SIZE || Height > MAX_SUPPORTED_TEXTURE_SIZE)
+        if (Width <= 0 || Height <= 0)
+        {
+            bValid = false;
+        }
+
+        // images larger than a texture can still be decoded to pixels or native image data,
+        // as long as the decoded pixels fit in memory
+        const uint64 AvailableMemoryBytes = FPlatformMemory::GetStats().AvailablePhysical;
+        if ((uint64)Width * (uint64)Height * (uint64)BytesPerPixel > AvailableMemoryBytes)
         {
             bValid = false;
         }
@@ -59,10 +80,33 @@ namespace FRuntimeImageUtils
         return bValid;
     }
 
-    bool ImportBufferAsImage(const uint8* Buffer, int32 Length, FRuntimeImageData& OutImage, FString& OutError)
+    bool IsSupportedImageFile(const FString& Filename)
     {
-        QUICK_SCOPE_CYCLE_COUNTER(STAT_EvoImageUtils_ImportFileAsTexture_ImportBufferAsImage);
-        
+        for (const FString& ImageFormat : SupportedImageFormats)
+        {
+            if (Filename.EndsWith(ImageFormat))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool IsTextureResolutionValid(int32 Width, int32 Height)
+    {
+        return Width > 0 && Height > 0 && Width <= MAX_SUPPORTED_TEXTURE_SIZE && Height <= MAX_SUPPORTED_TEXTURE_SIZE;
+    }
+
+    bool ImportBufferAsImage(const uint8* Buffer, int64 Length, FRuntimeImageData& OutImage, FString& OutError)
+    {
+        FScopedDecodeStat DecodeStat(FRuntimeImageLoaderCounters::GetDecodeFormat(Buffer, Length));
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Decode);
+        ON_SCOPE_EXIT
+        {
+            FRuntimeImageLoaderCounters::AddBytesDecoded(OutImage.RawData.Num());
+        };
+
         IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
 
         //
@@ -72,7 +116,7 @@ namespace FRuntimeImageUtils
         TSharedPtr<IImageWrapper> PngImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
         if (PngImageWrapper.IsValid() && PngImageWrapper->SetCompressed(Buffer, Length))
         {
-            if (!IsImportResolutionValid(PngImageWrapper->GetWidth(), PngImageWrapper->GetHeight(), true))
+            if (!IsImportResolutionValid(PngImageWrapper->GetWidth(), PngImageWrapper->GetHeight(), true, GetDecodedBytesPerPixel(PngImageWrapper->GetFormat(), PngImageWrapper->GetBitDepth())))
             {
                 OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d"), PngImageWrapper->GetWidth(), PngImageWrapper->GetHeight());
                 return false;
@@ -121,7 +165,7 @@ namespace FRuntimeImageUtils
                 return false;
             }
 
-            TArray<uint8> RawPNG;
+            TArray64<uint8> RawPNG;
             if (PngImageWrapper->GetRaw(Format, BitDepth, RawPNG))
             {
                 OutImage.Init2D(
@@ -133,7 +177,11 @@ namespace FRuntimeImageUtils
                 OutImage.SRGB = BitDepth < 16;
                 OutImage.GammaSpace = OutImage.SRGB ? EGammaSpace::sRGB : EGammaSpace::Linear; 
 
-                FPNGHelpers::FillZeroAlphaPNGData(OutImage.SizeX, OutImage.SizeY, OutImage.TextureSourceFormat, OutImage.RawData.GetData());
+                // opaque PNGs are decoded with a constant alpha, there is nothing to fill
+                if (FPNGHelpers::HasAlpha(Buffer, Length))
+                {
+                    FPNGHelpers::FillZeroAlphaPNGData(OutImage.SizeX, OutImage.SizeY, OutImage.TextureSourceFormat, OutImage.RawData.GetData());
+                }
             }
             else
             {
@@ -151,7 +199,7 @@ namespace FRuntimeImageUtils
         TSharedPtr<IImageWrapper> JpegImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::JPEG);
         if (JpegImageWrapper.IsValid() && JpegImageWrapper->SetCompressed(Buffer, Length))
         {
-            if (!IsImportResolutionValid(JpegImageWrapper->GetWidth(), JpegImageWrapper->GetHeight(), true))
+            if (!IsImportResolutionValid(JpegImageWrapper->GetWidth(), JpegImageWrapper->GetHeight(), true, GetDecodedBytesPerPixel(JpegImageWrapper->GetFormat(), JpegImageWrapper->GetBitDepth())))
             {
                 OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d"), JpegImageWrapper->GetWidth(), JpegImageWrapper->GetHeight());
                 return false;
@@ -187,7 +235,7 @@ namespace FRuntimeImageUtils
                 return false;
             }
 
-            TArray<uint8> RawJPEG;
+            TArray64<uint8> RawJPEG;
             if (JpegImageWrapper->GetRaw(Format, BitDepth, RawJPEG))
             {
                 OutImage.Init2D(
@@ -215,13 +263,13 @@ namespace FRuntimeImageUtils
         if (BmpImageWrapper.IsValid() && BmpImageWrapper->SetCompressed(Buffer, Length))
         {
             // Check the resolution of the imported texture to ensure validity
-            if (!IsImportResolutionValid(BmpImageWrapper->GetWidth(), BmpImageWrapper->GetHeight(), true))
+            if (!IsImportResolutionValid(BmpImageWrapper->GetWidth(), BmpImageWrapper->GetHeight(), true, GetDecodedBytesPerPixel(BmpImageWrapper->GetFormat(), BmpImageWrapper->GetBitDepth())))
             {
                 OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d"), BmpImageWrapper->GetWidth(), BmpImageWrapper->GetHeight());
                 return false;
             }
 
-            TArray<uint8> RawBMP;
+            TArray64<uint8> RawBMP;
             if (BmpImageWrapper->GetRaw(BmpImageWrapper->GetFormat(), BmpImageWrapper->GetBitDepth(), RawBMP))
             {
                 // Set texture properties.
@@ -258,13 +306,13 @@ namespace FRuntimeImageUtils
             )
         {
             // Check the resolution of the imported texture to ensure validity
-            if (!IsImportResolutionValid(TGA->Width, TGA->Height, true))
+            if (!IsImportResolutionValid(TGA->Width, TGA->Height, true, sizeof(FColor)))
             {
                 OutError = FString::Printf(TEXT("Texture resolution is not supported: %d x %d"), TGA->Width, TGA->Height);
                 return false;
             }
 
-            const bool bResult = FTGAHelpers::DecompressTGA(TGA, OutImage, OutError);
+            const bool bResult = FTGAHelpers::DecompressTGA(TGA, Length, OutImage, OutError);
             if (bResult)
             {
                 if (OutImage.CompressionSettings == TC_Grayscale && TGA->ImageTypeCode == 3)
@@ -278,7 +326,10 @@ namespace FRuntimeImageUtils
             }
             else
             {
-                OutError = TEXT("Failed to decompress TGA. Please contact devs");
+                if (OutError.IsEmpty())
+                {
+                    OutError = TEXT("Failed to decompress TGA. Please contact devs");
+                }
                 return false;
             }
 
@@ -295,8 +346,9 @@ namespace FRuntimeImageUtils
             int32 Width = ExrImageWrapper->GetWidth();
             int32 Height = ExrImageWrapper->GetHeight();
 
-            if (!IsImportResolutionValid(Width, Height, true))
+            if (!IsImportResolutionValid(Width, Height, true, GetDecodedBytesPerPixel(ExrImageWrapper->GetFormat(), ExrImageWrapper->GetBitDepth())))
             {
+                OutError = FString::Printf(TEXT("EXR Texture resolution is not supported: %d x %d"), Width, Height);
                 return false;
             }
 
@@ -317,7 +369,7 @@ namespace FRuntimeImageUtils
                 return false;
             }
 
-            TArray<uint8> RawExr;
+            TArray64<uint8> RawExr;
             if (ExrImageWrapper->GetRaw(Format, BitDepth, RawExr))
             {
                 OutImage.Init2D(
@@ -345,7 +397,7 @@ namespace FRuntimeImageUtils
         //
 #if WITH_FREEIMAGE_LIB
         static FRuntimeTiffLoadHelper TiffLoaderHelper;
-        if (TiffLoaderHelper.IsValid())
+        if (TiffLoaderHelper.IsValid() && Length <= MAX_uint32)
         {
             TiffLoaderHelper.Reset();
 
@@ -371,7 +423,7 @@ namespace FRuntimeImageUtils
         // QOI
         //
         FQOILoader QOILoader;
-        if (QOILoader.IsValidImage(Buffer, Length))
+        if (Length <= MAX_uint32 && QOILoader.IsValidImage(Buffer, Length))
         {
             if (QOILoader.Load(Buffer, Length))
             {
@@ -399,7 +451,7 @@ namespace FRuntimeImageUtils
         TSharedPtr<IImageWrapper> HdrImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::HDR);
         if (HdrImageWrapper.IsValid() && HdrImageWrapper->SetCompressed(Buffer, Length))
         {
-            if (!IsImportResolutionValid(HdrImageWrapper->GetWidth(), HdrImageWrapper->GetHeight(), true))
+            if (!IsImportResolutionValid(HdrImageWrapper->GetWidth(), HdrImageWrapper->GetHeight(), true, GetDecodedBytesPerPixel(HdrImageWrapper->GetFormat(), HdrImageWrapper->GetBitDepth())))
             {
                 OutError = FString::Printf(TEXT("HDR Texture resolution is not supported: %d x %d"), HdrImageWrapper->GetWidth(), HdrImageWrapper->GetHeight());
                 return false;
@@ -437,9 +489,36 @@ namespace FRuntimeImageUtils
         return false;
     }
 
+    bool ImportImage(const FInputImageDescription& InputImage, FRuntimeImageData& OutImage, FString& OutError)
+    {
+        if (InputImage.ImageFilename.Len() > 0)
+        {
+            TSharedPtr<IImageReader, ESPMode::ThreadSafe> ImageReader = FImageReaderFactory::CreateReader(InputImage.ImageFilename);
+
+            const TArray64<uint8> ImageBuffer = ImageReader->ReadImage(InputImage.ImageFilename);
+            if (ImageBuffer.Num() == 0)
+            {
+                OutError = FString::Printf(TEXT("Failed to read %s image. Error: %s"), *InputImage.ImageFilename, *ImageReader->GetLastError());
+                return false;
+            }
+
+            return ImportBufferAsImage(ImageBuffer.GetData(), ImageBuffer.Num(), OutImage, OutError);
+        }
+
+        if (InputImage.ImageBytes.Num() > 0)
+        {
+            return ImportBufferAsImage(InputImage.ImageBytes.GetData(), InputImage.ImageBytes.Num(), OutImage, OutError);
+        }
+
+        OutError = TEXT("Failed to read image. Make sure input data is valid!");
+        return false;
+    }
+
     UTexture2D* CreateTexture(const FString& ImageFilename, const FRuntimeImageData& ImageData)
     {
         check(IsInGameThread());
+        RUNTIMEIMAGELOADER_SCOPE_STAT(CreateUObject);
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
 
         const FString& BaseFilename = FPaths::GetBaseFilename(ImageFilename);
 
@@ -455,8 +534,6 @@ namespace FRuntimeImageUtils
         NewTexture->Filter = ImageData.FilterMode;
 
         {
-            QUICK_SCOPE_CYCLE_COUNTER(STAT_RuntimeImageReader_ImportFileAsTexture_NewTexture);
-
             check(IsValid(NewTexture));
 
             FTexturePlatformData* PlatformData = new FTexturePlatformData();
@@ -471,10 +548,13 @@ namespace FRuntimeImageUtils
             PlatformData->SizeY = ImageData.SizeY;
             PlatformData->PixelFormat = ImageData.PixelFormat;
 
-            FTexture2DMipMap* Mip = new FTexture2DMipMap();
-            PlatformData->Mips.Add(Mip);
-            Mip->SizeX = ImageData.SizeX;
-            Mip->SizeY = ImageData.SizeY;
+            for (int32 MipIndex = 0; MipIndex < ImageData.NumMips; ++MipIndex)
+            {
+                FTexture2DMipMap* Mip = new FTexture2DMipMap();
+                PlatformData->Mips.Add(Mip);
+                Mip->SizeX = FMath::Max(1, ImageData.SizeX >> MipIndex);
+                Mip->SizeY = FMath::Max(1, ImageData.SizeY >> MipIndex);
+            }
         }
 
         return NewTexture;
@@ -483,6 +563,8 @@ namespace FRuntimeImageUtils
     UTextureCube* CreateTextureCube(const FString& ImageFilename, const FRuntimeImageData& ImageData)
     {
         check(IsInGameThread());
+        RUNTIMEIMAGELOADER_SCOPE_STAT(CreateUObject);
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
 
         const FString& BaseFilename = FPaths::GetBaseFilename(ImageFilename);
 
@@ -497,8 +579,6 @@ namespace FRuntimeImageUtils
         NewTexture->SRGB = ImageData.SRGB;
 
         {
-            QUICK_SCOPE_CYCLE_COUNTER(STAT_RuntimeImageReader_ImportFileAsTexture_NewTexture);
-
             check(IsValid(NewTexture));
 
             FTexturePlatformData* PlatformData = new FTexturePlatformData();
@@ -0,0 +1,477 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#include "RuntimeTiledImage.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "TextureFactory/RuntimeRHITexture2DFactory.h"
+#include "Helpers/TilePyramid.h"
+#include "RuntimeImageUtils.h"
+#include "RuntimeImageLoaderMemory.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeTiledImage, Log, All);
+
+namespace
+{
+    /** Stored tile size for pyramids built from a single image, including the 1 pixel overlap on each side */
+    constexpr int32 BuiltPyramidTileSize = 256;
+
+    FString GetPyramidCacheFilename(const FString& ImageFilename)
+    {
+        // a changed file gets a new pyramid
+        FString CacheKey = ImageFilename;
+        if (FPaths::FileExists(ImageFilename))
+        {
+            IFileManager& FileManager = IFileManager::Get();
+            CacheKey += FString::Printf(TEXT("|%lld|%s"), FileManager.FileSize(*ImageFilename), *FileManager.GetTimeStamp(*ImageFilename).ToString());
+        }
+
+        return FPaths::Combine(
+            FPaths::ProjectSavedDir(), TEXT("RuntimeImageLoader"), TEXT("TilePyramids"),
+            FMD5::HashAnsiString(*CacheKey), FPaths::GetBaseFilename(ImageFilename) + TEXT(".dzi")
+        );
+    }
+
+    bool OpenPyramid(const FString& ImageFilename, const FRuntimeImageTaskHandle& TaskHandle, FTilePyramidDescriptor& OutDescriptor, FString& OutError)
+    {
+        if (FPaths::GetExtension(ImageFilename).Equals(TEXT("dzi"), ESearchCase::IgnoreCase))
+        {
+            return FTilePyramid::LoadDescriptor(ImageFilename, OutDescriptor, OutError);
+        }
+
+        const FString DziFilename = GetPyramidCacheFilename(ImageFilename);
+        if (FPaths::FileExists(DziFilename) && FTilePyramid::LoadDescriptor(DziFilename, OutDescriptor, OutError))
+        {
+            return true;
+        }
+
+        FRuntimeImageData ImageData;
+        if (!FRuntimeImageUtils::ImportImage(FInputImageDescription(ImageFilename), ImageData, OutError))
+        {
+            return false;
+        }
+
+        return FTilePyramid::BuildPyramid(MoveTemp(ImageData), DziFilename, BuiltPyramidTileSize, TaskHandle, OutDescriptor, OutError);
+    }
+
+    FString GetTileName(const FIntVector& TileKey)
+    {
+        return FString::Printf(TEXT("TiledImage_%d_%d_%d"), TileKey.Z, TileKey.X, TileKey.Y);
+    }
+
+    /** Game thread, the texture is rooted until the cache takes it */
+    UTexture2D* CreateTileTexture(const FIntVector& TileKey, const FRuntimeImageData& TileImage, FString& OutError)
+    {
+        check(IsInGameThread());
+
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
+        UTexture2D* Texture = FRuntimeImageUtils::CreateTexture(GetTileName(TileKey), TileImage);
+        if (!IsValid(Texture))
+        {
+            OutError = FString::Printf(TEXT("Failed to create texture for tile %s"), *GetTileName(TileKey));
+            return nullptr;
+        }
+
+        return Texture;
+    }
+
+    /** Waits for the render thread, so it runs on a scheduler worker */
+    bool UploadTileTexture(const FIntVector& TileKey, UTexture2D* Texture, const FRuntimeImageData& TileImage, FString& OutError)
+    {
+        RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
+        FRuntimeRHITexture2DFactory RHITexture2DFactory(Texture, TileImage);
+        if (!RHITexture2DFactory.Create())
+        {
+            OutError = FString::Printf(TEXT("Failed to create RHI texture for tile %s"), *GetTileName(TileKey));
+            return false;
+        }
+
+        FRuntimeTextureRegistry::Register(Texture, GetTileName(TileKey), TileImage.SizeX, TileImage.SizeY, TileImage.PixelFormat, TileImage.NumMips);
+        return true;
+    }
+}
+
+URuntimeTiledImage* URuntimeTiledImage::OpenTiledImage(const FString& ImageFilename, int32 MaxCachedTiles, ERuntimeImagePriority Priority)
+{
+    URuntimeTiledImage* TiledImage = NewObject<URuntimeTiledImage>();
+    TiledImage->MaxCachedTiles = FMath::Max(MaxCachedTiles, 4);
+    TiledImage->Priority = Priority;
+    TiledImage->Open(ImageFilename);
+
+    return TiledImage;
+}
+
+void URuntimeTiledImage::Open(const FString& ImageFilename)
+{
+    TWeakObjectPtr<URuntimeTiledImage> WeakThis(this);
+
+    OpenTaskHandle = FRuntimeImageScheduler::Get().Schedule(
+        [WeakThis, ImageFilename](const FRuntimeImageTaskHandle& InTaskHandle)
+        {
+            TSharedPtr<FTilePyramidDescriptor, ESPMode::ThreadSafe> NewDescriptor = MakeShared<FTilePyramidDescriptor, ESPMode::ThreadSafe>();
+
+            FString Error = TEXT("Tiled image request was cancelled");
+            const bool bOpened = !InTaskHandle.IsCancelled() && OpenPyramid(ImageFilename, InTaskHandle, *NewDescriptor, Error);
+            if (!bOpened)
+            {
+                NewDescriptor = nullptr;
+            }
+
+            AsyncTask(
+                ENamedThreads::GameThread, [WeakThis, NewDescriptor, Error]()
+                {
+                    if (URuntimeTiledImage* TiledImage = WeakThis.Get())
+                    {
+                        TiledImage->OnOpened(NewDescriptor, Error);
+                    }
+                }
+            );
+        },
+        Priority
+    );
+}
+
+void URuntimeTiledImage::OnOpened(TSharedPtr<const FTilePyramidDescriptor, ESPMode::ThreadSafe> InDescriptor, const FString& Error)
+{
+    OpenTaskHandle = FRuntimeImageTaskHandle();
+
+    if (!InDescriptor.IsValid())
+    {
+        UE_LOG(LogRuntimeTiledImage, Warning, TEXT("Failed to open tiled image: %s"), *Error);
+        OnFail.Broadcast(Error);
+        return;
+    }
+
+    Descriptor = InDescriptor;
+    OnReady.Broadcast();
+}
+
+int32 URuntimeTiledImage::GetWidth() const
+{
+    return Descriptor.IsValid() ? Descriptor->Width : 0;
+}
+
+int32 URuntimeTiledImage::GetHeight() const
+{
+    return Descriptor.IsValid() ? Descriptor->Height : 0;
+}
+
+void URuntimeTiledImage::SetMaxCachedTiles(int32 InMaxCachedTiles)
+{
+    MaxCachedTiles = FMath::Max(InMaxCachedTiles, 4);
+    EvictTiles();
+}
+
+void URuntimeTiledImage::UpdateView(const FBox2D& VisibleRegion, float ViewWidthPixels)
+{
+    if (!Descriptor.IsValid())
+    {
+        return;
+    }
+
+    const FTilePyramidDescriptor& Pyramid = *Descriptor;
+
+    const FVector2D RegionMin(FMath::Clamp<double>(VisibleRegion.Min.X, 0., 1.), FMath::Clamp<double>(VisibleRegion.Min.Y, 0., 1.));
+    const FVector2D RegionMax(FMath::Clamp<double>(VisibleRegion.Max.X, 0., 1.), FMath::Clamp<double>(VisibleRegion.Max.Y, 0., 1.));
+
+    ++ViewSerial;
+    ViewTiles.Reset();
+
+    if (RegionMax.X > RegionMin.X && RegionMax.Y > RegionMin.Y)
+    {
+        // the level whose resolution over the visible region is closest to the view, rounded up to stay sharp
+        const double RegionWidthPixels = FMath::Max<double>((RegionMax.X - RegionMin.X) * Pyramid.Width, 1.);
+        const double ViewScale = FMath::Max(ViewWidthPixels, 1.f) / RegionWidthPixels;
+        const int32 MaxLevel = Pyramid.GetMaxLevel();
+
+        int32 Level = FMath::Clamp(MaxLevel + FMath::CeilToInt(FMath::Log2(ViewScale)), 0, MaxLevel);
+
+        auto GetTileRange = [&Pyramid, &RegionMin, &RegionMax](int32 InLevel)
+        {
+            const FIntPoint LevelSize = Pyramid.GetLevelSize(InLevel);
+            const FIntPoint NumTiles = Pyramid.GetNumTiles(InLevel);
+            return FIntRect(
+                FMath::Clamp(FMath::FloorToInt(RegionMin.X * LevelSize.X / Pyramid.TileSize), 0, NumTiles.X - 1),
+                FMath::Clamp(FMath::FloorToInt(RegionMin.Y * LevelSize.Y / Pyramid.TileSize), 0, NumTiles.Y - 1),
+                FMath::Clamp(FMath::CeilToInt(RegionMax.X * LevelSize.X / Pyramid.TileSize) - 1, 0, NumTiles.X - 1),
+                FMath::Clamp(FMath::CeilToInt(RegionMax.Y * LevelSize.Y / Pyramid.TileSize) - 1, 0, NumTiles.Y - 1)
+            );
+        };
+
+        // a view needing more tiles than the cache holds would keep evicting its own tiles
+        FIntRect TileRange = GetTileRange(Level);
+        while (Level > 0 && (TileRange.Width() + 1) * (TileRange.Height() + 1) > MaxCachedTiles / 2)
+        {
+            TileRange = GetTileRange(--Level);
+        }
+
+        for (int32 Row = TileRange.Min.Y; Row <= TileRange.Max.Y; ++Row)
+        {
+            for (int32 Column = TileRange.Min.X; Column <= TileRange.Max.X; ++Column)
+            {
+                ViewTiles.Add(FIntVector(Column, Row, Level));
+            }
+        }
+
+        // the coarsest level that is still a single tile stands in for anything not loaded yet
+        int32 OverviewLevel = Level;
+        while (OverviewLevel > 0 && Pyramid.GetNumTiles(OverviewLevel) != FIntPoint(1, 1))
+        {
+            --OverviewLevel;
+        }
+        if (OverviewLevel != Level)
+        {
+            ViewTiles.Insert(FIntVector(0, 0, OverviewLevel), 0);
+        }
+    }
+
+    for (const FIntVector& TileKey : ViewTiles)
+    {
+        TileLastUsed.Add(TileKey, ViewSerial);
+
+        if (!CachedTiles.Contains(TileKey) && !PendingTiles.Contains(TileKey))
+        {
+            RequestTile(TileKey);
+        }
+    }
+
+    // stop loading tiles that went out of view
+    for (auto PendingIt = PendingTiles.CreateIterator(); PendingIt; ++PendingIt)
+    {
+        if (TileLastUsed.FindRef(PendingIt.Key()) != ViewSerial)
+        {
+            PendingIt.Value().Cancel();
+            PendingIt.RemoveCurrent();
+        }
+    }
+
+    EvictTiles();
+}
+
+TArray<FRuntimeImageTile> URuntimeTiledImage::GetVisibleTiles() const
+{
+    TArray<FRuntimeImageTile> StandInTiles;
+    TArray<FRuntimeImageTile> Tiles;
+    TSet<FIntVector> AddedStandIns;
+
+    for (const FIntVector& TileKey : ViewTiles)
+    {
+        if (UTexture2D* const* Texture = CachedTiles.Find(TileKey))
+        {
+            Tiles.Add(MakeTile(TileKey, *Texture));
+            continue;
+        }
+
+        // closest loaded ancestor
+        for (int32 Level = TileKey.Z - 1; Level >= 0; --Level)
+        {
+            const int32 Shift = TileKey.Z - Level;
+            const FIntVector ParentKey(TileKey.X >> Shift, TileKey.Y >> Shift, Level);
+
+            if (UTexture2D* const* ParentTexture = CachedTiles.Find(ParentKey))
+            {
+                if (!AddedStandIns.Contains(ParentKey))
+                {
+                    AddedStandIns.Add(ParentKey);
+                    StandInTiles.Add(MakeTile(ParentKey, *ParentTexture));
+                }
+                break;
+            }
+        }
+    }
+
+    StandInTiles.Sort([](const FRuntimeImageTile& A, const FRuntimeImageTile& B) { return A.Level < B.Level; });
+    StandInTiles.Append(MoveTemp(Tiles));
+
+    return StandInTiles;
+}
+
+void URuntimeTiledImage::BeginDestroy()
+{
+    OpenTaskHandle.Cancel();
+
+    for (const TPair<FIntVector, FRuntimeImageTaskHandle>& PendingTile : PendingTiles)
+    {
+        PendingTile.Value.Cancel();
+    }
+    PendingTiles.Empty();
+
+    Super::BeginDestroy();
+}
+
+void URuntimeTiledImage::RequestTile(const FIntVector& TileKey)
+{
+    TWeakObjectPtr<URuntimeTiledImage> WeakThis(this);
+    TSharedPtr<const FTilePyramidDescriptor, ESPMode::ThreadSafe> TileDescriptor = Descriptor;
+
+    FRuntimeImageTaskHandle TaskHandle = FRuntimeImageScheduler::Get().Schedule(
+        [WeakThis, TileDescriptor, TileKey](const FRuntimeImageTaskHandle& InTaskHandle)
+        {
+            // whoever cancelled the tile has already forgotten about it
+            if (InTaskHandle.IsCancelled())
+            {
+                return;
+            }
+
+            FString Error;
+            TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> TileImage = MakeShared<FRuntimeImageData, ESPMode::ThreadSafe>();
+            if (!FTilePyramid::DecodeTile(*TileDescriptor, TileKey.Z, FIntPoint(TileKey.X, TileKey.Y), *TileImage, Error))
+            {
+                TileImage = nullptr;
+            }
+
+            // the texture object is created on the game thread without a worker waiting for it
+            AsyncTask(
+                ENamedThreads::GameThread, [WeakThis, TileKey, TileImage, Error, TaskId = InTaskHandle.GetId()]()
+                {
+                    URuntimeTiledImage* TiledImage = WeakThis.Get();
+                    if (!TiledImage || !TiledImage->IsTilePending(TileKey, TaskId))
+                    {
+                        return;
+                    }
+
+                    FString TextureError = Error;
+                    UTexture2D* Texture = TileImage.IsValid() ? CreateTileTexture(TileKey, *TileImage, TextureError) : nullptr;
+                    if (!Texture)
+                    {
+                        TiledImage->OnTileLoaded(TileKey, nullptr, TextureError);
+                        return;
+                    }
+
+                    TiledImage->PendingTiles.Add(TileKey, TiledImage->UploadTile(TileKey, Texture, TileImage));
+                }
+            );
+        },
+        Priority
+    );
+
+    PendingTiles.Add(TileKey, TaskHandle);
+}
+
+FRuntimeImageTaskHandle URuntimeTiledImage::UploadTile(const FIntVector& TileKey, UTexture2D* Texture, TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> TileImage)
+{
+    TWeakObjectPtr<URuntimeTiledImage> WeakThis(this);
+
+    return FRuntimeImageScheduler::Get().Schedule(
+        [WeakThis, TileKey, Texture, TileImage](const FRuntimeImageTaskHandle& InTaskHandle)
+        {
+            FString Error;
+            const bool bUploaded = !InTaskHandle.IsCancelled() && UploadTileTexture(TileKey, Texture, *TileImage, Error);
+
+            AsyncTask(
+                ENamedThreads::GameThread, [WeakThis, TileKey, Texture, bUploaded, Error, TaskId = InTaskHandle.GetId()]()
+                {
+                    URuntimeTiledImage* TiledImage = WeakThis.Get();
+                    const bool bWanted = TiledImage && TiledImage->IsTilePending(TileKey, TaskId);
+                    if (bWanted)
+                    {
+                        TiledImage->OnTileLoaded(TileKey, bUploaded ? Texture : nullptr, Error);
+                    }
+
+                    // taken over by the cache otherwise
+                    if (!bWanted || !bUploaded)
+                    {
+                        Texture->RemoveFromRoot();
+                    }
+                }
+            );
+        },
+        Priority
+    );
+}
+
+bool URuntimeTiledImage::IsTilePending(const FIntVector& TileKey, uint64 TaskId) const
+{
+    // a tile cancelled and requested again has a different task
+    const FRuntimeImageTaskHandle* PendingTask = PendingTiles.Find(TileKey);
+    return PendingTask && PendingTask->GetId() == TaskId;
+}
+
+void URuntimeTiledImage::OnTileLoaded(const FIntVector& TileKey, UTexture2D* Texture, const FString& Error)
+{
+    PendingTiles.Remove(TileKey);
+
+    if (!Texture)
+    {
+        UE_LOG(LogRuntimeTiledImage, Warning, TEXT("Failed to load tile (%d, %d) at level %d: %s"), TileKey.X, TileKey.Y, TileKey.Z, *Error);
+        return;
+    }
+
+    // owned by the cache from now on
+    Texture->RemoveFromRoot();
+    CachedTiles.Add(TileKey, Texture);
+
+    if (!TileLastUsed.Contains(TileKey))
+    {
+        TileLastUsed.Add(TileKey, ViewSerial);
+    }
+
+    EvictTiles();
+
+    OnTilesUpdated.Broadcast();
+}
+
+void URuntimeTiledImage::EvictTiles()
+{
+    // forget usage of tiles that are neither cached nor loading
+    for (auto UsageIt = TileLastUsed.CreateIterator(); UsageIt; ++UsageIt)
+    {
+        if (!CachedTiles.Contains(UsageIt.Key()) && !PendingTiles.Contains(UsageIt.Key()) && UsageIt.Value() != ViewSerial)
+        {
+            UsageIt.RemoveCurrent();
+        }
+    }
+
+    if (CachedTiles.Num() <= MaxCachedTiles)
+    {
+        return;
+    }
+
+    TArray<FIntVector> TileKeys;
+    CachedTiles.GetKeys(TileKeys);
+    TileKeys.Sort([this](const FIntVector& A, const FIntVector& B) { return TileLastUsed.FindRef(A) < TileLastUsed.FindRef(B); });
+
+    // least recently used first, tiles of the current view are never evicted.
+    // GPU memory is released right away, the texture objects by the next garbage collection
+    for (const FIntVector& TileKey : TileKeys)
+    {
+        if (CachedTiles.Num() <= MaxCachedTiles || TileLastUsed.FindRef(TileKey) == ViewSerial)
+        {
+            break;
+        }
+
+        if (UTexture2D* EvictedTexture = CachedTiles.FindAndRemoveChecked(TileKey))
+        {
+            EvictedTexture->ReleaseResource();
+            FRuntimeTextureRegistry::Unregister(EvictedTexture);
+        }
+        TileLastUsed.Remove(TileKey);
+    }
+}
+
+FRuntimeImageTile URuntimeTiledImage::MakeTile(const FIntVector& TileKey, UTexture2D* Texture) const
+{
+    const FTilePyramidDescriptor& Pyramid = *Descriptor;
+
+    const FIntPoint Tile(TileKey.X, TileKey.Y);
+    const FIntPoint LevelSize = Pyramid.GetLevelSize(TileKey.Z);
+    const FIntRect TileRect = Pyramid.GetTileRect(TileKey.Z, Tile);
+    const FIntRect StoredTileRect = Pyramid.GetStoredTileRect(TileKey.Z, Tile);
+
+    FRuntimeImageTile ImageTile;
+    ImageTile.Texture = Texture;
+    ImageTile.Level = TileKey.Z;
+    ImageTile.ImageRegion = FBox2D(
+        FVector2D((double)TileRect.Min.X / LevelSize.X, (double)TileRect.Min.Y / LevelSize.Y),
+        FVector2D((double)TileRect.Max.X / LevelSize.X, (double)TileRect.Max.Y / LevelSize.Y)
+    );
+    ImageTile.TextureRegion = FBox2D(
+        FVector2D((double)(TileRect.Min.X - StoredTileRect.Min.X) / StoredTileRect.Width(), (double)(TileRect.Min.Y - StoredTileRect.Min.Y) / StoredTileRect.Height()),
+        FVector2D((double)(TileRect.Max.X - StoredTileRect.Min.X) / StoredTileRect.Width(), (double)(TileRect.Max.Y - StoredTileRect.Min.Y) / StoredTileRect.Height())
+    );
+
+    return ImageTile;
+}
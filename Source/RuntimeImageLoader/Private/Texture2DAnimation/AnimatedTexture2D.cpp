@@ -36,15 +36,54 @@ void UAnimatedTexture2D::Tick(float DeltaTime)
 
 	if (!Decoder) return;
 
+	// FrameTime is the time the current frame has been shown. The remainder is carried over on every advance
+	// so playback doesn't drift, and after a hitch playback jumps straight to the frame that should be shown
 	FrameTime += DeltaTime * PlayRate;
-	if (FrameTime < Decoder->GetNextFrameDelay(CurrentFrame))
-		return;
 
-	FrameTime = 0;
+	const int32 NumDecodedFrames = Decoder->GetNumDecodedFrames();
+	int32 TargetFrame = CurrentFrame;
+	int32 NumAdvancedFrames = 0;
+	float AdvancedTime = 0.f;
+
+	for (float Delay = GetFrameDelay(TargetFrame); FrameTime >= Delay; Delay = GetFrameDelay(TargetFrame))
+	{
+		int32 NextFrame = TargetFrame + 1;
+		if (NextFrame >= NumDecodedFrames)
+		{
+			// hold on the last available frame while the rest of the animation is still decoding, or at the end when not looping
+			if (!Decoder->IsDecodeFinished() || !bLooping)
+			{
+				FrameTime = Delay;
+				break;
+			}
+
+			NextFrame = 0;
+		}
+
+		FrameTime -= Delay;
+		TargetFrame = NextFrame;
+
+		// skip whole loops at once after very long deltas
+		AdvancedTime += Delay;
+		if (++NumAdvancedFrames == NumDecodedFrames && AdvancedTime > 0.f)
+		{
+			FrameTime = FMath::Fmod(FrameTime, AdvancedTime);
+		}
+	}
+
+	if (TargetFrame != CurrentFrame)
+	{
+		CurrentFrame = TargetFrame;
+		RenderFrameToTexture();
+	}
+}
 
-	RenderFrameToTexture();
+float UAnimatedTexture2D::GetFrameDelay(int32 FrameIndex) const
+{
+	const float Delay = Decoder->GetNextFrameDelay(FrameIndex);
 
-	CurrentFrame++;
+	// never zero, the clock advances by whole frame delays
+	return FMath::Max(Delay > 0.f ? Delay : DefaultFrameDelay, 0.001f);
 }
 
 UAnimatedTexture2D* UAnimatedTexture2D::Create(int32 InSizeX, int32 InSizeY, const FAnimatedTexture2DCreateInfo& InCreateInfo)
@@ -87,7 +126,7 @@ UAnimatedTexture2D* UAnimatedTexture2D::Create(int32 InSizeX, int32 InSizeY, con
 	}
 }
 
-void UAnimatedTexture2D::SetDecoder(TUniquePtr<IGIFLoader> DecoderState)
+void UAnimatedTexture2D::SetDecoder(TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> DecoderState)
 {
 	Decoder = MoveTemp(DecoderState);
 }
@@ -96,12 +135,22 @@ void UAnimatedTexture2D::RenderFrameToTexture()
 {
 	FScopeLock ResultsLock(&ResultsMutex);
 
-	if (CurrentFrame > Decoder->GetTotalFrames() - 1 && bLooping) CurrentFrame = 0;
-
 	FRenderCommandData CommandData;
 
 	CommandData.RHIResource = GetResource();
-	CommandData.RawData = (const uint8*)Decoder->GetNextFrame(CurrentFrame);
+	CommandData.Decoder = Decoder;
+	CommandData.FrameIndex = CurrentFrame;
+
+	// sequential frames only upload the area that changed since the previous frame
+	if (CurrentFrame == LastRenderedFrame + 1)
+	{
+		CommandData.DirtyRect = Decoder->GetFrameDirtyRect(CurrentFrame);
+	}
+	else
+	{
+		CommandData.DirtyRect = FIntRect(0, 0, Decoder->GetWidth(), Decoder->GetHeight());
+	}
+	LastRenderedFrame = CurrentFrame;
 
 	/** @See AsyncTaskDownloadImage Class, How to Pass Texture Content Data To Render QUEUE at Runtime */
 	ENQUEUE_RENDER_COMMAND(AnimTexture2D_RenderFrame)(
@@ -118,12 +167,29 @@ void UAnimatedTexture2D::RenderFrameToTexture()
 			uint32 TexHeight = Texture2DRHI->GetSizeY();
 			uint32 SrcPitch = TexWidth * sizeof(FColor);
 
-			FUpdateTextureRegion2D Region;
-			Region.SrcX = Region.SrcY = Region.DestX = Region.DestY = 0;
-			Region.Width = TexWidth;
-			Region.Height = TexHeight;
+			const FIntRect DirtyRect(
+				FIntPoint::ComponentMax(CommandData.DirtyRect.Min, FIntPoint::ZeroValue),
+				FIntPoint::ComponentMin(CommandData.DirtyRect.Max, FIntPoint(TexWidth, TexHeight)));
+			if (DirtyRect.Width() <= 0 || DirtyRect.Height() <= 0)
+				return;
 
-			RHIUpdateTexture2D(Texture2DRHI, 0, Region, SrcPitch, CommandData.RawData);
+			FUpdateTextureRegion2D Region;
+			Region.SrcX = Region.DestX = DirtyRect.Min.X;
+			Region.SrcY = Region.DestY = DirtyRect.Min.Y;
+			Region.Width = DirtyRect.Width();
+			Region.Height = DirtyRect.Height();
+
+			// frame stores expand frames into scratch buffers shared with other textures, the pixels are only valid inside the visitor
+			CommandData.Decoder->ReadFrame(
+				CommandData.FrameIndex,
+				[&](const FColor* FramePixels)
+				{
+					const uint8* RawData = (const uint8*)FramePixels;
+					RawData += Region.SrcY * SrcPitch + Region.SrcX * sizeof(FColor);
+
+					RHIUpdateTexture2D(Texture2DRHI, 0, Region, SrcPitch, RawData);
+				}
+			);
 		}
 	);
 }
@@ -139,6 +205,12 @@ void UAnimatedTexture2D::PlayFromStart()
 	FrameDelay = 0;
 	bPlaying = true;
 	CurrentFrame = 0;
+	LastRenderedFrame = INDEX_NONE;
+
+	if (Decoder)
+	{
+		RenderFrameToTexture();
+	}
 }
 
 void UAnimatedTexture2D::Stop()
@@ -160,11 +232,11 @@ void UAnimatedTexture2D::Init(int32 InSizeX, int32 InSizeY, EPixelFormat InForma
 	UpdateResource();
 }
 
-const uint8* UAnimatedTexture2D::GetFirstFrameData() const
+void UAnimatedTexture2D::ReadFirstFrameData(TFunctionRef<void(const uint8* FrameData)> Visitor) const
 {
 	check (Decoder.IsValid());
 
-	return (const uint8*)Decoder->GetNextFrame(CurrentFrame);
+	Decoder->ReadFrame(CurrentFrame, [&Visitor](const FColor* FramePixels) { Visitor((const uint8*)FramePixels); });
 }
 
 uint32 UAnimatedTexture2D::GetFrameSize() const
@@ -4,6 +4,7 @@
 #include "Containers/ResourceArray.h"
 #include "Engine/Texture2D.h"
 #include "Texture2DAnimation/AnimatedTexture2D.h"
+#include "RuntimeImageLoaderMemory.h"
 
 struct FGifDataResource : public FResourceBulkDataInterface
 {
@@ -60,6 +61,8 @@ void FAnimatedTextureResource::InitRHI()
 void FAnimatedTextureResource::InitRHI(FRHICommandListBase& RHICmdList)
 #endif
 {
+	RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
 	// Create the sampler state RHI resource.
 	ESamplerAddressMode AddressU = ConvertAddressMode(Owner->AddressX);
 	ESamplerAddressMode AddressV = ConvertAddressMode(Owner->AddressY);
@@ -107,26 +110,30 @@ void FAnimatedTextureResource::InitRHI(FRHICommandListBase& RHICmdList)
 	
 	FRHIResourceCreateInfo CreateInfo(*Name);
 
-	FGifDataResource GifBulkData((void*)Owner->GetFirstFrameData(), Owner->GetFrameSize());
-	CreateInfo.BulkData = &GifBulkData;
-	
+	// the first frame may live in a scratch buffer shared with other textures, so the texture is created while it is being read
+	Owner->ReadFirstFrameData([&](const uint8* FrameData)
+	{
+		FGifDataResource GifBulkData((void*)FrameData, Owner->GetFrameSize());
+		CreateInfo.BulkData = &GifBulkData;
+
 #if (ENGINE_MAJOR_VERSION >= 5) && (ENGINE_MINOR_VERSION > 0)
-    TextureRHI = RHICreateTexture(
-        FRHITextureCreateDesc::Create2D(CreateInfo.DebugName)
-        .SetExtent(GetSizeX(), GetSizeY())
-        .SetFormat(ImageFormat)
-        .SetNumMips(NumMips)
-        .SetNumSamples(1)
-        .SetFlags(Flags)
-        .SetInitialState(ERHIAccess::Unknown)
-        .SetExtData(CreateInfo.ExtData)
-		.SetBulkData(CreateInfo.BulkData)
-        .SetGPUMask(CreateInfo.GPUMask)
-        .SetClearValue(CreateInfo.ClearValueBinding)
-    );
+		TextureRHI = RHICreateTexture(
+			FRHITextureCreateDesc::Create2D(CreateInfo.DebugName)
+			.SetExtent(GetSizeX(), GetSizeY())
+			.SetFormat(ImageFormat)
+			.SetNumMips(NumMips)
+			.SetNumSamples(1)
+			.SetFlags(Flags)
+			.SetInitialState(ERHIAccess::Unknown)
+			.SetExtData(CreateInfo.ExtData)
+			.SetBulkData(CreateInfo.BulkData)
+			.SetGPUMask(CreateInfo.GPUMask)
+			.SetClearValue(CreateInfo.ClearValueBinding)
+		);
 #else
-    TextureRHI = RHICreateTexture2D(GetSizeX(), GetSizeY(), ImageFormat, NumMips, 1, Flags, CreateInfo);
+		TextureRHI = RHICreateTexture2D(GetSizeX(), GetSizeY(), ImageFormat, NumMips, 1, Flags, CreateInfo);
 #endif
+	});
 
 	TextureRHI->SetName(Owner->GetFName());
 	RHIUpdateTextureReference(Owner->TextureReference.TextureReferenceRHI, TextureRHI);
@@ -12,6 +12,8 @@
 #include "Async/TaskGraphInterfaces.h"
 
 #include "RuntimeTexture2DResource.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
 
 
 FRuntimeRHITexture2DFactory::FRuntimeRHITexture2DFactory(UTexture2D* InTexture2D, const FRuntimeImageData& InImageData)
@@ -22,6 +24,9 @@ FRuntimeRHITexture2DFactory::FRuntimeRHITexture2DFactory(UTexture2D* InTexture2D
 
 FTexture2DRHIRef FRuntimeRHITexture2DFactory::Create()
 {
+    RUNTIMEIMAGELOADER_SCOPE_STAT(RHIUpload);
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+
 #if PLATFORM_WINDOWS
     RHITexture2D = CreateRHITexture2D_Windows();
 #elif PLATFORM_ANDROID
@@ -38,24 +43,48 @@ FTexture2DRHIRef FRuntimeRHITexture2DFactory::Create()
 struct FTextureDataResource : public FResourceBulkDataInterface
 {
 public:
-    FTextureDataResource(void* InMipData, int32 InDataSize)
+    FTextureDataResource(void* InMipData, int64 InDataSize)
         : MipData(InMipData), DataSize(InDataSize)
     {}
 
     const void* GetResourceBulkData() const override { return MipData; }
-    uint32 GetResourceBulkDataSize() const override { return DataSize; }
+    uint32 GetResourceBulkDataSize() const override { check(DataSize <= MAX_uint32); return (uint32)DataSize; }
     void Discard() override {}
 
 private:
     void* MipData;
-    int32 DataSize;
+    int64 DataSize;
 };
 
+void FRuntimeRHITexture2DFactory::GetMipData(TArray<void*>& OutMipData, int64& OutDataSize) const
+{
+    OutMipData.Reset();
+    OutDataSize = 0;
+
+    if (ImageData.ExternalMips.Num() == 0)
+    {
+        OutMipData.Add((void*)ImageData.RawData.GetData());
+        OutDataSize = ImageData.RawData.Num();
+        return;
+    }
+
+    for (const TArrayView64<const uint8>& Mip : ImageData.ExternalMips)
+    {
+        check(OutMipData.Num() == 0 || (const uint8*)OutMipData[0] + OutDataSize == Mip.GetData());
+
+        OutMipData.Add((void*)Mip.GetData());
+        OutDataSize += Mip.Num();
+    }
+}
+
 FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Windows()
 {
-    uint32 NumMips = 1;
     uint32 NumSamples = 1;
-    void* Mip0Data = (void*)ImageData.RawData.GetData();
+
+    TArray<void*> MipData;
+    int64 DataSize = 0;
+    GetMipData(MipData, DataSize);
+    FRuntimeImageLoaderCounters::AddBytesUploaded(DataSize);
 
     ETextureCreateFlags TextureFlags = TexCreate_ShaderResource;
     if (ImageData.SRGB)
@@ -77,8 +106,8 @@ FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Windows()
             ImageData.PixelFormat,
             ImageData.NumMips,
             TextureFlags,
-            &Mip0Data,
-            1
+            MipData.GetData(),
+            MipData.Num()
 #if (ENGINE_MAJOR_VERSION >= 5) && (ENGINE_MINOR_VERSION > 2)
             ,CompletionEvent
 #endif
@@ -86,7 +115,8 @@ FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Windows()
     }
     else
     {
-        FTextureDataResource TextureData(Mip0Data, ImageData.RawData.Num());
+        // bulk data holds all mips back to back
+        FTextureDataResource TextureData(MipData[0], DataSize);
 
         FRHIResourceCreateInfo CreateInfo(TEXT("RuntimeImageReaderTextureData"));
         CreateInfo.BulkData = &TextureData;
@@ -128,9 +158,12 @@ FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Windows()
 
 FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Mobile()
 {
-    uint32 NumMips = 1;
     uint32 NumSamples = 1;
-    void* Mip0Data = (void*)ImageData.RawData.GetData();
+
+    TArray<void*> MipData;
+    int64 DataSize = 0;
+    GetMipData(MipData, DataSize);
+    FRuntimeImageLoaderCounters::AddBytesUploaded(DataSize);
 
     ETextureCreateFlags TextureFlags = TexCreate_ShaderResource;
     if (ImageData.SRGB)
@@ -142,7 +175,7 @@ FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Mobile()
     ensureMsgf(ImageData.SizeY > 0, TEXT("ImageData.SizeY must be > 0"));
 
     FGraphEventRef CreateTextureTask = FFunctionGraphTask::CreateAndDispatchWhenReady(
-        [this, &TextureFlags]()
+        [this, &TextureFlags, &MipData]()
         {
             FRHIResourceCreateInfo DummyCreateInfo(TEXT("DummyCreateInfo"));
 #if (ENGINE_MAJOR_VERSION >= 5) && (ENGINE_MINOR_VERSION > 0)
@@ -169,21 +202,26 @@ FTexture2DRHIRef FRuntimeRHITexture2DFactory::CreateRHITexture2D_Mobile()
                 DummyCreateInfo);
 #endif
 
-            FUpdateTextureRegion2D TextureRegion2D;
+            const FPixelFormatInfo& FormatInfo = GPixelFormats[ImageData.PixelFormat];
+            for (int32 MipIndex = 0; MipIndex < MipData.Num(); ++MipIndex)
             {
-                TextureRegion2D.DestX = 0;
-                TextureRegion2D.DestY = 0;
-                TextureRegion2D.SrcX = 0;
-                TextureRegion2D.SrcY = 0;
-                TextureRegion2D.Width = ImageData.SizeX;
-                TextureRegion2D.Height = ImageData.SizeY;
+                FUpdateTextureRegion2D TextureRegion2D;
+                {
+                    TextureRegion2D.DestX = 0;
+                    TextureRegion2D.DestY = 0;
+                    TextureRegion2D.SrcX = 0;
+                    TextureRegion2D.SrcY = 0;
+                    TextureRegion2D.Width = FMath::Max(1, ImageData.SizeX >> MipIndex);
+                    TextureRegion2D.Height = FMath::Max(1, ImageData.SizeY >> MipIndex);
+                }
+
+                // pitch of a row of blocks, a block is a single pixel for uncompressed formats
+                RHIUpdateTexture2D(
+                    RHITexture2D, MipIndex, TextureRegion2D,
+                    FMath::DivideAndRoundUp<uint32>(TextureRegion2D.Width, FormatInfo.BlockSizeX) * FormatInfo.BlockBytes,
+                    (const uint8*)MipData[MipIndex]
+                );
             }
-
-            RHIUpdateTexture2D(
-                RHITexture2D, 0, TextureRegion2D,
-                TextureRegion2D.Width * GPixelFormats[ImageData.PixelFormat].BlockBytes,
-                ImageData.RawData.GetData()
-            );
         }, TStatId(), nullptr, ENamedThreads::ActualRenderingThread
     );
     CreateTextureTask->Wait();
@@ -31,6 +31,9 @@ private:
     FTexture2DRHIRef CreateRHITexture2D_Other();
     void FinalizeRHITexture2D();
 
+    /** Initial data of every mip, either RawData or ImageData.ExternalMips */
+    void GetMipData(TArray<void*>& OutMipData, int64& OutDataSize) const;
+
 private:
     UTexture2D* NewTexture;
     const FRuntimeImageData& ImageData;
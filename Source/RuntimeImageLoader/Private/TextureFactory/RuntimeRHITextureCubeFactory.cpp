@@ -11,6 +11,8 @@
 #include "Async/TaskGraphInterfaces.h"
 
 #include "RuntimeTextureCubeResource.h"
+#include "RuntimeImageLoaderMemory.h"
+#include "RuntimeImageLoaderStats.h"
 
 FRuntimeRHITextureCubeFactory::FRuntimeRHITextureCubeFactory(UTextureCube* InTextureCube, const FRuntimeImageData& InImageData)
 : NewTextureCube(InTextureCube), ImageData(InImageData)
@@ -33,21 +35,25 @@ enum ECubeFace
 struct FTextureCubeDataResource : public FResourceBulkDataInterface
 {
 public:
-    FTextureCubeDataResource(void* InMipData, int32 InDataSize)
+    FTextureCubeDataResource(void* InMipData, int64 InDataSize)
         : MipData(InMipData), DataSize(InDataSize)
     {}
 
     const void* GetResourceBulkData() const override { return MipData; }
-    uint32 GetResourceBulkDataSize() const override { return DataSize; }
+    uint32 GetResourceBulkDataSize() const override { check(DataSize <= MAX_uint32); return (uint32)DataSize; }
     void Discard() override {}
 
 private:
     void* MipData;
-    int32 DataSize;
+    int64 DataSize;
 };
 
 FTextureCubeRHIRef FRuntimeRHITextureCubeFactory::Create()
 {
+    RUNTIMEIMAGELOADER_SCOPE_STAT(RHIUpload);
+    RUNTIMEIMAGELOADER_LLM_SCOPE(Textures);
+    FRuntimeImageLoaderCounters::AddBytesUploaded(ImageData.RawData.Num());
+
     RHITextureCube = CreateTextureCubeRHI_Windows();
 
     FinalizeRHITexture2D();
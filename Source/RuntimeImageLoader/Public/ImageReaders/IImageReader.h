@@ -7,7 +7,21 @@
 class IImageReader
 {
 public:
-    virtual TArray<uint8> ReadImage(const FString& ImageURI) = 0;
+    /** Files are read into a 64-bit array so images above 2 GB aren't truncated */
+    virtual TArray64<uint8> ReadImage(const FString& ImageURI) = 0;
+
+    /** For decoders indexing with 32-bit offsets (animations). Readers that can fill OutImageData directly avoid holding the file twice */
+    virtual bool ReadImage32(const FString& ImageURI, TArray<uint8>& OutImageData)
+    {
+        TArray64<uint8> ImageData = ReadImage(ImageURI);
+        if (ImageData.Num() == 0 || ImageData.Num() > MAX_int32)
+        {
+            return false;
+        }
+
+        OutImageData.Append(ImageData.GetData(), (int32)ImageData.Num());
+        return true;
+    }
     virtual FString GetLastError() const { return TEXT(""); };
     virtual void Flush() = 0;
     virtual void Cancel() = 0;
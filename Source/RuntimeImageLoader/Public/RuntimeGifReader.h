@@ -5,10 +5,10 @@
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "Engine/Texture.h"
-#include "Async/Future.h"
 #include "Templates/SharedPointer.h"
 #include "Helpers/GIFLoader.h"
 #include "InputImageDescription.h"
+#include "RuntimeImageScheduler.h"
 #include "RuntimeGifReader.generated.h"
 
 class UAnimatedTexture2D;
@@ -21,6 +21,27 @@ struct RUNTIMEIMAGELOADER_API FGifReadRequest
 {
 	FInputImageDescription InputGif;
     TEnumAsByte<TextureFilter> FilterMode = TextureFilter::TF_Default;
+
+    /** Keep decoded frames LZ4 compressed in memory, trading a little CPU per frame for much smaller fully cached animations */
+    bool bCompressFrames = false;
+
+    /**
+     * Keep only the canvas and a few recent frames, decoding each frame's changed region when it is played.
+     * Memory no longer grows with the animation length. Currently used by animated WebP only
+     */
+    bool bStreamFrames = false;
+
+    /** Reuse decoded frames of an identical GIF that is already loaded (same unchanged file, or same bytes) */
+    bool bShareDecodedData = false;
+
+    /** Return the very same animated texture for identical GIFs and filter. Playback state (frame, rate, looping) is shared as well */
+    bool bShareTexture = false;
+
+    /** Return the animated texture as soon as the first frame is decoded, the rest is decoded in background */
+    bool bProgressiveDecode = true;
+
+    /** Order in FRuntimeImageScheduler relative to other pending loads */
+    ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal;
 };
 
 USTRUCT()
@@ -44,10 +65,14 @@ class RUNTIMEIMAGELOADER_API URuntimeGifReader : public UBlueprintAsyncActionBas
 public:
 	/** GIF */
     UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "Runtime Gif Reader")
-    static URuntimeGifReader* LoadGIF(const FString& GIFFilename, TEnumAsByte<enum TextureFilter> InFilterMode = TextureFilter::TF_Trilinear, bool bSynchronous = false);
+    static URuntimeGifReader* LoadGIF(const FString& GIFFilename, TEnumAsByte<enum TextureFilter> InFilterMode = TextureFilter::TF_Trilinear, bool bSynchronous = false, ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal);
 
     UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true"), Category = "Runtime Gif Reader")
-	static URuntimeGifReader* LoadGIFFromBytes(UPARAM(ref) TArray<uint8>& GifBytes, TEnumAsByte<enum TextureFilter> InFilterMode = TextureFilter::TF_Trilinear, bool bSynchronous = false);
+	static URuntimeGifReader* LoadGIFFromBytes(UPARAM(ref) TArray<uint8>& GifBytes, TEnumAsByte<enum TextureFilter> InFilterMode = TextureFilter::TF_Trilinear, bool bSynchronous = false, ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal);
+
+    /** Stops the load, including a decode already in progress. OnFail is broadcast unless the texture was already returned */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Gif Reader")
+    void Cancel();
 
 public:
 	// Bind to these events when you want to use async API from C++
@@ -61,16 +86,28 @@ public:
 	/* Native API */
 	void SubmitRequest(FGifReadRequest&& InRequest, bool bSynchronous = false);
 
+	const FRuntimeImageTaskHandle& GetTaskHandle() const { return TaskHandle; }
+
 private:
-	void ProcessRequest();
+	void ProcessRequest(const FRuntimeImageTaskHandle& InTaskHandle);
+	bool ReadAndDecode(const FRuntimeImageTaskHandle& InTaskHandle);
+	bool CreateAnimatedTexture(const TSharedPtr<IGIFLoader, ESPMode::ThreadSafe>& InDecoder);
+	void FindSharedDecoder();
 	void OnPostProcessRequest();
 
 private:
 	FGifReadRequest Request;
 
-	TFuture<void> CurrentTask;
+	FRuntimeImageTaskHandle TaskHandle;
+	bool bResultPublished = false;
+
 	TSharedPtr<IImageReader, ESPMode::ThreadSafe> ImageReader;
-	TUniquePtr<IGIFLoader> Decoder;
+	TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> Decoder;
+	FString CacheKey;
+
+	/** Outcome of the cache lookups of this request, recorded once when the result is published */
+	bool bCacheLookedUp = false;
+	bool bCacheHit = false;
 
     UPROPERTY()
     FGifReadResult ReadResult;
@@ -0,0 +1,56 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Engine/Texture2D.h"
+#include "RuntimeImageBundle.generated.h"
+
+class FImageBundleReader;
+struct FRuntimeImageData;
+
+/**
+ * Many GPU ready images packed into one file by the RuntimeImageConvert commandlet (-Bundle=).
+ * The bundle is memory mapped once on open, a texture load uploads its mips straight from the mapping:
+ * no file open, no decode and no copy per image.
+ */
+UCLASS(BlueprintType)
+class RUNTIMEIMAGELOADER_API URuntimeImageBundle : public UObject
+{
+    GENERATED_BODY()
+
+public:
+    /** Maps the bundle and reads its index. Keep a reference to the returned object while loading from it */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    static URuntimeImageBundle* OpenImageBundle(const FString& Filename, FString& OutError);
+
+    /** Names are paths relative to the converted directory, without the extension */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    TArray<FString> GetImageNames() const;
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    bool Contains(const FString& Name) const;
+
+    /** Creates a texture from the bundled mips. The texture doesn't reference the bundle afterwards */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    UTexture2D* LoadTexture(const FString& Name, FString& OutError);
+
+    /** Creates a texture from a single .rtex cache file, written by the RuntimeImageConvert commandlet without -Bundle */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    static UTexture2D* LoadTextureCacheFile(const FString& Filename, FString& OutError);
+
+    /** Unmaps the bundle, loaded textures stay valid */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    void Close();
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Bundle")
+    bool IsOpen() const { return Reader.IsValid(); }
+
+private:
+    /** ImageData describes the texture and holds views of its mips in ExternalMips */
+    static UTexture2D* CreateTexture(const FString& Name, FRuntimeImageData& ImageData, FString& OutError);
+
+private:
+    TSharedPtr<FImageBundleReader, ESPMode::ThreadSafe> Reader;
+};
@@ -22,4 +22,10 @@ struct RUNTIMEIMAGELOADER_API FRuntimeImageData : public FImage
     ETextureSourceFormat TextureSourceFormat = TSF_Invalid;
     TextureCompressionSettings CompressionSettings;
     EPixelFormat PixelFormat = PF_B8G8R8A8;
+
+    /**
+     * GPU ready mips in PixelFormat owned elsewhere (e.g. a memory mapped image bundle), uploaded without a copy.
+     * Mips have to follow each other in memory, RawData is ignored when set
+     */
+    TArray<TArrayView64<const uint8>> ExternalMips;
 };
\ No newline at end of file
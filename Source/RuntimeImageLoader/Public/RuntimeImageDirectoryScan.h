@@ -0,0 +1,90 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "RuntimeImageScheduler.h"
+#include "RuntimeImageDirectoryScan.generated.h"
+
+/** Image file found by URuntimeImageDirectoryScan */
+USTRUCT(BlueprintType)
+struct RUNTIMEIMAGELOADER_API FRuntimeImageFileInfo
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Image Loader")
+    FString Filename;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Image Loader")
+    int64 FileSize = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Image Loader")
+    FDateTime Timestamp;
+
+    /** Width, height and format are read from the file header when the scan probes headers, zero and empty otherwise */
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Image Loader")
+    int32 Width = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Image Loader")
+    int32 Height = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Image Loader")
+    FString Format;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FImageDirectoryScanBatchDelegate, const TArray<FRuntimeImageFileInfo>&, Images);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FImageDirectoryScanCompletedDelegate, int32, NumImages);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FImageDirectoryScanFailureDelegate, FString, OutError);
+
+/**
+ * Finds images in a directory off the game thread. Directories of the same depth are listed in parallel
+ * and every level is reported through OnImagesFound as soon as it is done.
+ *
+ * With header probing, dimensions and formats are kept in an index under Saved/RuntimeImageLoader/DirectoryIndex,
+ * so a repeated scan only opens files whose size or modification time changed.
+ */
+UCLASS(BlueprintType)
+class RUNTIMEIMAGELOADER_API URuntimeImageDirectoryScan : public UObject
+{
+    GENERATED_BODY()
+
+public:
+    /** Starts scanning right away. Keep a reference to the returned object */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Utilities")
+    static URuntimeImageDirectoryScan* ScanDirectory(const FString& Directory, bool bIsRecursive = true, bool bProbeHeaders = false, ERuntimeImagePriority Priority = ERuntimeImagePriority::Low);
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Utilities")
+    void Cancel();
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Utilities")
+    bool IsScanning() const { return ScanTaskHandle.IsValid(); }
+
+    /** Everything found so far */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Utilities")
+    TArray<FRuntimeImageFileInfo> GetImages() const { return Images; }
+
+public:
+    UPROPERTY(BlueprintAssignable)
+    FImageDirectoryScanBatchDelegate OnImagesFound;
+
+    UPROPERTY(BlueprintAssignable)
+    FImageDirectoryScanCompletedDelegate OnCompleted;
+
+    UPROPERTY(BlueprintAssignable)
+    FImageDirectoryScanFailureDelegate OnFail;
+
+public:
+    virtual void BeginDestroy() override;
+
+private:
+    void Start(const FString& Directory, bool bIsRecursive, bool bProbeHeaders, ERuntimeImagePriority Priority);
+
+    void OnBatchFound(TArray<FRuntimeImageFileInfo>&& Batch);
+    void OnScanFinished(const FString& Error);
+
+private:
+    TArray<FRuntimeImageFileInfo> Images;
+    FRuntimeImageTaskHandle ScanTaskHandle;
+};
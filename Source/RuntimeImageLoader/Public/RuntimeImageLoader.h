@@ -12,12 +12,19 @@
 #include "Materials/MaterialInterface.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "RuntimeImageReader.h"
+#include "RuntimeImageScheduler.h"
+#include "RuntimeImageTensor.h"
 #include "RuntimeImageLoader.generated.h"
 
+class FOutputDevice;
 class UAnimatedTexture2D;
 class URuntimeGifReader;
+class FRequestRecorder;
+class FRequestReplay;
 
 DECLARE_DELEGATE_OneParam(FOnRequestCompleted, const FImageReadResult&);
+DECLARE_DELEGATE_TwoParams(FOnImageDataLoaded, TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> /*ImageData*/, const FString& /*Error*/);
+DECLARE_DELEGATE_TwoParams(FOnTensorLoaded, bool /*bSuccess*/, const TArray<FString>& /*Errors*/);
 
 struct RUNTIMEIMAGELOADER_API FLoadImageRequest
 {
@@ -25,6 +32,7 @@ public:
     void Invalidate()
     {
         Params = FImageReadRequest();
+        QueuedTime = 0.0;
     }
 
     bool IsRequestValid() const 
@@ -35,6 +43,105 @@ public:
 public:
     FImageReadRequest Params;
     FOnRequestCompleted OnRequestCompleted;
+
+    /** FPlatformTime::Seconds when the request joined the queue */
+    double QueuedTime = 0.0;
+};
+
+USTRUCT(BlueprintType)
+struct RUNTIMEIMAGELOADER_API FRuntimeImageStageLatency
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 Count = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    float AverageMs = 0.0f;
+
+    /** Upper bound of the histogram bucket holding the 95th percentile, up to 19% above the exact value */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    float P95Ms = 0.0f;
+};
+
+/**
+ * Snapshot of loader counters, collected in shipping builds as well.
+ * Queue depth is of the loader it was taken from, everything else is process wide and accumulates until "ril.Stats reset"
+ */
+USTRUCT(BlueprintType)
+struct RUNTIMEIMAGELOADER_API FRuntimeImageLoaderStats
+{
+    GENERATED_BODY()
+
+    /** Still image requests waiting for the reader, which schedules them one at a time */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int32 QueuedRequests = 0;
+
+    /** Requests being read, decoded and uploaded, the reader takes one at a time */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int32 InFlightRequests = 0;
+
+    /** Still image, animation, tile and tensor tasks waiting in FRuntimeImageScheduler */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int32 QueuedTasks = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int32 RunningTasks = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 CompletedRequests = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 FailedRequests = 0;
+
+    /** Lookups of decoded animations and their textures shared between requests */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 CacheHits = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 CacheMisses = 0;
+
+    /** 0..1, zero until the first lookup */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    float CacheHitRate = 0.0f;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 BytesRead = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 BytesDecoded = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 BytesUploaded = 0;
+
+    /** Live textures created by the plugin and their estimated GPU size, as listed by "ril.DumpTextures" */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int32 ResidentTextures = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    int64 ResidentBytes = 0;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency Read;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency Decode;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency Transform;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency CreateUObject;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency Upload;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency Callback;
+
+    /** From queuing a request to its completion callback, waiting in the queue included */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FRuntimeImageStageLatency Total;
 };
 
 /**
@@ -65,6 +172,28 @@ public:
     UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader", meta = (Latent, LatentInfo = "LatentInfo", HidePin = "WorldContextObject", DefaultToSelf = "WorldContextObject"))
     void LoadImagePixels(const FInputImageDescription& InputImage, const FTransformImageParams& TransformParams, TArray<FColor>& OutImagePixels, bool& bSuccess, FString& OutError, FLatentActionInfo LatentInfo, UObject* WorldContextObject = nullptr);
 
+    //------------------ Native API --------------------
+    /**
+     * Loads the image in the format it was decoded to (G8, BGRA8, RGBA16, RGBA16F, BGRE8...) without conversion.
+     * Pixels are not copied on the way, the caller becomes the owner of the returned image. Transform params are not applied
+     */
+    void LoadImageData(const FInputImageDescription& InputImage, FOnImageDataLoaded&& OnLoaded);
+    TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> LoadImageDataSync(const FInputImageDescription& InputImage, FString& OutError);
+
+    /** Queues a request like the Blueprint functions do, OnCompleted is called on the game thread unless the request gets cancelled */
+    void LoadImage(const FInputImageDescription& InputImage, const FTransformImageParams& TransformParams, FOnRequestCompleted&& OnCompleted);
+
+    /**
+     * Decodes a batch of images straight into a caller owned tensor of Images.Num() x Params.GetImageSizeBytes() bytes.
+     * Images are decoded in parallel and each is resized, normalized and laid out in one pass, no textures are created.
+     * Slices of images that failed to load are zeroed and OutErrors holds one entry per image (empty on success)
+     * When called on the game thread http(s) images without ImageBytes fail, downloading them would block the thread that ticks http
+     */
+    static bool LoadImagesToTensorSync(const TArray<FInputImageDescription>& Images, const FImageTensorParams& Params, void* OutTensor, int64 TensorSizeBytes, TArray<FString>& OutErrors);
+
+    /** Same as LoadImagesToTensorSync on a scheduler worker. OutTensor must stay alive until OnLoaded is called on the game thread */
+    static FRuntimeImageTaskHandle LoadImagesToTensor(const TArray<FInputImageDescription>& Images, const FImageTensorParams& Params, void* OutTensor, int64 TensorSizeBytes, FOnTensorLoaded&& OnLoaded, ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal);
+
     /** Utilities */
     UFUNCTION(BlueprintCallable, Category = "Runtime Image Loader | Utilities")
     void CancelAll();
@@ -78,6 +207,29 @@ public:
     UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Runtime Image Loader | Utilities")
     static FString GetThisPluginResourcesDirectory();
 
+    /** Queue depth, latencies, cache hit rate and resident memory for monitoring, also printed by ril.Stats */
+    UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Runtime Image Loader | Utilities")
+    FRuntimeImageLoaderStats GetLoaderStats() const;
+
+    /** Lists the active and queued requests, also available as ril.DumpQueue */
+    void DumpQueue(FOutputDevice& Ar);
+
+    //------------------ Capture & Replay --------------------
+    /**
+     * Appends every queued request and CancelAll to a capture in CaptureDirectory until StopRecording.
+     * Sync loads don't go through the queue and are not recorded. Also available as ril.Record / ril.StopRecording
+     */
+    bool StartRecording(const FString& CaptureDirectory, FString& OutError);
+    void StopRecording();
+    bool IsRecording() const { return Recorder.IsValid(); }
+
+    /**
+     * Replays a capture at its recorded timing and logs latency percentiles per source when done, the report is saved next to the capture.
+     * URLs are served from HttpRoot (<capture>/http when empty) by a local HTTP listener on HttpPort. Also available as ril.Replay
+     */
+    bool StartReplay(const FString& CaptureDirectory, const FString& HttpRoot, uint32 HttpPort, float Speed, FString& OutError);
+    bool IsReplaying() const { return Replay.IsValid(); }
+
 protected:
     virtual void Initialize(FSubsystemCollectionBase& Collection) override;
     virtual void Deinitialize() override;
@@ -90,10 +242,19 @@ private:
 
     URuntimeImageReader* InitializeImageReader();
 
+    /** Tags the request for tracing before it joins the queue */
+    void EnqueueRequest(FLoadImageRequest& Request);
+
 private:
     UPROPERTY()
     URuntimeImageReader* ImageReader = nullptr;
 
     TQueue<FLoadImageRequest> Requests;
     FLoadImageRequest ActiveRequest;
+
+    /** TQueue doesn't keep its size */
+    int32 NumQueuedRequests = 0;
+
+    TSharedPtr<FRequestRecorder> Recorder;
+    TSharedPtr<FRequestReplay> Replay;
 };
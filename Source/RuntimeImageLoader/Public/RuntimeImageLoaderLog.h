@@ -11,4 +11,5 @@
 DECLARE_LOG_CATEGORY_EXTERN(RuntimeImageLoaderLibHandler, Log, All);
 DECLARE_LOG_CATEGORY_EXTERN(LibNsGifHelper, Log, All);
 DECLARE_LOG_CATEGORY_EXTERN(LibWebpGifHelper, Log, All);
+DECLARE_LOG_CATEGORY_EXTERN(LibApngHelper, Log, All);
 DECLARE_LOG_CATEGORY_EXTERN(RuntimeGifReader, Log, All);
\ No newline at end of file
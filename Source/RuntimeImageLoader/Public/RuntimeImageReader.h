@@ -4,19 +4,17 @@
 
 #include "CoreMinimal.h"
 #include "Engine/Texture.h"
-#include "Misc/ScopedEvent.h"
-#include "HAL/Runnable.h"
 #include "HAL/ThreadSafeBool.h"
 #include "ImageCore.h"
 #include "Containers/Queue.h"
 #include "RuntimeImageData.h"
 #include "InputImageDescription.h"
+#include "RuntimeImageStatistics.h"
+#include "RuntimeImageScheduler.h"
 #include "RuntimeImageReader.generated.h"
 
 
 class URuntimeTextureFactory;
-class FRunnableThread;
-class FEvent;
 class UTexture2D;
 class UTextureCube;
 class IImageReader;
@@ -39,9 +37,23 @@ struct RUNTIMEIMAGELOADER_API FTransformImageParams
     UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Reader", UIMin = 0, UIMax = 100, ClampMin = 0, ClampMax = 100))
     int32 PercentSizeY = 100;
 
+    /**
+     * Pick the cheapest pixel format the image content allows, e.g. G8 for opaque greyscale stored as color.
+     * Only applies to textures not meant for UI, see FImageReadResult::OutPixelFormat for the choice
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Reader"))
+    bool bAutoPixelFormat = false;
+
+    /** Gather FImageReadResult::OutStatistics while decoding */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Reader"))
+    bool bComputeStatistics = false;
+
     // Hidden as there is method in RuntimeImageLoader that sets this flag
     bool bOnlyPixels = false;
 
+    // Hidden as well, see URuntimeImageLoader::LoadImageData. Other transform params are ignored
+    bool bNativeImageData = false;
+
     bool IsPercentSizeValid() const
     {
         return PercentSizeX > 0 && PercentSizeX < 100 && PercentSizeY > 0 && PercentSizeY < 100;
@@ -53,6 +65,12 @@ struct RUNTIMEIMAGELOADER_API FImageReadRequest
     FInputImageDescription InputImage;
     FTransformImageParams TransformParams;
     bool bPixelsOnly;
+
+    /** Identifies the request on the RuntimeImageLoader trace channel */
+    uint64 TraceRequestId = 0;
+
+    /** Order in FRuntimeImageScheduler relative to other pending loads */
+    ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal;
 };
 
 USTRUCT()
@@ -71,12 +89,38 @@ struct RUNTIMEIMAGELOADER_API FImageReadResult
     UPROPERTY()
     UTextureCube* OutTextureCube = nullptr;
 
+    /** Decoded image in its source format, shared so that results are passed along without copying pixels */
+    TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> OutImageData;
+
+    /** Filled when FTransformImageParams::bComputeStatistics is set, describes the decoded image before resizing */
+    UPROPERTY()
+    FRuntimeImageStatistics OutStatistics;
+
+    /** Pixel format the texture was created with */
+    EPixelFormat OutPixelFormat = PF_Unknown;
+
     FString OutError = TEXT("");
 };
 
 
+/** A request moving through the stages of URuntimeImageReader */
+struct FImageReadTask
+{
+    FImageReadRequest Request;
+    FTransformImageParams TransformParams;
+    FRuntimeImageData ImageData;
+    FImageReadResult Result;
+
+    TSharedPtr<IImageReader, ESPMode::ThreadSafe> ImageReader;
+
+    /** Stage currently queued or running in FRuntimeImageScheduler */
+    FRuntimeImageTaskHandle TaskHandle;
+    FThreadSafeBool bCancelled = false;
+};
+
+
 UCLASS()
-class RUNTIMEIMAGELOADER_API URuntimeImageReader : public UObject, public FRunnable
+class RUNTIMEIMAGELOADER_API URuntimeImageReader : public UObject
 {
     GENERATED_BODY()
 
@@ -85,26 +129,41 @@ public:
     void Deinitialize();
 
 public:
+    /**
+     * Reads and decodes the request on FRuntimeImageScheduler, next to animation and tile loads.
+     * Texture objects are created on the game thread in between, so no scheduler worker waits for it.
+     * Game thread only, one request at a time
+     */
+    void ScheduleRequest(const FImageReadRequest& Request);
+    bool GetScheduledResult(FImageReadResult& OutResult);
+
+    /** Requests processed on the calling thread by BlockTillAllRequestsFinished */
     void AddRequest(const FImageReadRequest& Request);
     bool GetResult(FImageReadResult& OutResult);
-    void Clear();
-    void Stop();
     bool IsWorkCompleted() const;
-
-    void Trigger();
     void BlockTillAllRequestsFinished();
     bool ProcessRequest(FImageReadRequest& Request);
 
-protected:
-    /* FRunnable interface */
-    bool Init() override;
-    uint32 Run() override;
-    void Exit() override;
-    /* ~FRunnable interface */
+    void Clear();
+
+    /** Transform stages of ProcessRequest, public so offline tools (URuntimeImageConvertCommandlet) run the same code */
+    static EPixelFormat DeterminePixelFormat(ERawImageFormat::Type ImageFormat, const FTransformImageParams& Params);
+    static void ApplySizeFormatTransformations(FRuntimeImageData& ImageData, FTransformImageParams TransformParams);
+    static void SelectCheapestPixelFormat(FRuntimeImageData& ImageData, const FTransformImageParams& TransformParams);
 
 private:
-    EPixelFormat DeterminePixelFormat(ERawImageFormat::Type ImageFormat, const FTransformImageParams& Params) const;
-    void ApplySizeFormatTransformations(FRuntimeImageData& ImageData, FTransformImageParams TransformParams);
+    /** Stages of a request: read and decode on a worker, create texture objects on the game thread, upload on a worker */
+    static bool ReadAndDecode(FImageReadTask& Task);
+    bool CreateTextureObject(FImageReadTask& Task);
+    static bool UploadTexture(FImageReadTask& Task);
+    static bool NeedsTexture(const FImageReadRequest& Request);
+
+    /** Texture objects stay rooted until a UPROPERTY result references them */
+    static void UnrootTextures(FImageReadResult& Result);
+
+    static void RunScheduledDecode(TWeakObjectPtr<URuntimeImageReader> WeakReader, TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task);
+    static void RunScheduledUpload(TWeakObjectPtr<URuntimeImageReader> WeakReader, TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task);
+    static void PublishScheduledResult(TWeakObjectPtr<URuntimeImageReader> WeakReader, TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> Task);
 
 private:
     TQueue<FImageReadRequest, EQueueMode::Mpsc> Requests;
@@ -121,12 +180,12 @@ private:
     UPROPERTY()
     URuntimeTextureFactory* TextureFactory;
 
-private:
-    FRunnableThread* Thread = nullptr;
-    FEvent* ThreadSemaphore = nullptr;
+    UPROPERTY()
+    FImageReadResult ScheduledResult;
 
-    TSharedPtr<IImageReader, ESPMode::ThreadSafe> ImageReader;
+    TSharedPtr<FImageReadTask, ESPMode::ThreadSafe> ScheduledTask;
+    bool bHasScheduledResult = false;
 
+private:
     FThreadSafeBool bCompletedWork = true; 
-    FThreadSafeBool bStopThread = false;
 };
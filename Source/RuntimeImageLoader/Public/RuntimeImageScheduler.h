@@ -0,0 +1,98 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Templates/Function.h"
+#include "RuntimeImageScheduler.generated.h"
+
+UENUM(BlueprintType)
+enum class ERuntimeImagePriority : uint8
+{
+    Low,
+    Normal,
+    High,
+};
+
+/**
+ * Identifies a task submitted to FRuntimeImageScheduler. Copies share the same state,
+ * so a handle kept by the caller can cancel the task the worker is running.
+ */
+class RUNTIMEIMAGELOADER_API FRuntimeImageTaskHandle
+{
+public:
+    FRuntimeImageTaskHandle() = default;
+
+    bool IsValid() const { return State.IsValid(); }
+    uint64 GetId() const { return State.IsValid() ? State->Id : 0; }
+    ERuntimeImagePriority GetPriority() const { return State.IsValid() ? State->Priority : ERuntimeImagePriority::Normal; }
+
+    /** Long running tasks poll this between units of work (e.g. animation frames) and bail out */
+    bool IsCancelled() const { return State.IsValid() && State->bCancelled; }
+
+    /** Same as FRuntimeImageScheduler::Cancel */
+    void Cancel() const;
+
+private:
+    friend class FRuntimeImageScheduler;
+
+    struct FState
+    {
+        uint64 Id = 0;
+        ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal;
+        FThreadSafeBool bCancelled = false;
+    };
+
+    TSharedPtr<FState, ESPMode::ThreadSafe> State;
+};
+
+/**
+ * Process wide queue for decode work that would otherwise be fired straight at the thread pool.
+ * Tasks run in priority order (FIFO within the same priority) with a limited number running at once,
+ * so a burst of loads doesn't starve engine tasks.
+ */
+class RUNTIMEIMAGELOADER_API FRuntimeImageScheduler
+{
+public:
+    using FTask = TUniqueFunction<void(const FRuntimeImageTaskHandle&)>;
+
+    static FRuntimeImageScheduler& Get();
+
+    /** Every task is invoked exactly once. Tasks cancelled while still queued are invoked on the cancelling thread with a cancelled handle */
+    FRuntimeImageTaskHandle Schedule(FTask&& Task, ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal);
+
+    /** Cancels a queued or running task. Returns true if the task had not started yet */
+    bool Cancel(const FRuntimeImageTaskHandle& Handle);
+    void CancelAll();
+
+    void SetMaxConcurrentTasks(int32 InMaxConcurrentTasks);
+    int32 GetMaxConcurrentTasks() const;
+
+    int32 GetNumQueuedTasks() const;
+    int32 GetNumRunningTasks() const;
+
+private:
+    FRuntimeImageScheduler();
+
+    struct FQueuedTask
+    {
+        FRuntimeImageTaskHandle Handle;
+        FTask Task;
+    };
+
+    void LaunchWorkers();
+    void RunWorker();
+    bool DequeueTask(FQueuedTask& OutTask);
+    void UpdateQueueStats() const;
+
+private:
+    mutable FCriticalSection QueueMutex;
+
+    /** Indexed by ERuntimeImagePriority */
+    TArray<FQueuedTask> Queues[3];
+
+    int32 NumRunningWorkers = 0;
+    int32 MaxConcurrentTasks = 2;
+    uint64 NextTaskId = 1;
+};
@@ -0,0 +1,53 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RuntimeImageStatistics.generated.h"
+
+/**
+ * Statistics of a decoded image, gathered when FTransformImageParams::bComputeStatistics is set.
+ * Values are in the image's own encoding on the 0..1 scale (sRGB for 8 bit images), HDR images may exceed 1
+ */
+USTRUCT(BlueprintType)
+struct RUNTIMEIMAGELOADER_API FRuntimeImageStatistics
+{
+    GENERATED_BODY()
+
+    static constexpr int32 NumHistogramBins = 256;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    bool bValid = false;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FLinearColor AverageColor = FLinearColor::Transparent;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FLinearColor MinValue = FLinearColor::Transparent;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    FLinearColor MaxValue = FLinearColor::Transparent;
+
+    /** Pixel counts per channel, values are clamped to 0..1 and split into NumHistogramBins bins */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    TArray<int64> HistogramR;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    TArray<int64> HistogramG;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    TArray<int64> HistogramB;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    TArray<int64> HistogramA;
+
+    /** Source format stores alpha, images without it are always fully opaque */
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    bool bHasAlphaChannel = false;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    bool bFullyOpaque = false;
+
+    UPROPERTY(BlueprintReadOnly, meta = (Category = "Runtime Image Loader"))
+    bool bFullyTransparent = false;
+};
@@ -0,0 +1,56 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RuntimeImageTensor.generated.h"
+
+UENUM(BlueprintType)
+enum class ERuntimeTensorLayout : uint8
+{
+    /** Batch, channel planes, rows, columns */
+    NCHW,
+    /** Batch, rows, columns, interleaved channels */
+    NHWC,
+};
+
+/**
+ * Describes the tensor images are written to by URuntimeImageLoader::LoadImagesToTensor.
+ * Every image is resized to Width x Height and each of its 3 colour channels is stored as (Value / 255 - Mean) / Std
+ */
+USTRUCT(BlueprintType)
+struct RUNTIMEIMAGELOADER_API FImageTensorParams
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader", ClampMin = 1))
+    int32 Width = 224;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader", ClampMin = 1))
+    int32 Height = 224;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader"))
+    ERuntimeTensorLayout Layout = ERuntimeTensorLayout::NCHW;
+
+    /** Store 16 bit floats instead of 32 bit ones */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader"))
+    bool bHalfPrecision = false;
+
+    /** Channel order is BGR instead of RGB */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader"))
+    bool bBGR = false;
+
+    /** Per channel mean and standard deviation on the 0..1 scale, alpha is ignored */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader"))
+    FLinearColor Mean = FLinearColor(0.f, 0.f, 0.f, 0.f);
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (Category = "Runtime Image Loader"))
+    FLinearColor Std = FLinearColor(1.f, 1.f, 1.f, 1.f);
+
+    static constexpr int32 NumChannels = 3;
+
+    int64 GetImageNumElements() const { return (int64)Width * Height * NumChannels; }
+    int64 GetImageSizeBytes() const { return GetImageNumElements() * (bHalfPrecision ? 2 : 4); }
+
+    bool IsValid() const { return Width > 0 && Height > 0 && Std.R != 0.f && Std.G != 0.f && Std.B != 0.f; }
+};
@@ -4,13 +4,20 @@
 
 #include "CoreMinimal.h"
 #include "RuntimeImageData.h"
+#include "InputImageDescription.h"
 
 class UTexture2D;
 class UTextureCube;
 
 namespace FRuntimeImageUtils
 {
-    bool ImportBufferAsImage(const uint8* Buffer, int32 Length, FRuntimeImageData& OutImage, FString& OutError);
+    bool ImportBufferAsImage(const uint8* Buffer, int64 Length, FRuntimeImageData& OutImage, FString& OutError);
+
+    /** Reads the file (or takes the bytes) and decodes it on the calling thread */
+    bool ImportImage(const FInputImageDescription& InputImage, FRuntimeImageData& OutImage, FString& OutError);
+
+    /** Decoded images may be larger than any texture, this checks the size against the texture limits */
+    bool IsTextureResolutionValid(int32 Width, int32 Height);
 
     UTexture2D* CreateTexture(const FString& ImageFilename, const FRuntimeImageData& ImageData);
     UTextureCube* CreateTextureCube(const FString& ImageFilename, const FRuntimeImageData& ImageData);
@@ -19,7 +26,9 @@ namespace FRuntimeImageUtils
         TEXT(".png"), TEXT(".jpg"), TEXT(".jpeg"), 
         TEXT(".bmp"), TEXT(".tga"), TEXT(".exr"), 
         TEXT(".tif"), TEXT(".tiff"), TEXT(".qoi"),
-        TEXT(".hdr"), TEXT(".tiff"), TEXT(".qoi"),
-        TEXT(".jfif")
+        TEXT(".hdr"), TEXT(".jfif")
     };
+
+    /** Matches the extension against SupportedImageFormats, case insensitive */
+    bool IsSupportedImageFile(const FString& Filename);
 }
\ No newline at end of file
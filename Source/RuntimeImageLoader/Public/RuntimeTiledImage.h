@@ -0,0 +1,126 @@
+// Copyright 2023 Petr Leontev. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Engine/Texture2D.h"
+#include "RuntimeImageScheduler.h"
+#include "RuntimeTiledImage.generated.h"
+
+struct FTilePyramidDescriptor;
+struct FRuntimeImageData;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FTiledImageDelegate);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FTiledImageFailureDelegate, FString, OutError);
+
+/** Tile texture and where to draw it */
+USTRUCT(BlueprintType)
+struct RUNTIMEIMAGELOADER_API FRuntimeImageTile
+{
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Tiled Image")
+    UTexture2D* Texture = nullptr;
+
+    /** Area of the whole image covered by the tile, normalized to 0..1 */
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Tiled Image")
+    FBox2D ImageRegion = FBox2D(ForceInit);
+
+    /** Part of the texture to draw over ImageRegion, leaves out the overlap with neighbouring tiles */
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Tiled Image")
+    FBox2D TextureRegion = FBox2D(ForceInit);
+
+    /** Pyramid level, coarser tiles (lower levels) are returned in place of tiles that are still loading */
+    UPROPERTY(BlueprintReadOnly, Category = "Runtime Tiled Image")
+    int32 Level = 0;
+};
+
+/**
+ * Image too large for a single texture, displayed as a pyramid of tiles.
+ * Only tiles of the visible region at the level matching the view resolution are decoded and uploaded,
+ * the least recently used ones are evicted past the cache budget, so memory follows what is on screen.
+ *
+ * The source is either a Deep Zoom (.dzi) pyramid already on disk, or any supported image
+ * which is decoded once and cut into a pyramid cached under Saved/RuntimeImageLoader/TilePyramids.
+ */
+UCLASS(BlueprintType)
+class RUNTIMEIMAGELOADER_API URuntimeTiledImage : public UObject
+{
+    GENERATED_BODY()
+
+public:
+    /** OnReady is broadcast once the pyramid is available. Keep a reference to the returned object */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    static URuntimeTiledImage* OpenTiledImage(const FString& ImageFilename, int32 MaxCachedTiles = 256, ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal);
+
+    /**
+     * Requests the tiles needed to show VisibleRegion (normalized 0..1 image coordinates) on ViewWidthPixels screen pixels.
+     * Tiles left out of the view stop loading, OnTilesUpdated is broadcast as new tiles arrive
+     */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    void UpdateView(const FBox2D& VisibleRegion, float ViewWidthPixels);
+
+    /** Loaded tiles for the current view, coarse stand-ins first so finer tiles can be drawn on top */
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    TArray<FRuntimeImageTile> GetVisibleTiles() const;
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    bool IsReady() const { return Descriptor.IsValid(); }
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    int32 GetWidth() const;
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    int32 GetHeight() const;
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    void SetMaxCachedTiles(int32 InMaxCachedTiles);
+
+    UFUNCTION(BlueprintCallable, Category = "Runtime Tiled Image")
+    int32 GetNumCachedTiles() const { return CachedTiles.Num(); }
+
+public:
+    UPROPERTY(BlueprintAssignable)
+    FTiledImageDelegate OnReady;
+
+    UPROPERTY(BlueprintAssignable)
+    FTiledImageDelegate OnTilesUpdated;
+
+    UPROPERTY(BlueprintAssignable)
+    FTiledImageFailureDelegate OnFail;
+
+public:
+    virtual void BeginDestroy() override;
+
+private:
+    void Open(const FString& ImageFilename);
+    void OnOpened(TSharedPtr<const FTilePyramidDescriptor, ESPMode::ThreadSafe> InDescriptor, const FString& Error);
+
+    void RequestTile(const FIntVector& TileKey);
+    FRuntimeImageTaskHandle UploadTile(const FIntVector& TileKey, UTexture2D* Texture, TSharedPtr<FRuntimeImageData, ESPMode::ThreadSafe> TileImage);
+    bool IsTilePending(const FIntVector& TileKey, uint64 TaskId) const;
+    void OnTileLoaded(const FIntVector& TileKey, UTexture2D* Texture, const FString& Error);
+    void EvictTiles();
+
+    FRuntimeImageTile MakeTile(const FIntVector& TileKey, UTexture2D* Texture) const;
+
+private:
+    /** Tiles are keyed by (Column, Row, Level) */
+    UPROPERTY(Transient)
+    TMap<FIntVector, UTexture2D*> CachedTiles;
+
+    TMap<FIntVector, uint64> TileLastUsed;
+    TMap<FIntVector, FRuntimeImageTaskHandle> PendingTiles;
+
+    /** Tiles wanted by the last UpdateView, ViewSerial marks them as used */
+    TArray<FIntVector> ViewTiles;
+    uint64 ViewSerial = 0;
+
+    TSharedPtr<const FTilePyramidDescriptor, ESPMode::ThreadSafe> Descriptor;
+    FRuntimeImageTaskHandle OpenTaskHandle;
+
+    int32 MaxCachedTiles = 256;
+    ERuntimeImagePriority Priority = ERuntimeImagePriority::Normal;
+};
@@ -12,7 +12,9 @@
 struct FRenderCommandData
 {
 	FTextureResource* RHIResource;
-	const uint8* RawData;
+	TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> Decoder;
+	int32 FrameIndex;
+	FIntRect DirtyRect;
 };
 
 /** @See Texture2DDynamic Class
@@ -84,7 +86,8 @@ public:
 	static UAnimatedTexture2D* Create(int32 InSizeX, int32 InSizeY, const FAnimatedTexture2DCreateInfo& InCreateInfo = FAnimatedTexture2DCreateInfo());
 
 public:
-	void SetDecoder(TUniquePtr<IGIFLoader> DecoderState);
+	/** Decoded frames may be shared between several animated textures, see FGIFLoaderCache */
+	void SetDecoder(TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> DecoderState);
 
 public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = RuntimeAnimatedTexture, meta = (DisplayName = "X-axis Tiling Method"), AdvancedDisplay)
@@ -103,8 +106,8 @@ public:
 	bool bLooping = true;
 
 public:
-	/* Used by AnimatedTextureResource when initializing the texture */
-	const uint8* GetFirstFrameData() const;
+	/* Used by AnimatedTextureResource when initializing the texture, the data is only valid inside the visitor */
+	void ReadFirstFrameData(TFunctionRef<void(const uint8* FrameData)> Visitor) const;
 	uint32 GetFrameSize() const;
 
 	virtual float GetSurfaceWidth() const override;
@@ -133,6 +136,9 @@ protected:
 
 	void RenderFrameToTexture();
 
+	/** Delay of the frame from the decoder, DefaultFrameDelay for frames without one */
+	float GetFrameDelay(int32 FrameIndex) const;
+
 protected:
 	virtual FTextureResource* CreateResource() override;
 	virtual EMaterialValueType GetMaterialType() const override { return MCT_Texture2D; }
@@ -161,7 +167,7 @@ private:
 	ESamplerAddressMode SamplerAddressMode;
 
 private:
-	TUniquePtr<IGIFLoader> Decoder;
+	TSharedPtr<IGIFLoader, ESPMode::ThreadSafe> Decoder;
 
 	float FrameDelay = 0.0f;
 	float FrameTime = 0.0f;
@@ -169,5 +175,6 @@ private:
 
 private:
 	int32 CurrentFrame = 0;
+	int32 LastRenderedFrame = INDEX_NONE;
 	FCriticalSection ResultsMutex;
 };
\ No newline at end of file
@@ -54,8 +54,10 @@ public class RuntimeImageLoader : ModuleRules
 				"ImageCore",
 				"FreeImage",
 				"HTTP",
+				"HTTPServer",
                 "RuntimeGifLibrary",
 				"Projects",
+				"Json",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -65,6 +67,10 @@ public class RuntimeImageLoader : ModuleRules
 			Path.Combine(EngineDir, @"Source/Runtime/Renderer/Private")
         });
 
+		// row by row PNG decoding for downscaled loads, see FPNGScanlineDecoder
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "UElibPNG", "zlib");
+		PrivateDefinitions.Add("WITH_LIBPNG=1");
+
         DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{